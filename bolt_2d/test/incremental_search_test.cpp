@@ -0,0 +1,305 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, PickNik LLC
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of PickNik LLC nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman
+   Desc:   Compare the incremental task graph search with Dijkstra on random grid graphs
+*/
+
+// C++
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+// ROS
+#include <ros/ros.h>
+
+// Testing
+#include <gtest/gtest.h>
+
+// Boost
+#include <boost/foreach.hpp>
+
+// OMPL
+#include <bolt_core/Bolt.h>
+#include <bolt_core/IncrementalTaskSearch.h>
+#include <ompl/base/StateSpace.h>
+#include <ompl/base/spaces/RealVectorStateSpace.h>
+
+namespace ob = ompl::base;
+namespace otb = ompl::tools::bolt;
+
+#define foreach BOOST_FOREACH
+
+/* Helpers -------------------------------------------------------------------------------- */
+
+const double INF = std::numeric_limits<double>::infinity();
+
+// Bolt in an empty 2D world, with visualization disabled because no visualizer is running
+otb::BoltPtr createBolt()
+{
+  const std::size_t dimensions = 2;
+  ob::StateSpacePtr space(new ob::RealVectorStateSpace(dimensions));
+  ob::RealVectorBounds bounds(dimensions);
+  bounds.setLow(0);
+  bounds.setHigh(200);
+  space->as<ob::RealVectorStateSpace>()->setBounds(bounds);
+  space->setup();
+
+  otb::BoltPtr bolt(new otb::Bolt(space));
+  bolt->setStateValidityChecker([](const ob::State *)
+                                {
+                                  return true;
+                                });
+  bolt->setup();
+
+  otb::SparseGraphPtr sg = bolt->getSparseGraph();
+  sg->visualizeGraphAfterLoading_ = false;
+  sg->visualizeVoronoiDiagram_ = false;
+  sg->visualizeVoronoiDiagramAnimated_ = false;
+  bolt->getTaskGraph()->visualizeTaskGraph_ = false;
+  return bolt;
+}
+
+// Grid of jittered vertices on the bottom level connected to their neighbors, plus some random diagonals
+std::vector<otb::TaskVertex> addRandomGrid(otb::TaskGraphPtr taskGraph, std::size_t size, std::mt19937 &random)
+{
+  const ob::StateSpacePtr &space = taskGraph->getSparseGraph()->getSpaceInformation()->getStateSpace();
+  std::uniform_real_distribution<double> jitter(-3.0, 3.0);
+  std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+  std::vector<otb::TaskVertex> vertices;
+  for (std::size_t x = 0; x < size; ++x)
+    for (std::size_t y = 0; y < size; ++y)
+    {
+      ob::State *state = space->allocState();
+      state->as<ob::RealVectorStateSpace::StateType>()->values[0] = 10.0 + 10.0 * x + jitter(random);
+      state->as<ob::RealVectorStateSpace::StateType>()->values[1] = 10.0 + 10.0 * y + jitter(random);
+      vertices.push_back(taskGraph->addVertexWithLevel(state, 0, 0));
+    }
+
+  for (std::size_t x = 0; x < size; ++x)
+    for (std::size_t y = 0; y < size; ++y)
+    {
+      const otb::TaskVertex v = vertices[x * size + y];
+      if (x + 1 < size)
+        taskGraph->addEdge(v, vertices[(x + 1) * size + y], 0);
+      if (y + 1 < size)
+        taskGraph->addEdge(v, vertices[x * size + y + 1], 0);
+      if (x + 1 < size && y + 1 < size && chance(random) < 0.2)
+        taskGraph->addEdge(v, vertices[(x + 1) * size + y + 1], 0);
+    }
+
+  return vertices;
+}
+
+// Cost of the best path from the virtual source through any start to the virtual target through any goal
+double dijkstra(const otb::TaskGraphPtr &taskGraph, const std::vector<otb::TaskVertex> &starts,
+                const std::vector<double> &startCosts, const std::vector<otb::TaskVertex> &goals,
+                const std::vector<double> &goalCosts)
+{
+  typedef std::pair<double, otb::TaskVertex> QueueEntry;
+  const otb::TaskCSRGraph &graph = taskGraph->getFrozenGraph();
+  const otb::TaskCSREdgeWeightMap weights(graph);
+
+  std::vector<double> distances(taskGraph->getNumVertices(), INF);
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > queue;
+  for (std::size_t i = 0; i < starts.size(); ++i)
+    if (startCosts[i] < distances[starts[i]])
+    {
+      distances[starts[i]] = startCosts[i];
+      queue.push(QueueEntry(startCosts[i], starts[i]));
+    }
+
+  while (!queue.empty())
+  {
+    const QueueEntry entry = queue.top();
+    queue.pop();
+    if (entry.first > distances[entry.second])
+      continue;
+
+    foreach (const boost::graph_traits<otb::TaskCSRGraph>::edge_descriptor e, boost::out_edges(entry.second, graph))
+    {
+      const otb::TaskVertex u = boost::target(e, graph);
+      const double distance = entry.first + get(weights, e);
+      if (distance < distances[u])
+      {
+        distances[u] = distance;
+        queue.push(QueueEntry(distance, u));
+      }
+    }
+  }
+
+  double best = INF;
+  for (std::size_t i = 0; i < goals.size(); ++i)
+    best = std::min(best, distances[goals[i]] + goalCosts[i]);
+  return best;
+}
+
+// Cost of a path returned by the search, from its goal back to its start, or infinity if it is not a path
+double pathCost(const otb::TaskGraphPtr &taskGraph, const std::vector<otb::TaskVertex> &vertexPath,
+                const std::vector<otb::TaskVertex> &starts, const std::vector<double> &startCosts,
+                const std::vector<otb::TaskVertex> &goals, const std::vector<double> &goalCosts)
+{
+  const otb::TaskCSRGraph &graph = taskGraph->getFrozenGraph();
+  const otb::TaskCSREdgeWeightMap weights(graph);
+
+  double cost = INF;
+  for (std::size_t i = 0; i < goals.size(); ++i)
+    if (goals[i] == vertexPath.front())
+      cost = std::min(cost, goalCosts[i]);
+  double startCost = INF;
+  for (std::size_t i = 0; i < starts.size(); ++i)
+    if (starts[i] == vertexPath.back())
+      startCost = std::min(startCost, startCosts[i]);
+  cost += startCost;
+
+  for (std::size_t i = 1; i < vertexPath.size(); ++i)
+  {
+    double edgeCost = INF;
+    const otb::TaskVertex v = vertexPath[i - 1];
+    foreach (const boost::graph_traits<otb::TaskCSRGraph>::edge_descriptor e, boost::out_edges(v, graph))
+      if (boost::target(e, graph) == vertexPath[i])
+        edgeCost = std::min(edgeCost, get(weights, e));
+    cost += edgeCost;
+  }
+  return cost;
+}
+
+// Disable an edge of the task graph the way lazy collision checking does
+void disableEdge(otb::TaskGraphPtr taskGraph, otb::TaskVertex v1, otb::TaskVertex v2)
+{
+  otb::TaskEdge e = boost::edge(v1, v2, taskGraph->getGraph()).first;
+  taskGraph->getGraphNonConst()[e].collision_state_ = otb::IN_COLLISION;
+}
+
+/* Tests ---------------------------------------------------------------------------------- */
+
+// Repair the search after disabling edges of each path found, and after disabling random edges elsewhere
+TEST(IncrementalTaskSearchTest, matches_dijkstra)
+{
+  const std::size_t gridSize = 12;
+  const std::size_t numGraphs = 10;
+  const std::size_t numRepairs = 30;
+  std::mt19937 random(42);
+
+  for (std::size_t graphID = 0; graphID < numGraphs; ++graphID)
+  {
+    otb::BoltPtr bolt = createBolt();
+    otb::TaskGraphPtr taskGraph = bolt->getTaskGraph();
+    std::vector<otb::TaskVertex> vertices = addRandomGrid(taskGraph, gridSize, random);
+    taskGraph->freezeGraph(0);
+
+    // A few starts and goals, each with a connection cost
+    std::uniform_int_distribution<std::size_t> pickVertex(0, vertices.size() - 1);
+    std::uniform_real_distribution<double> pickCost(0.0, 5.0);
+    std::vector<otb::TaskVertex> starts, goals;
+    std::vector<double> startCosts, goalCosts;
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+      starts.push_back(vertices[pickVertex(random)]);
+      startCosts.push_back(pickCost(random));
+      goals.push_back(vertices[pickVertex(random)]);
+      goalCosts.push_back(pickCost(random));
+    }
+
+    otb::IncrementalTaskSearch search(taskGraph.get());
+    search.start(starts, startCosts, goals, goalCosts);
+
+    for (std::size_t repair = 0; repair < numRepairs; ++repair)
+    {
+      const double expected = dijkstra(taskGraph, starts, startCosts, goals, goalCosts);
+
+      std::vector<otb::TaskVertex> vertexPath;
+      double distance = INF;
+      const bool found = search.computePath(vertexPath, distance);
+      ASSERT_EQ(expected < INF, found) << "graph " << graphID << " repair " << repair;
+      if (!found)
+        break;
+
+      EXPECT_NEAR(expected, distance, 1e-6) << "graph " << graphID << " repair " << repair;
+      EXPECT_NEAR(distance, pathCost(taskGraph, vertexPath, starts, startCosts, goals, goalCosts), 1e-6)
+          << "graph " << graphID << " repair " << repair;
+
+      // Disable the middle edge of the path if it has one, like a collision found by lazy checking
+      if (vertexPath.size() > 1)
+      {
+        const std::size_t i = vertexPath.size() / 2;
+        disableEdge(taskGraph, vertexPath[i - 1], vertexPath[i]);
+        search.updateEdge(vertexPath[i - 1], vertexPath[i]);
+      }
+
+      // And an edge elsewhere in the graph, which should not change the result unless it is on the best path
+      const otb::TaskVertex v = vertices[pickVertex(random)];
+      otb::TaskAdjList::adjacency_iterator neighbor, end;
+      boost::tie(neighbor, end) = boost::adjacent_vertices(v, taskGraph->getGraph());
+      if (neighbor != end)
+      {
+        disableEdge(taskGraph, v, *neighbor);
+        search.updateEdge(v, *neighbor);
+      }
+    }
+  }
+}
+
+// A start that is also a goal is a path of one vertex with only the connection costs
+TEST(IncrementalTaskSearchTest, start_is_goal)
+{
+  std::mt19937 random(7);
+  otb::BoltPtr bolt = createBolt();
+  otb::TaskGraphPtr taskGraph = bolt->getTaskGraph();
+  std::vector<otb::TaskVertex> vertices = addRandomGrid(taskGraph, 4, random);
+  taskGraph->freezeGraph(0);
+
+  otb::IncrementalTaskSearch search(taskGraph.get());
+  search.start({ vertices[5] }, { 1.0 }, { vertices[5] }, { 2.0 });
+
+  std::vector<otb::TaskVertex> vertexPath;
+  double distance;
+  ASSERT_TRUE(search.computePath(vertexPath, distance));
+  ASSERT_EQ(1u, vertexPath.size());
+  EXPECT_EQ(vertices[5], vertexPath.front());
+  EXPECT_NEAR(3.0, distance, 1e-9);
+}
+
+/* Main  ------------------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "incremental_search_test");
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,306 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, PickNik LLC
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of PickNik LLC nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman
+   Desc:   Save and load the sparse graph in each file format
+*/
+
+// C++
+#include <fstream>
+#include <string>
+#include <vector>
+
+// ROS
+#include <ros/ros.h>
+
+// Testing
+#include <gtest/gtest.h>
+
+// Boost
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+// OMPL
+#include <bolt_core/Bolt.h>
+#include <ompl/base/StateSpace.h>
+#include <ompl/base/spaces/RealVectorStateSpace.h>
+
+namespace ob = ompl::base;
+namespace otb = ompl::tools::bolt;
+
+/* Helpers -------------------------------------------------------------------------------- */
+
+// Bolt in an empty 2D world, with visualization disabled because no visualizer is running
+otb::BoltPtr createBolt()
+{
+  const std::size_t dimensions = 2;
+  ob::StateSpacePtr space(new ob::RealVectorStateSpace(dimensions));
+  ob::RealVectorBounds bounds(dimensions);
+  bounds.setLow(0);
+  bounds.setHigh(100);
+  space->as<ob::RealVectorStateSpace>()->setBounds(bounds);
+  space->setup();
+
+  otb::BoltPtr bolt(new otb::Bolt(space));
+  bolt->setStateValidityChecker([](const ob::State *)
+                                {
+                                  return true;
+                                });
+  bolt->setup();
+
+  otb::SparseGraphPtr sg = bolt->getSparseGraph();
+  sg->visualizeGraphAfterLoading_ = false;
+  sg->visualizeVoronoiDiagram_ = false;
+  sg->visualizeVoronoiDiagramAnimated_ = false;
+  return bolt;
+}
+
+// Grid of vertices connected to their right and upper neighbors
+void addGrid(otb::SparseGraphPtr sg, std::size_t size, double offset)
+{
+  const ob::StateSpacePtr &space = sg->getSpaceInformation()->getStateSpace();
+  std::vector<otb::SparseVertex> vertices;
+  for (std::size_t x = 0; x < size; ++x)
+    for (std::size_t y = 0; y < size; ++y)
+    {
+      ob::State *state = space->allocState();
+      state->as<ob::RealVectorStateSpace::StateType>()->values[0] = offset + 10.0 * x + 0.123;
+      state->as<ob::RealVectorStateSpace::StateType>()->values[1] = offset + 10.0 * y + 0.456;
+      vertices.push_back(sg->addVertex(state, otb::COVERAGE, 0));
+    }
+
+  for (std::size_t x = 0; x < size; ++x)
+    for (std::size_t y = 0; y < size; ++y)
+    {
+      if (x + 1 < size)
+        sg->addEdge(vertices[x * size + y], vertices[(x + 1) * size + y], otb::eUNKNOWN, 0);
+      if (y + 1 < size)
+        sg->addEdge(vertices[x * size + y], vertices[x * size + y + 1], otb::eUNKNOWN, 0);
+    }
+}
+
+// Unique file for one test, removed with its journal when the test is done
+class TempDatabase
+{
+public:
+  TempDatabase()
+    : path_((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("bolt_%%%%%%%%.ompl")).string())
+  {
+  }
+
+  ~TempDatabase()
+  {
+    boost::filesystem::remove(path_);
+    boost::filesystem::remove(path_ + ".journal");
+  }
+
+  const std::string &path() const
+  {
+    return path_;
+  }
+
+private:
+  std::string path_;
+};
+
+// Save, wait for the background snapshot and release the storage of the saved graph
+void saveGraph(otb::BoltPtr bolt, const std::string &filePath)
+{
+  otb::SparseGraphPtr sg = bolt->getSparseGraph();
+  sg->setFilePath(filePath);
+  sg->setHasUnsavedChanges(true);
+  ASSERT_TRUE(sg->save());
+  sg->getSparseStorage()->waitForCompaction();
+}
+
+// Load into a new Bolt instance
+bool loadGraph(otb::BoltPtr bolt, const std::string &filePath)
+{
+  otb::SparseGraphPtr sg = bolt->getSparseGraph();
+  sg->setFilePath(filePath);
+  return sg->load();
+}
+
+// Same vertices in the same order, within the given tolerance, and the same edges
+void expectSameGraph(otb::SparseGraphPtr expected, otb::SparseGraphPtr actual, double tolerance)
+{
+  ASSERT_EQ(expected->getNumVertices(), actual->getNumVertices());
+  ASSERT_EQ(expected->getNumEdges(), actual->getNumEdges());
+
+  const ob::SpaceInformationPtr &si = expected->getSpaceInformation();
+  for (otb::SparseVertex v = expected->getNumQueryVertices(); v < expected->getNumVertices(); ++v)
+    EXPECT_NEAR(si->distance(expected->getState(v), actual->getState(v)), 0, tolerance) << "vertex " << v;
+
+  BOOST_FOREACH (const otb::SparseEdge e, boost::edges(expected->getGraph()))
+  {
+    const otb::SparseVertex v1 = boost::source(e, expected->getGraph());
+    const otb::SparseVertex v2 = boost::target(e, expected->getGraph());
+    EXPECT_TRUE(boost::edge(v1, v2, actual->getGraph()).second) << "edge " << v1 << " - " << v2;
+  }
+}
+
+// Overwrite part of a file
+template <typename T>
+void writeAt(const std::string &filePath, std::size_t offset, const T &value)
+{
+  std::fstream file(filePath.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+  file.seekp(offset);
+  file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+// Cut a file down to a fraction of its size
+void truncate(const std::string &filePath, double fraction)
+{
+  boost::filesystem::resize_file(filePath, boost::filesystem::file_size(filePath) * fraction);
+}
+
+/* Run tests ------------------------------------------------------------------------------ */
+
+TEST(SparseStorage, flat_round_trip)
+{
+  TempDatabase database;
+  otb::BoltPtr saved = createBolt();
+  saved->getSparseGraph()->getSparseStorage()->useFlatFormat_ = true;
+  addGrid(saved->getSparseGraph(), 6, 0);
+  saveGraph(saved, database.path());
+
+  otb::BoltPtr loaded = createBolt();
+  ASSERT_TRUE(loadGraph(loaded, database.path()));
+  expectSameGraph(saved->getSparseGraph(), loaded->getSparseGraph(), 1e-12);
+}
+
+TEST(SparseStorage, compressed_round_trip)
+{
+  TempDatabase database;
+  otb::BoltPtr saved = createBolt();
+  otb::SparseStoragePtr storage = saved->getSparseGraph()->getSparseStorage();
+  storage->useCompressedFormat_ = true;
+  addGrid(saved->getSparseGraph(), 6, 0);
+  saveGraph(saved, database.path());
+
+  // Joint values are rounded to the compression resolution
+  otb::BoltPtr loaded = createBolt();
+  ASSERT_TRUE(loadGraph(loaded, database.path()));
+  expectSameGraph(saved->getSparseGraph(), loaded->getSparseGraph(), storage->compressionResolution_);
+}
+
+TEST(SparseStorage, journal_round_trip)
+{
+  TempDatabase database;
+  otb::BoltPtr saved = createBolt();
+  otb::SparseStoragePtr storage = saved->getSparseGraph()->getSparseStorage();
+  storage->useJournal_ = true;
+  storage->journalCompactionRatio_ = 100;  // append every change after the first snapshot
+  addGrid(saved->getSparseGraph(), 4, 0);
+  saveGraph(saved, database.path());
+
+  // The second grid only exists in the journal
+  addGrid(saved->getSparseGraph(), 4, 50);
+  saveGraph(saved, database.path());
+  ASSERT_TRUE(boost::filesystem::exists(storage->getJournalPath(database.path())));
+
+  otb::BoltPtr loaded = createBolt();
+  ASSERT_TRUE(loadGraph(loaded, database.path()));
+  expectSameGraph(saved->getSparseGraph(), loaded->getSparseGraph(), 1e-12);
+}
+
+TEST(SparseStorage, flat_truncated)
+{
+  TempDatabase database;
+  otb::BoltPtr saved = createBolt();
+  saved->getSparseGraph()->getSparseStorage()->useFlatFormat_ = true;
+  addGrid(saved->getSparseGraph(), 6, 0);
+  saveGraph(saved, database.path());
+  truncate(database.path(), 0.5);
+
+  otb::BoltPtr loaded = createBolt();
+  EXPECT_FALSE(loadGraph(loaded, database.path()));
+  EXPECT_TRUE(loaded->getSparseGraph()->isEmpty());
+}
+
+TEST(SparseStorage, flat_corrupt_blocks)
+{
+  TempDatabase database;
+  otb::BoltPtr saved = createBolt();
+  saved->getSparseGraph()->getSparseStorage()->useFlatFormat_ = true;
+  addGrid(saved->getSparseGraph(), 6, 0);
+  saveGraph(saved, database.path());
+
+  std::ifstream in(database.path().c_str(), std::ios::binary);
+  otb::SparseStorage::FlatHeader h;
+  in.read(reinterpret_cast<char *>(&h), sizeof(h));
+  in.close();
+
+  // Weights block pointing past the end of the file
+  otb::SparseStorage::FlatHeader corrupt = h;
+  corrupt.weightsOffset = h.fileSize;
+  writeAt(database.path(), 0, corrupt);
+  {
+    otb::BoltPtr loaded = createBolt();
+    EXPECT_FALSE(loadGraph(loaded, database.path()));
+    EXPECT_TRUE(loaded->getSparseGraph()->isEmpty());
+  }
+  writeAt(database.path(), 0, h);
+
+  // Edge to a vertex that does not exist
+  const boost::uint32_t badTarget = h.vertexCount;
+  writeAt(database.path(), h.edgeTargetsOffset, badTarget);
+  {
+    otb::BoltPtr loaded = createBolt();
+    EXPECT_FALSE(loadGraph(loaded, database.path()));
+    EXPECT_TRUE(loaded->getSparseGraph()->isEmpty());
+  }
+}
+
+TEST(SparseStorage, compressed_truncated)
+{
+  TempDatabase database;
+  otb::BoltPtr saved = createBolt();
+  saved->getSparseGraph()->getSparseStorage()->useCompressedFormat_ = true;
+  addGrid(saved->getSparseGraph(), 6, 0);
+  saveGraph(saved, database.path());
+  truncate(database.path(), 0.5);
+
+  otb::BoltPtr loaded = createBolt();
+  EXPECT_FALSE(loadGraph(loaded, database.path()));
+  EXPECT_TRUE(loaded->getSparseGraph()->isEmpty());
+}
+
+/* Main  ------------------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "sparse_storage_test");
+  return RUN_ALL_TESTS();
+}
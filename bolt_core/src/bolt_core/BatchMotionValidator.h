@@ -0,0 +1,182 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Collision check many motions at once using a pool of threads
+*/
+
+#ifndef OMPL_TOOLS_BOLT_BATCH_MOTION_VALIDATOR_H_
+#define OMPL_TOOLS_BOLT_BATCH_MOTION_VALIDATOR_H_
+
+// OMPL
+#include <ompl/base/SpaceInformation.h>
+
+// C++
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+OMPL_CLASS_FORWARD(BatchMotionValidator);
+OMPL_CLASS_FORWARD(MotionBatch);
+
+/** \brief A motion from the first state to the second */
+typedef std::pair<const base::State *, const base::State *> MotionSegment;
+
+/**
+ * \brief Handle to motions submitted together to a BatchMotionValidator. Results are reported from the shortest
+ *        motion to the longest, as soon as each one is known, so a caller looking for the first visible neighbor
+ *        can stop early. Motions that have not been reported when the handle is destroyed are abandoned
+ */
+class MotionBatch
+{
+public:
+  ~MotionBatch();
+
+  /**
+   * \brief Block until the next shortest motion has been checked
+   * \param index - position of the motion in the list passed to BatchMotionValidator::checkMotions()
+   * \param valid - whether the motion is collision free
+   * \return false when every motion has been reported
+   */
+  bool next(std::size_t &index, bool &valid);
+
+  /** \brief Stop checking motions that have not been reported yet. Does not return until no worker is using the
+   *         states of this batch, so they can be freed afterwards */
+  void cancel();
+
+private:
+  friend class BatchMotionValidator;
+
+  struct Motion
+  {
+    /** \brief Position in the submitted list */
+    std::size_t index_;
+
+    /** \brief Interpolation steps in the order they are checked, the goal state first and then bisecting */
+    std::vector<unsigned int> order_;
+    unsigned int numSegments_;
+
+    /** \brief Number of tasks the check order is dealt out to */
+    std::size_t numChunks_;
+    std::size_t chunksLeft_;
+    bool invalid_ = false;
+    bool done_ = false;
+  };
+
+  /** \brief State shared with the worker threads */
+  struct Shared
+  {
+    std::vector<MotionSegment> segments_;
+
+    /** \brief Sorted by increasing length */
+    std::vector<Motion> motions_;
+
+    std::size_t nextResult_ = 0;
+    std::size_t numRunning_ = 0;
+    bool cancelled_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+  };
+
+  std::shared_ptr<Shared> shared_;
+};
+
+/**
+ * \brief Collision checks the interpolated states of many motions in parallel. Each motion is split into chunks
+ *        of its interpolation steps that are handed to a pool of worker threads, so even a single long motion is
+ *        checked by several threads. Steps are checked with the validity checker of the space information in the
+ *        same order as base::DiscreteMotionValidator; the start state of every motion is assumed to be valid
+ */
+class BatchMotionValidator
+{
+public:
+  /**
+   * \brief Constructor
+   * \param si - space information whose state validity checker must be thread safe
+   * \param numThreads - size of the worker pool, 0 to use one thread per core
+   */
+  BatchMotionValidator(base::SpaceInformationPtr si, std::size_t numThreads = 0);
+
+  ~BatchMotionValidator();
+
+  /** \brief Start checking \e segments in the background. The states must stay allocated until the returned batch
+   *         has reported every motion or is destroyed */
+  MotionBatchPtr checkMotions(const std::vector<MotionSegment> &segments);
+
+  /** \brief Check a single motion, split across the worker pool */
+  bool checkMotion(const base::State *s1, const base::State *s2);
+
+  std::size_t getNumThreads() const
+  {
+    return workers_.size();
+  }
+
+private:
+  struct Task
+  {
+    std::shared_ptr<MotionBatch::Shared> batch_;
+    std::size_t motion_;
+    std::size_t chunk_;
+  };
+
+  void workerThread();
+
+  /** \brief Check the interpolation steps of one chunk, stopping as soon as the motion is known to be invalid */
+  void runTask(const Task &task, base::State *workState);
+
+  base::SpaceInformationPtr si_;
+
+  std::vector<std::thread> workers_;
+
+  std::deque<Task> tasks_;
+  bool stopping_ = false;
+  std::mutex tasksMutex_;
+  std::condition_variable tasksAvailable_;
+};
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
+
+#endif  // OMPL_TOOLS_BOLT_BATCH_MOTION_VALIDATOR_H_
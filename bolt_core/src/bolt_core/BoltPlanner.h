@@ -41,6 +41,8 @@
 #include <ompl/geometric/PathGeometric.h>
 #include <ompl/geometric/PathSimplifier.h>
 #include <bolt_core/TaskGraph.h>
+#include <bolt_core/BatchMotionValidator.h>
+#include <bolt_core/IncrementalTaskSearch.h>
 #include <ompl/tools/debug/Visualizer.h>
 
 // Boost
@@ -54,6 +56,9 @@
 #include <boost/function.hpp>
 #include <boost/thread.hpp>
 
+// C++
+#include <functional>
+
 namespace ompl
 {
 namespace tools
@@ -117,6 +122,20 @@ public:
     smoothingEnabled_ = enable;
   }
 
+  /** \brief Workspace voxels that are completely filled by obstacles in the current scene. Edges the
+   *         EdgeOccupancyIndex finds passing through them are marked in collision before searching */
+  void setObstacleVoxels(const std::vector<boost::uint64_t> &obstacleVoxels)
+  {
+    obstacleVoxels_ = obstacleVoxels;
+  }
+
+  /** \brief Worker pool for checking the visibility of all start and goal candidates at once. Without it the
+   *         candidates are checked one after the other */
+  void setBatchMotionValidator(BatchMotionValidatorPtr batchMotionValidator)
+  {
+    batchMotionValidator_ = batchMotionValidator;
+  }
+
   /**
    * \brief Search the roadmap for the best path close to the given start and goal states that is valid
    * \param start
@@ -146,15 +165,17 @@ public:
    * \brief Finds nodes in the graph near state NOTE: note tested for visibility
    * \param state - vertex to find neighbors around
    * \param neighbors - result vector
+   * \param threadID - query slot of the graphs to search with, see TaskGraph::nearestK()
    * \param requiredLevel - if -1, allows states from all levels, otherwise only returns states from a certain level
    * \return false is no neighbors found
    */
-  bool findGraphNeighbors(const base::State *state, std::vector<bolt::TaskVertex> &neighbors, int requiredLevel = -1,
-                          std::size_t indent = 0);
+  bool findGraphNeighbors(const base::State *state, std::vector<bolt::TaskVertex> &neighbors, std::size_t threadID,
+                          int requiredLevel = -1, std::size_t indent = 0);
 
   /** \brief Check if there exists a solution, i.e., there exists a pair of milestones such that the
    *   first is in \e start and the second is in \e goal, and the two milestones are in the same
-   *   connected component. If a solution is found, the path is saved.
+   *   connected component. If a solution is found, the path is saved. The graph is searched as soon as a visible
+   *   start and goal are known, and again as more candidates are found visible until a valid path is found.
    * \param debug - whether to show the failure points
    * \param feedbackStartFailed - if getPathOnGraph returns false, this flag determines if the start or goal node failed
    * to conenct
@@ -165,12 +186,21 @@ public:
                       bool debug, bool &feedbackStartFailed, std::size_t indent);
 
   /**
-   * \brief Repeatidly search through graph for connection then check for collisions then repeat
+   * \brief Repeatidly search through graph for connection then check for collisions then repeat. Each search goes
+   *        from all the starts to whichever goal is closest
+   * \param startCosts - cost of connecting the actual start to each start vertex
+   * \param goalCosts - cost of connecting each goal vertex to the actual goal
    * \return true if a valid path is found
    */
-  bool onGraphSearch(const bolt::TaskVertex &start, const bolt::TaskVertex &goal, const base::State *actualStart,
-                     const base::State *actualGoal, geometric::PathGeometricPtr compoundSolution, Termination &ptc,
-                     std::size_t indent);
+  bool onGraphSearch(const std::vector<bolt::TaskVertex> &starts, const std::vector<double> &startCosts,
+                     const std::vector<bolt::TaskVertex> &goals, const std::vector<double> &goalCosts,
+                     const base::State *actualStart, const base::State *actualGoal,
+                     geometric::PathGeometricPtr compoundSolution, Termination &ptc, std::size_t indent);
+
+  /** \brief Start checking which candidates can be connected to \e actual by a straight motion. The returned
+   *         function reports each candidate's visibility as it is found, nearest first */
+  std::function<bool(std::size_t &, bool &)> checkCandidatesVisible(const std::vector<bolt::TaskVertex> &candidates,
+                                                                     const base::State *actual, MotionBatchPtr &batch);
 
   /** \brief Check recalled path for collision and disable as needed */
   bool lazyCollisionCheck(std::vector<bolt::TaskVertex> &vertexPath, Termination &ptc, std::size_t indent);
@@ -239,6 +269,12 @@ protected:
   /** \brief Optionally smooth retrieved and repaired paths from database */
   bool smoothingEnabled_ = true;
 
+  /** \brief Checks start and goal candidates for visibility in parallel, optional */
+  BatchMotionValidatorPtr batchMotionValidator_;
+
+  /** \brief Voxels filled by obstacles, see setObstacleVoxels() */
+  std::vector<boost::uint64_t> obstacleVoxels_;
+
   /** \brief Used by getPathOffGraph */
   std::vector<bolt::TaskVertex> startVertexCandidateNeighbors_;
   std::vector<bolt::TaskVertex> goalVertexCandidateNeighbors_;
@@ -248,6 +284,9 @@ public:
   bool verbose_ = false;
   bool vCollisionCheck_ = false;
 
+  /** \brief Repair the search tree after lazy collision checking disables edges instead of searching again */
+  bool useIncrementalSearch_ = false;
+
   bool visualizeSmoothedTrajectory_ = false;
   bool visualizeStartGoal_ = false;
   bool visualizeLazyCollisionCheck_ = true;
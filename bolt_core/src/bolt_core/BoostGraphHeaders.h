@@ -50,6 +50,7 @@
 #include <boost/range/adaptor/map.hpp>
 #include <boost/graph/graph_traits.hpp>
 #include <boost/graph/adjacency_list.hpp>
+#include <boost/graph/compressed_sparse_row_graph.hpp>
 #include <boost/graph/graph_utility.hpp>
 #include <boost/graph/connected_components.hpp>
 #include <boost/property_map/property_map.hpp>
@@ -175,6 +176,16 @@ typedef boost::graph_traits<SparseAdjList>::vertex_descriptor SparseVertex;
 /** \brief Edge in Graph */
 typedef boost::graph_traits<SparseAdjList>::edge_descriptor SparseEdge;
 
+/** \brief Edge properties of the frozen copy of the graph, only what is needed for searching */
+struct SparseCSREdgeStruct
+{
+  float weight_;
+};
+
+/** \brief Immutable compressed sparse row copy of SparseAdjList with the same vertex indices. Each undirected edge
+ *         is stored in both directions, so that neighbors and weights of a vertex are contiguous in memory */
+typedef boost::compressed_sparse_row_graph<boost::directedS, boost::no_property, SparseCSREdgeStruct> SparseCSRGraph;
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // Typedefs for property maps
 
@@ -225,6 +236,17 @@ typedef boost::graph_traits<TaskAdjList>::vertex_descriptor TaskVertex;
 /** \brief Edge in Graph */
 typedef boost::graph_traits<TaskAdjList>::edge_descriptor TaskEdge;
 
+/** \brief Edge properties of the frozen copy of the graph. The collision state can change between searches so it
+ *         is read from the original edge */
+struct TaskCSREdgeStruct
+{
+  float weight_;
+  const TaskEdgeStruct* edge_;
+};
+
+/** \brief Immutable compressed sparse row copy of TaskAdjList with the same vertex indices */
+typedef boost::compressed_sparse_row_graph<boost::directedS, boost::no_property, TaskCSREdgeStruct> TaskCSRGraph;
+
 /** \brief Internal representation of a dense path */
 // typedef std::deque<base::State*> DensePath;
 
@@ -278,6 +300,55 @@ public:
   }
 };
 
+////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Same as TaskEdgeWeightMap for the frozen copy of the graph.
+ * \implements ReadablePropertyMapConcept
+ */
+class TaskCSREdgeWeightMap
+{
+private:
+  const TaskCSRGraph& g_;  // Graph used
+
+public:
+  /** Map key type. */
+  typedef boost::graph_traits<TaskCSRGraph>::edge_descriptor key_type;
+  /** Map value type. */
+  typedef double value_type;
+  /** Map auxiliary value type. */
+  typedef double& reference;
+  /** Map type. */
+  typedef boost::readable_property_map_tag category;
+
+  /**
+   * Construct map for certain constraints.
+   * \param g - Graph to use
+   */
+  TaskCSREdgeWeightMap(const TaskCSRGraph& g)
+    : g_(g)
+  {
+  }
+
+  /**
+   * Get the weight of an edge.
+   * \param e the edge
+   * \return infinity if \a e has been found to be in collision; actual weight of \a e otherwise
+   */
+  double get(key_type e) const
+  {
+    if (g_[e].edge_->collision_state_ == IN_COLLISION)
+      return std::numeric_limits<double>::infinity();
+
+    return g_[e].weight_;
+  }
+};
+
+/** \brief Property map access used by boost::astar_search, found through argument dependent lookup */
+inline double get(const TaskCSREdgeWeightMap& m, const TaskCSREdgeWeightMap::key_type& e)
+{
+  return m.get(e);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////
 /**
  * Used to artifically supress edges during A* search.
@@ -370,6 +441,33 @@ class FoundGoalException
 {
 };
 
+////////////////////////////////////////////////////////////////////////////////////////
+// CANDIDATE PROPOSAL STRUCT
+////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Decision of the sparse criteria for a candidate, made by a generator thread without modifying the graph.
+ * The main thread only rechecks the components and edges it depends on before applying it
+ */
+struct CandidateProposal
+{
+  // Whether the sparse criteria have been evaluated for the candidate
+  bool evaluated_ = false;
+
+  // Whether any criteria accepted the candidate, and which
+  bool accepted_ = false;
+  VertexType type_ = COVERAGE;
+
+  // The fourth criteria setting the proposal was evaluated with
+  bool useFourthCriteria_ = false;
+
+  // Connectivity - visible neighbors in different components, and the collision free direct edges between them
+  std::vector<SparseVertex> connectivityVertices_;
+  std::vector<std::pair<SparseVertex, SparseVertex> > directEdges_;
+
+  // Interface - whether the two closest neighbors can be connected directly
+  bool interfaceDirect_ = false;
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // CANDIDATE STATE STRUCT
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -379,13 +477,16 @@ struct CandidateData
   {
   }
 
-  CandidateData()
+  CandidateData() : state_(nullptr)
   {
   }
 
   // Graph version number - allow to determine if candidate was expired by time candidate was generated
   std::size_t graphVersion_;
 
+  // Number of vertices in the graph when the neighbors were searched, all later vertices are newer than the candidate
+  std::size_t graphNumVertices_ = 0;
+
   // The sampled state to be added to the graph
   base::State* state_;
 
@@ -397,6 +498,9 @@ struct CandidateData
 
   // The generated state
   SparseVertex newVertex_;
+
+  // Decision of the sparse criteria made on a generator thread, if any
+  CandidateProposal proposal_;
 };
 
 }  // namespace bolt
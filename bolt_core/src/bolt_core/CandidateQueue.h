@@ -47,11 +47,12 @@
 #include <bolt_core/SparseGraph.h>
 
 // Boost
-#include <boost/thread/shared_mutex.hpp>
 #include <boost/thread.hpp>
 
 // C++
-#include <queue>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 
 namespace ompl
@@ -65,6 +66,11 @@ OMPL_CLASS_FORWARD(CandidateQueue);
 OMPL_CLASS_FORWARD(SparseCriteria);
 OMPL_CLASS_FORWARD(SparseGenerator);
 
+/**
+ * Pool of threads that sample candidate states and find their neighbors ahead of the parent thread, which adds them
+ * to the graph. Candidates are passed through a bounded ring buffer; producers block while it is full, and when it
+ * is empty the parent takes over the work of generating a candidate itself instead of waiting idle
+ */
 class CandidateQueue
 {
 public:
@@ -86,18 +92,49 @@ public:
   /** \brief This function is called from the parent thread */
   void setCandidateUsed(bool wasUsed, std::size_t indent);
 
+  /** \brief Number of times the parent found no candidate ready */
   std::size_t getTotalMisses()
   {
     return totalMisses_;
   }
 
+  /** \brief Seconds the parent spent waiting for or generating candidates itself */
+  double getTotalStallTime()
+  {
+    return totalStallTime_;
+  }
+
+  /** \brief Number of candidates the parent generated itself because the queue was empty */
+  std::size_t getTotalStolen()
+  {
+    return totalStolen_;
+  }
+
+  std::size_t getNumThreads()
+  {
+    return numThreads_;
+  }
+
 private:
-  void generatingThread(std::size_t threadID, base::SpaceInformationPtr si, base::ValidStateSamplerPtr sampler,
-                        std::size_t indent);
+  void generatingThread(std::size_t threadID, base::ValidStateSamplerPtr sampler, std::size_t indent);
+
+  /**
+   * \brief Sample a state and find its neighbors, evaluating the criteria if they are speculative
+   * \return false if the candidate expired or the queue is stopping, in which case its state was freed
+   */
+  bool generateCandidate(CandidateData &candidateD, std::size_t threadID, base::ValidStateSamplerPtr sampler,
+                         std::size_t indent);
 
-  /** \brief Do not add more states if queue is full */
-  void waitForQueueNotFull(std::size_t indent);
-  void waitForQueueNotEmpty(std::size_t indent);
+  /** \brief Reserve a place in the ring buffer before generating a candidate, so it is not left waiting to be
+   *         added while the graph changes. Blocks while the buffer is full, false if the queue stopped */
+  bool reserveSlot(std::size_t indent);
+
+  /** \brief Fill a reserved place at the back of the ring buffer, or give it up if no candidate was generated */
+  void push(const CandidateData &candidateD);
+  void releaseSlot();
+
+  /** \brief Free and remove the front of the ring buffer, must hold ringMutex_ */
+  void popFront(bool freeState);
 
   bool findGraphNeighbors(CandidateData &candidateD, std::size_t threadID, std::size_t indent);
 
@@ -114,20 +151,36 @@ private:
   /** \brief Class for managing various visualization features */
   VisualizerPtr visual_;
 
-  std::queue<CandidateData> queue_;
+  /** \brief Bounded ring buffer of candidates, the front one is in use by the parent until setCandidateUsed() */
+  std::vector<CandidateData> ring_;
+  std::size_t ringFront_ = 0;
+  std::size_t ringSize_ = 0;
+  std::size_t ringReserved_ = 0;
 
-  std::size_t targetQueueSize_ = 20;
+  /** \brief Guards the ring buffer, producers wait on notFull_ and the parent on notEmpty_ */
+  std::mutex ringMutex_;
+  std::condition_variable notFull_;
+  std::condition_variable notEmpty_;
 
-  std::vector<boost::thread *> generatorThreads_;
+  /** \brief Candidate the parent generated itself, used instead of the front of the ring buffer */
+  CandidateData stolenCandidate_;
+  bool usingStolenCandidate_ = false;
 
-  /** \brief Mutex for adding to the queue */
-  boost::shared_mutex candidateQueueMutex_;
+  /** \brief Whether the parent holds a candidate from getNextCandidate() that it has not returned yet */
+  bool candidateInUse_ = false;
+
+  /** \brief Sampler for candidates generated on the parent thread */
+  base::ValidStateSamplerPtr parentSampler_;
+
+  std::vector<boost::thread *> generatorThreads_;
 
   /** \brief Flag indicating generator is active */
-  bool threadsRunning_ = false;
+  std::atomic<bool> threadsRunning_;
 
   std::size_t numThreads_ = 1;
   std::size_t totalMisses_ = 0;
+  std::size_t totalStolen_ = 0;
+  double totalStallTime_ = 0;
 
   std::size_t totalMissesOverAllResets_ = 0;
   std::size_t totalResets_ = 0;
@@ -137,6 +190,15 @@ private:
   std::size_t totalCandidates_ = 0;
 
 public:
+  /** \brief Generator threads, 0 for one per core besides the parent */
+  std::size_t numThreadsRequested_ = 0;
+
+  /** \brief Capacity of the ring buffer for each generator thread */
+  std::size_t queueSizePerThread_ = 4;
+
+  /** \brief How long the parent waits for a generator thread before generating a candidate itself */
+  double stealAfterSeconds_ = 0.001;
+
   bool verbose_ = false;      // general program direction
   bool vNeighbor_ = false;    // nearest neighbor search
   bool vClear_ = false;       // when queue is being cleared because of change
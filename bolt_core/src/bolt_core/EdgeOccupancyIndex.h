@@ -0,0 +1,171 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Reverse index from workspace voxels to the roadmap edges whose motion passes through them
+*/
+
+#ifndef OMPL_TOOLS_BOLT_EDGE_OCCUPANCY_INDEX_H_
+#define OMPL_TOOLS_BOLT_EDGE_OCCUPANCY_INDEX_H_
+
+// OMPL
+#include <ompl/base/SpaceInformation.h>
+#include <ompl/util/ClassForward.h>
+
+// Bolt
+#include <bolt_core/BoostGraphHeaders.h>
+
+// Boost
+#include <boost/cstdint.hpp>
+
+// C++
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+/// @cond IGNORE
+OMPL_CLASS_FORWARD(EdgeOccupancyIndex);
+OMPL_CLASS_FORWARD(SparseGraph);
+/// @endcond
+
+static const boost::uint32_t BOLT_OCCUPANCY_INDEX_MARKER = 0x4F4C4F42;  // this spells BOLO
+static const boost::uint32_t BOLT_OCCUPANCY_INDEX_VERSION = 2;
+
+/** \brief Fill \e voxels with the workspace voxels that the robot certainly occupies somewhere along the motion from
+ *         the first state to the second, e.g. the voxels containing points inside its links at each interpolated
+ *         state. Voxel ids are chosen by the application, they only need to match the obstacle voxels later */
+typedef std::function<void(const base::State *, const base::State *, std::vector<boost::uint64_t> &)>
+    SweptVoxelsFn;
+
+/**
+ * \brief For every voxel of a coarse workspace grid, the roadmap edges that pass through it. Given the voxels that
+ *        are completely filled by obstacles, the edges that must be in collision can be looked up directly instead
+ *        of being found one failed search at a time. Built once with the application's SweptVoxelsFn and saved next
+ *        to the database file
+ */
+class EdgeOccupancyIndex
+{
+public:
+  /**
+   * \brief Information stored at the beginning of the index file. The blocks that follow are:
+   *          edges:        edgeCount x (uint64, uint64), the vertices of each indexed edge
+   *          voxels:       voxelCount x uint64, sorted voxel ids
+   *          offsets:      (voxelCount + 1) x uint64, row offsets into the entries block
+   *          entries:      entryCount x uint32, edge numbers for each voxel
+   *        Vertex indices include the query vertices, as in the graph. graphHash covers the states of the vertices
+   *        and the endpoints of the edges, so an index is not used with another graph of the same size
+   */
+  struct Header
+  {
+    boost::uint32_t marker;
+    boost::uint32_t version;
+    double resolution;
+    boost::uint64_t vertexCount;
+    boost::uint64_t edgeCount;
+    boost::uint64_t voxelCount;
+    boost::uint64_t entryCount;
+    boost::uint64_t graphHash;
+  };
+
+  /** \brief Constructor */
+  EdgeOccupancyIndex(SparseGraph *sparseGraph);
+
+  void clear();
+
+  /** \brief Whether the index matches the current graph, i.e. the graph was not modified since it was built or loaded */
+  bool isValid() const;
+
+  /**
+   * \brief Sweep every edge of the graph through the workspace
+   * \param resolution - voxel size, stored so that an index built with another grid is not loaded
+   */
+  void build(const SweptVoxelsFn &sweptVoxels, double resolution, std::size_t indent = 0);
+
+  /** \brief Find the edges passing through any of \e obstacleVoxels, i.e. voxels completely inside obstacles */
+  void getBlockedEdges(std::vector<boost::uint64_t> obstacleVoxels,
+                       std::vector<std::pair<SparseVertex, SparseVertex>> &edges) const;
+
+  /** \brief Path of the index that belongs to a database file */
+  std::string getIndexPath(const std::string &filePath) const
+  {
+    return filePath + ".occupancy";
+  }
+
+  /** \brief Read the index next to a database file, returns false if it is missing or does not match */
+  bool load(const std::string &filePath, double resolution, std::size_t indent = 0);
+
+  bool save(const std::string &filePath, std::size_t indent = 0);
+
+  /** \brief Short name of class */
+  const std::string name_ = "EdgeOccupancyIndex";
+
+  bool verbose_ = false;
+
+private:
+  /** \brief Hash of the serialized vertex states and the edge endpoints in the order the edges are indexed */
+  boost::uint64_t hashGraph() const;
+
+  SparseGraph *sparseGraph_;
+
+  double resolution_ = 0;
+
+  /** \brief Size of the graph when it was indexed */
+  std::size_t vertexCount_ = 0;
+
+  /** \brief Identifies the indexed graph in the file, see hashGraph() */
+  boost::uint64_t graphHash_ = 0;
+
+  /** \brief SparseGraph::getModificationCount() when the index was built or loaded */
+  std::size_t modificationCount_ = 0;
+
+  /** \brief Endpoints of each indexed edge */
+  std::vector<std::pair<boost::uint64_t, boost::uint64_t>> edges_;
+
+  /** \brief Sorted voxel ids, with the edges through voxels_[i] at entries_[offsets_[i]] to entries_[offsets_[i+1]] */
+  std::vector<boost::uint64_t> voxels_;
+  std::vector<boost::uint64_t> offsets_;
+  std::vector<boost::uint32_t> entries_;
+};
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
+
+#endif  // OMPL_TOOLS_BOLT_EDGE_OCCUPANCY_INDEX_H_
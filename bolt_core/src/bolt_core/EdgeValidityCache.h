@@ -0,0 +1,200 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Remember which roadmap edges are collision free between planning sessions
+*/
+
+#ifndef OMPL_TOOLS_BOLT_EDGE_VALIDITY_CACHE_H_
+#define OMPL_TOOLS_BOLT_EDGE_VALIDITY_CACHE_H_
+
+// OMPL
+#include <ompl/base/SpaceInformation.h>
+#include <ompl/util/ClassForward.h>
+
+// Boost
+#include <boost/cstdint.hpp>
+
+// C++
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+/// @cond IGNORE
+OMPL_CLASS_FORWARD(EdgeValidityCache);
+OMPL_CLASS_FORWARD(SparseGraph);
+/// @endcond
+
+static const boost::uint32_t BOLT_EDGE_CACHE_MARKER = 0x454C4F42;  // this spells BOLE
+static const boost::uint32_t BOLT_EDGE_CACHE_VERSION = 1;
+
+/** \brief Hash of every object in the planning scene by name, supplied by the application. Two scenes with the same
+ *         fingerprint must collision check the same, so it should cover object geometry and poses, and anything
+ *         else the state validity checker depends on besides the robot state */
+typedef std::map<std::string, boost::uint64_t> SceneFingerprint;
+
+/** \brief Returns true if the motion between two states might touch any of the named objects, i.e. if its swept
+ *         volume intersects them */
+typedef std::function<bool(const base::State *, const base::State *, const std::vector<std::string> &)>
+    EdgeAffectedFn;
+
+/**
+ * \brief Set of edges that have been proven collision free in a given scene, saved next to the database file.
+ *        Edges are identified by a hash of the joint values of their two states rather than by vertex index, so
+ *        entries stay correct when the graph is renumbered or vertices are moved, and the task graph can use it too.
+ *        Nothing is reported free until setScene() has been called in this session
+ */
+class EdgeValidityCache
+{
+public:
+  /**
+   * \brief Information stored at the beginning of the cache file. It is followed by:
+   *          objects:  objectCount x (uint64 hash, uint32 name length, name), the scene the edges were checked in
+   *          edges:    edgeCount x (uint64, uint64), the sorted hashes of the two states of each free edge
+   */
+  struct Header
+  {
+    boost::uint32_t marker;
+    boost::uint32_t version;
+    boost::uint64_t stateLength;
+    boost::uint64_t objectCount;
+    boost::uint64_t edgeCount;
+  };
+
+  /** \brief Identifies an undirected motion by the hashes of its two states, lowest first */
+  typedef std::pair<boost::uint64_t, boost::uint64_t> EdgeKey;
+
+  /** \brief Constructor */
+  EdgeValidityCache(const base::SpaceInformationPtr &si, SparseGraph *sparseGraph);
+
+  /** \brief Forget all edges and the scene */
+  void clear();
+
+  /**
+   * \brief Tell the cache which scene is being planned in. Objects that were added or changed since the edges were
+   *        checked invalidate the free edges that might touch them. Removed objects do not invalidate anything,
+   *        since removing an obstacle cannot put a free edge in collision
+   */
+  void setScene(const SceneFingerprint &scene, std::size_t indent = 0);
+
+  /** \brief Optional test for which edges a changed object can affect, otherwise a changed object invalidates all */
+  void setEdgeAffectedFn(const EdgeAffectedFn &edgeAffectedFn)
+  {
+    edgeAffectedFn_ = edgeAffectedFn;
+  }
+
+  /** \brief Whether the motion from \e s1 to \e s2 was found collision free in the current scene */
+  bool isKnownFree(const base::State *s1, const base::State *s2) const;
+
+  /** \brief Record the result of collision checking a motion in the current scene */
+  void setFree(const base::State *s1, const base::State *s2);
+  void setInCollision(const base::State *s1, const base::State *s2);
+
+  /** \brief Path of the cache that belongs to a database file */
+  std::string getCachePath(const std::string &filePath) const
+  {
+    return filePath + ".edge_cache";
+  }
+
+  /** \brief Read the cache next to a database file, a missing or mismatched cache is simply empty */
+  bool load(const std::string &filePath, std::size_t indent = 0);
+
+  /** \brief Write the cache next to a database file if anything changed since it was loaded */
+  bool saveIfChanged(const std::string &filePath, std::size_t indent = 0);
+
+  std::size_t getNumFreeEdges() const
+  {
+    return freeEdges_.size();
+  }
+
+  std::size_t getNumHits() const
+  {
+    return numHits_;
+  }
+
+  /** \brief Short name of class */
+  const std::string name_ = "EdgeValidityCache";
+
+  bool verbose_ = false;
+
+private:
+  struct EdgeKeyHash
+  {
+    std::size_t operator()(const EdgeKey &key) const
+    {
+      return static_cast<std::size_t>(key.first ^ (key.second * 0x9E3779B97F4A7C15ULL));
+    }
+  };
+
+  /** \brief Hash of the serialized state, stable across sessions */
+  boost::uint64_t hashState(const base::State *state) const;
+
+  EdgeKey getKey(const base::State *s1, const base::State *s2) const;
+
+  base::SpaceInformationPtr si_;
+
+  SparseGraph *sparseGraph_;
+
+  /** \brief Edges known to be free in scene_ */
+  std::unordered_set<EdgeKey, EdgeKeyHash> freeEdges_;
+
+  /** \brief Scene the edges were checked in */
+  SceneFingerprint scene_;
+
+  /** \brief Whether the application has told us the current scene */
+  bool sceneSet_ = false;
+
+  bool hasUnsavedChanges_ = false;
+
+  EdgeAffectedFn edgeAffectedFn_;
+
+  /** \brief Buffer for serializing states before hashing */
+  mutable std::vector<unsigned char> serialized_;
+
+  mutable std::size_t numHits_ = 0;
+};
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
+
+#endif  // OMPL_TOOLS_BOLT_EDGE_VALIDITY_CACHE_H_
@@ -0,0 +1,106 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Helpers for viewing states whose joint values live in memory not owned by the state space
+*/
+
+#ifndef OMPL_TOOLS_BOLT_FLAT_STATE_H_
+#define OMPL_TOOLS_BOLT_FLAT_STATE_H_
+
+// OMPL
+#include <ompl/base/StateSpace.h>
+#include <ompl/base/spaces/RealVectorStateSpace.h>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+/**
+ * \brief A state that only holds a pointer to its joint values. This matches the layout of both
+ *        RealVectorStateSpace::StateType and moveit_ompl::ModelBasedStateSpace::StateType, which lets us
+ *        point a state at an externally owned block of doubles (e.g. a memory mapped file)
+ */
+typedef base::RealVectorStateSpace::StateType FlatState;
+
+/** \brief Count the number of doubles that make up one state of this space */
+inline std::size_t getFlatStateDimension(const base::StateSpacePtr &space)
+{
+  base::State *state = space->allocState();
+  std::size_t dim = 0;
+  while (space->getValueAddressAtIndex(state, dim) != nullptr)
+    ++dim;
+  space->freeState(state);
+  return dim;
+}
+
+/**
+ * \brief Determine if states of this space keep all their values in one contiguous array that is referenced by the
+ *        first member of the state, i.e. the state can be safely viewed as a FlatState
+ */
+inline bool hasFlatStateLayout(const base::StateSpacePtr &space)
+{
+  base::State *state = space->allocState();
+  bool flat = space->getValueAddressAtIndex(state, 0) == state->as<FlatState>()->values;
+
+  for (std::size_t i = 0; flat && space->getValueAddressAtIndex(state, i) != nullptr; ++i)
+    flat = space->getValueAddressAtIndex(state, i) == state->as<FlatState>()->values + i;
+
+  space->freeState(state);
+  return flat;
+}
+
+/** \brief Copy the values of any state into a contiguous row of doubles */
+inline void copyToFlatValues(const base::StateSpacePtr &space, const base::State *state, double *values,
+                             std::size_t dim)
+{
+  for (std::size_t i = 0; i < dim; ++i)
+    values[i] = *space->getValueAddressAtIndex(state, i);
+}
+
+/** \brief Copy a contiguous row of doubles into the values of any state */
+inline void copyFromFlatValues(const base::StateSpacePtr &space, base::State *state, const double *values,
+                               std::size_t dim)
+{
+  for (std::size_t i = 0; i < dim; ++i)
+    *space->getValueAddressAtIndex(state, i) = values[i];
+}
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
+
+#endif  // OMPL_TOOLS_BOLT_FLAT_STATE_H_
@@ -0,0 +1,144 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Shortest path search over the task graph that is repaired instead of restarted when edges are invalidated
+*/
+
+#ifndef OMPL_TOOLS_BOLT_INCREMENTAL_TASK_SEARCH_H_
+#define OMPL_TOOLS_BOLT_INCREMENTAL_TASK_SEARCH_H_
+
+// Bolt
+#include <bolt_core/BoostGraphHeaders.h>
+
+// C++
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+OMPL_CLASS_FORWARD(TaskGraph);
+
+/**
+ * \brief Lifelong Planning A* (Koenig, Likhachev & Furcy 2004) over the frozen copy of the task graph, from several
+ *        starts to whichever of several goals is closest. Lazy collision checking only ever raises edge weights to
+ *        infinity, so after the edges of a rejected path are disabled the previous search tree is kept and only the
+ *        vertices whose best path went through those edges are searched again. The starts are connected to a virtual
+ *        source at their connection cost and the goals to a virtual target at theirs
+ */
+class IncrementalTaskSearch
+{
+public:
+  /** \brief Constructor, the task graph must be frozen for as long as the search is used */
+  IncrementalTaskSearch(TaskGraph *taskGraph);
+
+  /**
+   * \brief Forget any previous search and set up a new query. Nothing is searched until computePath()
+   * \param startCosts - cost of connecting to each start, e.g. the distance from the actual start state
+   * \param goalCosts - cost of connecting each goal to the actual goal state
+   */
+  void start(const std::vector<TaskVertex> &starts, const std::vector<double> &startCosts,
+             const std::vector<TaskVertex> &goals, const std::vector<double> &goalCosts);
+
+  /** \brief The edge between two vertices changed its weight, i.e. it was found to be in collision */
+  void updateEdge(TaskVertex v1, TaskVertex v2);
+
+  /**
+   * \brief Bring the search up to date and find the shortest path to any goal
+   * \param vertexPath - resulting path in reverse, from one of the goals to one of the starts
+   * \param distance - cost of the path including the connection costs of its start and goal
+   * \return false if no goal can be reached
+   */
+  bool computePath(std::vector<TaskVertex> &vertexPath, double &distance);
+
+  /** \brief Number of vertices expanded since start(), for comparison with a search from scratch */
+  std::size_t getNumExpanded() const
+  {
+    return numExpanded_;
+  }
+
+private:
+  /** \brief Priority of a vertex, compared lexicographically */
+  typedef std::pair<double, double> Key;
+  typedef std::pair<Key, TaskVertex> OpenEntry;
+
+  Key calculateKey(TaskVertex v);
+
+  /** \brief Minimum of the task heuristic to every goal plus its connection cost, computed once per vertex and query */
+  double heuristic(TaskVertex v);
+
+  /** \brief Recompute the one step lookahead cost of \e v and put it on the open list if it is inconsistent */
+  void updateVertex(TaskVertex v);
+
+  /** \brief Lowest key on the open list, skipping entries that are out of date */
+  bool topKey(Key &key);
+
+  /** \brief Key of the virtual target, i.e. the best cost through any goal, and whether that goal is consistent */
+  Key goalKey(bool &consistent, TaskVertex &bestGoal) const;
+
+  TaskGraph *taskGraph_;
+  TaskCSREdgeWeightMap weights_;
+
+  std::vector<TaskVertex> goals_;
+  std::vector<double> goalCosts_;
+
+  /** \brief Cost from the virtual source, infinity for vertices that are not a start */
+  std::vector<double> startCosts_;
+
+  /** \brief Cost of the best path found to each vertex, and its one step lookahead */
+  std::vector<double> g_;
+  std::vector<double> rhs_;
+
+  /** \brief Cached heuristic, negative until computed */
+  std::vector<double> heuristics_;
+
+  /** \brief Binary heap of keys. Entries are left behind when a vertex is removed or its key changes, they are
+   *         recognized by comparing with keys_ */
+  std::vector<OpenEntry> open_;
+  std::vector<Key> keys_;
+  std::vector<bool> isOpen_;
+
+  std::size_t numExpanded_ = 0;
+};
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
+
+#endif  // OMPL_TOOLS_BOLT_INCREMENTAL_TASK_SEARCH_H_
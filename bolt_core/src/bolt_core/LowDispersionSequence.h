@@ -0,0 +1,91 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Deterministic low-dispersion sequence of states for seeding the sparse graph
+*/
+
+#ifndef OMPL_TOOLS_BOLT_LOW_DISPERSION_SEQUENCE_H_
+#define OMPL_TOOLS_BOLT_LOW_DISPERSION_SEQUENCE_H_
+
+// OMPL
+#include <ompl/base/SpaceInformation.h>
+
+// C++
+#include <vector>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+OMPL_CLASS_FORWARD(LowDispersionSequence);
+
+/**
+ * \brief Halton sequence over the bounds of the state space, with each coordinate shifted by a fixed irrational
+ *        offset (a Cranley-Patterson rotation) so that the first points are not all on the lower corner. Every point
+ *        depends only on its index, so a sequence can be continued from any index and shared between threads
+ */
+class LowDispersionSequence
+{
+public:
+  /** \brief Constructor */
+  LowDispersionSequence(base::SpaceInformationPtr si);
+
+  /** \brief Fill \e state with the point of the sequence at \e index */
+  void sample(std::size_t index, base::State *state) const;
+
+private:
+  /** \brief Van der Corput radical inverse of \e index in \e base, in [0, 1) */
+  static double radicalInverse(std::size_t index, std::size_t base);
+
+  base::SpaceInformationPtr si_;
+
+  /** \brief Bounds of each coordinate */
+  std::vector<double> low_;
+  std::vector<double> range_;
+
+  /** \brief Base of each coordinate, the first primes */
+  std::vector<std::size_t> bases_;
+
+  /** \brief Offset added to each coordinate before wrapping it into [0, 1) */
+  std::vector<double> rotation_;
+};
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
+
+#endif  // OMPL_TOOLS_BOLT_LOW_DISPERSION_SEQUENCE_H_
@@ -0,0 +1,149 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Nearest neighbor datastructure that can be searched while vertices are being added
+*/
+
+#ifndef OMPL_TOOLS_BOLT_NEAREST_NEIGHBORS_CONCURRENT_H_
+#define OMPL_TOOLS_BOLT_NEAREST_NEIGHBORS_CONCURRENT_H_
+
+// OMPL
+#include <ompl/datastructures/NearestNeighbors.h>
+
+// Bolt
+#include <bolt_core/BoostGraphHeaders.h>
+
+// C++
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+/**
+ * \brief Keeps two copies of another nearest neighbor datastructure so that searches never wait for insertions.
+ *        Searches use the active copy. A change is applied to the standby copy, which then becomes active, and is
+ *        repeated on the other copy at the start of the next change, by when the searches that were still using it
+ *        have normally finished. Removals are applied to both copies before returning, because the removed vertex's
+ *        state is usually freed right after. Changes are serialized with each other and cost twice as much, searches
+ *        only increment a counter
+ */
+class NearestNeighborsConcurrent : public NearestNeighbors<SparseVertex>
+{
+public:
+  typedef std::shared_ptr<NearestNeighbors<SparseVertex> > NearestNeighborsPtr;
+
+  /** \brief Constructor
+   *  \param allocator - creates each of the two copies */
+  NearestNeighborsConcurrent(const std::function<NearestNeighborsPtr()> &allocator);
+
+  void setDistanceFunction(const DistanceFunction &distFun) override;
+
+  bool reportsSortedResults() const override
+  {
+    return copies_[0]->reportsSortedResults();
+  }
+
+  void clear() override;
+
+  void add(const SparseVertex &v) override;
+
+  void add(const std::vector<SparseVertex> &vertices) override;
+
+  bool remove(const SparseVertex &v) override;
+
+  SparseVertex nearest(const SparseVertex &v) const override;
+
+  void nearestK(const SparseVertex &v, std::size_t k, std::vector<SparseVertex> &nbh) const override;
+
+  void nearestR(const SparseVertex &v, double radius, std::vector<SparseVertex> &nbh) const override;
+
+  std::size_t size() const override;
+
+  void list(std::vector<SparseVertex> &data) const override;
+
+private:
+  /** \brief Registers a search on the active copy for the lifetime of this object */
+  class ReadGuard
+  {
+  public:
+    ReadGuard(const NearestNeighborsConcurrent &parent);
+    ~ReadGuard();
+
+    const NearestNeighbors<SparseVertex> &get() const
+    {
+      return *parent_.copies_[index_];
+    }
+
+  private:
+    const NearestNeighborsConcurrent &parent_;
+    std::size_t index_;
+  };
+
+  typedef std::function<void(NearestNeighbors<SparseVertex> &)> Change;
+
+  /** \brief Apply a change to the standby copy and make it active, without blocking searches
+   *  \param applyToBoth - also apply it to the other copy now, waiting for the searches still running on it */
+  void write(const Change &change, bool applyToBoth = false);
+
+  /** \brief Wait until no search is running on a copy */
+  void waitForReaders(std::size_t index) const;
+
+  NearestNeighborsPtr copies_[2];
+
+  /** \brief Copy that new searches use */
+  std::atomic<std::size_t> active_;
+
+  /** \brief Number of searches running on each copy */
+  mutable std::atomic<std::size_t> readers_[2];
+
+  /** \brief Last change, which has not been applied to the inactive copy yet */
+  Change lastChange_;
+
+  /** \brief Serializes changes */
+  std::mutex writeMutex_;
+};
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
+
+#endif  // OMPL_TOOLS_BOLT_NEAREST_NEIGHBORS_CONCURRENT_H_
@@ -0,0 +1,278 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Nearest neighbor datastructures that search copies of the joint values of each vertex
+*/
+
+#ifndef OMPL_TOOLS_BOLT_NEAREST_NEIGHBORS_FLAT_H_
+#define OMPL_TOOLS_BOLT_NEAREST_NEIGHBORS_FLAT_H_
+
+// OMPL
+#include <ompl/base/StateSpace.h>
+#include <ompl/datastructures/NearestNeighbors.h>
+
+// Bolt
+#include <bolt_core/BoostGraphHeaders.h>
+
+// C++
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+/** \brief How the distance function of a state space relates to the joint values of its states */
+enum FlatMetric
+{
+  FLAT_METRIC_UNKNOWN,  // anything else, e.g. weighted joints or wrapping continuous joints
+  FLAT_METRIC_L1,       // sum of absolute differences
+  FLAT_METRIC_L2        // Euclidean distance
+};
+
+/** \brief Compare the distance function of \e space to the L1 and L2 norms on random pairs of states. The flat
+ *         nearest neighbor datastructures are only exact when one of them matches */
+FlatMetric detectFlatMetric(const base::StateSpacePtr &space, std::size_t numSamples = 100);
+
+/**
+ * \brief Base for nearest neighbor datastructures that keep the joint values of every vertex in one array per joint,
+ *        rather than calling the distance function through the vertex to state indirection. Removed vertices are
+ *        left in place until they outnumber the remaining ones
+ */
+class NearestNeighborsFlat : public NearestNeighbors<SparseVertex>
+{
+public:
+  /** \brief Lookup of the state of a vertex, including query vertices */
+  typedef std::function<const base::State *(SparseVertex)> StateFunction;
+
+  NearestNeighborsFlat(const base::StateSpacePtr &space, FlatMetric metric, const StateFunction &getState);
+
+  bool reportsSortedResults() const override
+  {
+    return true;
+  }
+
+  void clear() override;
+
+  void add(const SparseVertex &v) override;
+
+  void add(const std::vector<SparseVertex> &vertices) override;
+
+  bool remove(const SparseVertex &v) override;
+
+  SparseVertex nearest(const SparseVertex &v) const override;
+
+  void nearestK(const SparseVertex &v, std::size_t k, std::vector<SparseVertex> &nbh) const override;
+
+  void nearestR(const SparseVertex &v, double radius, std::vector<SparseVertex> &nbh) const override;
+
+  std::size_t size() const override
+  {
+    return vertices_.size() - numRemoved_;
+  }
+
+  void list(std::vector<SparseVertex> &data) const override;
+
+protected:
+  /** \brief Comparable distance and row of a result. For L2 the distance is squared */
+  typedef std::pair<double, std::size_t> Neighbor;
+
+  /** \brief Marks a row whose vertex was removed */
+  static const SparseVertex REMOVED_VERTEX;
+
+  /** \brief Called after rows were appended to the end */
+  virtual void rowsAdded()
+  {
+  }
+
+  /** \brief Called after removed rows were dropped and the remaining rows renumbered */
+  virtual void rowsCompacted()
+  {
+  }
+
+  /** \brief Find the \e k closest rows to \e query, sorted by distance */
+  virtual void searchK(const double *query, std::size_t k, std::vector<Neighbor> &result) const = 0;
+
+  /** \brief Find all rows within comparable distance \e radius of \e query, sorted by distance */
+  virtual void searchR(const double *query, double radius, std::vector<Neighbor> &result) const = 0;
+
+  /** \brief Comparable distance from \e query to \e row */
+  double rowDistance(const double *query, std::size_t row) const
+  {
+    double distance = 0;
+    for (std::size_t d = 0; d < dim_; ++d)
+      distance += axisDistance(query[d] - columns_[d][row]);
+    return distance;
+  }
+
+  /** \brief Contribution of the difference along one joint to the comparable distance, also a lower bound of it */
+  double axisDistance(double diff) const
+  {
+    return metric_ == FLAT_METRIC_L2 ? diff * diff : std::abs(diff);
+  }
+
+  /** \brief Check if the vertex of \e row is still in the datastructure */
+  bool isLive(std::size_t row) const
+  {
+    return vertices_[row] != REMOVED_VERTEX;
+  }
+
+  /** \brief Number of joint values per vertex */
+  std::size_t dim_;
+
+  FlatMetric metric_;
+
+  /** \brief One array per joint with the value of every row */
+  std::vector<std::vector<double> > columns_;
+
+  /** \brief Vertex of every row */
+  std::vector<SparseVertex> vertices_;
+
+private:
+  /** \brief Get the joint values of \e v, either directly from its state or copied into \e buffer */
+  const double *getValues(SparseVertex v, std::vector<double> &buffer) const;
+
+  /** \brief Drop removed rows once they outnumber the remaining ones */
+  void compact();
+
+  /** \brief Convert a comparable distance back to the distance of the state space */
+  double toDistance(double comparable) const
+  {
+    return metric_ == FLAT_METRIC_L2 ? std::sqrt(comparable) : comparable;
+  }
+
+  base::StateSpacePtr space_;
+
+  StateFunction getState_;
+
+  /** \brief Whether states can be read as a FlatState without copying */
+  bool flatLayout_;
+
+  /** \brief Row of every vertex, NO_ROW if it is not in the datastructure */
+  std::vector<std::size_t> rows_;
+
+  std::size_t numRemoved_ = 0;
+};
+
+/**
+ * \brief Brute force search that computes the distance to all vertices in one pass per joint, which the compiler
+ *        turns into vector instructions. Fastest for small graphs
+ */
+class NearestNeighborsFlatLinear : public NearestNeighborsFlat
+{
+public:
+  NearestNeighborsFlatLinear(const base::StateSpacePtr &space, FlatMetric metric, const StateFunction &getState);
+
+protected:
+  void searchK(const double *query, std::size_t k, std::vector<Neighbor> &result) const override;
+
+  void searchR(const double *query, double radius, std::vector<Neighbor> &result) const override;
+
+private:
+  /** \brief Comparable distance from \e query to every row */
+  void computeDistances(const double *query, std::vector<double> &distances) const;
+};
+
+/**
+ * \brief Exact KD-tree. Vertices added after the tree was built are scanned linearly until there are enough of them
+ *        to be worth rebuilding it, so the cost of insertion stays logarithmic on average
+ */
+class NearestNeighborsFlatKD : public NearestNeighborsFlat
+{
+public:
+  NearestNeighborsFlatKD(const base::StateSpacePtr &space, FlatMetric metric, const StateFunction &getState);
+
+protected:
+  void rowsAdded() override;
+
+  void rowsCompacted() override
+  {
+    build();
+  }
+
+  void searchK(const double *query, std::size_t k, std::vector<Neighbor> &result) const override;
+
+  void searchR(const double *query, double radius, std::vector<Neighbor> &result) const override;
+
+private:
+  /** \brief Maximum number of rows in a leaf */
+  static const std::size_t LEAF_SIZE = 8;
+
+  struct Node
+  {
+    /** \brief Range of order_ below this node */
+    std::size_t begin_;
+    std::size_t end_;
+
+    std::size_t splitDim_;
+    double splitValue_;
+
+    /** \brief Children, both zero for leaves since the root can not be a child */
+    std::size_t left_;
+    std::size_t right_;
+  };
+
+  /** \brief Index all rows */
+  void build();
+
+  /** \brief Create the node for order_[begin, end) and return its index */
+  std::size_t buildNode(std::size_t begin, std::size_t end);
+
+  /** \brief Offer \e row to the max-heap of the \e k best results */
+  void offerK(const double *query, std::size_t row, std::size_t k, std::vector<Neighbor> &heap) const;
+
+  void searchNodeK(std::size_t node, const double *query, std::size_t k, std::vector<Neighbor> &heap) const;
+
+  void searchNodeR(std::size_t node, const double *query, double radius, std::vector<Neighbor> &result) const;
+
+  std::vector<Node> nodes_;
+
+  /** \brief Rows ordered so that each node covers a contiguous range */
+  std::vector<std::size_t> order_;
+
+  /** \brief Rows from this one on are not in the tree yet */
+  std::size_t numIndexed_ = 0;
+};
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
+
+#endif  // OMPL_TOOLS_BOLT_NEAREST_NEIGHBORS_FLAT_H_
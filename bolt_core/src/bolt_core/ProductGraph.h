@@ -0,0 +1,212 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Dual arm roadmap that is the product of a single arm sparse graph with its mirror, without building it
+*/
+
+#ifndef OMPL_TOOLS_BOLT_PRODUCT_GRAPH_H_
+#define OMPL_TOOLS_BOLT_PRODUCT_GRAPH_H_
+
+// OMPL
+#include <ompl/base/PlannerTerminationCondition.h>
+#include <ompl/geometric/PathGeometric.h>
+
+// Bolt
+#include <bolt_core/SparseGraph.h>
+#include <bolt_core/SparseMirror.h>
+
+// C++
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+/// @cond IGNORE
+OMPL_CLASS_FORWARD(ProductGraph);
+/// @endcond
+
+/** \class ompl::tools::bolt::::ProductGraphPtr
+    \brief A boost shared pointer wrapper for ompl::tools::ProductGraph */
+
+/** \brief Index of a pair of vertices in the single arm graph, first for the right arm and second for the mirrored
+ *         left arm */
+typedef std::size_t ProductVertex;
+
+/**
+ * \brief The tensor product of the single arm sparse graph with itself, answered on the fly instead of being stored
+ *        like SparseMirror::mirrorGraphDualArm() does. Each arm can move along an edge of the single arm graph while
+ *        the other arm waits, or both can move along an edge at the same time. Edge weights and the heuristic come
+ *        from the single arm graph, so a search never touches the dual arm state space. Combined states are only
+ *        created for vertices on a candidate path, which is then checked for collisions between the two arms and
+ *        searched again around any part that is invalid
+ */
+class ProductGraph
+{
+public:
+  /** \brief Constructor. The single arm graph must not change while this is used and the combine states callback
+   *         of the mirror must be set */
+  ProductGraph(SparseMirrorPtr sparseMirror, SparseGraphPtr monoSG, base::SpaceInformationPtr dualSpaceInfo,
+               base::SpaceInformationPtr leftArmSpaceInfo);
+
+  /** \brief Deconstructor */
+  virtual ~ProductGraph();
+
+  /** \brief Free all combined states and forget which vertices and edges are invalid */
+  void clear();
+
+  ProductVertex getVertex(SparseVertex rightV, SparseVertex leftV) const
+  {
+    return rightV * numMonoVertices_ + leftV;
+  }
+
+  SparseVertex getRightVertex(ProductVertex v) const
+  {
+    return v / numMonoVertices_;
+  }
+
+  SparseVertex getLeftVertex(ProductVertex v) const
+  {
+    return v % numMonoVertices_;
+  }
+
+  /** \brief Number of vertices the materialized dual arm graph would have, not including query vertices */
+  std::size_t getNumVertices() const
+  {
+    return numRealMonoVertices_ * numRealMonoVertices_;
+  }
+
+  /** \brief Number of combined states created so far */
+  std::size_t getNumCachedStates() const
+  {
+    return states_.size();
+  }
+
+  /** \brief Neighbors of a vertex and the weight of the edge to each, skipping those already found to be invalid */
+  void getNeighbors(ProductVertex v, std::vector<std::pair<ProductVertex, double>> &neighbors) const;
+
+  /** \brief Lower bound on the cost between two vertices, combining the distances of each arm */
+  double distanceHeuristic(ProductVertex a, ProductVertex b) const;
+
+  /** \brief Combined dual arm state of a vertex, created and cached the first time it is requested */
+  const base::State *getState(ProductVertex v);
+
+  /** \brief Collision check the combined state, the result is cached */
+  bool isValid(ProductVertex v);
+
+  /** \brief Collision check the combined motion between two neighbors, the result is cached */
+  bool checkMotion(ProductVertex v1, ProductVertex v2);
+
+  /**
+   * \brief Find the pair of vertices closest to the state of each arm
+   * \param rightState - state of the right arm in the single arm space
+   * \param leftState - state of the left arm, mirrored into the single arm space
+   * \return false if the single arm graph has no vertices
+   */
+  bool findNearestVertex(const base::State *rightState, const base::State *leftState, ProductVertex &vertex,
+                         std::size_t indent);
+
+  /**
+   * \brief A* over the product graph without any collision checking of combined states
+   * \param vertexPath - resulting path from start to goal
+   * \return false if no path exists through vertices and edges not yet known to be invalid
+   */
+  bool astarSearch(ProductVertex start, ProductVertex goal, std::vector<ProductVertex> &vertexPath, double &distance,
+                   std::size_t indent);
+
+  /**
+   * \brief Search repeatedly, collision checking each candidate path and removing its invalid parts, until a valid
+   *        path is found, the start and goal are disconnected, or \e ptc is true
+   * \param path - resulting path in the dual arm space, from start to goal
+   * \param ptc - checked before each search
+   */
+  bool lazyAstarSearch(ProductVertex start, ProductVertex goal, geometric::PathGeometric &path,
+                       const base::PlannerTerminationCondition &ptc, std::size_t indent);
+
+protected:
+  /** \brief Collision check every vertex then every edge of a path, marking the first invalid one */
+  bool checkPath(const std::vector<ProductVertex> &vertexPath, std::size_t indent);
+
+  /** \brief Short name of this class */
+  const std::string name_ = "ProductGraph";
+
+  /** \brief Used for mirroring the left arm and combining the two arms into one state */
+  SparseMirrorPtr sparseMirror_;
+
+  /** \brief Single arm graph that both arms move along */
+  SparseGraphPtr monoSG_;
+  base::SpaceInformationPtr monoSI_;
+
+  base::SpaceInformationPtr dualSI_;
+  base::SpaceInformationPtr leftArmSI_;
+
+  /** \brief Size of the single arm graph when this was created */
+  std::size_t numMonoVertices_;
+  std::size_t numRealMonoVertices_;
+
+  /** \brief Temporary state for the mirrored left arm */
+  base::State *leftArmState_;
+
+  /** \brief Combined states, owned by this class */
+  std::unordered_map<ProductVertex, base::State *> states_;
+
+  /** \brief Result of collision checking each vertex, those that are invalid are skipped by getNeighbors() */
+  std::unordered_map<ProductVertex, bool> vertexValidity_;
+
+  /** \brief Result of collision checking each edge, smaller vertex first */
+  std::map<VertexPair, bool> edgeValidity_;
+
+public:
+  /** \brief Allow both arms to move along an edge at the same time */
+  bool useSimultaneousEdges_ = true;
+
+  /** \brief Number of candidate paths to collision check before giving up */
+  std::size_t maxLazyIterations_ = 1000;
+
+  bool verbose_ = false;
+  bool vSearch_ = false;
+
+};  // end ProductGraph
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
+
+#endif  // OMPL_TOOLS_BOLT_PRODUCT_GRAPH_H_
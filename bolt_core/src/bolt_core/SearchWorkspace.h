@@ -0,0 +1,160 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Reusable memory for graph searches
+*/
+
+#ifndef OMPL_TOOLS_BOLT_SEARCH_WORKSPACE_H_
+#define OMPL_TOOLS_BOLT_SEARCH_WORKSPACE_H_
+
+// C++
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+/**
+ * \brief Predecessor, distance, and open list storage for A* that is kept between searches. Vertices are marked
+ *        with the generation of the search that touched them, so starting a new search does not need to clear the
+ *        arrays and only costs as much as the previous search touched
+ */
+class SearchWorkspace
+{
+public:
+  /** \brief Start a new search over a graph with \e numVertices vertices */
+  void reset(std::size_t numVertices);
+
+  /** \brief Whether \e v has been reached by the current search */
+  bool isDiscovered(std::size_t v) const
+  {
+    return discovered_[v] == generation_;
+  }
+
+  /** \brief Whether \e v has been expanded by the current search */
+  bool isClosed(std::size_t v) const
+  {
+    return closed_[v] == generation_;
+  }
+
+  /**
+   * \brief Record a new best path to \e v and add it to the open list
+   * \param distance - cost from the start to \e v
+   * \param estimate - distance plus the heuristic to the goal, used to order the open list
+   */
+  void discover(std::size_t v, double distance, double estimate, std::size_t predecessor)
+  {
+    discovered_[v] = generation_;
+    distances_[v] = distance;
+    predecessors_[v] = predecessor;
+    open_.push_back(std::make_pair(estimate, v));
+    std::push_heap(open_.begin(), open_.end(), std::greater<OpenEntry>());
+  }
+
+  /** \brief Remove the open vertex with the lowest estimate and mark it closed, false if the open list is empty */
+  bool popOpen(std::size_t &v);
+
+  /** \brief Cost of the best known path to \e v, infinity if it has not been reached */
+  double getDistance(std::size_t v) const
+  {
+    return isDiscovered(v) ? distances_[v] : std::numeric_limits<double>::infinity();
+  }
+
+  /** \brief Previous vertex on the best known path to \e v, the start vertex is its own predecessor */
+  std::size_t getPredecessor(std::size_t v) const
+  {
+    return predecessors_[v];
+  }
+
+  /** \brief Whether the heuristic of \e v was stored by the current search */
+  bool hasHeuristic(std::size_t v) const
+  {
+    return heuristicStamps_[v] == generation_;
+  }
+
+  /** \brief Heuristic of \e v stored by the current search, only valid if hasHeuristic() */
+  double getHeuristic(std::size_t v) const
+  {
+    return heuristics_[v];
+  }
+
+  /** \brief Keep the heuristic of \e v for the rest of the current search, for heuristics that are costly to compute */
+  void setHeuristic(std::size_t v, double heuristic)
+  {
+    heuristicStamps_[v] = generation_;
+    heuristics_[v] = heuristic;
+  }
+
+  /** \brief Number of entries on the open list, including ones left behind by improved distances */
+  std::size_t getNumOpen() const
+  {
+    return open_.size();
+  }
+
+  /** \brief Number of workspaces each thread keeps, so that a bidirectional search can use one per direction */
+  static const std::size_t NUM_THREAD_WORKSPACES = 2;
+
+  /** \brief Workspace \e slot of the calling thread, searches using the same slot on one thread must not be nested */
+  static SearchWorkspace &getThreadWorkspace(std::size_t slot = 0);
+
+private:
+  typedef std::pair<double, std::size_t> OpenEntry;
+
+  /** \brief Binary heap of estimates, a vertex may appear more than once after its distance improves */
+  std::vector<OpenEntry> open_;
+
+  std::vector<double> distances_;
+  std::vector<std::size_t> predecessors_;
+  std::vector<double> heuristics_;
+
+  /** \brief Generation in which each vertex was last discovered, closed, or had its heuristic stored */
+  std::vector<unsigned int> discovered_;
+  std::vector<unsigned int> closed_;
+  std::vector<unsigned int> heuristicStamps_;
+
+  unsigned int generation_ = 0;
+};
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
+
+#endif  // OMPL_TOOLS_BOLT_SEARCH_WORKSPACE_H_
@@ -41,6 +41,13 @@
 
 // OMPL
 #include <bolt_core/SparseGraph.h>
+#include <bolt_core/BatchMotionValidator.h>
+
+// Boost
+#include <boost/thread/shared_mutex.hpp>
+
+// C++
+#include <atomic>
 
 namespace ompl
 {
@@ -80,6 +87,18 @@ public:
    */
   bool addStateToRoadmap(CandidateData& candidateD, VertexType& addReason, std::size_t threadID, std::size_t indent);
 
+  /**
+   * \brief Evaluate the coverage, connectivity and interface criteria for a candidate without modifying the graph,
+   *        storing the decision and its collision checks in candidateD.proposal_. Called from generator threads
+   */
+  void evaluateCandidate(CandidateData& candidateD, std::size_t indent);
+
+  /**
+   * \brief Bring a candidate evaluated on an older version of the graph up to date with the vertices added since.
+   *        If any of them is within its neighborhood the proposal is discarded and addStateToRoadmap() reevaluates it
+   */
+  void revalidateCandidate(CandidateData& candidateD, std::size_t indent);
+
   /* ----------------------------------------------------------------------------------------*/
   /** \brief SPARS-related functions */
   bool checkAddCoverage(CandidateData& candidateD, std::size_t indent);
@@ -203,7 +222,29 @@ public:
     return numVerticesMoved_;
   }
 
+  /** \brief Pool for collision checking many neighbor edges at once, available after setup() */
+  BatchMotionValidatorPtr getBatchMotionValidator()
+  {
+    return batchMotionValidator_;
+  }
+
+  /** \brief Held for reading by generator threads while they look at the graph, and for writing while it changes */
+  boost::shared_mutex& getGraphMutex()
+  {
+    return graphMutex_;
+  }
+
 protected:
+  /** \brief Apply a proposal from evaluateCandidate() after rechecking the components and edges it relied on */
+  bool commitProposal(CandidateData& candidateD, VertexType& addReason, std::size_t indent);
+
+  /** \brief Add the candidate as a vertex joining the components of its neighbors in \e statesInDiffConnectedComponents */
+  void addConnectivityVertex(CandidateData& candidateD, const std::set<SparseVertex>& statesInDiffConnectedComponents,
+                             std::size_t indent);
+
+  /** \brief Add the candidate as a vertex bridging the interface between its two closest neighbors */
+  void addInterfaceVertex(CandidateData& candidateD, SparseVertex v1, SparseVertex v2, std::size_t indent);
+
   /** \brief Short name of this class */
   const std::string name_ = "SparseCriteria";
 
@@ -219,6 +260,9 @@ protected:
   /** \brief Sampler user for generating valid samples in the state space */
   base::ValidStateSamplerPtr sampler_;
 
+  /** \brief Worker threads that collision check edges to the neighbors of a candidate */
+  BatchMotionValidatorPtr batchMotionValidator_;
+
   /** \brief Amount of sub-optimality allowed */
   double sparseDelta_;
 
@@ -237,7 +281,8 @@ protected:
   /** \brief Granuality of the discretized graph */
   double discretization_;
 
-  bool useFourthCriteria_;
+  /** \brief Switched on by the generator while concurrent insertion threads evaluate candidates */
+  std::atomic<bool> useFourthCriteria_;
 
   /** \brief Temporary state for doing sparse criteria sampling */
   std::vector<base::State*> closeRepSampledState_;
@@ -245,6 +290,9 @@ protected:
   /** \brief For statistics */
   std::size_t numVerticesMoved_ = 0;
 
+  /** \brief Guards the graph against changes while generator threads evaluate candidates */
+  boost::shared_mutex graphMutex_;
+
 public:
   /** \brief SPARS parameter for dense graph connection distance as a fraction of max. extent */
   double denseDeltaFraction_ = 0.05;
@@ -276,6 +324,12 @@ public:
   bool useDirectConnectivyCriteria_ = true;  // Add direct edge instead of also vertex
   bool useSmoothedPathImprovementRule_ = true;
 
+  /** \brief Threads used to collision check neighbor edges in batches, 0 for one per core */
+  std::size_t numMotionValidationThreads_ = 0;
+
+  /** \brief Evaluate the criteria on the candidate queue threads, and only revalidate their proposals when adding */
+  bool useSpeculativeCriteria_ = false;
+
   /** \brief Verbose flags */
   bool vCriteria_ = false;
   bool vQuality_ = false;
@@ -42,6 +42,12 @@
 // OMPL
 #include <bolt_core/SparseGraph.h>
 #include <bolt_core/CandidateQueue.h>
+#include <bolt_core/SpatialLocks.h>
+#include <bolt_core/LowDispersionSequence.h>
+
+// C++
+#include <atomic>
+#include <mutex>
 
 namespace ompl
 {
@@ -100,6 +106,29 @@ public:
   bool addRandomSamplesOneThread(std::size_t indent);
   bool addRandomSamplesThreaded(std::size_t indent);
 
+  /** \brief Randomly sample on several threads that each add their own candidates to the graph, locking the region
+   *         within sparse delta of the candidate so that threads in distant regions do not wait on each other. The
+   *         graph is saved once all threads have stopped, also when shutdown is requested */
+  bool addRandomSamplesConcurrent(std::size_t indent);
+
+  /** \brief Add the states of a low-dispersion sequence, starting at lowDispersionStartIndex_, until the graph is
+   *         complete. The sequence is deterministic, so generation can be continued later from the index reached */
+  bool addLowDispersionSamples(std::size_t indent);
+
+  /** \brief File next to the database that holds the low-dispersion index to continue from */
+  std::string getLowDispersionPath() const
+  {
+    return sg_->getFilePath() + ".low_dispersion";
+  }
+
+  /** \brief Read the low-dispersion index saved next to the database, false if there is none or it was saved with a
+   *         graph of a different size */
+  bool loadLowDispersionIndex(std::size_t &index, std::size_t indent);
+
+  /** \brief Save the low-dispersion index to continue from next to the database, with the size of the graph that was
+   *         just saved */
+  bool saveLowDispersionIndex(std::size_t index, std::size_t indent);
+
   /**
    * \brief Add state to sparse graph
    * \param stateID representing a pre-populate state
@@ -150,6 +179,12 @@ public:
     return numRandSamplesAdded_;
   }
 
+  /** \brief Index of the next state of the low-dispersion sequence, to resume from */
+  std::size_t getLowDispersionIndex()
+  {
+    return lowDispersionIndex_;
+  }
+
   CandidateQueuePtr getCandidateQueue()
   {
     return candidateQueue_;
@@ -172,6 +207,9 @@ public:
   }
 
 protected:
+  /** \brief Sample, evaluate and add candidates until the graph is complete, for addRandomSamplesConcurrent() */
+  void insertionThread(std::size_t threadID, base::ValidStateSamplerPtr sampler, std::size_t indent);
+
   /** \brief Short name of this class */
   const std::string name_ = "SparseGenerator";
 
@@ -192,6 +230,21 @@ protected:
   /** \brief Multiple threads for finding nearest neighbors from samples */
   CandidateQueuePtr candidateQueue_;
 
+  /** \brief Regions locked by the threads of addRandomSamplesConcurrent() */
+  SpatialLocksPtr spatialLocks_;
+
+  /** \brief Serializes addSample() between the threads of addRandomSamplesConcurrent() */
+  std::mutex addSampleMutex_;
+
+  /** \brief Cleared when the threads of addRandomSamplesConcurrent() should stop */
+  std::atomic<bool> insertionRunning_;
+
+  /** \brief Set while addLowDispersionSamples() runs, which does not use the candidate queue */
+  bool lowDispersionRunning_ = false;
+
+  /** \brief Index of the next state of the low-dispersion sequence */
+  std::size_t lowDispersionIndex_ = 0;
+
   std::size_t numConsecutiveFailures_;
   std::size_t maxConsecutiveFailures_ = 0;  // find the closest to completion the process has gotten
   std::size_t maxPercentComplete_;          // the whole number percentage presented to user
@@ -228,8 +281,19 @@ public:
   /** \brief Generate the Sparse graph with discretized and/or random samples */
   bool useDiscretizedSamples_;
   bool useRandomSamples_;
+  bool useLowDispersionSamples_ = false;
   bool verifyGraphProperties_ = false;
 
+  /** \brief Index of the low-dispersion sequence to start from, negative to continue from the index saved next to
+   *         the database */
+  int lowDispersionStartIndex_ = -1;
+
+  /** \brief Add random samples with addRandomSamplesConcurrent() instead of through the candidate queue */
+  bool useConcurrentInsertion_ = false;
+
+  /** \brief Threads for concurrent insertion, 0 for one per core */
+  std::size_t numInsertionThreads_ = 0;
+
 };  // end SparseGenerator
 
 }  // namespace bolt
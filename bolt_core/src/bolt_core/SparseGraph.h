@@ -37,7 +37,6 @@
 
    Future Improvements:
      - Consolidate vertex data into single struct so memory is closer together
-     - Store state as non-pointer so memory is closer together
 */
 
 #ifndef OMPL_TOOLS_BOLT_SPARSE_GRAPH_
@@ -55,13 +54,20 @@
 #include <bolt_core/Debug.h>
 #include <bolt_core/VertexDiscretizer.h>
 #include <bolt_core/SparseStorage.h>
+#include <bolt_core/EdgeValidityCache.h>
+#include <bolt_core/EdgeOccupancyIndex.h>
 #include <bolt_core/SparseSmoother.h>
+#include <bolt_core/StateArena.h>
+#include <bolt_core/SearchWorkspace.h>
+#include <bolt_core/NearestNeighborsFlat.h>
+#include <bolt_core/NearestNeighborsConcurrent.h>
 
 // Boost
 #include <boost/function.hpp>
 #include <boost/graph/astar_search.hpp>
 
 // C++
+#include <atomic>
 #include <list>
 #include <random>
 #include <mutex>
@@ -122,6 +128,18 @@ public:
     return sparseStorage_;
   }
 
+  /** \brief Edges proven collision free in earlier planning sessions, null unless useEdgeValidityCache_ */
+  EdgeValidityCachePtr getEdgeValidityCache()
+  {
+    return useEdgeValidityCache_ ? edgeValidityCache_ : EdgeValidityCachePtr();
+  }
+
+  /** \brief Workspace voxels to the edges passing through them, null unless useEdgeOccupancyIndex_ */
+  EdgeOccupancyIndexPtr getEdgeOccupancyIndex()
+  {
+    return useEdgeOccupancyIndex_ ? edgeOccupancyIndex_ : EdgeOccupancyIndexPtr();
+  }
+
   SparseCriteriaPtr getSparseCriteria()
   {
     return sparseCriteria_;
@@ -140,16 +158,14 @@ public:
     return visual_;
   }
 
-  /** \brief Get the nearest neighbor structure */
+  /** \brief Get the nearest neighbor structure, it may be searched from several threads while vertices are added */
   std::shared_ptr<NearestNeighbors<SparseVertex> > getNN()
   {
     return nn_;
   }
 
-  std::mutex& getNNGuard()
-  {
-    return nearestNeighborMutex_;
-  }
+  /** \brief Create the nearest neighbor structure chosen by nearestNeighborsType_ and insert all existing vertices */
+  void setupNearestNeighbors(std::size_t indent = 0);
 
   /** \brief Reset the whole class */
   void clear();
@@ -176,6 +192,11 @@ public:
     filePath_ = filePath;
   }
 
+  const std::string& getFilePath() const
+  {
+    return filePath_;
+  }
+
   /**
    * \brief Load database from file
    * \return true if file loaded successfully
@@ -213,6 +234,48 @@ public:
   /** \brief Same as astarSearch except does not return vertexPath for performance reasons */
   bool astarSearchLength(SparseVertex start, SparseVertex goal, double& distance, std::size_t indent);
 
+  /** \brief Run A* on either the adjacency list or its frozen copy, stopping as soon as the goal is expanded
+   *  \param workspace - receives the distances and predecessors of the search
+   *  \return true if the goal was reached */
+  template <typename Graph, typename WeightMap>
+  bool astarSearchGraph(const Graph& graph, WeightMap weights, SparseVertex start, SparseVertex goal,
+                        SearchWorkspace& workspace);
+
+  /** \brief Check if the graph has a path between two vertices that is shorter than \e bound, without finding the
+   *         shortest one. Searches from both ends and skips vertices that can not be on such a path
+   *  \return true as soon as the two searches meet with a combined length below the bound */
+  bool hasPathShorterThan(SparseVertex v1, SparseVertex v2, double bound, std::size_t indent);
+
+  /** \brief Implementation of hasPathShorterThan() for either the adjacency list or its frozen copy */
+  template <typename Graph, typename WeightMap>
+  bool boundedBidirectionalSearch(const Graph& graph, WeightMap weights, SparseVertex v1, SparseVertex v2,
+                                  double bound);
+
+  /** \brief Expand vertex \e v of one direction of boundedBidirectionalSearch()
+   *  \param target - the vertex this direction is searching towards
+   *  \return true if a path through a vertex reached by \e other is shorter than \e bound */
+  template <typename Graph, typename WeightMap>
+  bool expandBoundedFrontier(const Graph& graph, WeightMap weights, SparseVertex v, SparseVertex target, double bound,
+                             SearchWorkspace& workspace, const SearchWorkspace& other);
+
+  /** \brief Build an immutable compressed sparse row copy of the graph that searches use until the graph changes.
+   *         Call once the graph is mostly read, i.e. after loading or generating */
+  void freezeGraph(std::size_t indent = 0);
+
+  /** \brief Whether searches currently use the frozen copy of the graph */
+  bool isFrozen() const
+  {
+    return frozen_;
+  }
+
+  /** \brief Incremented by every change to the vertices or edges, so that copies of the graph such as the layers of
+   *         the task graph can tell whether they are out of date even when the counts did not change. Atomic so that
+   *         it can be read without holding the graph lock of the thread that modifies the graph */
+  std::size_t getModificationCount() const
+  {
+    return modificationCount_;
+  }
+
   /** \brief Determine if there is already a path the same length between the two vertices
    *  \param distance (optional): pass in a pre-calculated distance between vertices
    *  \return if true, path is necessary. if false, do not add path to graph
@@ -302,15 +365,28 @@ public:
   void visualizeDisjointSets(SparseDisjointSetsMap& disjointSets);
   std::size_t checkConnectedComponents();
   bool sameComponent(SparseVertex v1, SparseVertex v2);
+
+  /** \brief Same as sameComponent() but without path compression, so it only reads the disjoint sets and can be called
+   *         from generator threads while the main thread holds no write lock */
+  bool sameComponentReadOnly(SparseVertex v1, SparseVertex v2) const;
   void resetDisjointSets();
 
   /* ---------------------------------------------------------------------------------
    * Add/remove vertices, edges, states
    * --------------------------------------------------------------------------------- */
 
-  /** \brief Add vertex to graph */
+  /**
+   * \brief Add vertex to graph. The graph takes ownership of \e state, and when the state arena is used the values
+   *        are copied into it and \e state is freed immediately, so callers must not use their pointer afterwards.
+   *        Use getState() on the returned vertex instead
+   */
   SparseVertex addVertex(base::State* state, const VertexType& type, std::size_t indent);
 
+  /** \brief Add many vertices at once, updating the nearest neighbor structure a single time. Meant for vertices that
+   *         are not added by a sparse criteria, such as the discretized grid, so no interface data is cleared.
+   *         Takes ownership of the states like addVertex() */
+  void addVertices(const std::vector<base::State*>& states, const VertexType& type, std::size_t indent);
+
   /** \brief Quickly add vertex to graph when loading from file */
   SparseVertex addVertexFromFile(base::State* state, std::size_t indent);
 
@@ -348,9 +424,18 @@ public:
 
   const base::State* getState(SparseVertex v) const;
 
+  /** \brief State of any vertex, looking up the query state for query vertices */
+  const base::State* getVertexOrQueryState(SparseVertex v) const;
+
   /** \brief Determine if a vertex has been deleted (but not fully removed yet) */
   bool stateDeleted(SparseVertex v) const;
 
+  /** \brief Take ownership of a newly added vertex's state, moving its values into the state arena if possible */
+  base::State* adoptState(SparseVertex v, base::State* state);
+
+  /** \brief Release the state of a vertex unless it is owned by the state arena or a memory mapped file */
+  void freeVertexState(SparseVertex v);
+
   /** \brief Used for creating a voronoi diagram */
   SparseVertex getSparseRepresentative(base::State* state);
 
@@ -444,6 +529,13 @@ public:
   }
 
 protected:
+  /** \brief Invalidate the frozen copy and the copies of other classes after g_ is changed */
+  void markModified()
+  {
+    frozen_ = false;
+    modificationCount_++;
+  }
+
   /** \brief Short name of this class */
   const std::string name_ = "SparseGraph";
 
@@ -459,6 +551,12 @@ protected:
   /** \brief For saving and loading to file */
   SparseStoragePtr sparseStorage_;
 
+  /** \brief Collision free edges, saved next to the database file */
+  EdgeValidityCachePtr edgeValidityCache_;
+
+  /** \brief Edges by the workspace voxels they pass through, built by the application */
+  EdgeOccupancyIndexPtr edgeOccupancyIndex_;
+
   /** \brief Class for smoothing paths in ideal way for SPARS criteria */
   SparseSmootherPtr sparseSmoother_;
 
@@ -468,6 +566,18 @@ protected:
   /** \brief Connectivity graph */
   SparseAdjList g_;
 
+  /** \brief Contiguous joint values of all vertices, row v holds the state of SparseVertex v */
+  StateArenaPtr stateArena_;
+
+  /** \brief Frozen copy of g_ used for searching, only valid while frozen_ is true */
+  SparseCSRGraph csr_;
+
+  /** \brief Cleared whenever g_ is modified after freezeGraph() */
+  bool frozen_ = false;
+
+  /** \brief Number of modifications of g_, see getModificationCount() */
+  std::atomic<std::size_t> modificationCount_;
+
   /** \brief Vertices for performing nearest neighbor queries on multiple threads */
   std::vector<SparseVertex> queryVertices_;
   std::vector<base::State*> queryStates_;
@@ -509,7 +619,6 @@ protected:
   tools::VizSizes edgeSize_ = tools::MEDIUM;
 
   // Multi-threading modifying graph
-  std::mutex nearestNeighborMutex_;
   std::mutex modifyGraphMutex_;
 
   /** \brief Instance of random number generator */
@@ -531,6 +640,16 @@ public:  // user settings from other applications
   /** \brief Allow the database to save to file (new experiences) */
   bool savingEnabled_ = true;
 
+  /** \brief Remember which edges were collision free in a planning scene across sessions */
+  bool useEdgeValidityCache_ = false;
+
+  /** \brief Mark edges through voxels filled by obstacles as in collision before searching */
+  bool useEdgeOccupancyIndex_ = false;
+
+  /** \brief Nearest neighbor structure: "gnat", "linear" for a brute force scan that is fastest on small graphs, or
+   *         "kd_tree". The last two fall back to gnat unless the state space distance is the L1 or L2 norm */
+  std::string nearestNeighborsType_ = "gnat";
+
   /** \brief Various options for visualizing the algorithmns performance */
   bool visualizeAstar_ = false;
 
@@ -560,47 +679,6 @@ public:  // user settings from other applications
 
 };  // end class SparseGraph
 
-////////////////////////////////////////////////////////////////////////////////////////
-/**
- * Vertex visitor to check if A* search is finished.
- * \implements AStarVisitorConcept
- * See http://www.boost.org/doc/libs/1_58_0/libs/graph/doc/AStarVisitor.html
- */
-class SparseAstarVisitor : public boost::default_astar_visitor
-{
-private:
-  SparseVertex goal_;  // Goal Vertex of the search
-  SparseGraph* parent_;
-
-public:
-  /**
-   * Construct a visitor for a given search.
-   * \param goal  goal vertex of the search
-   */
-  SparseAstarVisitor(SparseVertex goal, SparseGraph* parent);
-
-/**
- * \brief Invoked when a vertex is first discovered and is added to the OPEN list.
- * \param v current Vertex
- * \param g graph we are searching on
- */
-
-#ifndef NDEBUG
-  void discover_vertex(SparseVertex v, const SparseAdjList& g) const;
-#endif
-
-  /**
-   * \brief Check if we have arrived at the goal.
-   * This is invoked on a vertex as it is popped from the queue (i.e., it has the lowest
-   * cost on the OPEN list). This happens immediately before examine_edge() is invoked on
-   * each of the out-edges of vertex u.
-   * \param v current vertex
-   * \param g graph we are searching on
-   * \throw FoundGoalException if \a u is the goal
-   */
-  void examine_vertex(SparseVertex v, const SparseAdjList& g) const;
-};  // end SparseGraph
-
 }  // namespace bolt
 }  // namespace tools
 }  // namespace ompl
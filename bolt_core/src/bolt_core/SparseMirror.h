@@ -43,6 +43,11 @@
 #include <bolt_core/SparseGraph.h>
 #include <bolt_core/SparseGenerator.h>
 
+// C++
+#include <atomic>
+#include <fstream>
+#include <functional>
+
 namespace ompl
 {
 namespace tools
@@ -74,15 +79,15 @@ public:
   /** \brief Initialize sparse parameters */
   bool setup(std::size_t indent);
 
+  /**
+   * \brief Save the product of the graph with its mirror for the other arm. Rows of dual vertices, one per vertex of
+   *        the right arm, are generated in shards on several threads. Each shard streams its vertices and edges to
+   *        its own file, which are then joined into the journal of an empty database, so the dual graph is never
+   *        held in memory
+   */
   void mirrorGraphDualArm(base::SpaceInformationPtr dualSpaceInfo, base::SpaceInformationPtr leftArmSpaceInfo,
                           const std::string &outputFile, std::size_t indent);
 
-  void addEdgesForDim(std::vector<SparseVertex> &sparseV2ToDualVertex, SparseGraphPtr &dualSG,
-                      base::SpaceInformationPtr dualSpaceInfo, std::size_t indent);
-
-  void addEdgesForAll(std::vector<std::vector<SparseVertex>> &vertexMapMatrix, SparseGraphPtr dualSG,
-                      base::SpaceInformationPtr dualSpaceInfo, std::size_t indent);
-
   void mirrorState(const base::State *source, base::State *dest, std::size_t indent);
 
   void printJointLimits(double min, double max, double value, const std::string &name);
@@ -91,13 +96,55 @@ public:
   void checkValidityOfArmMirror(base::SpaceInformationPtr dualSpaceInfo, base::SpaceInformationPtr leftArmSpaceInfo,
                                 std::size_t indent);
 
-  /** \brief Set the callback to combine robot arms into unified state */
+  /** \brief Set the callback to combine robot arms into unified state, it is called from several threads */
   void setCombineStatesCallback(ompl::tools::bolt::CombineStatesCallback callback)
   {
     combineStatesCallback_ = callback;
   }
 
+  const CombineStatesCallback &getCombineStatesCallback() const
+  {
+    return combineStatesCallback_;
+  }
+
 protected:
+  /** \brief Combine and collision check every pair in the rows of one shard, writing the valid ones as journal
+   *         records */
+  void mirrorVerticesShard(std::size_t shard, base::SpaceInformationPtr dualSpaceInfo, const std::string &filePath,
+                           std::size_t indent);
+
+  /** \brief Connect the rows of one shard, reading their states back from the vertex records of the journal */
+  void mirrorEdgesShard(std::size_t shard, base::SpaceInformationPtr dualSpaceInfo, const std::string &filePath,
+                        std::size_t indent);
+
+  /** \brief Deserialize the states of one row from the journal and the dual vertex index of each */
+  void readRow(std::istream &journal, SparseVertex rightV, base::SpaceInformationPtr dualSpaceInfo,
+               std::vector<base::State *> &states, std::vector<std::size_t> &indices);
+
+  /** \brief Run \e processShard on every shard, each thread taking the next unprocessed one
+   *  \return false if shutdown was requested before every shard was processed */
+  bool runShards(std::size_t numShards, const std::function<void(std::size_t)> &processShard);
+
+  /**
+   * \brief Append the shard files of one type to the journal in order, deleting each shard file
+   * \param numBytes - total size of the shards appended
+   * \return false if a shard could not be read or the journal could not be written
+   */
+  bool appendShards(std::ofstream &journal, const std::string &filePath, std::size_t numShards,
+                    const std::string &type, std::size_t &numBytes, std::size_t indent);
+
+  /** \brief Delete the shard files of one type, e.g. when mirroring is interrupted */
+  void removeShards(const std::string &filePath, std::size_t numShards, const std::string &type) const;
+
+  /** \brief Whether the combination of two single arm vertices is a vertex of the dual graph */
+  bool isPairValid(SparseVertex rightV, SparseVertex leftV) const
+  {
+    return (validPairs_[rightV][leftV / 64] >> (leftV % 64)) & 1;
+  }
+
+  /** \brief File that one shard streams its vertex or edge records to */
+  std::string getShardPath(const std::string &filePath, std::size_t shard, const std::string &type) const;
+
   /** \brief Short name of this class */
   const std::string name_ = "SparseMirror";
 
@@ -116,6 +163,25 @@ protected:
   /** \brief Callback to combine robot arms into unified state */
   CombineStatesCallback combineStatesCallback_;
 
+  /** \brief Mirrored state of every single arm vertex for the left arm, while generating */
+  std::vector<base::State *> mirroredStates_;
+
+  /** \brief Bit set of the single arm vertices of the left arm that are valid with each vertex of the right arm */
+  std::vector<std::vector<boost::uint64_t>> validPairs_;
+
+  /** \brief Number of dual vertices in each row, and the index of the first one */
+  std::vector<std::size_t> rowCounts_;
+  std::vector<std::size_t> rowOffsets_;
+
+  /** \brief Size of each vertex record in the journal */
+  std::size_t recordLength_ = 0;
+
+  /** \brief Statistics, updated from all threads */
+  std::atomic<std::size_t> skippedStates_;
+  std::atomic<std::size_t> skippedCollisionEdges_;
+  std::atomic<std::size_t> skippedTooLongEdges_;
+  std::atomic<std::size_t> numRowsDone_;
+
 public:
   bool verbose_ = false;
   bool vMirror_ = false;
@@ -126,6 +192,12 @@ public:
 
   bool collisionCheckMirror_ = true;
 
+  /** \brief Threads used to generate the dual graph, 0 for one per core */
+  std::size_t numThreads_ = 0;
+
+  /** \brief Rows of dual vertices generated together and written to one shard file */
+  std::size_t shardRows_ = 64;
+
 };  // end SparseMirror
 
 }  // namespace bolt
@@ -42,12 +42,22 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <sstream>
 #include <ompl/base/State.h>
 #include <ompl/base/SpaceInformation.h>
 #include <ompl/util/ClassForward.h>
 
+// Bolt
+#include <bolt_core/FlatState.h>
+
 // Boost
 #include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/thread/thread.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/utility.hpp>
 #include <boost/serialization/access.hpp>
@@ -75,6 +85,12 @@ OMPL_CLASS_FORWARD(SparseGraph);
     \brief A boost shared pointer wrapper for ompl::tools::bolt::SparseStorage */
 
 static const boost::uint32_t OMPL_PLANNER_DATA_ARCHIVE_MARKER = 0x5044414D;  // this spells PDAM
+static const boost::uint32_t BOLT_FLAT_ARCHIVE_MARKER = 0x544C4F42;         // this spells BOLT
+static const boost::uint32_t BOLT_FLAT_ARCHIVE_VERSION = 1;
+static const boost::uint32_t BOLT_COMPRESSED_ARCHIVE_MARKER = 0x5A4C4F42;  // this spells BOLZ
+static const boost::uint32_t BOLT_COMPRESSED_ARCHIVE_VERSION = 1;
+static const boost::uint32_t BOLT_JOURNAL_MARKER = 0x4A4C4F42;  // this spells BOLJ
+static const boost::uint32_t BOLT_JOURNAL_VERSION = 1;
 
 class SparseStorage
 {
@@ -131,32 +147,187 @@ public:
     float weight_;
   };
 
+  /**
+   * \brief Information stored at the beginning of the flat (memory mappable) file format. All offsets are in bytes
+   *        from the beginning of the file. The blocks that follow are:
+   *          signature:    signatureLength x int32
+   *          states:       vertexCount x stateDimension x double, one row per vertex
+   *          edgeOffsets:  (vertexCount + 1) x uint64, CSR row offsets into the targets and weights blocks
+   *          edgeTargets:  edgeCount x uint32, each undirected edge is stored once on its lower index vertex
+   *          weights:      edgeCount x float
+   *        Vertex indices do not include the query vertices
+   */
+  struct FlatHeader
+  {
+    boost::uint32_t marker;
+    boost::uint32_t version;
+    boost::uint64_t vertexCount;
+    boost::uint64_t edgeCount;
+    boost::uint64_t stateDimension;
+    boost::uint64_t signatureLength;
+    boost::uint64_t signatureOffset;
+    boost::uint64_t statesOffset;
+    boost::uint64_t edgeOffsetsOffset;
+    boost::uint64_t edgeTargetsOffset;
+    boost::uint64_t weightsOffset;
+    boost::uint64_t fileSize;
+  };
+
+  /**
+   * \brief Information stored at the beginning of the compressed file format. The blocks that follow in order are:
+   *          signature:    signatureLength x int32
+   *          minimums:     stateDimension x double, lowest value of each joint over all vertices
+   *          states:       vertexCount x stateDimension x valueBytes, unsigned fixed point steps of \e resolution
+   *                        above the joint's minimum
+   *          edges:        edgeBytes of varints, for each vertex its number of edges to higher index vertices
+   *                        followed by the sorted targets, each as the difference to the previous target (or to
+   *                        the vertex itself for the first one)
+   *          weights:      edgeCount x float in the same order as the edges, only if hasWeights
+   *        Vertex indices do not include the query vertices
+   */
+  struct CompressedHeader
+  {
+    boost::uint32_t marker;
+    boost::uint32_t version;
+    boost::uint64_t vertexCount;
+    boost::uint64_t edgeCount;
+    boost::uint64_t stateDimension;
+    boost::uint64_t signatureLength;
+    double resolution;
+    boost::uint32_t valueBytes;
+    boost::uint32_t hasWeights;
+    boost::uint64_t edgeBytes;
+  };
+
+  /** \brief Types of changes to the graph that are recorded in the journal */
+  enum JournalRecordType
+  {
+    JOURNAL_ADD_VERTEX = 1,
+    JOURNAL_REMOVE_VERTEX,
+    JOURNAL_CLEAR_VERTEX,
+    JOURNAL_ADD_EDGE,
+    JOURNAL_REMOVE_EDGE
+  };
+
+  /**
+   * \brief Information stored at the beginning of the journal next to the database file. It is followed by records
+   *        of one JournalRecordType byte and then:
+   *          add vertex:           stateLength bytes of the serialized state
+   *          remove/clear vertex:  uint64 vertex
+   *          add edge:             uint64 vertex, uint64 vertex, float weight
+   *          remove edge:          uint64 vertex, uint64 vertex
+   *        Vertex indices do not include the query vertices. Vertices are never renumbered while journaling, removed
+   *        vertices stay in the graph until the next snapshot
+   */
+  struct JournalHeader
+  {
+    boost::uint32_t marker;
+    boost::uint32_t version;
+    boost::uint64_t baseVertexCount;
+    boost::uint64_t baseEdgeCount;
+    boost::uint64_t stateLength;
+  };
+
   /** \brief Constructor */
   SparseStorage(const base::SpaceInformationPtr &si, SparseGraph *sparseGraph);
 
+  /** \brief Deconstructor */
+  ~SparseStorage();
+
   void save(const std::string &filePath, std::size_t indent = 0);
 
   void save(std::ostream &out);
 
+  /* \brief Save the whole graph in the format chosen by the settings */
+  void saveSnapshot(std::ostream &out, std::size_t indent = 0);
+
+  /* \brief Write a snapshot serialized by save() to disk and start a new journal, runs in the background */
+  void writeSnapshotThread(std::string filePath, std::shared_ptr<std::stringstream> snapshot);
+
+  /* \brief Move a newly written snapshot over the database file and start a new journal if journaling */
+  void replaceSnapshot(const std::string &tempFilePath, const std::string &filePath);
+
   /* \brief Serialize and save all vertices in \e pd to the binary archive. */
   void saveVertices(boost::archive::binary_oarchive &oa);
 
   /* \brief Serialize and store all edges in \e pd to the binary archive. */
   void saveEdges(boost::archive::binary_oarchive &oa);
 
+  /* \brief Save the graph in the flat format that can be memory mapped when loading */
+  void saveFlat(std::ostream &out, std::size_t indent = 0);
+
+  /* \brief Save the graph with quantized joint values and delta encoded edges, see CompressedHeader */
+  void saveCompressed(std::ostream &out, std::size_t indent = 0);
+
   bool load(const std::string &filePath, std::size_t indent = 0);
 
+  /* \brief Determine if a file was written with saveCompressed() */
+  bool isCompressedFile(const std::string &filePath);
+
+  /* \brief Load a file written with saveCompressed(), edge weights are recomputed if they were not stored */
+  bool loadCompressed(std::istream &in, std::size_t indent = 0);
+
+  /* \brief Determine if a file was written with saveFlat() rather than the boost archive */
+  bool isFlatFile(const std::string &filePath);
+
+  /* \brief Memory map a file written with saveFlat() and point the vertex states directly into it if possible */
+  bool loadFlat(const std::string &filePath, std::size_t indent = 0);
+
+  /* \brief Check if a state points into the memory mapped file, in which case it must not be freed */
+  bool isMappedState(const base::State *state) const
+  {
+    return numMappedStates_ && state >= &mappedStates_[0] && state < &mappedStates_[0] + numMappedStates_;
+  }
+
+  /* \brief Unmap the file loaded with loadFlat(). The graph must no longer reference any of its states */
+  void releaseMappedStates();
+
   bool load(std::istream &in, std::size_t indent);
 
   /* \brief Read \e numVertices from the binary input \e ia and store them as SparseStorage */
   void loadVertices(std::size_t numVertices, boost::archive::binary_iarchive &ia, std::size_t indent = 0);
 
-  /** \brief Thread to populate nearest neighbor structure, because that is the slowest component */
-  void populateNNThread(std::size_t startingVertex, std::size_t numVertices);
+  /* \brief Split \e numStates into one contiguous chunk per load thread and run \e decodeChunk(start, end) on each */
+  void decodeInChunks(std::size_t numStates, const std::function<void(std::size_t, std::size_t)> &decodeChunk,
+                      std::size_t indent = 0);
+
+  /* \brief Add already decoded states to the graph, then build the nearest neighbor structure in one bulk operation */
+  void addLoadedVertices(const std::vector<base::State *> &states, std::size_t indent = 0);
 
   /* \brief Read \e numEdges from the binary input \e ia and store them as SparseStorage  */
   void loadEdges(std::size_t numEdges, boost::archive::binary_iarchive &ia, std::size_t indent = 0);
 
+  /* \brief Path of the journal that belongs to a database file */
+  std::string getJournalPath(const std::string &filePath) const
+  {
+    return filePath + ".journal";
+  }
+
+  /* \brief Record a change to the graph so that it is appended to the journal on the next save */
+  void journalAddVertex(std::size_t v);
+  void journalRemoveVertex(std::size_t v);
+  void journalClearVertex(std::size_t v);
+  void journalAddEdge(std::size_t v1, std::size_t v2, float weight);
+  void journalRemoveEdge(std::size_t v1, std::size_t v2);
+
+  /* \brief Check if a full snapshot must be saved because the journal is missing or has grown too large */
+  bool journalNeedsCompaction(const std::string &filePath);
+
+  /* \brief Append all changes recorded since the last save to the journal */
+  bool appendJournal(const std::string &filePath, std::size_t indent = 0);
+
+  /* \brief Replay the journal on top of the snapshot that was just loaded */
+  bool loadJournal(const std::string &filePath, std::size_t indent = 0);
+
+  /* \brief Replace the journal with an empty one that matches the last saved snapshot */
+  void resetJournal(const std::string &filePath);
+
+  /* \brief Forget recorded changes when the graph is cleared, the next save writes a new snapshot */
+  void discardJournal();
+
+  /* \brief Block until a snapshot that is being written in the background is on disk */
+  void waitForCompaction();
+
   /** \brief Getter for where to save auditing data about size of graph, etc */
   const std::string &getLoggingPath() const
   {
@@ -184,11 +355,55 @@ public:
   std::size_t prevNumEdges_ = 0;
   std::size_t prevNumVertices_ = 0;
 
-  bool loadVerticesFinished_;
+  /** \brief Number of threads used to decode the vertex section when loading */
+  std::size_t numLoadThreads_;
+
+  /** \brief Memory mapped file from loadFlat() and the states that view into it */
+  std::shared_ptr<boost::interprocess::mapped_region> mappedRegion_;
+  std::unique_ptr<FlatState[]> mappedStates_;
+  std::size_t numMappedStates_ = 0;
 
   /** \brief Where to save auditing data about size of graph, etc */
   std::string loggingPath_;
 
+  /** \brief Save using the memory mappable flat format instead of the boost archive. Both can always be loaded */
+  bool useFlatFormat_ = true;
+
+  /** \brief Save using the compressed format instead, takes priority over useFlatFormat_ */
+  bool useCompressedFormat_ = false;
+
+  /** \brief Step size that joint values are rounded to when compressing, max error is half of this */
+  double compressionResolution_ = 0.0001;
+
+  /** \brief Store edge weights when compressing, otherwise recompute them from the (quantized) states on load */
+  bool compressionKeepWeights_ = false;
+
+  /** \brief Append changes to a journal next to the database instead of rewriting the whole file on every save */
+  bool useJournal_ = false;
+
+  /** \brief Save a new snapshot once the journal holds more records than this fraction of vertices plus edges */
+  double journalCompactionRatio_ = 0.25;
+
+  /** \brief Changes recorded since the last save, already encoded as journal records */
+  std::vector<unsigned char> journalPending_;
+  std::size_t journalPendingRecords_ = 0;
+
+  /** \brief Number of records in the journal file and the size of the snapshot it applies to */
+  std::size_t journalRecords_ = 0;
+  std::size_t journalBaseVertexCount_ = 0;
+  std::size_t journalBaseEdgeCount_ = 0;
+
+  /** \brief Whether the journal file on disk matches the snapshot, otherwise the next save writes a new snapshot */
+  bool journalValid_ = false;
+
+  /** \brief Do not record changes, used while loading */
+  bool journalPaused_ = false;
+
+  std::mutex journalMutex_;
+
+  /** \brief Writes snapshots to disk in the background when journaling */
+  boost::thread compactionThread_;
+
   bool verbose_ = true;
   bool vThreadTiming_ = false;
 };  // end of class SparseStorage
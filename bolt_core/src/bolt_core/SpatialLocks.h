@@ -0,0 +1,111 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Locks on regions of the state space so distant parts of the graph can be changed in parallel
+*/
+
+#ifndef OMPL_TOOLS_BOLT_SPATIAL_LOCKS_H_
+#define OMPL_TOOLS_BOLT_SPATIAL_LOCKS_H_
+
+// OMPL
+#include <ompl/base/SpaceInformation.h>
+
+// C++
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+OMPL_CLASS_FORWARD(SpatialLocks);
+
+/**
+ * \brief Partitions the state space into a grid of cells at least as wide as a radius, over the leading coordinates
+ *        of the states, so that any two states closer than the radius are in the same or adjacent cells. Locking a
+ *        state locks its cell and every adjacent one, excluding all other states within the radius of it. This
+ *        assumes the distance between two states is no less than the difference of any one coordinate, as for
+ *        joint spaces with L1 or L2 distances; continuous joints that wrap around are not handled. Cells are hashed
+ *        onto a fixed number of mutexes, so unrelated cells occasionally share one
+ */
+class SpatialLocks
+{
+public:
+  /**
+   * \brief Constructor
+   * \param si - space information of the locked states
+   * \param cellWidth - width of each cell, the radius within which states exclude each other
+   * \param numDims - number of leading coordinates to partition, each adds a factor of 3 to the cells locked
+   * \param numStripes - number of mutexes the cells are hashed onto
+   */
+  SpatialLocks(base::SpaceInformationPtr si, double cellWidth, std::size_t numDims = 3,
+               std::size_t numStripes = 4096);
+
+  /**
+   * \brief Lock the cell of a state and its adjacent cells, blocking until no other thread holds any of them
+   * \param stripes - receives the mutexes that were locked, to pass to unlock()
+   */
+  void lock(const base::State *state, std::vector<std::size_t> &stripes);
+
+  void unlock(const std::vector<std::size_t> &stripes);
+
+  /** \brief Number of times lock() had to wait for another thread */
+  std::size_t getNumContended() const
+  {
+    return numContended_;
+  }
+
+private:
+  base::SpaceInformationPtr si_;
+
+  double cellWidth_;
+
+  std::size_t numDims_;
+
+  /** \brief Mutexes the cells are hashed onto, always locked in increasing order */
+  std::vector<std::mutex> stripes_;
+
+  std::atomic<std::size_t> numContended_;
+};
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
+
+#endif  // OMPL_TOOLS_BOLT_SPATIAL_LOCKS_H_
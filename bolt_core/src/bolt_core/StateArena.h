@@ -0,0 +1,129 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Contiguous storage of the joint values of all vertices in a graph
+*/
+
+#ifndef OMPL_TOOLS_BOLT_STATE_ARENA_H_
+#define OMPL_TOOLS_BOLT_STATE_ARENA_H_
+
+// OMPL
+#include <ompl/base/StateSpace.h>
+#include <ompl/util/ClassForward.h>
+
+// Bolt
+#include <bolt_core/FlatState.h>
+
+// C++
+#include <memory>
+#include <vector>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+/// @cond IGNORE
+OMPL_CLASS_FORWARD(StateArena);
+/// @endcond
+
+/** \class ompl::tools::bolt::StateArenaPtr
+    \brief A boost shared pointer wrapper for ompl::tools::bolt::StateArena */
+
+/**
+ * \brief Stores one fixed stride row of joint values per index in large blocks, along with a FlatState per row that
+ *        views into it, so that states of neighboring vertices are next to each other in memory. Blocks are never
+ *        moved once allocated, so states handed out stay valid until clear()
+ */
+class StateArena
+{
+public:
+  /** \brief Constructor */
+  StateArena(const base::StateSpacePtr &space);
+
+  /** \brief Whether states of this space are a single array of doubles, otherwise the arena can not be used */
+  bool isSupported() const
+  {
+    return supported_;
+  }
+
+  /** \brief Copy the values of \e state into the row of \e index and return the arena's state for that row */
+  base::State *store(std::size_t index, const base::State *state);
+
+  /** \brief Copy the row of \e from into the row of \e to, used when vertices are renumbered */
+  base::State *move(std::size_t from, std::size_t to);
+
+  /** \brief Check if \e state is the arena's state for the row of \e index */
+  bool ownsState(std::size_t index, const base::State *state) const
+  {
+    return index / BLOCK_SIZE < blocks_.size() && blocks_[index / BLOCK_SIZE] &&
+           state == &blocks_[index / BLOCK_SIZE]->states_[index % BLOCK_SIZE];
+  }
+
+  /** \brief Release all blocks, every state that was handed out becomes invalid */
+  void clear();
+
+  /** \brief Number of doubles in each row */
+  std::size_t getDimension() const
+  {
+    return dim_;
+  }
+
+private:
+  /** \brief Number of rows allocated at once */
+  static const std::size_t BLOCK_SIZE = 4096;
+
+  struct Block
+  {
+    std::unique_ptr<double[]> values_;
+    std::unique_ptr<FlatState[]> states_;
+  };
+
+  /** \brief Get the state for the row of \e index, allocating its block if needed */
+  FlatState *getRow(std::size_t index);
+
+  std::vector<std::unique_ptr<Block> > blocks_;
+
+  std::size_t dim_;
+
+  bool supported_;
+};
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
+
+#endif  // OMPL_TOOLS_BOLT_STATE_ARENA_H_
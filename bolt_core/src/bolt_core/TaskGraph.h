@@ -107,7 +107,7 @@ public:
     return g_;
   }
 
-  TaskAdjList getGraphNonConst()
+  TaskAdjList& getGraphNonConst()
   {
     return g_;
   }
@@ -159,6 +159,20 @@ public:
   bool astarSearch(const TaskVertex start, const TaskVertex goal, std::vector<TaskVertex>& vertexPath, double& distance,
                    std::size_t indent);
 
+  /**
+   * \brief One A* search from any of several starts to the best of several goals, instead of a
+   *        search for every start and goal pair. The open list is seeded with every start at its connection cost and
+   *        the heuristic is the minimum over the goals plus their connection costs
+   * \param startCosts - cost of connecting to each start, e.g. the distance from the actual start state
+   * \param goalCosts - cost of connecting each goal to the actual goal state
+   * \param vertexPath - resulting path in reverse, from one of the goals to one of the starts
+   * \param distance - cost of the path including the connection costs of its start and goal
+   * \return true if candidate solution found
+   */
+  bool astarSearch(const std::vector<TaskVertex>& starts, const std::vector<double>& startCosts,
+                   const std::vector<TaskVertex>& goals, const std::vector<double>& goalCosts,
+                   std::vector<TaskVertex>& vertexPath, double& distance, std::size_t indent);
+
   /** \brief Compute distance between two states ignoreing task level */
   double distanceVertex(const TaskVertex a, const TaskVertex b) const;
   double distanceState(const base::State* a, const base::State* b) const;
@@ -166,6 +180,21 @@ public:
   /** \brief Distance between two vertices in a task space */
   double astarTaskHeuristic(const TaskVertex a, const TaskVertex b) const;
 
+  /** \brief Rebuild the compressed sparse row copy of the graph that A* searches while the graph is unchanged */
+  void freezeGraph(std::size_t indent = 0);
+
+  /** \brief Whether the compressed sparse row copy matches the graph */
+  bool isFrozen() const
+  {
+    return frozen_;
+  }
+
+  /** \brief The compressed sparse row copy of the graph, only valid while isFrozen() */
+  const TaskCSRGraph& getFrozenGraph() const
+  {
+    return csr_;
+  }
+
   /** \brief Custom A* visitor statistics */
   void recordNodeOpened()  // discovered
   {
@@ -258,9 +287,24 @@ public:
   /** \brief Only create one level, basically provides non-task based planning but copies the graph */
   void generateMonoLevelTaskSpace(std::size_t indent);
 
-  /** \brief Copy the sparse graph into a new task graph, and mirror it into two layers */
+  /** \brief Copy the sparse graph into a new task graph, and mirror it into two layers. The layers share the joint
+   *         states of the sparse graph, but their vertices and edges are still copied, so building them costs time
+   *         proportional to the size of the sparse graph. They are kept for the next task as long as the sparse graph
+   *         does not change, then only the cartesian vertices and their connectors from the previous task are removed
+   *         and the cost is proportional to the cartesian path */
   void generateTaskSpace(std::size_t indent);
 
+  /** \brief Whether levels 0 and 2 were generated from the sparse graph as it is now */
+  bool layersMatchSparseGraph() const;
+
+  /**
+   * \brief Find the k nearest level 0 vertices to a state, ignoring its level. Level 0 of the layers is looked up
+   *        in the nearest neighbor structure of the sparse graph instead of keeping a second one for the task graph
+   * \param state - compound state
+   * \param threadID - query slot of the sparse graph and task graph to search with, one per concurrent caller
+   */
+  void nearestK(const base::State* state, std::size_t k, std::vector<TaskVertex>& neighbors, std::size_t threadID);
+
   /** \brief Add a cartesian path into the middle layer of the task dimension
    *         This is only used for the 2D planning case (toy problem)
    */
@@ -271,14 +315,15 @@ public:
    * \param fromVertex - the endpoint (start or goal) we are connecting from the cartesian path to the graph
    * \param level - what task level we are connecting to - either 0 or 2 (bottom layer or top layer)
    * \param isStart - is this a start or goal vertex we are connecting?
+   * \param threadID - query slot to search for neighbors with, see nearestK()
    * \return true on success
    */
   bool connectVertexToNeighborsAtLevel(const TaskVertex fromVertex, const VertexLevel level, bool isStart,
-                                       std::size_t indent);
+                                       std::size_t threadID, std::size_t indent);
 
   /** \brief Get k number of neighbors near a state at a certain level that have valid motions */
   void getNeighborsAtLevel(const TaskVertex nearVertex, const VertexLevel level, const std::size_t kNeighbors,
-                           std::vector<TaskVertex>& neighbors, std::size_t indent);
+                           std::vector<TaskVertex>& neighbors, std::size_t threadID, std::size_t indent);
 
   /** \brief Error checking function to ensure solution has correct task path/level changes */
   bool checkTaskPathSolution(geometric::PathGeometric& path, base::State* start, base::State* goal);
@@ -303,6 +348,11 @@ public:
   /** \brief Clear all past edge state information about in collision or not */
   void clearEdgeCollisionStates();
 
+  /** \brief Mark the level 0 and 2 copies of sparse graph edges as in collision
+   *  \return number of task edges marked */
+  std::size_t markEdgesInCollision(const std::vector<std::pair<SparseVertex, SparseVertex> >& sparseEdges,
+                                   std::size_t indent);
+
   /** \brief Part of super debugging */
   void errorCheckDuplicateStates(std::size_t indent);
 
@@ -331,6 +381,13 @@ public:
   /** \brief Remove vertex from graph */
   void removeVertex(TaskVertex v);
 
+  /** \brief Free the compound state of a vertex, and its joint state unless that belongs to the sparse graph */
+  void freeVertexState(TaskVertex v);
+
+  /** \brief Remove the vertices and edges added after levels 0 and 2, i.e. the previous cartesian path
+   *  \return false if the layers themselves were changed and have to be generated again */
+  bool removeTaskVertices(std::size_t indent);
+
   /** \brief Cleanup graph because we leave deleted vertices in graph during construction */
   void removeDeletedVertices(std::size_t indent);
 
@@ -444,6 +501,21 @@ protected:
   /** \brief Connectivity graph */
   TaskAdjList g_;
 
+  /** \brief Read-only copy of g_ with contiguous adjacency, only valid while frozen_ is true */
+  TaskCSRGraph csr_;
+  bool frozen_ = false;
+
+  /** \brief The copies of each SparseVertex on level 0 and level 2, filled by generateTaskSpace() */
+  std::vector<TaskVertex> sparseToTaskVertex0_;
+  std::vector<TaskVertex> sparseToTaskVertex2_;
+
+  /** \brief Size of the graph once levels 0 and 2 were generated, everything after belongs to the current task */
+  std::size_t numLayerVertices_ = 0;
+  std::size_t numLayerEdges_ = 0;
+
+  /** \brief Modification count of the sparse graph when the layers were generated from it */
+  std::size_t layerSparseModificationCount_ = 0;
+
   /** \brief Vertices for performing nearest neighbor queries on multiple threads */
   std::vector<TaskVertex> queryVertices_;
   std::vector<base::State*> queryStates_;
@@ -505,22 +577,17 @@ public:  // user settings from other applications
 
 ////////////////////////////////////////////////////////////////////////////////////////
 /**
- * Vertex visitor to check if A* search is finished.
+ * Vertex visitor that records statistics and visualizes an A* search, without ending it.
  * \implements AStarVisitorConcept
  * See http://www.boost.org/doc/libs/1_58_0/libs/graph/doc/AStarVisitor.html
  */
-class TaskAstarVisitor : public boost::default_astar_visitor
+class TaskAstarStatisticsVisitor : public boost::default_astar_visitor
 {
-private:
-  TaskVertex goal_;  // Goal Vertex of the search
+protected:
   TaskGraph* parent_;
 
 public:
-  /**
-   * Construct a visitor for a given search.
-   * \param goal  goal vertex of the search
-   */
-  TaskAstarVisitor(TaskVertex goal, TaskGraph* parent);
+  TaskAstarStatisticsVisitor(TaskGraph* parent);
 
 /**
  * \brief Invoked when a vertex is first discovered and is added to the OPEN list.
@@ -529,8 +596,36 @@ public:
  */
 #ifndef NDEBUG
   void discover_vertex(TaskVertex v, const TaskAdjList& g) const;
+  void discover_vertex(TaskVertex v, const TaskCSRGraph& g) const;
 #endif
 
+  /**
+   * \brief Invoked on a vertex as it is popped from the queue (i.e., it has the lowest cost on the OPEN list)
+   * \param v current vertex
+   * \param g graph we are searching on
+   */
+  void examine_vertex(TaskVertex v, const TaskAdjList& g) const;
+  void examine_vertex(TaskVertex v, const TaskCSRGraph& g) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Vertex visitor to check if A* search is finished.
+ * \implements AStarVisitorConcept
+ * See http://www.boost.org/doc/libs/1_58_0/libs/graph/doc/AStarVisitor.html
+ */
+class TaskAstarVisitor : public TaskAstarStatisticsVisitor
+{
+private:
+  TaskVertex goal_;  // Goal Vertex of the search
+
+public:
+  /**
+   * Construct a visitor for a given search.
+   * \param goal  goal vertex of the search
+   */
+  TaskAstarVisitor(TaskVertex goal, TaskGraph* parent);
+
   /**
    * \brief Check if we have arrived at the goal.
    * This is invoked on a vertex as it is popped from the queue (i.e., it has the lowest
@@ -541,6 +636,7 @@ public:
    * \throw FoundGoalException if \a u is the goal
    */
   void examine_vertex(TaskVertex v, const TaskAdjList& g) const;
+  void examine_vertex(TaskVertex v, const TaskCSRGraph& g) const;
 };  // end TaskGraph
 
 }  // namespace bolt
@@ -46,6 +46,10 @@
 // Boost
 #include <boost/thread/mutex.hpp>
 
+// C++
+#include <memory>
+#include <vector>
+
 namespace ompl
 {
 namespace tools
@@ -120,19 +124,32 @@ public:
 
 private:
   /**
-   * \brief Generate a grid of vertices across the configuration space
+   * \brief Generate a grid of vertices across the configuration space. The points of the lattice are numbered with
+   *        joint 0 the most significant digit, and the index space is split between threads that steal from each
+   *        other when they run out
    */
   void generateVertices(std::size_t indent);
 
-  void generateVerticesThread(std::size_t threadID, double startJointValue, double endJointValue,
-                              base::SpaceInformationPtr si, std::size_t indent);
+  void generateVerticesThread(std::size_t threadID, base::SpaceInformationPtr si, std::size_t indent);
+
+  /** \brief Take the next chunk of lattice indices for a thread, stealing half of the largest remaining range of
+   *         another thread when its own is empty. \return false when the whole lattice has been handed out */
+  bool takeChunk(std::size_t threadID, std::size_t& begin, std::size_t& end);
 
-  void recursiveDiscretization(std::size_t threadID, std::vector<double>& values, std::size_t jointID,
-                               base::SpaceInformationPtr si, base::State* candidateState,
-                               std::size_t maxDiscretizationLevel, std::size_t indent);
+  /** \brief Fill \e values with the joint values of a lattice index */
+  void getLatticePoint(std::size_t index, std::vector<double>& values) const;
 
-  void createState(std::size_t threadID, std::vector<double>& values, base::SpaceInformationPtr si,
-                   base::State* candidateState, std::size_t indent);
+  /** \brief Collision and clearance check a lattice point \return true if it should become a vertex */
+  bool checkState(std::vector<double>& values, base::SpaceInformationPtr si, base::State* candidateState,
+                  std::size_t indent);
+
+  /** \brief Part of the lattice index space left to one thread, other threads steal from its end */
+  struct WorkRange
+  {
+    boost::mutex mutex_;
+    std::size_t begin_ = 0;
+    std::size_t end_ = 0;
+  };
 
   /** \brief Short name of class */
   const std::string name_ = "VertexDiscretizer";
@@ -158,6 +175,15 @@ private:
   /** \brief Track total vertices added to graph */
   std::size_t verticesAdded_;
 
+  /** \brief Values visited by each joint, a single value for joints that are not discretized */
+  std::vector<std::vector<double> > jointValues_;
+
+  /** \brief Number of points in the lattice, the product of the number of values of every joint */
+  std::size_t numLatticePoints_ = 0;
+
+  /** \brief Remaining lattice indices of each thread */
+  std::vector<std::shared_ptr<WorkRange> > workRanges_;
+
   /** \brief Distance between grid points (discretization level) */
   double discretization_ = 2.0;
 
@@ -168,6 +194,9 @@ private:
   double clearance_;
 
 public:
+  /** \brief Lattice points checked together before their vertices are added to the graph in one batch */
+  std::size_t chunkSize_ = 256;
+
   /** \brief Show more debug info */
   bool verbose_ = false;
   bool vThread_ = false;
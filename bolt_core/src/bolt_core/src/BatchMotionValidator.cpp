@@ -0,0 +1,265 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Collision check many motions at once using a pool of threads
+*/
+
+// Bolt
+#include <bolt_core/BatchMotionValidator.h>
+
+// C++
+#include <algorithm>
+#include <queue>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+namespace
+{
+/** \brief Fewest interpolation steps worth handing to a worker on their own */
+const std::size_t MIN_STEPS_PER_CHUNK = 4;
+}
+
+MotionBatch::~MotionBatch()
+{
+  cancel();
+}
+
+bool MotionBatch::next(std::size_t &index, bool &valid)
+{
+  std::unique_lock<std::mutex> lock(shared_->mutex_);
+  if (shared_->cancelled_ || shared_->nextResult_ >= shared_->motions_.size())
+    return false;
+
+  const Motion &motion = shared_->motions_[shared_->nextResult_];
+  shared_->changed_.wait(lock, [&motion]
+                         {
+                           return motion.done_;
+                         });
+
+  index = motion.index_;
+  valid = !motion.invalid_;
+  shared_->nextResult_++;
+
+  return true;
+}
+
+void MotionBatch::cancel()
+{
+  std::unique_lock<std::mutex> lock(shared_->mutex_);
+  shared_->cancelled_ = true;
+
+  // Workers might still be interpolating from our states
+  shared_->changed_.wait(lock, [this]
+                         {
+                           return shared_->numRunning_ == 0;
+                         });
+}
+
+BatchMotionValidator::BatchMotionValidator(base::SpaceInformationPtr si, std::size_t numThreads) : si_(si)
+{
+  if (numThreads == 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (std::size_t i = 0; i < numThreads; ++i)
+    workers_.push_back(std::thread(&BatchMotionValidator::workerThread, this));
+}
+
+BatchMotionValidator::~BatchMotionValidator()
+{
+  {
+    std::lock_guard<std::mutex> lock(tasksMutex_);
+    stopping_ = true;
+  }
+  tasksAvailable_.notify_all();
+
+  for (std::thread &worker : workers_)
+    worker.join();
+}
+
+MotionBatchPtr BatchMotionValidator::checkMotions(const std::vector<MotionSegment> &segments)
+{
+  MotionBatchPtr batch(new MotionBatch());
+  batch->shared_.reset(new MotionBatch::Shared());
+  MotionBatch::Shared &shared = *batch->shared_;
+  shared.segments_ = segments;
+
+  // Shortest motions first, since those are the ones callers are usually after
+  std::vector<std::pair<double, std::size_t>> lengths(segments.size());
+  for (std::size_t i = 0; i < segments.size(); ++i)
+    lengths[i] = std::make_pair(si_->distance(segments[i].first, segments[i].second), i);
+  std::sort(lengths.begin(), lengths.end());
+
+  std::vector<Task> tasks;
+  shared.motions_.resize(segments.size());
+  for (std::size_t i = 0; i < lengths.size(); ++i)
+  {
+    MotionBatch::Motion &motion = shared.motions_[i];
+    motion.index_ = lengths[i].second;
+
+    const MotionSegment &segment = segments[motion.index_];
+    motion.numSegments_ = si_->getStateSpace()->validSegmentCount(segment.first, segment.second);
+
+    // Same order as DiscreteMotionValidator: the goal state, then repeatedly the middle of the unchecked intervals
+    if (motion.numSegments_ > 0)
+      motion.order_.push_back(motion.numSegments_);
+    std::queue<std::pair<unsigned int, unsigned int>> intervals;
+    if (motion.numSegments_ > 1)
+      intervals.push(std::make_pair(1u, motion.numSegments_ - 1));
+    while (!intervals.empty())
+    {
+      const std::pair<unsigned int, unsigned int> interval = intervals.front();
+      intervals.pop();
+
+      const unsigned int mid = (interval.first + interval.second) / 2;
+      motion.order_.push_back(mid);
+
+      if (interval.first < mid)
+        intervals.push(std::make_pair(interval.first, mid - 1));
+      if (interval.second > mid)
+        intervals.push(std::make_pair(mid + 1, interval.second));
+    }
+
+    const std::size_t maxChunks = (motion.order_.size() + MIN_STEPS_PER_CHUNK - 1) / MIN_STEPS_PER_CHUNK;
+    motion.numChunks_ = std::min(workers_.size(), maxChunks);
+    motion.chunksLeft_ = motion.numChunks_;
+    if (motion.numChunks_ == 0)
+      motion.done_ = true;
+
+    for (std::size_t chunk = 0; chunk < motion.numChunks_; ++chunk)
+      tasks.push_back(Task{ batch->shared_, i, chunk });
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(tasksMutex_);
+    tasks_.insert(tasks_.end(), tasks.begin(), tasks.end());
+  }
+  tasksAvailable_.notify_all();
+
+  return batch;
+}
+
+bool BatchMotionValidator::checkMotion(const base::State *s1, const base::State *s2)
+{
+  MotionBatchPtr batch = checkMotions(std::vector<MotionSegment>(1, MotionSegment(s1, s2)));
+
+  std::size_t index;
+  bool valid = false;
+  batch->next(index, valid);
+
+  return valid;
+}
+
+void BatchMotionValidator::workerThread()
+{
+  base::State *workState = si_->allocState();
+
+  while (true)
+  {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(tasksMutex_);
+      tasksAvailable_.wait(lock, [this]
+                           {
+                             return stopping_ || !tasks_.empty();
+                           });
+      if (stopping_)
+        break;
+
+      task = tasks_.front();
+      tasks_.pop_front();
+    }
+
+    runTask(task, workState);
+  }
+
+  si_->freeState(workState);
+}
+
+void BatchMotionValidator::runTask(const Task &task, base::State *workState)
+{
+  MotionBatch::Shared &shared = *task.batch_;
+  MotionBatch::Motion &motion = shared.motions_[task.motion_];
+  const MotionSegment &segment = shared.segments_[motion.index_];
+
+  // Checked once here, so the caller cannot free the states while we are interpolating
+  {
+    std::lock_guard<std::mutex> lock(shared.mutex_);
+    if (shared.cancelled_ || motion.done_)
+      return;
+    shared.numRunning_++;
+  }
+
+  // Every chunk gets an evenly spread share of the check order
+  bool invalid = false;
+  for (std::size_t i = task.chunk_; i < motion.order_.size(); i += motion.numChunks_)
+  {
+    // Another chunk may already have found a collision
+    if (i != task.chunk_)
+    {
+      std::lock_guard<std::mutex> lock(shared.mutex_);
+      if (shared.cancelled_ || motion.done_)
+        break;
+    }
+
+    si_->getStateSpace()->interpolate(segment.first, segment.second,
+                                      static_cast<double>(motion.order_[i]) / motion.numSegments_, workState);
+    if (!si_->isValid(workState))
+    {
+      invalid = true;
+      break;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(shared.mutex_);
+    shared.numRunning_--;
+    motion.chunksLeft_--;
+    if (invalid && !motion.done_)
+    {
+      motion.invalid_ = true;
+      motion.done_ = true;
+    }
+    else if (motion.chunksLeft_ == 0)
+      motion.done_ = true;
+  }
+  shared.changed_.notify_all();
+}
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
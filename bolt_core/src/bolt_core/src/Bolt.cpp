@@ -144,6 +144,7 @@ void Bolt::setup()
     // Setup SPARS
     sparseGraph_->setup();
     sparseCriteria_->setup(indent);
+    boltPlanner_->setBatchMotionValidator(sparseCriteria_->getBatchMotionValidator());
     sparseGenerator_->setup(indent);
     taskGraph_->setup();
 
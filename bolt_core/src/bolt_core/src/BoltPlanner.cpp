@@ -47,6 +47,7 @@
 
 // C++
 #include <limits>
+#include <memory>
 
 namespace og = ompl::geometric;
 namespace ob = ompl::base;
@@ -116,6 +117,17 @@ base::PlannerStatus BoltPlanner::solve(Termination &ptc)
 
   taskGraph_->clearEdgeCollisionStates();
 
+  // Edges through voxels filled by obstacles are in collision without checking them one search at a time
+  EdgeOccupancyIndexPtr occupancyIndex = taskGraph_->getSparseGraph()->getEdgeOccupancyIndex();
+  if (occupancyIndex && occupancyIndex->isValid() && !obstacleVoxels_.empty())
+  {
+    std::vector<std::pair<SparseVertex, SparseVertex> > blockedEdges;
+    occupancyIndex->getBlockedEdges(obstacleVoxels_, blockedEdges);
+    const std::size_t numMarked = taskGraph_->markEdgesInCollision(blockedEdges, indent);
+    BOLT_DEBUG(indent, verbose_, "Marked " << numMarked << " task edges through " << obstacleVoxels_.size()
+                                           << " obstacle voxels as in collision");
+  }
+
   // Restart the Planner Input States so that the first start and goal state can be fetched
   pis_.restart();  // PlannerInputStates
 
@@ -210,6 +222,9 @@ bool BoltPlanner::getPathOffGraph(const base::State *start, const base::State *g
 {
   BOLT_FUNC(indent, verbose_, "getPathOffGraph()");
 
+  // The planner searches the graphs on the thread that called solve()
+  const std::size_t threadID = 0;
+
   // Attempt to connect to graph x times, because if it fails we start adding samples
   std::size_t maxAttempts = 2;
   std::size_t attempt = 0;
@@ -222,7 +237,7 @@ bool BoltPlanner::getPathOffGraph(const base::State *start, const base::State *g
     // Start
     int level = taskGraph_->getTaskLevel(start);
     BOLT_DEBUG(indent, verbose_, "Looking for a node near the problem start on level " << level);
-    if (!findGraphNeighbors(start, startVertexCandidateNeighbors_, level, indent))
+    if (!findGraphNeighbors(start, startVertexCandidateNeighbors_, threadID, level, indent))
     {
       BOLT_DEBUG(indent, verbose_, "No graph neighbors found for start");
       return false;
@@ -232,7 +247,7 @@ bool BoltPlanner::getPathOffGraph(const base::State *start, const base::State *g
     // Goal
     level = taskGraph_->getTaskLevel(goal);
     BOLT_DEBUG(indent, verbose_, "Looking for a node near the problem goal on level " << level);
-    if (!findGraphNeighbors(goal, goalVertexCandidateNeighbors_, level, indent))
+    if (!findGraphNeighbors(goal, goalVertexCandidateNeighbors_, threadID, level, indent))
     {
       BOLT_DEBUG(indent, verbose_, "No graph neighbors found for goal");
       return false;
@@ -284,101 +299,157 @@ bool BoltPlanner::getPathOnGraph(const std::vector<TaskVertex> &candidateStarts,
 {
   BOLT_FUNC(indent, verbose_, "getPathOnGraph()");
 
-  bool foundValidStart = false;
-  bool foundValidGoal = false;
-
-  // Try every combination of nearby start and goal pairs
-  for (TaskVertex startVertex : candidateStarts)
+  // Check the visibility of every start and goal candidate at once. Searching begins as soon as a visible start and
+  // goal are known, and when a path is found the batches go out of scope and cancel the remaining checks
+  MotionBatchPtr startBatch;
+  MotionBatchPtr goalBatch;
+  std::function<bool(std::size_t &, bool &)> nextStart =
+      checkCandidatesVisible(candidateStarts, actualStart, startBatch);
+  std::function<bool(std::size_t &, bool &)> nextGoal = checkCandidatesVisible(candidateGoals, actualGoal, goalBatch);
+
+  // Starts and goals are entered into the search at the cost of connecting to them
+  std::vector<TaskVertex> visibleStarts;
+  std::vector<double> startCosts;
+  std::vector<TaskVertex> visibleGoals;
+  std::vector<double> goalCosts;
+  bool allStartsChecked = false;
+  bool allGoalsChecked = false;
+  bool searchedAll = true;  // whether the last search already had every visible start and goal
+  std::size_t index;
+  bool visible;
+  while (!allStartsChecked || !allGoalsChecked)
   {
-    // Check if this start is visible from the actual start
-    if (!taskGraph_->checkMotion(actualStart, taskGraph_->getCompoundState(startVertex)))
+    if (ptc)  // Check if our planner is out of time
     {
-      BOLT_WARN(indent, verbose_, "Found start candidate that is not visible on vertex " << startVertex);
-
-      if (debug)
-      {
-        // visual_->viz4()->state(taskGraph_->getModelBasedState(startVertex), tools::LARGE, tools::RED, 1);
-        visual_->viz4()->state(taskGraph_->getModelBasedState(startVertex), tools::ROBOT, tools::RED, 1);
-        visual_->viz5()->state(taskGraph_->getModelBasedState(actualStart), tools::ROBOT, tools::GREEN, 1);
-
-        visual_->viz4()->edge(taskGraph_->getModelBasedState(actualStart), taskGraph_->getModelBasedState(startVertex),
-                              tools::MEDIUM, tools::BLACK);
-        visual_->viz4()->trigger();
-        // usleep(0.1 * 1000000);
-        visual_->waitForUserFeedback("not visible");
-      }
-      continue;  // this is actually not visible
+      BOLT_DEBUG(indent, verbose_, "getPathOnGraph function interrupted because termination condition is true.");
+      return false;
     }
-    foundValidStart = true;
 
-    for (TaskVertex goal : candidateGoals)
+    // Take the next start candidate, nearest first
+    if (!allStartsChecked)
     {
-      BOLT_DEBUG(indent, true || verbose_, "Planning from candidate start/goal pair "
-                                               << actualGoal << " to " << taskGraph_->getCompoundState(goal));
+      if (!nextStart(index, visible))
+        allStartsChecked = true;
+      else if (!visible)
+      {
+        const TaskVertex startVertex = candidateStarts[index];
+        BOLT_WARN(indent, verbose_, "Found start candidate that is not visible on vertex " << startVertex);
 
-      if (ptc)  // Check if our planner is out of time
+        if (debug)
+        {
+          // visual_->viz4()->state(taskGraph_->getModelBasedState(startVertex), tools::LARGE, tools::RED, 1);
+          visual_->viz4()->state(taskGraph_->getModelBasedState(startVertex), tools::ROBOT, tools::RED, 1);
+          visual_->viz5()->state(taskGraph_->getModelBasedState(actualStart), tools::ROBOT, tools::GREEN, 1);
+
+          visual_->viz4()->edge(taskGraph_->getModelBasedState(actualStart),
+                                taskGraph_->getModelBasedState(startVertex), tools::MEDIUM, tools::BLACK);
+          visual_->viz4()->trigger();
+          // usleep(0.1 * 1000000);
+          visual_->waitForUserFeedback("not visible");
+        }
+      }
+      else
       {
-        BOLT_DEBUG(indent, verbose_, "getPathOnGraph function interrupted because termination condition is true.");
-        return false;
+        const TaskVertex startVertex = candidateStarts[index];
+        visibleStarts.push_back(startVertex);
+        startCosts.push_back(taskGraph_->distanceState(actualStart, taskGraph_->getCompoundState(startVertex)));
+        searchedAll = false;
       }
+    }
 
-      // Check if this goal is visible from the actual goal
-      if (!taskGraph_->checkMotion(actualGoal, taskGraph_->getCompoundState(goal)))
+    // Take the next goal candidate, nearest first
+    if (!allGoalsChecked)
+    {
+      if (!nextGoal(index, visible))
+        allGoalsChecked = true;
+      else if (!visible)
       {
         BOLT_WARN(indent, verbose_, "FOUND GOAL CANDIDATE THAT IS NOT VISIBLE! ");
 
         if (visualizeStartGoalUnconnected_)
-          visualizeBadEdge(actualGoal, taskGraph_->getCompoundState(goal));
-
-        continue;  // this is actually not visible
-      }
-      foundValidGoal = true;
-
-      // Repeatidly search through graph for connection then check for collisions then repeat
-      if (onGraphSearch(startVertex, goal, actualStart, actualGoal, compoundSolution, ptc, indent))
-      {
-        // All save trajectories should be at least 1 state long, then we append the start and goal states, for
-        // min of 3
-        assert(compoundSolution->getStateCount() >= 3);
-
-        // Found a path
-        return true;
+          visualizeBadEdge(actualGoal, taskGraph_->getCompoundState(candidateGoals[index]));
       }
       else
       {
-        // Did not find a path
-        BOLT_DEBUG(indent, verbose_, "Did not find a path, looking for other start/goal combinations ");
+        const TaskVertex goalVertex = candidateGoals[index];
+        visibleGoals.push_back(goalVertex);
+        goalCosts.push_back(taskGraph_->distanceState(actualGoal, taskGraph_->getCompoundState(goalVertex)));
+        searchedAll = false;
       }
+    }
 
-      if (visual_->viz1()->shutdownRequested())
-        break;
-    }  // foreach
+    // Search as soon as both ends can be connected, and again whenever more candidates become visible after a search
+    // that found no valid path
+    if (visibleStarts.empty() || visibleGoals.empty() || searchedAll)
+      continue;
+    searchedAll = true;
 
-    if (visual_->viz1()->shutdownRequested())
-      break;
-  }  // foreach
+    BOLT_DEBUG(indent, verbose_, "Planning from " << visibleStarts.size() << " visible starts to "
+                                                  << visibleGoals.size() << " visible goals");
+
+    // Repeatidly search through graph for connection then check for collisions then repeat
+    if (onGraphSearch(visibleStarts, startCosts, visibleGoals, goalCosts, actualStart, actualGoal, compoundSolution,
+                      ptc, indent))
+    {
+      // All save trajectories should be at least 1 state long, then we append the start and goal states, for min of 3
+      assert(compoundSolution->getStateCount() >= 3);
+
+      return true;
+    }
+    if (ptc || visual_->viz1()->shutdownRequested())
+      return false;
+  }
 
-  if (foundValidStart && foundValidGoal)
+  if (visibleStarts.empty())
   {
-    BOLT_ERROR(indent, "Both a valid start and goal were found but still no path found.");
+    BOLT_WARN(indent, true, "Unable to connect START state to graph");
+    feedbackStartFailed = true;  // the start state failed us
     return false;
   }
-
-  if (foundValidStart && !foundValidGoal)
+  if (visibleGoals.empty())
   {
     BOLT_WARN(indent, true, "Unable to connect GOAL state to graph");
     feedbackStartFailed = false;  // it was the goal state that failed us
+    return false;
   }
-  else
+
+  BOLT_ERROR(indent, "Both a valid start and goal were found but still no path found.");
+  return false;
+}
+
+std::function<bool(std::size_t &, bool &)> BoltPlanner::checkCandidatesVisible(
+    const std::vector<TaskVertex> &candidates, const base::State *actual, MotionBatchPtr &batch)
+{
+  // Without a worker pool check each candidate when it is asked for, in the order given
+  if (!batchMotionValidator_)
   {
-    BOLT_WARN(indent, true, "Unable to connect START state to graph");
-    feedbackStartFailed = true;  // the start state failed us
+    std::shared_ptr<std::size_t> nextIndex(new std::size_t(0));
+    return [this, &candidates, actual, nextIndex](std::size_t &index, bool &valid)
+    {
+      if (*nextIndex >= candidates.size())
+        return false;
+      index = (*nextIndex)++;
+      valid = taskGraph_->checkMotion(actual, taskGraph_->getCompoundState(candidates[index]));
+      return true;
+    };
   }
 
-  return false;
+  std::vector<MotionSegment> segments;
+  segments.reserve(candidates.size());
+  for (const TaskVertex &candidate : candidates)
+    segments.push_back(
+        MotionSegment(taskGraph_->getModelBasedState(actual), taskGraph_->getModelBasedState(candidate)));
+  batch = batchMotionValidator_->checkMotions(segments);
+
+  MotionBatch *batchPtr = batch.get();
+  return [batchPtr](std::size_t &index, bool &valid)
+  {
+    return batchPtr->next(index, valid);
+  };
 }
 
-bool BoltPlanner::onGraphSearch(const TaskVertex &startVertex, const TaskVertex &goalVertex,
+bool BoltPlanner::onGraphSearch(const std::vector<TaskVertex> &starts, const std::vector<double> &startCosts,
+                                const std::vector<TaskVertex> &goals, const std::vector<double> &goalCosts,
                                 const base::State *actualStart, const base::State *actualGoal,
                                 og::PathGeometricPtr compoundSolution, Termination &ptc, std::size_t indent)
 {
@@ -388,47 +459,34 @@ bool BoltPlanner::onGraphSearch(const TaskVertex &startVertex, const TaskVertex
   std::vector<TaskVertex> vertexPath;
   double distance;  // resulting path distance
 
-  // Make sure that the start and goal aren't so close together that they find the same vertex
-  if (startVertex == goalVertex)
-  {
-    BOLT_DEBUG(indent, verbose_, "    Start equals goal, creating simple solution ");
-    visual_->waitForUserFeedback("    Start equals goal, creating simple solution ");
-
-    // There are only three verticies in this path - start, middle, goal
-    vertexPath.push_back(startVertex);
-
-    convertVertexPathToStatePath(vertexPath, actualStart, actualGoal, compoundSolution, indent);
-    return true;
-  }
-
   // Error check all states are non-nullptr
   assert(actualStart);
   assert(actualGoal);
-  assert(taskGraph_->getCompoundState(startVertex));
-  assert(taskGraph_->getCompoundState(goalVertex));
 
-  // Visualize start vertex
+  // Visualize start and goal vertices
   if (visualizeStartGoal_)
   {
     BOLT_DEBUG(indent, verbose_, "viz start -----------------------------");
-    // visual_->viz5()->state(taskGraph_->getModelBasedState(startVertex), tools::VARIABLE_SIZE, tools::PURPLE, 1);
-    visual_->viz4()->state(taskGraph_->getModelBasedState(startVertex), tools::ROBOT, tools::ORANGE);
-    // visual_->viz5()->edge(actualStart, taskGraph_->getModelBasedState(startVertex), tools::MEDIUM, tools::BLACK);
-    // visual_->viz5()->trigger();
-    // visual_->waitForUserFeedback("start viz");
+    for (const TaskVertex startVertex : starts)
+      visual_->viz4()->state(taskGraph_->getModelBasedState(startVertex), tools::ROBOT, tools::ORANGE);
 
-    // Visualize goal vertex
     BOLT_DEBUG(indent, verbose_, "viz goal ------------------------------");
-    // visual_->viz5()->state(taskGraph_->getModelBasedState(goalVertex), tools::VARIABLE_SIZE, tools::PURPLE, 1);
-    visual_->viz5()->state(taskGraph_->getModelBasedState(goalVertex), tools::ROBOT, tools::GREEN);
-    // visual_->viz5()->edge(actualGoal, taskGraph_->getModelBasedState(goalVertex), tools::MEDIUM, tools::BLACK);
-    // visual_->viz5()->trigger();
-    // visual_->waitForUserFeedback("goal viz");
+    for (const TaskVertex goalVertex : goals)
+      visual_->viz5()->state(taskGraph_->getModelBasedState(goalVertex), tools::ROBOT, tools::GREEN);
   }
 
-  // Keep looking for paths between chosen start and goal until one is found that is valid,
+  // Keep looking for paths between any start and any goal until one is found that is valid,
   // or no further paths can be found between them because of disabled edges
   // this is necessary for lazy collision checking i.e. rerun after marking invalid edges we found
+  std::unique_ptr<IncrementalTaskSearch> incrementalSearch;
+  if (useIncrementalSearch_)
+  {
+    if (!taskGraph_->isFrozen())
+      taskGraph_->freezeGraph(indent);
+    incrementalSearch.reset(new IncrementalTaskSearch(taskGraph_.get()));
+    incrementalSearch->start(starts, startCosts, goals, goalCosts);
+  }
+
   while (!visual_->viz1()->shutdownRequested())
   {
     // Check if our planner is out of time
@@ -438,8 +496,14 @@ bool BoltPlanner::onGraphSearch(const TaskVertex &startVertex, const TaskVertex
       return false;
     }
 
-    // Attempt to find a solution from start to goal
-    if (!taskGraph_->astarSearch(startVertex, goalVertex, vertexPath, distance, indent))
+    // Attempt to find a solution from the starts to the goals, repairing the previous search if there is one
+    bool foundPath;
+    if (incrementalSearch)
+      foundPath = incrementalSearch->computePath(vertexPath, distance);
+    else
+      foundPath = taskGraph_->astarSearch(starts, startCosts, goals, goalCosts, vertexPath, distance, indent);
+
+    if (!foundPath)
     {
       BOLT_WARN(indent, true || verbose_, "Unable to construct solution between start and goal using astar");
 
@@ -447,15 +511,40 @@ bool BoltPlanner::onGraphSearch(const TaskVertex &startVertex, const TaskVertex
       return false;
     }
 
+    // A start that is also a goal, there are only three vertices in this path - start, middle, goal
+    if (vertexPath.size() == 1)
+    {
+      BOLT_DEBUG(indent, verbose_, "    Start equals goal, creating simple solution ");
+
+      convertVertexPathToStatePath(vertexPath, actualStart, actualGoal, compoundSolution, indent);
+      return true;
+    }
+
     // Check if all the points in the potential solution are valid
     if (lazyCollisionCheck(vertexPath, ptc, indent))
     {
       BOLT_DEBUG(indent, verbose_, "Lazy collision check returned valid ");
+      if (incrementalSearch)
+      {
+        BOLT_DEBUG(indent, verbose_, "Incremental search expanded " << incrementalSearch->getNumExpanded()
+                                                                    << " vertices");
+      }
 
       // the path is valid, we are done!
       convertVertexPathToStatePath(vertexPath, actualStart, actualGoal, compoundSolution, indent);
       return true;
     }
+
+    // Tell the search which edges of the path were disabled so it only repairs the part of the tree behind them
+    if (incrementalSearch)
+    {
+      for (std::size_t i = 1; i < vertexPath.size(); ++i)
+      {
+        TaskEdge e = boost::edge(vertexPath[i - 1], vertexPath[i], taskGraph_->getGraph()).first;
+        if (taskGraph_->getGraph()[e].collision_state_ == IN_COLLISION)
+          incrementalSearch->updateEdge(vertexPath[i - 1], vertexPath[i]);
+      }
+    }
     // else, loop with updated graph that has the invalid edges/states disabled
   }  // end while
 
@@ -469,6 +558,9 @@ bool BoltPlanner::lazyCollisionCheck(std::vector<TaskVertex> &vertexPath, Termin
 
   bool hasInvalidEdges = false;
 
+  // Edges found free in earlier sessions with the same obstacles
+  EdgeValidityCachePtr edgeCache = taskGraph_->getSparseGraph()->getEdgeValidityCache();
+
   // Initialize
   TaskVertex fromVertex = vertexPath[0];
   TaskVertex toVertex;
@@ -495,7 +587,13 @@ bool BoltPlanner::lazyCollisionCheck(std::vector<TaskVertex> &vertexPath, Termin
       // Check path between states
       const base::State *fromState = taskGraph_->getModelBasedState(fromVertex);
       const base::State *toState = taskGraph_->getModelBasedState(toVertex);
-      if (!modelSI_->getMotionValidator()->checkMotion(fromState, toState))
+      if (edgeCache && edgeCache->isKnownFree(fromState, toState))
+      {
+        BOLT_DEBUG(indent, vCollisionCheck_, "LAZY CHECK: edge from vertex " << fromVertex << " to " << toVertex
+                                                                             << " is known to be free");
+        taskGraph_->getGraphNonConst()[thisEdge].collision_state_ = FREE;
+      }
+      else if (!modelSI_->getMotionValidator()->checkMotion(fromState, toState))
       {
         BOLT_MAGENTA(indent, vCollisionCheck_, "LAZY CHECK: disabling edge from vertex " << fromVertex << " to "
                                                                                          << toVertex);
@@ -511,11 +609,15 @@ bool BoltPlanner::lazyCollisionCheck(std::vector<TaskVertex> &vertexPath, Termin
 
         // Disable edge
         taskGraph_->getGraphNonConst()[thisEdge].collision_state_ = IN_COLLISION;
+        if (edgeCache)
+          edgeCache->setInCollision(fromState, toState);
       }
       else
       {
         // Mark edge as free so we no longer need to check for collision
         taskGraph_->getGraphNonConst()[thisEdge].collision_state_ = FREE;
+        if (edgeCache)
+          edgeCache->setFree(fromState, toState);
       }
     }
     else if (taskGraph_->getGraphNonConst()[thisEdge].collision_state_ == IN_COLLISION)
@@ -546,8 +648,8 @@ bool BoltPlanner::lazyCollisionCheck(std::vector<TaskVertex> &vertexPath, Termin
   return !hasInvalidEdges;
 }
 
-bool BoltPlanner::findGraphNeighbors(const base::State *state, std::vector<TaskVertex> &neighbors, int requiredLevel,
-                                     std::size_t indent)
+bool BoltPlanner::findGraphNeighbors(const base::State *state, std::vector<TaskVertex> &neighbors,
+                                     std::size_t threadID, int requiredLevel, std::size_t indent)
 {
   BOLT_FUNC(indent, verbose_, "findGraphNeighbors()");
 
@@ -568,16 +670,8 @@ bool BoltPlanner::findGraphNeighbors(const base::State *state, std::vector<TaskV
   // else
   kNearestNeighbors = 30;
 
-  // Setup search by getting a non-const version of the focused state
-  const std::size_t threadID = 0;
-  // TODO avoid this memory allocation but keeping as member variable
-  base::State *stateCopy = compoundSI_->cloneState(state);
-
   // Search
-  taskGraph_->getCompoundQueryStateNonConst(taskGraph_->getQueryVertices()[threadID]) = stateCopy;
-  // taskGraph_->nn_->nearestR(taskGraph_->getQueryVertices()[threadID], radius, neighbors);
-  taskGraph_->getNN()->nearestK(taskGraph_->getQueryVertices()[threadID], kNearestNeighbors, neighbors);
-  taskGraph_->getCompoundQueryStateNonConst(taskGraph_->getQueryVertices()[threadID]) = nullptr;
+  taskGraph_->nearestK(state, kNearestNeighbors, neighbors, threadID);
 
   // Convert our list of neighbors to the proper level
   if (requiredLevel == 2)
@@ -596,9 +690,6 @@ bool BoltPlanner::findGraphNeighbors(const base::State *state, std::vector<TaskV
     }
   }
 
-  // Free memory
-  compoundSI_->getStateSpace()->freeState(stateCopy);
-
   return neighbors.size();
 }
 
@@ -827,10 +918,11 @@ bool BoltPlanner::canConnect(const base::State *randomState, Termination &ptc, s
   BOLT_FUNC(indent, verbose_, "canConnect()");
 
   std::vector<TaskVertex> candidateNeighbors;
+  const std::size_t threadID = 0;
 
   // Find neighbors to rand state
   BOLT_DEBUG(indent, verbose_, "Looking for a node near the random state");
-  if (!findGraphNeighbors(randomState, candidateNeighbors))
+  if (!findGraphNeighbors(randomState, candidateNeighbors, threadID))
   {
     BOLT_DEBUG(indent, verbose_, "No graph neighbors found for randomState");
     return false;
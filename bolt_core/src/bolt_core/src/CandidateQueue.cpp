@@ -41,8 +41,12 @@
 #include <bolt_core/SparseCriteria.h>
 #include <bolt_core/SparseGenerator.h>
 
+// OMPL
+#include <ompl/util/Time.h>
+
 // C++
-#include <queue>
+#include <algorithm>
+#include <chrono>
 #include <thread>
 
 namespace ompl
@@ -57,6 +61,7 @@ CandidateQueue::CandidateQueue(SparseGraphPtr sg, SparseGenerator *sparseGenerat
   , sparseGenerator_(sparseGenerator)
   , si_(sg_->getSpaceInformation())
   , visual_(sg_->getVisual())
+  , threadsRunning_(false)
 {
 }
 
@@ -78,16 +83,21 @@ void CandidateQueue::clear()
 
   // Clear
   totalMisses_ = 0;
+  totalStolen_ = 0;
+  totalStallTime_ = 0;
   totalTime_ = 0;
   totalCandidates_ = 0;
 
-  // TODO: is it possible the front item in the queue is being used elsewhere and setCandidateUsed()
-  // was not called yet?
-  while (!queue_.empty())
+  std::lock_guard<std::mutex> lock(ringMutex_);
+  while (ringSize_ > 0)
+    popFront(true);
+
+  if (usingStolenCandidate_)
   {
-    si_->freeState(queue_.front().state_);
-    queue_.pop();
+    si_->freeState(stolenCandidate_.state_);
+    usingStolenCandidate_ = false;
   }
+  candidateInUse_ = false;
 }
 
 void CandidateQueue::startGenerating(std::size_t indent)
@@ -98,7 +108,6 @@ void CandidateQueue::startGenerating(std::size_t indent)
     BOLT_ERROR(indent, "CandidateQueue already running");
     return;
   }
-  threadsRunning_ = true;
 
   // Add up all misses before resetting
   if (totalMisses_ > 0)
@@ -114,39 +123,36 @@ void CandidateQueue::startGenerating(std::size_t indent)
   // Stats
   totalMisses_ = 0;
 
-  // Set number threads - should be at least less than 1 from total number of threads on system
-  // 1 thread is for parent, 1 is for sampler, 1 is for GUIs, etc, remainder are for this
-  // numThreads_ = std::max(1, int(sg_->getNumQueryVertices() - 3));
-
-  // TODO: how to choose this number best to minimize queue misses?
-  /* For 2D environment test data...
-     Threads:
-     2 AVERAGE CandidateQueue MISSES: 447
-     3 AVERAGE CandidateQueue MISSES: 432
-     4 AVERAGE CandidateQueue MISSES: 385
-     5 AVERAGE CandidateQueue MISSES: 398
-
-     For 3D environment test data...
-     4 AVERAGE CandidateQueue MISSES: 2621
-     5 AVERAGE CandidateQueue MISSES: 2429
-     6 AVERAGE CandidateQueue MISSES: 2493
-
-     so we choose 5.
-  */
-  numThreads_ = 5;
-  BOLT_DEBUG(indent, true, "Running CandidateQueue with " << numThreads_ << " threads");
-  if (numThreads_ < 2)
-    BOLT_WARN(indent, true, "Only running CandidateQueue with 1 thread");
-  if (numThreads_ >= sg_->getNumQueryVertices())
+  // Size the pool to the hardware, leaving one core for the parent
+  std::size_t numThreads = numThreadsRequested_;
+  if (numThreads == 0)
+    numThreads = std::max(1u, boost::thread::hardware_concurrency()) - 1;
+
+  // Each thread searches the nearest neighbors through its own query vertex, the first is the parent's
+  const std::size_t maxThreads = sg_->getNumQueryVertices() - 1;
+  if (numThreads > maxThreads)
   {
-    BOLT_ERROR(indent, "Too many threads requested for candidate queue");
-    exit(-1);
+    BOLT_WARN(indent, true, "Only " << maxThreads << " query vertices are available for CandidateQueue threads");
+    numThreads = maxThreads;
   }
+  numThreads_ = numThreads;
+
+  BOLT_DEBUG(indent, true, "Running CandidateQueue with " << numThreads_ << " threads");
+  if (numThreads_ == 0)
+    BOLT_WARN(indent, true, "CandidateQueue has no threads, candidates are generated by the parent");
+
+  // Room for a few candidates per thread
+  ring_.assign(std::max<std::size_t>(1, numThreads_ * queueSizePerThread_), CandidateData());
+  ringFront_ = 0;
+  ringSize_ = 0;
+  ringReserved_ = 0;
+
+  threadsRunning_ = true;
 
   // Create threads
   generatorThreads_.resize(numThreads_);
 
-  for (std::size_t i = 0; i < generatorThreads_.size(); ++i)
+  for (std::size_t threadID = 0; threadID <= numThreads_; ++threadID)
   {
     // Create new collision checker
     base::SpaceInformationPtr si(new base::SpaceInformation(si_->getStateSpace()));
@@ -156,23 +162,27 @@ void CandidateQueue::startGenerating(std::size_t indent)
     // Choose sampler based on clearance
     base::ValidStateSamplerPtr sampler = sg_->getSampler(si, sg_->getObstacleClearance(), indent);
 
-    std::size_t threadID = i + 1;  // the first thread (0) is reserved for the parent process
-    generatorThreads_[i] =
-        new boost::thread(boost::bind(&CandidateQueue::generatingThread, this, threadID, si, sampler, indent));
-  }
+    // The first thread (0) is reserved for the parent process
+    if (threadID == 0)
+    {
+      parentSampler_ = sampler;
+      continue;
+    }
 
-  // Wait for first sample to be found
-  // BOLT_DEBUG(indent, true, "Waiting for first candidate to be found");
-  while (queue_.empty())
-  {
-    usleep(0.001 * 1000000);
+    generatorThreads_[threadID - 1] =
+        new boost::thread(boost::bind(&CandidateQueue::generatingThread, this, threadID, sampler, indent));
   }
 }
 
 void CandidateQueue::stopGenerating(std::size_t indent)
 {
   BOLT_FUNC(indent, true, "CandidateQueue.stopGenerating() Stopping generating thread");
-  threadsRunning_ = false;
+  {
+    std::lock_guard<std::mutex> lock(ringMutex_);
+    threadsRunning_ = false;
+  }
+  notFull_.notify_all();
+  notEmpty_.notify_all();
 
   // Join threads
   for (std::size_t i = 0; i < generatorThreads_.size(); ++i)
@@ -180,192 +190,272 @@ void CandidateQueue::stopGenerating(std::size_t indent)
     generatorThreads_[i]->join();
     delete generatorThreads_[i];
   }
+  generatorThreads_.clear();
 
   BOLT_DEBUG(indent, true, "CandidateQueue.stopGenerating() joined");
 
-  // Clear the first state in the queue without freeing the memory
+  std::lock_guard<std::mutex> lock(ringMutex_);
+
+  // Clear the candidate in use by the parent without freeing the memory
   // TODO: this is a memory leak, but sometimes it segfaults because perhaps that state was already
   // freed somewhere in the main thread (SparseCritera) and it was never reflected back here
-  if (!queue_.empty())
+  if (candidateInUse_)
   {
-    // skip freeing
-    queue_.pop();
+    if (!usingStolenCandidate_)
+      popFront(false);  // skip freeing
+    candidateInUse_ = false;
+    usingStolenCandidate_ = false;
   }
 
   // Clear remaining data
-  while (!queue_.empty())
+  while (ringSize_ > 0)
   {
-    // std::cout << "Queue num " << queue_.size() << ": queue_.front().state_: " << queue_.front().state_;
-
-    if (queue_.front().state_ == nullptr)
+    if (ring_[ringFront_].state_ == nullptr)
     {
-      std::cout << std::endl;
       BOLT_WARN(indent, true, "Found state in queue that is null!");
+      popFront(false);
     }
     else
     {
-      // Do not free the state of the last item on the queue, because it is used somewhere else (?)
-      si_->getStateSpace()->freeState(queue_.front().state_);
-      // std::cout << "... freed " << std::endl;
+      popFront(true);
     }
-
-    queue_.pop();
   }
+  ringReserved_ = 0;
 
   BOLT_DEBUG(indent, true, "CandidateQueue.stopGenerating() finished");
 }
 
-void CandidateQueue::generatingThread(std::size_t threadID, base::SpaceInformationPtr si,
-                                      base::ValidStateSamplerPtr sampler, std::size_t indent)
+void CandidateQueue::generatingThread(std::size_t threadID, base::ValidStateSamplerPtr sampler, std::size_t indent)
 {
   BOLT_FUNC(indent, verbose_, "generatingThread() " << threadID);
 
-  base::State *candidateState;
-
   while (threadsRunning_ && !visual_->viz1()->shutdownRequested())
   {
     BOLT_DEBUG(indent + 2, vThread_, "generatingThread: Running while loop on thread " << threadID);
 
     // Do not add more states if queue is full
-    if (queue_.size() > targetQueueSize_)
-      waitForQueueNotFull(indent + 2);
+    if (!reserveSlot(indent + 2))
+      return;
 
-    // Create new state
-    candidateState = si_->allocState();
+    CandidateData candidateD;
+    if (generateCandidate(candidateD, threadID, sampler, indent + 2))
+      push(candidateD);
+    else
+      releaseSlot();
+  }
+}
 
-    // Sample randomly
-    if (!sampler->sample(candidateState))
-      throw Exception(name_, "Unable to find valid sample");
+bool CandidateQueue::generateCandidate(CandidateData &candidateD, std::size_t threadID,
+                                       base::ValidStateSamplerPtr sampler, std::size_t indent)
+{
+  // Create new state
+  base::State *candidateState = si_->allocState();
 
-    BOLT_DEBUG(indent + 2, vThread_, "New candidateState: " << candidateState << " on thread " << threadID);
+  // Sample randomly
+  if (!sampler->sample(candidateState))
+    throw Exception(name_, "Unable to find valid sample");
 
-    if (!threadsRunning_)  // Check for thread ending
-    {
-      BOLT_DEBUG(indent + 2, vThread_, "Thread ended, freeing memory");
-      si_->freeState(candidateState);
-      return;
-    }
+  BOLT_DEBUG(indent, vThread_, "New candidateState: " << candidateState << " on thread " << threadID);
 
-    // Find nearby nodes
-    CandidateData candidateD(candidateState);
+  if (!threadsRunning_)  // Check for thread ending
+  {
+    BOLT_DEBUG(indent, vThread_, "Thread ended, freeing memory");
+    si_->freeState(candidateState);
+    return false;
+  }
 
-    // time::point startTime = time::now(); // Benchmark
+  // Find nearby nodes
+  candidateD = CandidateData(candidateState);
 
-    if (!findGraphNeighbors(candidateD, threadID, indent + 2))
-    {
-      // The search for neighbors was aborted
-      si_->freeState(candidateState);
-      continue;
-    }
+  // time::point startTime = time::now(); // Benchmark
 
-    // Benchmark
-    // double time = time::seconds(time::now() - startTime);
-    // totalTime_ += time;
-    // totalCandidates_ ++;
-    // double average = totalTime_ / totalCandidates_;
-    // BOLT_MAGENTA(0, true,  time << " CandidateQueue, average: " << average << " queue: " << queue_.size()); //
-    // Benchmark
+  if (!findGraphNeighbors(candidateD, threadID, indent))
+  {
+    // The search for neighbors was aborted
+    si_->freeState(candidateState);
+    return false;
+  }
 
-    // Ensure this candidate is still valid
-    if (candidateD.graphVersion_ != sparseGenerator_->getNumRandSamplesAdded())
-    {
-      // Expired graph
-      si_->freeState(candidateState);
-      continue;
-    }
+  // Benchmark
+  // double time = time::seconds(time::now() - startTime);
+  // totalTime_ += time;
+  // totalCandidates_ ++;
+  // double average = totalTime_ / totalCandidates_;
+  // BOLT_MAGENTA(0, true,  time << " CandidateQueue, average: " << average << " queue: " << ringSize_); //
+  // Benchmark
 
-    // Add to queue - thread-safe
-    boost::lock_guard<boost::shared_mutex> lock(candidateQueueMutex_);
-    queue_.push(candidateD);
+  // Decide what to add on this thread, the parent only revalidates the decision against newer vertices
+  if (sparseCriteria_->useSpeculativeCriteria_)
+  {
+    sparseCriteria_->evaluateCandidate(candidateD, indent);
+  }
+  // Ensure this candidate is still valid
+  else if (candidateD.graphVersion_ != sparseGenerator_->getNumRandSamplesAdded())
+  {
+    // Expired graph
+    si_->freeState(candidateState);
+    return false;
   }
+
+  return true;
 }
 
 CandidateData &CandidateQueue::getNextCandidate(std::size_t indent)
 {
   BOLT_CYAN(indent, verbose_, "CandidateQueue.getNextCanidate(): queue size: "
-                                  << queue_.size()
-                                  << " num samples added: " << sparseGenerator_->getNumRandSamplesAdded());
+                                  << ringSize_ << " num samples added: " << sparseGenerator_->getNumRandSamplesAdded());
   // This function is run in the parent thread
 
-  // Keep looping until a non-expired candidate exists or the thread ends
-  while (threadsRunning_)
+  std::unique_lock<std::mutex> lock(ringMutex_);
+
+  bool stalled = false;
+  time::point stallStart;
+  while (true)
   {
-    // Clear all expired candidates
+    // Clear all expired candidates, or bring them up to date if the criteria are speculative
+    std::size_t numCleared = 0;
+    BOLT_DEBUG(indent, verbose_, "Current graph version: " << sparseGenerator_->getNumRandSamplesAdded());
+    while (ringSize_ > 0)
     {
-      boost::lock_guard<boost::shared_mutex> lock(candidateQueueMutex_);
-      std::size_t numCleared = 0;
-      BOLT_DEBUG(indent, verbose_, "Current graph version: " << sparseGenerator_->getNumRandSamplesAdded());
-      while (!queue_.empty() && queue_.front().graphVersion_ != sparseGenerator_->getNumRandSamplesAdded() &&
-             threadsRunning_)
-      {
-        BOLT_DEBUG(indent, verbose_, "Expired candidate state with graph version: " << queue_.front().graphVersion_);
-
-        // Next Candidate state is expired, delete
-        si_->freeState(queue_.front().state_);
-        queue_.pop();
-        numCleared++;
-      }
-      BOLT_DEBUG(indent, vClear_ && numCleared > 0, "Cleared " << numCleared << " states from CandidateQueue");
+      // Only the parent removes the front, so it can be used without the lock
+      CandidateData &candidateD = ring_[ringFront_];
+      if (candidateD.graphVersion_ == sparseGenerator_->getNumRandSamplesAdded())
+        break;
 
-      // Stop seaching for expired states after we find the first one that is not expired
-      if (!queue_.empty() && queue_.front().graphVersion_ == sparseGenerator_->getNumRandSamplesAdded())
+      if (sparseCriteria_->useSpeculativeCriteria_)
       {
+        lock.unlock();
+        sparseCriteria_->revalidateCandidate(candidateD, indent);
+        lock.lock();
+        candidateD.graphVersion_ = sparseGenerator_->getNumRandSamplesAdded();
         break;
       }
+
+      BOLT_DEBUG(indent, verbose_, "Expired candidate state with graph version: " << candidateD.graphVersion_);
+
+      // Next Candidate state is expired, delete
+      popFront(true);
+      numCleared++;
     }
+    BOLT_DEBUG(indent, vClear_ && numCleared > 0, "Cleared " << numCleared << " states from CandidateQueue");
+
+    if (ringSize_ > 0)
+      break;
 
-    // Do not continue until there is something in the queue
-    waitForQueueNotEmpty(indent);
+    if (!stalled)
+    {
+      BOLT_WARN(indent, vQueueEmpty_, "CandidateQueue: Queue is empty, waiting for next generated CandidateData");
+      stalled = true;
+      stallStart = time::now();
+      totalMisses_++;
+    }
 
-    // Now check that the queue isn't expired by looping through again
+    // Give the generator threads a moment to finish a candidate
+    if (numThreads_ > 0 &&
+        notEmpty_.wait_for(lock, std::chrono::duration<double>(stealAfterSeconds_), [this]
+                           {
+                             return ringSize_ > 0;
+                           }))
+      continue;
+
+    if (!threadsRunning_)
+      throw Exception(name_, "CandidateQueue stopped while waiting for a candidate");
+
+    // Rather than idle, generate a candidate on this thread
+    lock.unlock();
+    bool generated = generateCandidate(stolenCandidate_, 0, parentSampler_, indent);
+    lock.lock();
+
+    if (generated)
+    {
+      BOLT_DEBUG(indent, vQueueEmpty_, "CandidateQueue: Generated candidate on parent thread");
+      totalStolen_++;
+      totalStallTime_ += time::seconds(time::now() - stallStart);
+      usingStolenCandidate_ = true;
+      candidateInUse_ = true;
+      return stolenCandidate_;
+    }
   }
 
-  return queue_.front();
+  if (stalled)
+    totalStallTime_ += time::seconds(time::now() - stallStart);
+
+  usingStolenCandidate_ = false;
+  candidateInUse_ = true;
+  return ring_[ringFront_];
 }
 
 void CandidateQueue::setCandidateUsed(bool wasUsed, std::size_t indent)
 {
   // Note: This function is run in the parent thread
 
-  if (!wasUsed)  // if was used the state is now in use elsewhere, otherwise free the memory
-    si_->freeState(queue_.front().state_);
+  // The candidate was already dropped when the queue was restarted
+  if (!candidateInUse_)
+    return;
+  candidateInUse_ = false;
+
+  // if was used the state is now in use elsewhere, otherwise free the memory
+  if (usingStolenCandidate_)
+  {
+    if (!wasUsed)
+      si_->freeState(stolenCandidate_.state_);
+    usingStolenCandidate_ = false;
+    return;
+  }
 
-  boost::lock_guard<boost::shared_mutex> lock(candidateQueueMutex_);
-  queue_.pop();
+  std::lock_guard<std::mutex> lock(ringMutex_);
+  popFront(!wasUsed);
 }
 
-void CandidateQueue::waitForQueueNotFull(std::size_t indent)
+bool CandidateQueue::reserveSlot(std::size_t indent)
 {
-  bool oneTimeFlag = true;
-  while (queue_.size() >= targetQueueSize_ && threadsRunning_)
+  std::unique_lock<std::mutex> lock(ringMutex_);
+  if (ringSize_ + ringReserved_ >= ring_.size())
   {
-    if (oneTimeFlag)
-    {
-      BOLT_DEBUG(indent, vQueueFull_, "CandidateQueue: Queue is full, generator is waiting");
-      oneTimeFlag = false;
-    }
-    usleep(0.001 * 1000000);
-  }
-  if (!oneTimeFlag)
+    BOLT_DEBUG(indent, vQueueFull_, "CandidateQueue: Queue is full, generator is waiting");
+    notFull_.wait(lock, [this]
+                  {
+                    return ringSize_ + ringReserved_ < ring_.size() || !threadsRunning_;
+                  });
     BOLT_DEBUG(indent, vQueueFull_, "CandidateQueue: No longer waiting on full queue");
+  }
+
+  if (!threadsRunning_)
+    return false;
+
+  ringReserved_++;
+  return true;
 }
 
-void CandidateQueue::waitForQueueNotEmpty(std::size_t indent)
+void CandidateQueue::push(const CandidateData &candidateD)
 {
-  // Wait for queue to not be empty
-  bool oneTimeFlag = true;
-  totalMisses_++;
-  while (queue_.empty() && threadsRunning_)
   {
-    if (oneTimeFlag)
-    {
-      BOLT_WARN(indent, vQueueEmpty_, "CandidateQueue: Queue is empty, waiting for next generated CandidateData");
-      oneTimeFlag = false;
-    }
-    usleep(100);
+    std::lock_guard<std::mutex> lock(ringMutex_);
+    ring_[(ringFront_ + ringSize_) % ring_.size()] = candidateD;
+    ringSize_++;
+    ringReserved_--;
+  }
+  notEmpty_.notify_one();
+}
+
+void CandidateQueue::releaseSlot()
+{
+  {
+    std::lock_guard<std::mutex> lock(ringMutex_);
+    ringReserved_--;
   }
-  if (!oneTimeFlag)
-    BOLT_DEBUG(indent, vQueueEmpty_ && false, "CandidateQueue: No longer waiting on queue");
+  notFull_.notify_one();
+}
+
+void CandidateQueue::popFront(bool freeState)
+{
+  if (freeState)
+    si_->freeState(ring_[ringFront_].state_);
+
+  ring_[ringFront_] = CandidateData();
+  ringFront_ = (ringFront_ + 1) % ring_.size();
+  ringSize_--;
+  notFull_.notify_one();
 }
 
 bool CandidateQueue::findGraphNeighbors(CandidateData &candidateD, std::size_t threadID, std::size_t indent)
@@ -379,45 +469,57 @@ bool CandidateQueue::findGraphNeighbors(CandidateData &candidateD, std::size_t t
   candidateD.graphVersion_ = sparseGenerator_->getNumRandSamplesAdded();
 
   // Search in thread-safe manner
-  // Note that the main thread could be modifying the NN, so we have to lock it
-  sg_->getQueryStateNonConst(threadID) = candidateD.state_;
+  // The main thread adds vertices under the unique lock, which can reallocate the vertex storage that the
+  // distance function reads, so the graph must be locked for the whole search
   {
-    std::lock_guard<std::mutex> lock(sg_->getNNGuard());
+    boost::shared_lock<boost::shared_mutex> lock(sparseCriteria_->getGraphMutex());
+
+    // Vertices past this count are newer than the search, and are checked again when the candidate is used
+    candidateD.graphNumVertices_ = sg_->getNumVertices();
+
+    sg_->getQueryStateNonConst(threadID) = candidateD.state_;
     sg_->getNN()->nearestR(sg_->getQueryVertices(threadID), sparseCriteria_->getSparseDelta(),
                            candidateD.graphNeighborhood_);
+    sg_->getQueryStateNonConst(threadID) = nullptr;
   }
-  sg_->getQueryStateNonConst(threadID) = nullptr;
 
   // Now that we got the neighbors from the NN, we must remove any we can't see
-  for (std::size_t i = 0; i < candidateD.graphNeighborhood_.size(); ++i)
+  std::vector<MotionSegment> segments;
+  std::vector<SparseVertex> segmentVertices;
   {
-    SparseVertex v2 = candidateD.graphNeighborhood_[i];
-
-    // Check for expired graph or termination condition
-    if (candidateD.graphVersion_ != sparseGenerator_->getNumRandSamplesAdded() || !threadsRunning_)
-    {
-      BOLT_WARN(indent, vNeighbor_, "findGraphNeighbors aborted b/c expired graph or term cond");
-      return false;
-    }
-
-    // Don't collision check if they are the same state
-    if (candidateD.state_ != sg_->getState(v2))
+    boost::shared_lock<boost::shared_mutex> lock(sparseCriteria_->getGraphMutex());
+    for (const SparseVertex &v2 : candidateD.graphNeighborhood_)
     {
-      if (!si_->checkMotion(candidateD.state_, sg_->getState(v2)))
+      // Don't collision check if they are the same state
+      if (candidateD.state_ == sg_->getState(v2))
       {
+        candidateD.visibleNeighborhood_.push_back(v2);
         continue;
       }
+
+      segments.push_back(MotionSegment(candidateD.state_, sg_->getState(v2)));
+      segmentVertices.push_back(v2);
     }
+  }
 
-    // Check for expired graph or termination condition
-    if (candidateD.graphVersion_ != sparseGenerator_->getNumRandSamplesAdded() || !threadsRunning_)
+  // Check all edges in parallel, the results come back from the closest neighbor to the farthest
+  MotionBatchPtr batch = sparseCriteria_->getBatchMotionValidator()->checkMotions(segments);
+  std::size_t i;
+  bool valid;
+  while (batch->next(i, valid))
+  {
+    // Check for expired graph or termination condition, speculative candidates are revalidated instead
+    if ((!sparseCriteria_->useSpeculativeCriteria_ &&
+         candidateD.graphVersion_ != sparseGenerator_->getNumRandSamplesAdded()) ||
+        !threadsRunning_)
     {
       BOLT_WARN(indent, vNeighbor_, "findGraphNeighbors aborted b/c expired graph or term cond");
       return false;
     }
 
     // The two are visible to each other!
-    candidateD.visibleNeighborhood_.push_back(candidateD.graphNeighborhood_[i]);
+    if (valid)
+      candidateD.visibleNeighborhood_.push_back(segmentVertices[i]);
   }
 
   BOLT_DEBUG(indent, vNeighbor_,
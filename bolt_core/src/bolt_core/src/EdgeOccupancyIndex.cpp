@@ -0,0 +1,335 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Reverse index from workspace voxels to the roadmap edges whose motion passes through them
+*/
+
+// Bolt
+#include <bolt_core/EdgeOccupancyIndex.h>
+#include <bolt_core/SparseGraph.h>
+
+// Boost
+#include <boost/foreach.hpp>
+#include <boost/filesystem.hpp>
+
+// C++
+#include <algorithm>
+#include <fstream>
+
+#define foreach BOOST_FOREACH
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+namespace
+{
+template <typename T>
+void writeIndexBlock(std::ostream &out, const std::vector<T> &block)
+{
+  if (!block.empty())
+    out.write(reinterpret_cast<const char *>(&block[0]), block.size() * sizeof(T));
+}
+
+template <typename T>
+bool readIndexBlock(std::istream &in, std::vector<T> &block, std::size_t size)
+{
+  block.resize(size);
+  if (!block.empty())
+    in.read(reinterpret_cast<char *>(&block[0]), block.size() * sizeof(T));
+  return in.good();
+}
+}  // namespace
+
+EdgeOccupancyIndex::EdgeOccupancyIndex(SparseGraph *sparseGraph) : sparseGraph_(sparseGraph)
+{
+}
+
+void EdgeOccupancyIndex::clear()
+{
+  resolution_ = 0;
+  vertexCount_ = 0;
+  graphHash_ = 0;
+  modificationCount_ = 0;
+  edges_.clear();
+  voxels_.clear();
+  offsets_.clear();
+  entries_.clear();
+}
+
+bool EdgeOccupancyIndex::isValid() const
+{
+  // Any change to the graph after the index was matched to it, even one that keeps the counts, renumbers the edges
+  return resolution_ > 0 && modificationCount_ == sparseGraph_->getModificationCount() &&
+         vertexCount_ == sparseGraph_->getNumVertices() && edges_.size() == sparseGraph_->getNumEdges();
+}
+
+void EdgeOccupancyIndex::build(const SweptVoxelsFn &sweptVoxels, double resolution, std::size_t indent)
+{
+  BOLT_FUNC(indent, true, "EdgeOccupancyIndex.build() for " << sparseGraph_->getNumEdges() << " edges");
+  time::point startTime = time::now();
+
+  clear();
+
+  // Sweep every edge and record (voxel, edge) pairs
+  std::vector<std::pair<boost::uint64_t, boost::uint32_t>> pairs;
+  std::vector<boost::uint64_t> voxels;
+  foreach (const SparseEdge e, boost::edges(sparseGraph_->getGraph()))
+  {
+    const SparseVertex v1 = boost::source(e, sparseGraph_->getGraph());
+    const SparseVertex v2 = boost::target(e, sparseGraph_->getGraph());
+
+    voxels.clear();
+    sweptVoxels(sparseGraph_->getState(v1), sparseGraph_->getState(v2), voxels);
+    std::sort(voxels.begin(), voxels.end());
+    voxels.erase(std::unique(voxels.begin(), voxels.end()), voxels.end());
+
+    const boost::uint32_t edgeNumber = edges_.size();
+    edges_.push_back(std::make_pair(v1, v2));
+    for (boost::uint64_t voxel : voxels)
+      pairs.push_back(std::make_pair(voxel, edgeNumber));
+  }
+
+  // Group by voxel
+  std::sort(pairs.begin(), pairs.end());
+  entries_.reserve(pairs.size());
+  for (std::size_t i = 0; i < pairs.size(); ++i)
+  {
+    if (i == 0 || pairs[i].first != pairs[i - 1].first)
+    {
+      voxels_.push_back(pairs[i].first);
+      offsets_.push_back(entries_.size());
+    }
+    entries_.push_back(pairs[i].second);
+  }
+  offsets_.push_back(entries_.size());
+
+  resolution_ = resolution;
+  vertexCount_ = sparseGraph_->getNumVertices();
+  graphHash_ = hashGraph();
+  modificationCount_ = sparseGraph_->getModificationCount();
+
+  BOLT_INFO(indent, true, "Indexed " << edges_.size() << " edges in " << voxels_.size() << " voxels with "
+                                     << entries_.size() << " entries in " << time::seconds(time::now() - startTime)
+                                     << " seconds");
+}
+
+void EdgeOccupancyIndex::getBlockedEdges(std::vector<boost::uint64_t> obstacleVoxels,
+                                         std::vector<std::pair<SparseVertex, SparseVertex>> &edges) const
+{
+  edges.clear();
+
+  std::sort(obstacleVoxels.begin(), obstacleVoxels.end());
+  obstacleVoxels.erase(std::unique(obstacleVoxels.begin(), obstacleVoxels.end()), obstacleVoxels.end());
+
+  std::vector<bool> blocked(edges_.size(), false);
+  for (boost::uint64_t voxel : obstacleVoxels)
+  {
+    std::vector<boost::uint64_t>::const_iterator it = std::lower_bound(voxels_.begin(), voxels_.end(), voxel);
+    if (it == voxels_.end() || *it != voxel)
+      continue;
+
+    const std::size_t row = it - voxels_.begin();
+    for (std::size_t i = offsets_[row]; i < offsets_[row + 1]; ++i)
+      blocked[entries_[i]] = true;
+  }
+
+  for (std::size_t i = 0; i < edges_.size(); ++i)
+    if (blocked[i])
+      edges.push_back(std::make_pair(edges_[i].first, edges_[i].second));
+}
+
+bool EdgeOccupancyIndex::load(const std::string &filePath, double resolution, std::size_t indent)
+{
+  const std::string indexPath = getIndexPath(filePath);
+  BOLT_FUNC(indent, verbose_, "EdgeOccupancyIndex.load() " << indexPath);
+
+  clear();
+
+  if (!boost::filesystem::exists(indexPath))
+    return false;
+
+  std::ifstream in(indexPath.c_str(), std::ios::binary);
+  Header h;
+  in.read(reinterpret_cast<char *>(&h), sizeof(Header));
+  if (!in.good() || h.marker != BOLT_OCCUPANCY_INDEX_MARKER || h.version != BOLT_OCCUPANCY_INDEX_VERSION)
+  {
+    OMPL_WARN("Ignoring occupancy index %s, it is invalid", indexPath.c_str());
+    return false;
+  }
+  if (h.resolution != resolution || h.vertexCount != sparseGraph_->getNumVertices() ||
+      h.edgeCount != sparseGraph_->getNumEdges())
+  {
+    OMPL_WARN("Ignoring occupancy index %s, it does not belong to the loaded database", indexPath.c_str());
+    return false;
+  }
+
+  // Check the sizes against the file before allocating the blocks
+  const boost::uint64_t fileSize = boost::filesystem::file_size(indexPath);
+  const boost::uint64_t blocksSize = fileSize - sizeof(Header);
+  if (h.voxelCount > blocksSize / sizeof(boost::uint64_t) || h.entryCount > blocksSize / sizeof(boost::uint32_t) ||
+      blocksSize != h.edgeCount * 2 * sizeof(boost::uint64_t) + (2 * h.voxelCount + 1) * sizeof(boost::uint64_t) +
+                        h.entryCount * sizeof(boost::uint32_t))
+  {
+    OMPL_WARN("Ignoring occupancy index %s, its size does not match its header", indexPath.c_str());
+    return false;
+  }
+
+  if (!readIndexBlock(in, edges_, h.edgeCount) || !readIndexBlock(in, voxels_, h.voxelCount) ||
+      !readIndexBlock(in, offsets_, h.voxelCount + 1) || !readIndexBlock(in, entries_, h.entryCount))
+  {
+    OMPL_WARN("Ignoring occupancy index %s, it is truncated", indexPath.c_str());
+    clear();
+    return false;
+  }
+
+  // Every row must lie within the entries and every entry must name an indexed edge
+  bool consistent = offsets_.front() == 0 && offsets_.back() == h.entryCount;
+  for (std::size_t i = 1; consistent && i < offsets_.size(); ++i)
+    consistent = offsets_[i - 1] <= offsets_[i];
+  for (std::size_t i = 0; consistent && i < entries_.size(); ++i)
+    consistent = entries_[i] < h.edgeCount;
+  if (!consistent)
+  {
+    OMPL_WARN("Ignoring occupancy index %s, its offsets or entries are out of range", indexPath.c_str());
+    clear();
+    return false;
+  }
+
+  // The same counts do not mean the same graph, e.g. after the database was regenerated
+  const boost::uint64_t graphHash = hashGraph();
+  if (h.graphHash != graphHash)
+  {
+    OMPL_WARN("Ignoring occupancy index %s, it was built for another graph of the same size", indexPath.c_str());
+    clear();
+    return false;
+  }
+
+  resolution_ = h.resolution;
+  vertexCount_ = h.vertexCount;
+  graphHash_ = graphHash;
+  modificationCount_ = sparseGraph_->getModificationCount();
+
+  BOLT_DEBUG(indent, verbose_, "Loaded " << voxels_.size() << " voxels for " << edges_.size() << " edges");
+  return true;
+}
+
+bool EdgeOccupancyIndex::save(const std::string &filePath, std::size_t indent)
+{
+  const std::string indexPath = getIndexPath(filePath);
+  BOLT_FUNC(indent, verbose_, "EdgeOccupancyIndex.save() " << indexPath);
+
+  Header h;
+  h.marker = BOLT_OCCUPANCY_INDEX_MARKER;
+  h.version = BOLT_OCCUPANCY_INDEX_VERSION;
+  h.resolution = resolution_;
+  h.vertexCount = vertexCount_;
+  h.edgeCount = edges_.size();
+  h.voxelCount = voxels_.size();
+  h.entryCount = entries_.size();
+  h.graphHash = graphHash_;
+
+  // Write next to the old index and then replace it
+  const std::string tempPath = indexPath + ".tmp";
+  {
+    std::ofstream out(tempPath.c_str(), std::ios::binary);
+    out.write(reinterpret_cast<const char *>(&h), sizeof(Header));
+    writeIndexBlock(out, edges_);
+    writeIndexBlock(out, voxels_);
+    writeIndexBlock(out, offsets_);
+    writeIndexBlock(out, entries_);
+
+    if (!out.good())
+    {
+      OMPL_ERROR("Failed to write occupancy index %s", tempPath.c_str());
+      return false;
+    }
+  }
+
+  boost::system::error_code ec;
+  boost::filesystem::rename(tempPath, indexPath, ec);
+  if (ec)
+  {
+    OMPL_ERROR("Failed to replace occupancy index %s: %s", indexPath.c_str(), ec.message().c_str());
+    return false;
+  }
+
+  return true;
+}
+
+boost::uint64_t EdgeOccupancyIndex::hashGraph() const
+{
+  const SparseAdjList &graph = sparseGraph_->getGraph();
+  const base::StateSpacePtr &space = sparseGraph_->getSpaceInformation()->getStateSpace();
+  std::vector<unsigned char> serialized(space->getSerializationLength());
+
+  // FNV-1a, as the edge validity cache uses for states
+  boost::uint64_t hash = 14695981039346656037ULL;
+  auto hashBytes = [&hash](const unsigned char *bytes, std::size_t size)
+  {
+    for (std::size_t i = 0; i < size; ++i)
+    {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+  };
+
+  // States of the vertices, removed vertices have none
+  for (SparseVertex v = sparseGraph_->getNumQueryVertices(); v < sparseGraph_->getNumVertices(); ++v)
+  {
+    const base::State *state = graph[v].state_;
+    const unsigned char present = state != nullptr;
+    hashBytes(&present, 1);
+    if (state && !serialized.empty())
+    {
+      space->serialize(&serialized[0], state);
+      hashBytes(&serialized[0], serialized.size());
+    }
+  }
+
+  // Endpoints of the edges, in the order build() numbers them
+  foreach (const SparseEdge e, boost::edges(graph))
+  {
+    const boost::uint64_t endpoints[2] = { boost::source(e, graph), boost::target(e, graph) };
+    hashBytes(reinterpret_cast<const unsigned char *>(endpoints), sizeof(endpoints));
+  }
+
+  return hash;
+}
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
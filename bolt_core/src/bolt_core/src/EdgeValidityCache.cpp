@@ -0,0 +1,323 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Remember which roadmap edges are collision free between planning sessions
+*/
+
+// Bolt
+#include <bolt_core/EdgeValidityCache.h>
+#include <bolt_core/SparseGraph.h>
+
+// Boost
+#include <boost/foreach.hpp>
+#include <boost/filesystem.hpp>
+
+// C++
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#define foreach BOOST_FOREACH
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+namespace
+{
+/** \brief Read a value from the cache buffer and advance \e data, returns false if \e end is reached */
+template <typename T>
+bool readCacheValue(const unsigned char *&data, const unsigned char *end, T &value)
+{
+  if (end - data < static_cast<std::ptrdiff_t>(sizeof(T)))
+    return false;
+  std::memcpy(&value, data, sizeof(T));
+  data += sizeof(T);
+  return true;
+}
+
+template <typename T>
+void writeCacheValue(std::ostream &out, const T &value)
+{
+  out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+}  // namespace
+
+EdgeValidityCache::EdgeValidityCache(const base::SpaceInformationPtr &si, SparseGraph *sparseGraph)
+  : si_(si), sparseGraph_(sparseGraph)
+{
+}
+
+void EdgeValidityCache::clear()
+{
+  freeEdges_.clear();
+  scene_.clear();
+  sceneSet_ = false;
+  hasUnsavedChanges_ = false;
+  numHits_ = 0;
+}
+
+void EdgeValidityCache::setScene(const SceneFingerprint &scene, std::size_t indent)
+{
+  BOLT_FUNC(indent, verbose_, "EdgeValidityCache.setScene() " << scene.size() << " objects");
+
+  if (scene == scene_)
+  {
+    sceneSet_ = true;
+    return;
+  }
+
+  // Objects that are new or have moved may put free edges in collision
+  std::vector<std::string> changedObjects;
+  for (const std::pair<const std::string, boost::uint64_t> &object : scene)
+  {
+    SceneFingerprint::const_iterator previous = scene_.find(object.first);
+    if (previous == scene_.end() || previous->second != object.second)
+      changedObjects.push_back(object.first);
+  }
+
+  if (!changedObjects.empty() && !freeEdges_.empty())
+  {
+    const std::size_t numFreeEdges = freeEdges_.size();
+    if (!edgeAffectedFn_)
+    {
+      freeEdges_.clear();
+    }
+    else
+    {
+      // Only the edges of the current graph can be tested, the others are dropped too
+      std::unordered_set<EdgeKey, EdgeKeyHash> unaffected;
+      foreach (const SparseEdge e, boost::edges(sparseGraph_->getGraph()))
+      {
+        const base::State *s1 = sparseGraph_->getState(boost::source(e, sparseGraph_->getGraph()));
+        const base::State *s2 = sparseGraph_->getState(boost::target(e, sparseGraph_->getGraph()));
+        const EdgeKey key = getKey(s1, s2);
+        if (freeEdges_.count(key) && !edgeAffectedFn_(s1, s2, changedObjects))
+          unaffected.insert(key);
+      }
+      freeEdges_.swap(unaffected);
+    }
+
+    BOLT_DEBUG(indent, verbose_, changedObjects.size() << " objects changed, invalidated "
+                                                       << numFreeEdges - freeEdges_.size() << " of " << numFreeEdges
+                                                       << " free edges");
+  }
+
+  scene_ = scene;
+  sceneSet_ = true;
+  hasUnsavedChanges_ = true;
+}
+
+bool EdgeValidityCache::isKnownFree(const base::State *s1, const base::State *s2) const
+{
+  if (!sceneSet_ || freeEdges_.empty())
+    return false;
+
+  if (!freeEdges_.count(getKey(s1, s2)))
+    return false;
+
+  numHits_++;
+  return true;
+}
+
+void EdgeValidityCache::setFree(const base::State *s1, const base::State *s2)
+{
+  if (!sceneSet_)
+    return;
+
+  if (freeEdges_.insert(getKey(s1, s2)).second)
+    hasUnsavedChanges_ = true;
+}
+
+void EdgeValidityCache::setInCollision(const base::State *s1, const base::State *s2)
+{
+  if (!sceneSet_)
+    return;
+
+  if (freeEdges_.erase(getKey(s1, s2)))
+    hasUnsavedChanges_ = true;
+}
+
+bool EdgeValidityCache::load(const std::string &filePath, std::size_t indent)
+{
+  const std::string cachePath = getCachePath(filePath);
+  BOLT_FUNC(indent, verbose_, "EdgeValidityCache.load() " << cachePath);
+
+  clear();
+
+  if (!boost::filesystem::exists(cachePath))
+    return false;
+
+  // Read the whole cache at once
+  std::ifstream in(cachePath.c_str(), std::ios::binary);
+  std::vector<unsigned char> buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  in.close();
+
+  const unsigned char *data = buffer.empty() ? NULL : &buffer[0];
+  const unsigned char *end = data + buffer.size();
+
+  // Error checking
+  Header h;
+  if (!readCacheValue(data, end, h) || h.marker != BOLT_EDGE_CACHE_MARKER || h.version != BOLT_EDGE_CACHE_VERSION ||
+      h.stateLength != si_->getStateSpace()->getSerializationLength())
+  {
+    OMPL_WARN("Ignoring edge cache %s, it is invalid", cachePath.c_str());
+    return false;
+  }
+
+  SceneFingerprint scene;
+  for (std::size_t i = 0; i < h.objectCount; ++i)
+  {
+    boost::uint64_t hash;
+    boost::uint32_t length;
+    if (!readCacheValue(data, end, hash) || !readCacheValue(data, end, length) || end - data < length)
+    {
+      OMPL_WARN("Ignoring edge cache %s, it is truncated", cachePath.c_str());
+      return false;
+    }
+    scene[std::string(reinterpret_cast<const char *>(data), length)] = hash;
+    data += length;
+  }
+
+  if (static_cast<std::size_t>(end - data) != h.edgeCount * sizeof(EdgeKey::first_type) * 2)
+  {
+    OMPL_WARN("Ignoring edge cache %s, it is truncated", cachePath.c_str());
+    return false;
+  }
+
+  freeEdges_.reserve(h.edgeCount);
+  for (std::size_t i = 0; i < h.edgeCount; ++i)
+  {
+    EdgeKey key;
+    readCacheValue(data, end, key.first);
+    readCacheValue(data, end, key.second);
+    freeEdges_.insert(key);
+  }
+  scene_ = scene;
+
+  BOLT_DEBUG(indent, verbose_, "Loaded " << freeEdges_.size() << " free edges checked in a scene of "
+                                         << scene_.size() << " objects");
+  return true;
+}
+
+bool EdgeValidityCache::saveIfChanged(const std::string &filePath, std::size_t indent)
+{
+  const std::string cachePath = getCachePath(filePath);
+  BOLT_FUNC(indent, verbose_, "EdgeValidityCache.saveIfChanged() " << cachePath);
+
+  if (!hasUnsavedChanges_)
+    return true;
+
+  // Sorted so that saving the same cache twice gives the same file
+  std::vector<EdgeKey> edges(freeEdges_.begin(), freeEdges_.end());
+  std::sort(edges.begin(), edges.end());
+
+  Header h;
+  h.marker = BOLT_EDGE_CACHE_MARKER;
+  h.version = BOLT_EDGE_CACHE_VERSION;
+  h.stateLength = si_->getStateSpace()->getSerializationLength();
+  h.objectCount = scene_.size();
+  h.edgeCount = edges.size();
+
+  // Write next to the old cache and then replace it, so a crash never leaves half a cache
+  const std::string tempPath = cachePath + ".tmp";
+  {
+    std::ofstream out(tempPath.c_str(), std::ios::binary);
+    writeCacheValue(out, h);
+    for (const std::pair<const std::string, boost::uint64_t> &object : scene_)
+    {
+      writeCacheValue(out, object.second);
+      writeCacheValue(out, static_cast<boost::uint32_t>(object.first.size()));
+      out.write(object.first.c_str(), object.first.size());
+    }
+    for (const EdgeKey &key : edges)
+    {
+      writeCacheValue(out, key.first);
+      writeCacheValue(out, key.second);
+    }
+
+    if (!out.good())
+    {
+      OMPL_ERROR("Failed to write edge cache %s", tempPath.c_str());
+      return false;
+    }
+  }
+
+  boost::system::error_code ec;
+  boost::filesystem::rename(tempPath, cachePath, ec);
+  if (ec)
+  {
+    OMPL_ERROR("Failed to replace edge cache %s: %s", cachePath.c_str(), ec.message().c_str());
+    return false;
+  }
+  hasUnsavedChanges_ = false;
+
+  BOLT_DEBUG(indent, verbose_, "Saved " << edges.size() << " free edges");
+  return true;
+}
+
+boost::uint64_t EdgeValidityCache::hashState(const base::State *state) const
+{
+  const base::StateSpacePtr &space = si_->getStateSpace();
+  serialized_.resize(space->getSerializationLength());
+  if (!serialized_.empty())
+    space->serialize(&serialized_[0], state);
+
+  // FNV-1a followed by a final mix so that nearby joint values spread over all bits
+  boost::uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char byte : serialized_)
+  {
+    hash ^= byte;
+    hash *= 1099511628211ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+
+  return hash;
+}
+
+EdgeValidityCache::EdgeKey EdgeValidityCache::getKey(const base::State *s1, const base::State *s2) const
+{
+  const boost::uint64_t h1 = hashState(s1);
+  const boost::uint64_t h2 = hashState(s2);
+  return h1 < h2 ? EdgeKey(h1, h2) : EdgeKey(h2, h1);
+}
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
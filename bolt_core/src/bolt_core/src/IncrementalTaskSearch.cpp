@@ -0,0 +1,256 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Shortest path search over the task graph that is repaired instead of restarted when edges are invalidated
+*/
+
+// Bolt
+#include <bolt_core/IncrementalTaskSearch.h>
+#include <bolt_core/TaskGraph.h>
+
+// Boost
+#include <boost/foreach.hpp>
+
+// C++
+#include <algorithm>
+#include <limits>
+
+#define foreach BOOST_FOREACH
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+namespace
+{
+const double INF = std::numeric_limits<double>::infinity();
+}
+
+IncrementalTaskSearch::IncrementalTaskSearch(TaskGraph *taskGraph)
+  : taskGraph_(taskGraph), weights_(taskGraph->getFrozenGraph())
+{
+}
+
+void IncrementalTaskSearch::start(const std::vector<TaskVertex> &starts, const std::vector<double> &startCosts,
+                                  const std::vector<TaskVertex> &goals, const std::vector<double> &goalCosts)
+{
+  BOLT_ASSERT(taskGraph_->isFrozen(), "Incremental search needs the frozen copy of the task graph");
+  BOLT_ASSERT(starts.size() == startCosts.size(), "Every start needs a connection cost");
+  BOLT_ASSERT(goals.size() == goalCosts.size(), "Every goal needs a connection cost");
+
+  const std::size_t numVertices = taskGraph_->getNumVertices();
+  goals_ = goals;
+  goalCosts_ = goalCosts;
+  startCosts_.assign(numVertices, INF);
+  g_.assign(numVertices, INF);
+  rhs_.assign(numVertices, INF);
+  heuristics_.assign(numVertices, -1);
+  keys_.assign(numVertices, Key(INF, INF));
+  isOpen_.assign(numVertices, false);
+  open_.clear();
+  numExpanded_ = 0;
+
+  for (std::size_t i = 0; i < starts.size(); ++i)
+    startCosts_[starts[i]] = std::min(startCosts_[starts[i]], startCosts[i]);
+  for (const TaskVertex v : starts)
+    updateVertex(v);
+}
+
+void IncrementalTaskSearch::updateEdge(TaskVertex v1, TaskVertex v2)
+{
+  // Undirected, each end may have had its best path through the other
+  updateVertex(v1);
+  updateVertex(v2);
+}
+
+bool IncrementalTaskSearch::computePath(std::vector<TaskVertex> &vertexPath, double &distance)
+{
+  const TaskCSRGraph &graph = taskGraph_->getFrozenGraph();
+
+  bool goalConsistent;
+  TaskVertex goal;
+  Key top;
+  while (topKey(top))
+  {
+    // Done once no vertex on the open list could improve the best goal and that goal is up to date
+    const Key target = goalKey(goalConsistent, goal);
+    if (goalConsistent && !(top < target))
+      break;
+
+    const TaskVertex v = open_.front().second;
+    std::pop_heap(open_.begin(), open_.end(), std::greater<OpenEntry>());
+    open_.pop_back();
+    isOpen_[v] = false;
+    numExpanded_++;
+
+    if (g_[v] > rhs_[v])
+    {
+      // Overconsistent, its new shorter cost is final
+      g_[v] = rhs_[v];
+      foreach (const boost::graph_traits<TaskCSRGraph>::edge_descriptor e, boost::out_edges(v, graph))
+      {
+        const TaskVertex u = boost::target(e, graph);
+        const double distanceU = g_[v] + get(weights_, e);
+        if (distanceU < rhs_[u])
+        {
+          rhs_[u] = distanceU;
+          updateVertex(u);
+        }
+      }
+    }
+    else
+    {
+      // Underconsistent, its path was cut off. Search it and everything that was reached through it again
+      g_[v] = INF;
+      updateVertex(v);
+      foreach (const boost::graph_traits<TaskCSRGraph>::edge_descriptor e, boost::out_edges(v, graph))
+        updateVertex(boost::target(e, graph));
+    }
+  }
+
+  const Key target = goalKey(goalConsistent, goal);
+  if (goals_.empty() || g_[goal] == INF)
+    return false;
+  distance = target.second;
+
+  // Walk back along the best predecessors until a start whose connection is its best path
+  vertexPath.clear();
+  TaskVertex v = goal;
+  vertexPath.push_back(v);
+  while (startCosts_[v] > g_[v])
+  {
+    TaskVertex best = v;
+    double bestCost = INF;
+    foreach (const boost::graph_traits<TaskCSRGraph>::edge_descriptor e, boost::out_edges(v, graph))
+    {
+      const TaskVertex u = boost::target(e, graph);
+      const double cost = g_[u] + get(weights_, e);
+      if (cost < bestCost)
+      {
+        bestCost = cost;
+        best = u;
+      }
+    }
+    if (best == v || vertexPath.size() > g_.size())
+    {
+      BOLT_ERROR(0, "Incremental search tree is broken at vertex " << v);
+      return false;
+    }
+    v = best;
+    vertexPath.push_back(v);
+  }
+
+  return true;
+}
+
+IncrementalTaskSearch::Key IncrementalTaskSearch::calculateKey(TaskVertex v)
+{
+  const double cost = std::min(g_[v], rhs_[v]);
+  return Key(cost + heuristic(v), cost);
+}
+
+double IncrementalTaskSearch::heuristic(TaskVertex v)
+{
+  if (heuristics_[v] < 0)
+  {
+    double minimum = INF;
+    for (std::size_t i = 0; i < goals_.size(); ++i)
+      minimum = std::min(minimum, taskGraph_->astarTaskHeuristic(v, goals_[i]) + goalCosts_[i]);
+    heuristics_[v] = minimum;
+  }
+  return heuristics_[v];
+}
+
+void IncrementalTaskSearch::updateVertex(TaskVertex v)
+{
+  // One step lookahead, through the best neighbor or straight from the virtual source
+  const TaskCSRGraph &graph = taskGraph_->getFrozenGraph();
+  double rhs = startCosts_[v];
+  foreach (const boost::graph_traits<TaskCSRGraph>::edge_descriptor e, boost::out_edges(v, graph))
+    rhs = std::min(rhs, g_[boost::target(e, graph)] + get(weights_, e));
+  rhs_[v] = rhs;
+
+  // Entries already on the heap become out of date
+  isOpen_[v] = false;
+  if (g_[v] != rhs_[v])
+  {
+    keys_[v] = calculateKey(v);
+    isOpen_[v] = true;
+    open_.push_back(OpenEntry(keys_[v], v));
+    std::push_heap(open_.begin(), open_.end(), std::greater<OpenEntry>());
+  }
+}
+
+bool IncrementalTaskSearch::topKey(Key &key)
+{
+  while (!open_.empty())
+  {
+    const OpenEntry &entry = open_.front();
+    if (isOpen_[entry.second] && keys_[entry.second] == entry.first)
+    {
+      key = entry.first;
+      return true;
+    }
+    std::pop_heap(open_.begin(), open_.end(), std::greater<OpenEntry>());
+    open_.pop_back();
+  }
+  return false;
+}
+
+IncrementalTaskSearch::Key IncrementalTaskSearch::goalKey(bool &consistent, TaskVertex &bestGoal) const
+{
+  // The target is reached from each goal at its connection cost and its heuristic is zero
+  Key best(INF, INF);
+  consistent = true;
+  bestGoal = goals_.empty() ? 0 : goals_.front();
+  for (std::size_t i = 0; i < goals_.size(); ++i)
+  {
+    const TaskVertex goal = goals_[i];
+    const double cost = std::min(g_[goal], rhs_[goal]) + goalCosts_[i];
+    if (cost < best.second)
+    {
+      best = Key(cost, cost);
+      bestGoal = goal;
+      consistent = g_[goal] == rhs_[goal];
+    }
+  }
+  return best;
+}
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
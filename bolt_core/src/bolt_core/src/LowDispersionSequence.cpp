@@ -0,0 +1,119 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Deterministic low-dispersion sequence of states for seeding the sparse graph
+*/
+
+// Bolt
+#include <bolt_core/LowDispersionSequence.h>
+
+// C++
+#include <cmath>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+LowDispersionSequence::LowDispersionSequence(base::SpaceInformationPtr si) : si_(si)
+{
+  const std::size_t dim = si_->getStateSpace()->getDimension();
+  base::RealVectorBounds bounds = si_->getStateSpace()->getBounds();
+  assert(bounds.low.size() == dim);
+
+  for (std::size_t i = 0; i < dim; ++i)
+  {
+    low_.push_back(bounds.low[i]);
+    range_.push_back(bounds.high[i] - bounds.low[i]);
+  }
+
+  // First primes, by trial division
+  for (std::size_t candidate = 2; bases_.size() < dim; ++candidate)
+  {
+    bool isPrime = true;
+    for (std::size_t prime : bases_)
+    {
+      if (prime * prime > candidate)
+        break;
+      if (candidate % prime == 0)
+      {
+        isPrime = false;
+        break;
+      }
+    }
+    if (isPrime)
+      bases_.push_back(candidate);
+  }
+
+  // The square roots of distinct primes are irrational and independent of each other
+  for (std::size_t base : bases_)
+  {
+    const double root = std::sqrt(static_cast<double>(base));
+    rotation_.push_back(root - std::floor(root));
+  }
+}
+
+void LowDispersionSequence::sample(std::size_t index, base::State *state) const
+{
+  std::vector<double> values(bases_.size());
+  for (std::size_t i = 0; i < bases_.size(); ++i)
+  {
+    double unit = radicalInverse(index, bases_[i]) + rotation_[i];
+    if (unit >= 1.0)
+      unit -= 1.0;
+    values[i] = low_[i] + unit * range_[i];
+  }
+
+  si_->getStateSpace()->copyFromReals(state, values);
+}
+
+double LowDispersionSequence::radicalInverse(std::size_t index, std::size_t base)
+{
+  const double invBase = 1.0 / base;
+  double digitWeight = invBase;
+  double result = 0;
+  while (index > 0)
+  {
+    result += (index % base) * digitWeight;
+    index /= base;
+    digitWeight *= invBase;
+  }
+  return result;
+}
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
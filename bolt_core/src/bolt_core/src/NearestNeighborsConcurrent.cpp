@@ -0,0 +1,208 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Nearest neighbor datastructure that can be searched while vertices are being added
+*/
+
+// Bolt
+#include <bolt_core/NearestNeighborsConcurrent.h>
+
+// C++
+#include <chrono>
+#include <thread>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+NearestNeighborsConcurrent::ReadGuard::ReadGuard(const NearestNeighborsConcurrent &parent) : parent_(parent)
+{
+  while (true)
+  {
+    index_ = parent_.active_.load();
+    parent_.readers_[index_]++;
+
+    // If the copy is still active the writer will see our count before changing it
+    if (parent_.active_.load() == index_)
+      return;
+    parent_.readers_[index_]--;
+  }
+}
+
+NearestNeighborsConcurrent::ReadGuard::~ReadGuard()
+{
+  parent_.readers_[index_]--;
+}
+
+NearestNeighborsConcurrent::NearestNeighborsConcurrent(const std::function<NearestNeighborsPtr()> &allocator)
+  : active_(0)
+{
+  copies_[0] = allocator();
+  copies_[1] = allocator();
+  readers_[0] = 0;
+  readers_[1] = 0;
+}
+
+void NearestNeighborsConcurrent::setDistanceFunction(const DistanceFunction &distFun)
+{
+  NearestNeighbors<SparseVertex>::setDistanceFunction(distFun);
+  write([distFun](NearestNeighbors<SparseVertex> &nn)
+        {
+          nn.setDistanceFunction(distFun);
+        });
+}
+
+void NearestNeighborsConcurrent::waitForReaders(std::size_t index) const
+{
+  // Usually they finished long ago, but when there are more threads than cores they may need to be given time to be
+  // scheduled
+  for (std::size_t attempt = 0; readers_[index].load() != 0; ++attempt)
+  {
+    if (attempt < 100)
+      std::this_thread::yield();
+    else
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+}
+
+void NearestNeighborsConcurrent::write(const Change &change, bool applyToBoth)
+{
+  std::lock_guard<std::mutex> lock(writeMutex_);
+
+  // Wait for searches still running on the standby copy, i.e. those that started before the previous change made the
+  // other copy active
+  const std::size_t standby = 1 - active_.load();
+  waitForReaders(standby);
+
+  // Catch up on the previous change, then apply this one and make the copy active
+  if (lastChange_)
+    lastChange_(*copies_[standby]);
+  change(*copies_[standby]);
+  active_.store(standby);
+
+  if (!applyToBoth)
+  {
+    // The now inactive copy receives this change on the next call
+    lastChange_ = change;
+    return;
+  }
+
+  // New searches use the changed copy, so the other one is free once the searches still running on it finish
+  const std::size_t inactive = 1 - standby;
+  waitForReaders(inactive);
+  change(*copies_[inactive]);
+  lastChange_ = Change();
+}
+
+void NearestNeighborsConcurrent::clear()
+{
+  write([](NearestNeighbors<SparseVertex> &nn)
+        {
+          nn.clear();
+        });
+}
+
+void NearestNeighborsConcurrent::add(const SparseVertex &v)
+{
+  const SparseVertex vertex = v;
+  write([vertex](NearestNeighbors<SparseVertex> &nn)
+        {
+          nn.add(vertex);
+        });
+}
+
+void NearestNeighborsConcurrent::add(const std::vector<SparseVertex> &vertices)
+{
+  write([vertices](NearestNeighbors<SparseVertex> &nn)
+        {
+          nn.add(vertices);
+        });
+}
+
+bool NearestNeighborsConcurrent::remove(const SparseVertex &v)
+{
+  // Only the first time the change is applied reports whether the vertex was found
+  std::shared_ptr<bool> removed(new bool(false));
+  std::shared_ptr<bool> first(new bool(true));
+  const SparseVertex vertex = v;
+
+  // Removing computes distances to the vertex's state, which the caller frees right after, so both copies are
+  // changed before returning
+  write([vertex, removed, first](NearestNeighbors<SparseVertex> &nn)
+        {
+          const bool found = nn.remove(vertex);
+          if (*first)
+            *removed = found;
+          *first = false;
+        },
+        true);
+  return *removed;
+}
+
+SparseVertex NearestNeighborsConcurrent::nearest(const SparseVertex &v) const
+{
+  ReadGuard guard(*this);
+  return guard.get().nearest(v);
+}
+
+void NearestNeighborsConcurrent::nearestK(const SparseVertex &v, std::size_t k, std::vector<SparseVertex> &nbh) const
+{
+  ReadGuard guard(*this);
+  guard.get().nearestK(v, k, nbh);
+}
+
+void NearestNeighborsConcurrent::nearestR(const SparseVertex &v, double radius, std::vector<SparseVertex> &nbh) const
+{
+  ReadGuard guard(*this);
+  guard.get().nearestR(v, radius, nbh);
+}
+
+std::size_t NearestNeighborsConcurrent::size() const
+{
+  ReadGuard guard(*this);
+  return guard.get().size();
+}
+
+void NearestNeighborsConcurrent::list(std::vector<SparseVertex> &data) const
+{
+  ReadGuard guard(*this);
+  guard.get().list(data);
+}
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
@@ -0,0 +1,510 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Nearest neighbor datastructures that search copies of the joint values of each vertex
+*/
+
+// Bolt
+#include <bolt_core/NearestNeighborsFlat.h>
+#include <bolt_core/FlatState.h>
+
+// OMPL
+#include <ompl/util/Exception.h>
+
+// Boost
+#include <boost/foreach.hpp>
+
+// C++
+#include <algorithm>
+
+#define foreach BOOST_FOREACH
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+namespace
+{
+const std::size_t NO_ROW = std::numeric_limits<std::size_t>::max();
+
+/** \brief Check if two distances are equal up to rounding */
+bool sameDistance(double a, double b)
+{
+  return std::abs(a - b) <= 1e-9 * (1.0 + std::abs(a));
+}
+}  // namespace
+
+FlatMetric detectFlatMetric(const base::StateSpacePtr &space, std::size_t numSamples)
+{
+  const std::size_t dim = getFlatStateDimension(space);
+  if (dim == 0)
+    return FLAT_METRIC_UNKNOWN;
+
+  base::StateSamplerPtr sampler = space->allocStateSampler();
+  base::State *a = space->allocState();
+  base::State *b = space->allocState();
+  std::vector<double> valuesA(dim);
+  std::vector<double> valuesB(dim);
+
+  bool isL1 = true;
+  bool isL2 = true;
+  for (std::size_t i = 0; i < numSamples && (isL1 || isL2); ++i)
+  {
+    sampler->sampleUniform(a);
+    sampler->sampleUniform(b);
+    copyToFlatValues(space, a, &valuesA[0], dim);
+    copyToFlatValues(space, b, &valuesB[0], dim);
+
+    double l1 = 0;
+    double l2 = 0;
+    for (std::size_t d = 0; d < dim; ++d)
+    {
+      const double diff = valuesA[d] - valuesB[d];
+      l1 += std::abs(diff);
+      l2 += diff * diff;
+    }
+
+    const double distance = space->distance(a, b);
+    isL1 = isL1 && sameDistance(distance, l1);
+    isL2 = isL2 && sameDistance(distance, std::sqrt(l2));
+  }
+
+  space->freeState(a);
+  space->freeState(b);
+
+  if (isL2)
+    return FLAT_METRIC_L2;
+  if (isL1)
+    return FLAT_METRIC_L1;
+  return FLAT_METRIC_UNKNOWN;
+}
+
+// NearestNeighborsFlat ////////////////////////////////////////////////////////////////////////////
+
+const SparseVertex NearestNeighborsFlat::REMOVED_VERTEX = std::numeric_limits<SparseVertex>::max();
+
+NearestNeighborsFlat::NearestNeighborsFlat(const base::StateSpacePtr &space, FlatMetric metric,
+                                           const StateFunction &getState)
+  : dim_(getFlatStateDimension(space))
+  , metric_(metric)
+  , columns_(dim_)
+  , space_(space)
+  , getState_(getState)
+  , flatLayout_(hasFlatStateLayout(space))
+{
+  if (metric_ == FLAT_METRIC_UNKNOWN)
+    throw Exception("NearestNeighborsFlat", "Distance function of the state space is not a norm of its values");
+}
+
+void NearestNeighborsFlat::clear()
+{
+  for (std::size_t d = 0; d < dim_; ++d)
+    columns_[d].clear();
+  vertices_.clear();
+  rows_.clear();
+  numRemoved_ = 0;
+  rowsCompacted();
+}
+
+void NearestNeighborsFlat::add(const SparseVertex &v)
+{
+  add(std::vector<SparseVertex>(1, v));
+}
+
+void NearestNeighborsFlat::add(const std::vector<SparseVertex> &vertices)
+{
+  std::vector<double> buffer(dim_);
+  for (std::size_t d = 0; d < dim_; ++d)
+    columns_[d].reserve(vertices_.size() + vertices.size());
+  vertices_.reserve(vertices_.size() + vertices.size());
+
+  foreach (SparseVertex v, vertices)
+  {
+    const double *values = getValues(v, buffer);
+    for (std::size_t d = 0; d < dim_; ++d)
+      columns_[d].push_back(values[d]);
+
+    if (rows_.size() <= v)
+      rows_.resize(v + 1, NO_ROW);
+    rows_[v] = vertices_.size();
+    vertices_.push_back(v);
+  }
+
+  rowsAdded();
+}
+
+bool NearestNeighborsFlat::remove(const SparseVertex &v)
+{
+  if (v >= rows_.size() || rows_[v] == NO_ROW)
+    return false;
+
+  vertices_[rows_[v]] = REMOVED_VERTEX;
+  rows_[v] = NO_ROW;
+  numRemoved_++;
+
+  if (numRemoved_ > size())
+    compact();
+  return true;
+}
+
+SparseVertex NearestNeighborsFlat::nearest(const SparseVertex &v) const
+{
+  std::vector<SparseVertex> nbh;
+  nearestK(v, 1, nbh);
+  if (nbh.empty())
+    throw Exception("No elements found in nearest neighbors data structure");
+  return nbh[0];
+}
+
+void NearestNeighborsFlat::nearestK(const SparseVertex &v, std::size_t k, std::vector<SparseVertex> &nbh) const
+{
+  nbh.clear();
+  if (k == 0 || size() == 0)
+    return;
+
+  std::vector<double> buffer(dim_);
+  std::vector<Neighbor> result;
+  searchK(getValues(v, buffer), k, result);
+
+  nbh.reserve(result.size());
+  foreach (const Neighbor &neighbor, result)
+    nbh.push_back(vertices_[neighbor.second]);
+}
+
+void NearestNeighborsFlat::nearestR(const SparseVertex &v, double radius, std::vector<SparseVertex> &nbh) const
+{
+  nbh.clear();
+  if (size() == 0)
+    return;
+
+  std::vector<double> buffer(dim_);
+  std::vector<Neighbor> result;
+  searchR(getValues(v, buffer), metric_ == FLAT_METRIC_L2 ? radius * radius : radius, result);
+
+  nbh.reserve(result.size());
+  foreach (const Neighbor &neighbor, result)
+    nbh.push_back(vertices_[neighbor.second]);
+}
+
+void NearestNeighborsFlat::list(std::vector<SparseVertex> &data) const
+{
+  data.clear();
+  data.reserve(size());
+  foreach (SparseVertex v, vertices_)
+    if (v != REMOVED_VERTEX)
+      data.push_back(v);
+}
+
+const double *NearestNeighborsFlat::getValues(SparseVertex v, std::vector<double> &buffer) const
+{
+  const base::State *state = getState_(v);
+  if (flatLayout_)
+    return state->as<FlatState>()->values;
+
+  copyToFlatValues(space_, state, &buffer[0], dim_);
+  return &buffer[0];
+}
+
+void NearestNeighborsFlat::compact()
+{
+  std::size_t next = 0;
+  for (std::size_t row = 0; row < vertices_.size(); ++row)
+  {
+    if (!isLive(row))
+      continue;
+
+    for (std::size_t d = 0; d < dim_; ++d)
+      columns_[d][next] = columns_[d][row];
+    vertices_[next] = vertices_[row];
+    rows_[vertices_[next]] = next;
+    next++;
+  }
+
+  for (std::size_t d = 0; d < dim_; ++d)
+    columns_[d].resize(next);
+  vertices_.resize(next);
+  numRemoved_ = 0;
+
+  rowsCompacted();
+}
+
+// NearestNeighborsFlatLinear ////////////////////////////////////////////////////////////////////////////
+
+NearestNeighborsFlatLinear::NearestNeighborsFlatLinear(const base::StateSpacePtr &space, FlatMetric metric,
+                                                       const StateFunction &getState)
+  : NearestNeighborsFlat(space, metric, getState)
+{
+}
+
+void NearestNeighborsFlatLinear::computeDistances(const double *query, std::vector<double> &distances) const
+{
+  const std::size_t numRows = vertices_.size();
+  distances.assign(numRows, 0.0);
+  double *out = &distances[0];
+
+  // One pass per joint over contiguous memory, without branches in the inner loops so they are vectorized
+  for (std::size_t d = 0; d < dim_; ++d)
+  {
+    const double *column = &columns_[d][0];
+    const double q = query[d];
+    if (metric_ == FLAT_METRIC_L2)
+    {
+      for (std::size_t row = 0; row < numRows; ++row)
+      {
+        const double diff = column[row] - q;
+        out[row] += diff * diff;
+      }
+    }
+    else
+    {
+      for (std::size_t row = 0; row < numRows; ++row)
+        out[row] += std::abs(column[row] - q);
+    }
+  }
+}
+
+void NearestNeighborsFlatLinear::searchK(const double *query, std::size_t k, std::vector<Neighbor> &result) const
+{
+  std::vector<double> distances;
+  computeDistances(query, distances);
+
+  result.clear();
+  result.reserve(size());
+  for (std::size_t row = 0; row < distances.size(); ++row)
+    if (isLive(row))
+      result.push_back(Neighbor(distances[row], row));
+
+  if (result.size() > k)
+  {
+    std::nth_element(result.begin(), result.begin() + k, result.end());
+    result.resize(k);
+  }
+  std::sort(result.begin(), result.end());
+}
+
+void NearestNeighborsFlatLinear::searchR(const double *query, double radius, std::vector<Neighbor> &result) const
+{
+  std::vector<double> distances;
+  computeDistances(query, distances);
+
+  result.clear();
+  for (std::size_t row = 0; row < distances.size(); ++row)
+    if (distances[row] <= radius && isLive(row))
+      result.push_back(Neighbor(distances[row], row));
+
+  std::sort(result.begin(), result.end());
+}
+
+// NearestNeighborsFlatKD ////////////////////////////////////////////////////////////////////////////
+
+NearestNeighborsFlatKD::NearestNeighborsFlatKD(const base::StateSpacePtr &space, FlatMetric metric,
+                                               const StateFunction &getState)
+  : NearestNeighborsFlat(space, metric, getState)
+{
+}
+
+void NearestNeighborsFlatKD::rowsAdded()
+{
+  const std::size_t numPending = vertices_.size() - numIndexed_;
+  if (numPending > std::max(4 * LEAF_SIZE, numIndexed_ / 4))
+    build();
+}
+
+void NearestNeighborsFlatKD::build()
+{
+  nodes_.clear();
+  order_.resize(vertices_.size());
+  for (std::size_t row = 0; row < order_.size(); ++row)
+    order_[row] = row;
+
+  numIndexed_ = order_.size();
+  if (numIndexed_ > 0)
+    buildNode(0, numIndexed_);
+}
+
+std::size_t NearestNeighborsFlatKD::buildNode(std::size_t begin, std::size_t end)
+{
+  const std::size_t index = nodes_.size();
+  nodes_.push_back(Node());
+  nodes_[index].begin_ = begin;
+  nodes_[index].end_ = end;
+  nodes_[index].left_ = 0;
+  nodes_[index].right_ = 0;
+
+  if (end - begin <= LEAF_SIZE)
+    return index;
+
+  // Split along the joint with the largest spread
+  std::size_t splitDim = 0;
+  double maxSpread = -1;
+  for (std::size_t d = 0; d < dim_; ++d)
+  {
+    double low = std::numeric_limits<double>::infinity();
+    double high = -std::numeric_limits<double>::infinity();
+    for (std::size_t i = begin; i < end; ++i)
+    {
+      low = std::min(low, columns_[d][order_[i]]);
+      high = std::max(high, columns_[d][order_[i]]);
+    }
+    if (high - low > maxSpread)
+    {
+      maxSpread = high - low;
+      splitDim = d;
+    }
+  }
+
+  // Median split
+  const std::vector<double> &column = columns_[splitDim];
+  const std::size_t middle = begin + (end - begin) / 2;
+  std::nth_element(order_.begin() + begin, order_.begin() + middle, order_.begin() + end,
+                   [&column](std::size_t a, std::size_t b)
+                   {
+                     return column[a] < column[b];
+                   });
+
+  nodes_[index].splitDim_ = splitDim;
+  nodes_[index].splitValue_ = column[order_[middle]];
+
+  // Children are created after the parent, so do not keep references into nodes_ across these calls
+  const std::size_t left = buildNode(begin, middle);
+  const std::size_t right = buildNode(middle, end);
+  nodes_[index].left_ = left;
+  nodes_[index].right_ = right;
+
+  return index;
+}
+
+void NearestNeighborsFlatKD::offerK(const double *query, std::size_t row, std::size_t k,
+                                    std::vector<Neighbor> &heap) const
+{
+  if (!isLive(row))
+    return;
+
+  const double distance = rowDistance(query, row);
+  if (heap.size() < k)
+  {
+    heap.push_back(Neighbor(distance, row));
+    std::push_heap(heap.begin(), heap.end());
+  }
+  else if (distance < heap.front().first)
+  {
+    std::pop_heap(heap.begin(), heap.end());
+    heap.back() = Neighbor(distance, row);
+    std::push_heap(heap.begin(), heap.end());
+  }
+}
+
+void NearestNeighborsFlatKD::searchNodeK(std::size_t index, const double *query, std::size_t k,
+                                         std::vector<Neighbor> &heap) const
+{
+  const Node &node = nodes_[index];
+  if (node.left_ == 0)
+  {
+    for (std::size_t i = node.begin_; i < node.end_; ++i)
+      offerK(query, order_[i], k, heap);
+    return;
+  }
+
+  // Search the side of the query first, then the other side only if it can still hold a closer row
+  const double diff = query[node.splitDim_] - node.splitValue_;
+  searchNodeK(diff < 0 ? node.left_ : node.right_, query, k, heap);
+  if (heap.size() < k || axisDistance(diff) < heap.front().first)
+    searchNodeK(diff < 0 ? node.right_ : node.left_, query, k, heap);
+}
+
+void NearestNeighborsFlatKD::searchNodeR(std::size_t index, const double *query, double radius,
+                                         std::vector<Neighbor> &result) const
+{
+  const Node &node = nodes_[index];
+  if (node.left_ == 0)
+  {
+    for (std::size_t i = node.begin_; i < node.end_; ++i)
+    {
+      const std::size_t row = order_[i];
+      if (!isLive(row))
+        continue;
+      const double distance = rowDistance(query, row);
+      if (distance <= radius)
+        result.push_back(Neighbor(distance, row));
+    }
+    return;
+  }
+
+  const double diff = query[node.splitDim_] - node.splitValue_;
+  const double bound = axisDistance(diff);
+  if (diff < 0 || bound <= radius)
+    searchNodeR(node.left_, query, radius, result);
+  if (diff >= 0 || bound <= radius)
+    searchNodeR(node.right_, query, radius, result);
+}
+
+void NearestNeighborsFlatKD::searchK(const double *query, std::size_t k, std::vector<Neighbor> &result) const
+{
+  result.clear();
+  result.reserve(k + 1);
+  if (!nodes_.empty())
+    searchNodeK(0, query, k, result);
+
+  // Rows added since the last build
+  for (std::size_t row = numIndexed_; row < vertices_.size(); ++row)
+    offerK(query, row, k, result);
+
+  std::sort_heap(result.begin(), result.end());
+}
+
+void NearestNeighborsFlatKD::searchR(const double *query, double radius, std::vector<Neighbor> &result) const
+{
+  result.clear();
+  if (!nodes_.empty())
+    searchNodeR(0, query, radius, result);
+
+  // Rows added since the last build
+  for (std::size_t row = numIndexed_; row < vertices_.size(); ++row)
+  {
+    if (!isLive(row))
+      continue;
+    const double distance = rowDistance(query, row);
+    if (distance <= radius)
+      result.push_back(Neighbor(distance, row));
+  }
+
+  std::sort(result.begin(), result.end());
+}
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
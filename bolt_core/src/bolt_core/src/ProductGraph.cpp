@@ -0,0 +1,348 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Dual arm roadmap that is the product of a single arm sparse graph with its mirror, without building it
+*/
+
+// Bolt
+#include <bolt_core/ProductGraph.h>
+
+// Boost
+#include <boost/foreach.hpp>
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <unordered_set>
+
+#define foreach BOOST_FOREACH
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+ProductGraph::ProductGraph(SparseMirrorPtr sparseMirror, SparseGraphPtr monoSG, base::SpaceInformationPtr dualSpaceInfo,
+                           base::SpaceInformationPtr leftArmSpaceInfo)
+  : sparseMirror_(sparseMirror)
+  , monoSG_(monoSG)
+  , monoSI_(monoSG->getSpaceInformation())
+  , dualSI_(dualSpaceInfo)
+  , leftArmSI_(leftArmSpaceInfo)
+  , numMonoVertices_(monoSG->getNumVertices())
+  , numRealMonoVertices_(monoSG->getNumRealVertices())
+{
+  BOLT_ASSERT(monoSI_->getStateSpace()->getDimension() == leftArmSI_->getStateSpace()->getDimension(),
+              "Number of dimensions for both arms must be the same");
+  BOLT_ASSERT(dualSI_->getStateSpace()->getDimension() >= monoSI_->getStateSpace()->getDimension() * 2,
+              "Number of dimensions in dual space info should be double or more the mono space number of dimension");
+  BOLT_ASSERT(bool(sparseMirror_->getCombineStatesCallback()), "Combine states callback has not been set");
+
+  leftArmState_ = leftArmSI_->allocState();
+}
+
+ProductGraph::~ProductGraph()
+{
+  clear();
+  leftArmSI_->freeState(leftArmState_);
+}
+
+void ProductGraph::clear()
+{
+  for (std::pair<const ProductVertex, base::State *> &entry : states_)
+    dualSI_->freeState(entry.second);
+  states_.clear();
+  vertexValidity_.clear();
+  edgeValidity_.clear();
+}
+
+void ProductGraph::getNeighbors(ProductVertex v, std::vector<std::pair<ProductVertex, double>> &neighbors) const
+{
+  const SparseAdjList &g = monoSG_->getGraph();
+  const SparseVertex rightV = getRightVertex(v);
+  const SparseVertex leftV = getLeftVertex(v);
+
+  // Neighbors of each arm on its own
+  std::vector<std::pair<SparseVertex, double>> rightNeighbors;
+  std::vector<std::pair<SparseVertex, double>> leftNeighbors;
+  foreach (const SparseEdge e, boost::out_edges(rightV, g))
+  {
+    const SparseVertex u = boost::target(e, g);
+    if (u >= monoSG_->getNumQueryVertices() && !monoSG_->stateDeleted(u))
+      rightNeighbors.push_back(std::make_pair(u, g[e].weight_));
+  }
+  foreach (const SparseEdge e, boost::out_edges(leftV, g))
+  {
+    const SparseVertex u = boost::target(e, g);
+    if (u >= monoSG_->getNumQueryVertices() && !monoSG_->stateDeleted(u))
+      leftNeighbors.push_back(std::make_pair(u, g[e].weight_));
+  }
+
+  neighbors.clear();
+  for (const std::pair<SparseVertex, double> &right : rightNeighbors)
+    neighbors.push_back(std::make_pair(getVertex(right.first, leftV), right.second));
+  for (const std::pair<SparseVertex, double> &left : leftNeighbors)
+    neighbors.push_back(std::make_pair(getVertex(rightV, left.first), left.second));
+  if (useSimultaneousEdges_)
+  {
+    for (const std::pair<SparseVertex, double> &right : rightNeighbors)
+      for (const std::pair<SparseVertex, double> &left : leftNeighbors)
+        neighbors.push_back(std::make_pair(getVertex(right.first, left.first),
+                                           std::sqrt(right.second * right.second + left.second * left.second)));
+  }
+
+  // Skip anything that has already been collision checked and found invalid
+  neighbors.erase(std::remove_if(neighbors.begin(), neighbors.end(),
+                                 [&](const std::pair<ProductVertex, double> &neighbor)
+                                 {
+                                   std::unordered_map<ProductVertex, bool>::const_iterator vertexIt =
+                                       vertexValidity_.find(neighbor.first);
+                                   if (vertexIt != vertexValidity_.end() && !vertexIt->second)
+                                     return true;
+                                   std::map<VertexPair, bool>::const_iterator edgeIt = edgeValidity_.find(
+                                       VertexPair(std::min(v, neighbor.first), std::max(v, neighbor.first)));
+                                   return edgeIt != edgeValidity_.end() && !edgeIt->second;
+                                 }),
+                  neighbors.end());
+}
+
+double ProductGraph::distanceHeuristic(ProductVertex a, ProductVertex b) const
+{
+  // Mirroring only reflects joints within their bounds, so distances between left arm states are the same as
+  // between the single arm states they were mirrored from
+  const double rightDist = monoSI_->distance(monoSG_->getState(getRightVertex(a)), monoSG_->getState(getRightVertex(b)));
+  const double leftDist = monoSI_->distance(monoSG_->getState(getLeftVertex(a)), monoSG_->getState(getLeftVertex(b)));
+  return std::sqrt(rightDist * rightDist + leftDist * leftDist);
+}
+
+const base::State *ProductGraph::getState(ProductVertex v)
+{
+  std::unordered_map<ProductVertex, base::State *>::const_iterator it = states_.find(v);
+  if (it != states_.end())
+    return it->second;
+
+  sparseMirror_->mirrorState(monoSG_->getState(getLeftVertex(v)), leftArmState_, 0);
+  base::State *state =
+      sparseMirror_->getCombineStatesCallback()(monoSG_->getState(getRightVertex(v)), leftArmState_);
+  states_[v] = state;
+  return state;
+}
+
+bool ProductGraph::isValid(ProductVertex v)
+{
+  std::unordered_map<ProductVertex, bool>::const_iterator it = vertexValidity_.find(v);
+  if (it != vertexValidity_.end())
+    return it->second;
+
+  const bool valid = dualSI_->isValid(getState(v));
+  vertexValidity_[v] = valid;
+  return valid;
+}
+
+bool ProductGraph::checkMotion(ProductVertex v1, ProductVertex v2)
+{
+  const VertexPair edge(std::min(v1, v2), std::max(v1, v2));
+  std::map<VertexPair, bool>::const_iterator it = edgeValidity_.find(edge);
+  if (it != edgeValidity_.end())
+    return it->second;
+
+  const bool valid = dualSI_->checkMotion(getState(v1), getState(v2));
+  edgeValidity_[edge] = valid;
+  return valid;
+}
+
+bool ProductGraph::findNearestVertex(const base::State *rightState, const base::State *leftState,
+                                     ProductVertex &vertex, std::size_t indent)
+{
+  BOLT_FUNC(indent, verbose_, "findNearestVertex()");
+
+  if (numRealMonoVertices_ == 0)
+  {
+    BOLT_ERROR(indent, "Single arm graph is empty");
+    return false;
+  }
+
+  const std::size_t threadID = 0;
+  monoSG_->getQueryStateNonConst(threadID) = const_cast<base::State *>(rightState);
+  const SparseVertex rightV = monoSG_->getNN()->nearest(monoSG_->getQueryVertices(threadID));
+  monoSG_->getQueryStateNonConst(threadID) = const_cast<base::State *>(leftState);
+  const SparseVertex leftV = monoSG_->getNN()->nearest(monoSG_->getQueryVertices(threadID));
+  monoSG_->getQueryStateNonConst(threadID) = nullptr;
+
+  vertex = getVertex(rightV, leftV);
+  BOLT_DEBUG(indent, verbose_, "Nearest right vertex " << rightV << ", left vertex " << leftV);
+  return true;
+}
+
+bool ProductGraph::astarSearch(ProductVertex start, ProductVertex goal, std::vector<ProductVertex> &vertexPath,
+                               double &distance, std::size_t indent)
+{
+  BOLT_FUNC(indent, vSearch_, "astarSearch()");
+
+  // Only the vertices that are reached are stored, the product graph is far too large for property maps
+  typedef std::pair<double, ProductVertex> OpenEntry;
+  std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> open;
+  std::unordered_map<ProductVertex, double> costs;
+  std::unordered_map<ProductVertex, ProductVertex> parents;
+  std::unordered_set<ProductVertex> closed;
+  std::vector<std::pair<ProductVertex, double>> neighbors;
+
+  costs[start] = 0;
+  parents[start] = start;
+  open.push(OpenEntry(distanceHeuristic(start, goal), start));
+
+  bool foundGoal = false;
+  while (!open.empty())
+  {
+    const ProductVertex v = open.top().second;
+    open.pop();
+
+    // The heuristic is consistent, so a vertex is final the first time it is taken off the open list
+    if (!closed.insert(v).second)
+      continue;
+
+    if (v == goal)
+    {
+      foundGoal = true;
+      break;
+    }
+
+    const double costV = costs[v];
+    getNeighbors(v, neighbors);
+    for (const std::pair<ProductVertex, double> &neighbor : neighbors)
+    {
+      if (closed.count(neighbor.first))
+        continue;
+
+      const double cost = costV + neighbor.second;
+      std::unordered_map<ProductVertex, double>::iterator it = costs.find(neighbor.first);
+      if (it != costs.end() && it->second <= cost)
+        continue;
+
+      costs[neighbor.first] = cost;
+      parents[neighbor.first] = v;
+      open.push(OpenEntry(cost + distanceHeuristic(neighbor.first, goal), neighbor.first));
+    }
+  }
+
+  BOLT_DEBUG(indent, vSearch_, "Expanded " << closed.size() << " vertices, reached " << costs.size());
+
+  if (!foundGoal)
+    return false;
+
+  distance = costs[goal];
+  vertexPath.clear();
+  for (ProductVertex v = goal; v != start; v = parents[v])
+    vertexPath.push_back(v);
+  vertexPath.push_back(start);
+  std::reverse(vertexPath.begin(), vertexPath.end());
+
+  return true;
+}
+
+bool ProductGraph::lazyAstarSearch(ProductVertex start, ProductVertex goal, geometric::PathGeometric &path,
+                                   const base::PlannerTerminationCondition &ptc, std::size_t indent)
+{
+  BOLT_FUNC(indent, verbose_, "lazyAstarSearch()");
+
+  if (!isValid(start) || !isValid(goal))
+  {
+    BOLT_WARN(indent, true, "Start or goal of the dual arm query is in collision");
+    return false;
+  }
+
+  std::vector<ProductVertex> vertexPath;
+  double distance;
+  for (std::size_t i = 0; i < maxLazyIterations_; ++i)
+  {
+    if (ptc)
+    {
+      BOLT_WARN(indent, true, "Dual arm search interrupted after " << i << " candidate paths");
+      return false;
+    }
+
+    if (!astarSearch(start, goal, vertexPath, distance, indent))
+    {
+      BOLT_WARN(indent, true, "No dual arm path after " << i << " candidate paths were rejected");
+      return false;
+    }
+
+    if (!checkPath(vertexPath, indent))
+      continue;
+
+    BOLT_DEBUG(indent, verbose_, "Found dual arm path with " << vertexPath.size() << " vertices and distance "
+                                                             << distance << " after " << i << " rejected paths, "
+                                                             << states_.size() << " combined states created");
+    path.clear();
+    for (const ProductVertex v : vertexPath)
+      path.append(getState(v));
+    return true;
+  }
+
+  BOLT_WARN(indent, true, "Gave up on dual arm path after " << maxLazyIterations_ << " candidate paths");
+  return false;
+}
+
+bool ProductGraph::checkPath(const std::vector<ProductVertex> &vertexPath, std::size_t indent)
+{
+  // Vertices are cheaper to check than edges, so reject a path on them first
+  for (const ProductVertex v : vertexPath)
+  {
+    if (!isValid(v))
+    {
+      BOLT_DEBUG(indent, vSearch_, "Combined state of vertex " << v << " is in collision");
+      return false;
+    }
+  }
+
+  for (std::size_t i = 1; i < vertexPath.size(); ++i)
+  {
+    if (!checkMotion(vertexPath[i - 1], vertexPath[i]))
+    {
+      BOLT_DEBUG(indent, vSearch_, "Combined motion from vertex " << vertexPath[i - 1] << " is in collision");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
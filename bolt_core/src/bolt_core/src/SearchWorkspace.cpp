@@ -0,0 +1,99 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Reusable memory for graph searches
+*/
+
+// Bolt
+#include <bolt_core/SearchWorkspace.h>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+void SearchWorkspace::reset(std::size_t numVertices)
+{
+  open_.clear();
+
+  // Vertices added since the last search start out untouched
+  if (discovered_.size() < numVertices)
+  {
+    distances_.resize(numVertices);
+    predecessors_.resize(numVertices);
+    heuristics_.resize(numVertices);
+    discovered_.resize(numVertices, generation_);
+    closed_.resize(numVertices, generation_);
+    heuristicStamps_.resize(numVertices, generation_);
+  }
+
+  // After the counter wraps old stamps could match again, so clear them once
+  if (++generation_ == 0)
+  {
+    std::fill(discovered_.begin(), discovered_.end(), 0);
+    std::fill(closed_.begin(), closed_.end(), 0);
+    std::fill(heuristicStamps_.begin(), heuristicStamps_.end(), 0);
+    generation_ = 1;
+  }
+}
+
+bool SearchWorkspace::popOpen(std::size_t &v)
+{
+  while (!open_.empty())
+  {
+    std::pop_heap(open_.begin(), open_.end(), std::greater<OpenEntry>());
+    v = open_.back().second;
+    open_.pop_back();
+
+    // Skip entries left behind when a shorter path to the vertex was found
+    if (closed_[v] == generation_)
+      continue;
+
+    closed_[v] = generation_;
+    return true;
+  }
+  return false;
+}
+
+SearchWorkspace &SearchWorkspace::getThreadWorkspace(std::size_t slot)
+{
+  static thread_local SearchWorkspace workspaces[NUM_THREAD_WORKSPACES];
+  return workspaces[slot];
+}
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
@@ -47,6 +47,7 @@
 #include <valgrind/callgrind.h>
 
 // C++
+#include <algorithm>
 #include <thread>
 
 #define foreach BOOST_FOREACH
@@ -62,7 +63,8 @@ namespace tools
 {
 namespace bolt
 {
-SparseCriteria::SparseCriteria(SparseGraphPtr sg) : sg_(sg), si_(sg_->getSpaceInformation()), visual_(sg_->getVisual())
+SparseCriteria::SparseCriteria(SparseGraphPtr sg)
+  : sg_(sg), si_(sg_->getSpaceInformation()), visual_(sg_->getVisual()), useFourthCriteria_(false)
 {
   // We really only need one, but this is setup to be threaded for future usage
   for (std::size_t i = 0; i < sg_->getNumQueryVertices(); ++i)
@@ -105,6 +107,11 @@ bool SparseCriteria::setup(std::size_t indent)
   // Get a sampler with or without clearance sampling
   sampler_ = sg_->getSampler(si_, sg_->getObstacleClearance(), indent);
 
+  // Collision checker threads for edges to a candidate's neighbors
+  if (!batchMotionValidator_ || (numMotionValidationThreads_ != 0 &&
+                                 batchMotionValidator_->getNumThreads() != numMotionValidationThreads_))
+    batchMotionValidator_.reset(new BatchMotionValidator(si_, numMotionValidationThreads_));
+
   if (si_->getStateValidityChecker()->getClearanceSearchDistance() < sg_->getObstacleClearance())
     OMPL_WARN("State validity checker clearance search distance %f is less than the required obstacle clearance %f for "
               "our state sampler, incompatible settings!",
@@ -141,8 +148,19 @@ bool SparseCriteria::addStateToRoadmap(CandidateData &candidateD, VertexType &ad
 
   bool stateAdded = false;
 
+  // Other threads read the graph while evaluating candidates, keep them out while it changes
+  boost::unique_lock<boost::shared_mutex> graphLock(graphMutex_);
+
+  // A generator thread already evaluated the criteria, its decision only has to be rechecked
+  const bool speculative =
+      candidateD.proposal_.evaluated_ && candidateD.proposal_.useFourthCriteria_ == useFourthCriteria_;
+
+  if (speculative && commitProposal(candidateD, addReason, indent))
+  {
+    stateAdded = true;
+  }
   // Always add a node if no other nodes around it are visible (GUARD)
-  if (checkAddCoverage(candidateD, indent))
+  else if (!speculative && checkAddCoverage(candidateD, indent))
   {
     BOLT_DEBUG(indent, vAddedReason_, "Graph updated: COVERAGE Fourth: " << useFourthCriteria_
                                                                          << " State: " << candidateD.state_);
@@ -150,7 +168,7 @@ bool SparseCriteria::addStateToRoadmap(CandidateData &candidateD, VertexType &ad
     addReason = COVERAGE;
     stateAdded = true;
   }
-  else if (checkAddConnectivity(candidateD, indent + 2))
+  else if (!speculative && checkAddConnectivity(candidateD, indent + 2))
   {
     BOLT_MAGENTA(indent, vAddedReason_, "Graph updated: CONNECTIVITY Fourth: " << useFourthCriteria_
                                                                                << " State: " << candidateD.state_);
@@ -158,7 +176,7 @@ bool SparseCriteria::addStateToRoadmap(CandidateData &candidateD, VertexType &ad
     addReason = CONNECTIVITY;
     stateAdded = true;
   }
-  else if (checkAddInterface(candidateD, indent + 4))
+  else if (!speculative && checkAddInterface(candidateD, indent + 4))
   {
     BOLT_BLUE(indent, vAddedReason_, "Graph updated: INTERFACE Fourth: " << useFourthCriteria_
                                                                          << " State: " << candidateD.state_);
@@ -202,6 +220,7 @@ bool SparseCriteria::checkAddCoverage(CandidateData &candidateD, std::size_t ind
   BOLT_DEBUG(indent, vCriteria_, "Adding node for COVERAGE ");
 
   candidateD.newVertex_ = sg_->addVertex(candidateD.state_, COVERAGE, indent + 4);
+  candidateD.state_ = sg_->getStateNonConst(candidateD.newVertex_);  // the graph owns the state now
 
   // Note: we do not connect this node with any edges because we have already determined
   // it is too far away from any nearby nodes
@@ -236,6 +255,10 @@ bool SparseCriteria::checkAddConnectivity(CandidateData &candidateD, std::size_t
   // different connected components) and connect them
   std::set<SparseVertex> statesInDiffConnectedComponents;
 
+  // Edges that could connect two components directly, checked together below
+  std::vector<MotionSegment> directSegments;
+  std::vector<std::pair<SparseVertex, SparseVertex>> directEdges;
+
   // For each neighbor
   for (const SparseVertex &v1 : candidateD.visibleNeighborhood_)
   {
@@ -257,19 +280,11 @@ bool SparseCriteria::checkAddConnectivity(CandidateData &candidateD, std::size_t
 
         BOLT_ASSERT(!sg_->hasEdge(v1, v2), "Edge exist but not in same component");
 
-        // Can they be connected directly?
-        if (useDirectConnectivyCriteria_)
+        // Can they be connected directly? Each pair is visited in both orders, only check it once
+        if (useDirectConnectivyCriteria_ && v1 < v2)
         {
-          if (si_->checkMotion(sg_->getState(v1), sg_->getState(v2)))
-          {
-            sg_->addEdge(v1, v2, eCONNECTIVITY, indent);
-
-            // We return true (state was used to improve graph) but we didn't actually use
-            // the state, so we much manually free the memory
-            si_->freeState(candidateD.state_);
-
-            return true;
-          }
+          directSegments.push_back(MotionSegment(sg_->getState(v1), sg_->getState(v2)));
+          directEdges.push_back(std::make_pair(v1, v2));
         }
 
         // Add to potential list
@@ -279,6 +294,28 @@ bool SparseCriteria::checkAddConnectivity(CandidateData &candidateD, std::size_t
     }
   }
 
+  // Connect with the shortest direct edge that is collision free
+  if (!directSegments.empty())
+  {
+    MotionBatchPtr batch = batchMotionValidator_->checkMotions(directSegments);
+
+    std::size_t i;
+    bool valid;
+    while (batch->next(i, valid))
+    {
+      if (!valid)
+        continue;
+
+      sg_->addEdge(directEdges[i].first, directEdges[i].second, eCONNECTIVITY, indent);
+
+      // We return true (state was used to improve graph) but we didn't actually use
+      // the state, so we much manually free the memory
+      si_->freeState(candidateD.state_);
+
+      return true;
+    }
+  }
+
   // Were any disconnected states found?
   if (statesInDiffConnectedComponents.empty())
   {
@@ -288,8 +325,18 @@ bool SparseCriteria::checkAddConnectivity(CandidateData &candidateD, std::size_t
 
   BOLT_DEBUG(indent, vCriteria_, "Adding node for CONNECTIVITY ");
 
+  addConnectivityVertex(candidateD, statesInDiffConnectedComponents, indent);
+
+  return true;
+}
+
+void SparseCriteria::addConnectivityVertex(CandidateData &candidateD,
+                                           const std::set<SparseVertex> &statesInDiffConnectedComponents,
+                                           std::size_t indent)
+{
   // Add the node
   candidateD.newVertex_ = sg_->addVertex(candidateD.state_, CONNECTIVITY, indent + 2);
+  candidateD.state_ = sg_->getStateNonConst(candidateD.newVertex_);  // the graph owns the state now
 
   // Remove all edges from all vertices near our new vertex
   sg_->clearEdgesNearVertex(candidateD.newVertex_, indent);
@@ -333,8 +380,6 @@ bool SparseCriteria::checkAddConnectivity(CandidateData &candidateD, std::size_t
       sg_->addEdge(candidateD.newVertex_, *vertexIt, eCONNECTIVITY, indent + 4);
     }
   }
-
-  return true;
 }
 
 bool SparseCriteria::checkAddInterface(CandidateData &candidateD, std::size_t indent)
@@ -384,7 +429,7 @@ bool SparseCriteria::checkAddInterface(CandidateData &candidateD, std::size_t in
     return false;
 
   // If they can be directly connected
-  if (si_->checkMotion(sg_->getState(v1), sg_->getState(v2)))
+  if (batchMotionValidator_->checkMotion(sg_->getState(v1), sg_->getState(v2)))
   {
     BOLT_DEBUG(indent, vCriteria_, "INTERFACE: directly connected nodes");
 
@@ -402,7 +447,17 @@ bool SparseCriteria::checkAddInterface(CandidateData &candidateD, std::size_t in
   // Add the new node to the graph, to bridge the interface
   BOLT_DEBUG(indent, vCriteria_, "Adding node for INTERFACE");
 
+  addInterfaceVertex(candidateD, v1, v2, indent);
+
+  // Report success
+  return true;
+}
+
+void SparseCriteria::addInterfaceVertex(CandidateData &candidateD, SparseVertex v1, SparseVertex v2,
+                                        std::size_t indent)
+{
   candidateD.newVertex_ = sg_->addVertex(candidateD.state_, INTERFACE, indent);
+  candidateD.state_ = sg_->getStateNonConst(candidateD.newVertex_);  // the graph owns the state now
 
   // Remove all edges from all vertices near our new vertex
   sg_->clearEdgesNearVertex(candidateD.newVertex_, indent);
@@ -431,9 +486,268 @@ bool SparseCriteria::checkAddInterface(CandidateData &candidateD, std::size_t in
   }
 
   BOLT_DEBUG(indent, vCriteria_, "INTERFACE: connected two neighbors through new interface node");
+}
 
-  // Report success
-  return true;
+void SparseCriteria::evaluateCandidate(CandidateData &candidateD, std::size_t indent)
+{
+  BOLT_FUNC(indent, vCriteria_, "evaluateCandidate() State: " << candidateD.state_);
+
+  CandidateProposal &proposal = candidateD.proposal_;
+  proposal = CandidateProposal();
+  proposal.evaluated_ = true;
+  proposal.useFourthCriteria_ = useFourthCriteria_;
+
+  const std::vector<SparseVertex> &visibleNeighborhood = candidateD.visibleNeighborhood_;
+
+  // Coverage - no other nodes around it are visible
+  if (visibleNeighborhood.empty())
+  {
+    proposal.accepted_ = true;
+    proposal.type_ = COVERAGE;
+    return;
+  }
+
+  // With less than two neighbors there are no components to connect and no interface
+  if (visibleNeighborhood.size() < 2)
+    return;
+
+  // Connectivity - find the visible neighbors that are in different components
+  if (useConnectivityCriteria_ && proposal.useFourthCriteria_)
+  {
+    std::set<SparseVertex> statesInDiffConnectedComponents;
+    std::vector<MotionSegment> directSegments;
+    std::vector<std::pair<SparseVertex, SparseVertex>> directEdges;
+    {
+      boost::shared_lock<boost::shared_mutex> lock(graphMutex_);
+      for (const SparseVertex &v1 : visibleNeighborhood)
+      {
+        for (const SparseVertex &v2 : visibleNeighborhood)
+        {
+          if (v1 >= v2 || sg_->sameComponentReadOnly(v1, v2))
+            continue;
+
+          if (useDirectConnectivyCriteria_)
+          {
+            directSegments.push_back(MotionSegment(sg_->getState(v1), sg_->getState(v2)));
+            directEdges.push_back(std::make_pair(v1, v2));
+          }
+
+          statesInDiffConnectedComponents.insert(v1);
+          statesInDiffConnectedComponents.insert(v2);
+        }
+      }
+    }
+
+    // Keep every collision free direct edge, in the order checkAddConnectivity() would try them, since some may
+    // have been connected another way by the time the proposal is committed
+    if (!directSegments.empty())
+    {
+      MotionBatchPtr batch = batchMotionValidator_->checkMotions(directSegments);
+
+      std::size_t i;
+      bool valid;
+      while (batch->next(i, valid))
+        if (valid)
+          proposal.directEdges_.push_back(directEdges[i]);
+    }
+
+    if (!statesInDiffConnectedComponents.empty())
+    {
+      proposal.accepted_ = true;
+      proposal.type_ = CONNECTIVITY;
+      proposal.connectivityVertices_.assign(statesInDiffConnectedComponents.begin(),
+                                            statesInDiffConnectedComponents.end());
+      return;
+    }
+  }
+
+  // Interface - the two closest nodes must be visible and not share an edge
+  const SparseVertex v1 = visibleNeighborhood[0];
+  const SparseVertex v2 = visibleNeighborhood[1];
+  if (!(candidateD.graphNeighborhood_[0] == v1 && candidateD.graphNeighborhood_[1] == v2))
+    return;
+
+  const base::State *state1;
+  const base::State *state2;
+  {
+    boost::shared_lock<boost::shared_mutex> lock(graphMutex_);
+    if (sg_->hasEdge(v1, v2))
+      return;
+    state1 = sg_->getState(v1);
+    state2 = sg_->getState(v2);
+  }
+
+  // The path length through the graph is left to commitProposal(), the search is not thread safe
+  proposal.accepted_ = true;
+  proposal.type_ = INTERFACE;
+  proposal.interfaceDirect_ = batchMotionValidator_->checkMotion(state1, state2);
+}
+
+void SparseCriteria::revalidateCandidate(CandidateData &candidateD, std::size_t indent)
+{
+  BOLT_FUNC(indent, vCriteria_, "revalidateCandidate() Vertices added since: "
+                                    << sg_->getNumVertices() - candidateD.graphNumVertices_);
+
+  // Keep a neighborhood sorted from the closest vertex, like the nearest neighbor search returns it
+  auto insertByDistance = [&](std::vector<SparseVertex> &neighborhood, SparseVertex v, double distance)
+  {
+    std::vector<SparseVertex>::iterator it = neighborhood.begin();
+    while (it != neighborhood.end() && si_->distance(candidateD.state_, sg_->getState(*it)) <= distance)
+      ++it;
+    neighborhood.insert(it, v);
+  };
+
+  // A neighbor that was removed changes the decision
+  for (const SparseVertex &v : candidateD.visibleNeighborhood_)
+  {
+    if (sg_->stateDeleted(v))
+      candidateD.proposal_.evaluated_ = false;
+  }
+
+  // Vertices are only appended, so everything past the count at search time is new
+  const std::size_t numVertices = sg_->getNumVertices();
+  for (SparseVertex v = candidateD.graphNumVertices_; v < numVertices; ++v)
+  {
+    if (sg_->stateDeleted(v))
+      continue;
+
+    // The search may already have found it
+    if (std::find(candidateD.graphNeighborhood_.begin(), candidateD.graphNeighborhood_.end(), v) !=
+        candidateD.graphNeighborhood_.end())
+      continue;
+
+    const double distance = si_->distance(candidateD.state_, sg_->getState(v));
+    if (distance > sparseDelta_)
+      continue;
+
+    BOLT_DEBUG(indent + 2, vCriteria_, "New vertex " << v << " is a neighbor, reevaluating the criteria");
+
+    insertByDistance(candidateD.graphNeighborhood_, v, distance);
+    if (batchMotionValidator_->checkMotion(candidateD.state_, sg_->getState(v)))
+      insertByDistance(candidateD.visibleNeighborhood_, v, distance);
+
+    candidateD.proposal_.evaluated_ = false;
+  }
+
+  candidateD.graphNumVertices_ = numVertices;
+}
+
+bool SparseCriteria::commitProposal(CandidateData &candidateD, VertexType &addReason, std::size_t indent)
+{
+  BOLT_FUNC(indent, vCriteria_, "commitProposal() Applying the decision of a generator thread");
+
+  const CandidateProposal &proposal = candidateD.proposal_;
+
+  if (!proposal.accepted_)
+  {
+    BOLT_DEBUG(indent, vCriteria_, "Did NOT add state for any criteria "
+                                       << " State: " << candidateD.state_);
+    return false;
+  }
+
+  switch (proposal.type_)
+  {
+    case COVERAGE:
+    {
+      // No vertex added since is visible from the candidate, otherwise the proposal would have been discarded
+      candidateD.newVertex_ = sg_->addVertex(candidateD.state_, COVERAGE, indent + 4);
+      candidateD.state_ = sg_->getStateNonConst(candidateD.newVertex_);  // the graph owns the state now
+
+      BOLT_DEBUG(indent, vAddedReason_, "Graph updated: COVERAGE Fourth: " << useFourthCriteria_
+                                                                           << " State: " << candidateD.state_);
+      addReason = COVERAGE;
+      return true;
+    }
+    case CONNECTIVITY:
+    {
+      // Components only merge, so the pairs still disconnected are among those the proposal found
+      for (const std::pair<SparseVertex, SparseVertex> &edge : proposal.directEdges_)
+      {
+        if (sg_->sameComponent(edge.first, edge.second))
+          continue;
+
+        sg_->addEdge(edge.first, edge.second, eCONNECTIVITY, indent);
+
+        // We return true (state was used to improve graph) but we didn't actually use
+        // the state, so we much manually free the memory
+        si_->freeState(candidateD.state_);
+
+        BOLT_MAGENTA(indent, vAddedReason_, "Graph updated: CONNECTIVITY Fourth: " << useFourthCriteria_
+                                                                                   << " State: " << candidateD.state_);
+        addReason = CONNECTIVITY;
+        return true;
+      }
+
+      std::set<SparseVertex> statesInDiffConnectedComponents;
+      for (const SparseVertex &v1 : proposal.connectivityVertices_)
+      {
+        for (const SparseVertex &v2 : proposal.connectivityVertices_)
+        {
+          if (v1 < v2 && !sg_->sameComponent(v1, v2))
+          {
+            statesInDiffConnectedComponents.insert(v1);
+            statesInDiffConnectedComponents.insert(v2);
+          }
+        }
+      }
+
+      if (!statesInDiffConnectedComponents.empty())
+      {
+        addConnectivityVertex(candidateD, statesInDiffConnectedComponents, indent);
+
+        BOLT_MAGENTA(indent, vAddedReason_, "Graph updated: CONNECTIVITY Fourth: " << useFourthCriteria_
+                                                                                   << " State: " << candidateD.state_);
+        addReason = CONNECTIVITY;
+        return true;
+      }
+
+      // The components were connected since, the interface criteria was never evaluated
+      if (checkAddInterface(candidateD, indent + 4))
+      {
+        BOLT_BLUE(indent, vAddedReason_, "Graph updated: INTERFACE Fourth: " << useFourthCriteria_
+                                                                             << " State: " << candidateD.state_);
+        addReason = INTERFACE;
+        return true;
+      }
+      return false;
+    }
+    case INTERFACE:
+    {
+      const SparseVertex &v1 = candidateD.visibleNeighborhood_[0];
+      const SparseVertex &v2 = candidateD.visibleNeighborhood_[1];
+
+      // Edges may have been added since
+      if (sg_->hasEdge(v1, v2))
+      {
+        BOLT_DEBUG(indent, vCriteria_, "Two closest two neighbors already share an edge, not connecting them");
+        return false;
+      }
+      if (!sg_->checkPathLength(v1, v2, indent))
+        return false;
+
+      if (proposal.interfaceDirect_)
+      {
+        sg_->addEdge(v1, v2, eINTERFACE, indent);
+
+        // We return true (state was used to improve graph) but we didn't actually use
+        // the state, so we much manually free the memory
+        si_->freeState(candidateD.state_);
+      }
+      else
+      {
+        addInterfaceVertex(candidateD, v1, v2, indent);
+      }
+
+      BOLT_BLUE(indent, vAddedReason_, "Graph updated: INTERFACE Fourth: " << useFourthCriteria_
+                                                                           << " State: " << candidateD.state_);
+      addReason = INTERFACE;
+      return true;
+    }
+    default:
+      BOLT_ERROR(indent, "Unknown proposal type " << proposal.type_);
+  }
+
+  return false;
 }
 
 #ifdef ENABLE_QUALITY
@@ -867,7 +1181,20 @@ bool SparseCriteria::spannerTest(SparseVertex v, SparseVertex vp, SparseVertex v
         return false;  // skip because new edge wouldn't help anything
       }
 
-      // Second test: Compare to the length of the shortest path through the graph with those endpoints
+      // Second test: Compare to the length of the shortest path through the graph with those endpoints. Most
+      // candidates fail it, which a bounded search finds out without exploring the whole graph
+      if (!visualizeQualityCriteriaAstar_ && sg_->hasPathShorterThan(vp, vpp, newEdgeDistance + SMALL_EPSILON, indent))
+      {
+        return false;  // skip because there is already a path that achieves this
+      }
+
+      // Only the smoothed path rule needs the actual length
+      if (!visualizeQualityCriteriaAstar_ && !useSmoothedPathImprovementRule_)
+      {
+        shortestPathVpVpp = std::numeric_limits<double>::infinity();
+        return true;  // spanner property was violated
+      }
+
       shortestPathVpVpp = qualityEdgeAstarTest(vp, vpp, iData, indent);
       BOLT_DEBUG(indent + 2, vQuality_, "newEdgeDistance: " << newEdgeDistance);
       BOLT_DEBUG(indent + 2, vQuality_, "shortestPathVpVpp: " << shortestPathVpVpp);
@@ -949,10 +1276,18 @@ SparseVertex SparseCriteria::findGraphRepresentative(base::State *state, std::si
 
   SparseVertex result = boost::graph_traits<SparseAdjList>::null_vertex();
 
-  for (std::size_t i = 0; i < graphNeighbors.size(); ++i)
+  // Check all neighbors in parallel but stop at the closest visible one
+  std::vector<MotionSegment> segments;
+  for (const SparseVertex &v : graphNeighbors)
+    segments.push_back(MotionSegment(state, sg_->getState(v)));
+  MotionBatchPtr batch = batchMotionValidator_->checkMotions(segments);
+
+  std::size_t i;
+  bool valid;
+  while (batch->next(i, valid))
   {
     BOLT_DEBUG(indent, vQuality_, "Checking motion of graph representative candidate " << i);
-    if (si_->checkMotion(state, sg_->getState(graphNeighbors[i])))
+    if (valid)
     {
       BOLT_DEBUG(indent + 2, vQuality_, "graph representative valid ");
       result = graphNeighbors[i];
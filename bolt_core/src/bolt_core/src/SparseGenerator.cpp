@@ -43,12 +43,14 @@
 #include <ompl/base/spaces/RealVectorStateSpace.h>
 
 // Boost
+#include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
 
 // Profiling
 #include <valgrind/callgrind.h>
 
 // C++
+#include <fstream>
 #include <thread>
 
 #define foreach BOOST_FOREACH
@@ -65,7 +67,7 @@ namespace tools
 namespace bolt
 {
 SparseGenerator::SparseGenerator(SparseGraphPtr sg)
-  : sg_(sg), si_(sg_->getSpaceInformation()), visual_(sg_->getVisual())
+  : sg_(sg), si_(sg_->getSpaceInformation()), visual_(sg_->getVisual()), insertionRunning_(false)
 {
   // Initialize discretizer
   vertexDiscretizer_.reset(new VertexDiscretizer(sg_));
@@ -108,9 +110,9 @@ void SparseGenerator::createSPARS()
   BOLT_FUNC(indent, verbose_ || true, "createSPARS()");
 
   // Error check
-  if (!useRandomSamples_ && !useDiscretizedSamples_)
+  if (!useRandomSamples_ && !useDiscretizedSamples_ && !useLowDispersionSamples_)
   {
-    OMPL_WARN("Unable to create SPARS because both random sampling and discretized sampling is disabled");
+    OMPL_WARN("Unable to create SPARS because random, discretized and low-dispersion sampling are all disabled");
     return;
   }
 
@@ -138,6 +140,13 @@ void SparseGenerator::createSPARS()
     addDiscretizedStates(indent);
   }
 
+  // Cover the space evenly before random sampling fills in the rest
+  if (useLowDispersionSamples_)
+  {
+    BOLT_INFO(indent, true, "Adding low-dispersion states");
+    addLowDispersionSamples(indent);
+  }
+
   // Only display database if enabled
   // if (sg_->visualizeSparseGraph_ && sg_->visualizeSparseGraphSpeed_ > std::numeric_limits<double>::epsilon())
   // sg_->displayDatabase(true, true, 1, indent);
@@ -147,7 +156,10 @@ void SparseGenerator::createSPARS()
   {
     BOLT_INFO(indent, true, "Adding random samples states");
     // addRandomSamplesOneThread(indent);
-    addRandomSamplesThreaded(indent);
+    if (useConcurrentInsertion_)
+      addRandomSamplesConcurrent(indent);
+    else
+      addRandomSamplesThreaded(indent);
   }
 
   // Profiler
@@ -157,6 +169,9 @@ void SparseGenerator::createSPARS()
   // Save graph - this also calls removeDeletedVertices();
   sg_->saveIfChanged(indent);
 
+  // Generation is finished, searches can use the compact copy of the graph
+  sg_->freezeGraph(indent);
+
   // Benchmark runtime
   double duration = time::seconds(time::now() - timeDiscretizeAndRandomStarted_);
 
@@ -201,8 +216,13 @@ void SparseGenerator::createSPARS()
   BOLT_INFO(indent, 1, "    Interface:               " << sg_->numSamplesAddedForInterface_);
   BOLT_INFO(indent, 1, "    Quality:                 " << sg_->numSamplesAddedForQuality_);
   BOLT_INFO(indent, 1, "  Num random samples added:  " << numRandSamplesAdded_);
+  if (useLowDispersionSamples_)
+    BOLT_INFO(indent, 1, "  Low-dispersion index:      " << lowDispersionIndex_);
   BOLT_INFO(indent, 1, "  Num vertices moved:        " << sparseCriteria_->getNumVerticesMoved());
   BOLT_INFO(indent, 1, "  CandidateQueue Misses:     " << candidateQueue_->getTotalMisses());
+  BOLT_INFO(indent, 1, "  CandidateQueue Stall Time: " << candidateQueue_->getTotalStallTime());
+  BOLT_INFO(indent, 1, "  CandidateQueue Stolen:     " << candidateQueue_->getTotalStolen());
+  BOLT_INFO(indent, 1, "  CandidateQueue Threads:    " << candidateQueue_->getNumThreads());
 #ifdef ENABLE_QUALITY
   std::pair<std::size_t, std::size_t> interfaceStats = sparseCriteria_->getInterfaceStateStorageSize();
   BOLT_INFO(indent, 1, "  InterfaceData:             ");
@@ -392,6 +412,226 @@ bool SparseGenerator::addRandomSamplesThreaded(std::size_t indent)
   return true;  // program should never reach here
 }
 
+bool SparseGenerator::addRandomSamplesConcurrent(std::size_t indent)
+{
+  BOLT_FUNC(indent, verbose_, "addRandomSamplesConcurrent()");
+
+  // Clear stats
+  numRandSamplesAdded_ = 0;
+  timeRandSamplesStarted_ = time::now();
+  maxConsecutiveFailures_ = 0;
+  maxPercentComplete_ = 0;
+
+  // Cells as wide as the visibility radius, so a candidate locks every vertex its criteria can touch
+  spatialLocks_.reset(new SpatialLocks(si_, sparseCriteria_->getSparseDelta()));
+
+  // Each thread searches the nearest neighbors through its own query vertex
+  std::size_t numThreads = numInsertionThreads_;
+  if (numThreads == 0)
+    numThreads = std::max(1u, boost::thread::hardware_concurrency());
+  numThreads = std::min(numThreads, sg_->getNumQueryVertices());
+  BOLT_DEBUG(indent, true, "Adding random samples concurrently on " << numThreads << " threads");
+
+  insertionRunning_ = true;
+  std::vector<std::thread> threads;
+  for (std::size_t threadID = 0; threadID < numThreads; ++threadID)
+  {
+    // Create new collision checker
+    base::SpaceInformationPtr si(new base::SpaceInformation(si_->getStateSpace()));
+    si->setStateValidityChecker(si_->getStateValidityChecker());
+    si->setMotionValidator(si_->getMotionValidator());
+
+    // Choose sampler based on clearance
+    base::ValidStateSamplerPtr sampler = sg_->getSampler(si, sg_->getObstacleClearance(), indent);
+
+    threads.push_back(std::thread(&SparseGenerator::insertionThread, this, threadID, sampler, indent));
+  }
+
+  for (std::thread &thread : threads)
+    thread.join();
+  insertionRunning_ = false;
+
+  BOLT_DEBUG(indent, true, "Threads waited for a locked region " << spatialLocks_->getNumContended() << " times");
+  spatialLocks_.reset();
+
+  // No other thread uses the graph anymore
+  sg_->saveIfChanged(indent);
+
+  if (visual_->viz1()->shutdownRequested())
+  {
+    BOLT_INFO(indent, true, "Shutdown requested");
+    exit(0);
+  }
+
+  return true;
+}
+
+void SparseGenerator::insertionThread(std::size_t threadID, base::ValidStateSamplerPtr sampler, std::size_t indent)
+{
+  base::State *candidateState = si_->allocState();
+  std::vector<std::size_t> lockedStripes;
+
+  while (insertionRunning_ && !visual_->viz1()->shutdownRequested())
+  {
+    // Sample randomly
+    if (!sampler->sample(candidateState))
+      throw Exception(name_, "Unable to find valid sample");
+
+    // No other thread can add or connect a vertex near the candidate until it is done
+    spatialLocks_->lock(candidateState, lockedStripes);
+
+    // Find nearby nodes and decide what to add, collision checking in parallel with the other threads
+    CandidateData candidateD(candidateState);
+    findGraphNeighbors(candidateD, threadID, indent);
+    sparseCriteria_->evaluateCandidate(candidateD, indent);
+
+    // Apply the decision and update the statistics one thread at a time
+    bool usedState = false;
+    {
+      std::lock_guard<std::mutex> lock(addSampleMutex_);
+      if (insertionRunning_ && !addSample(candidateD, threadID, usedState, indent))
+        insertionRunning_ = false;  // no more states needed
+    }
+
+    spatialLocks_->unlock(lockedStripes);
+
+    if (usedState)
+    {
+      // State was used, so allocate new state
+      candidateState = si_->allocState();
+    }
+  }
+
+  si_->freeState(candidateState);
+}
+
+bool SparseGenerator::addLowDispersionSamples(std::size_t indent)
+{
+  BOLT_FUNC(indent, verbose_, "addLowDispersionSamples()");
+
+  // Continue where the last generation of this database stopped unless a start is given. An empty graph has no
+  // samples to continue from, whatever file is next to it
+  std::size_t startIndex = 0;
+  if (lowDispersionStartIndex_ >= 0)
+    startIndex = lowDispersionStartIndex_;
+  else if (!sg_->isEmpty())
+    loadLowDispersionIndex(startIndex, indent);
+  BOLT_DEBUG(indent, verbose_, "Starting from low-dispersion index " << startIndex);
+
+  // Clear stats
+  numRandSamplesAdded_ = 0;
+  timeRandSamplesStarted_ = time::now();
+  maxConsecutiveFailures_ = 0;
+  maxPercentComplete_ = 0;
+
+  LowDispersionSequence sequence(si_);
+  const double clearance = sg_->getObstacleClearance();
+  const bool useClearance = clearance > std::numeric_limits<double>::epsilon();
+
+  base::State *candidateState = si_->allocState();
+  const std::size_t threadID = 0;
+
+  lowDispersionRunning_ = true;
+  for (lowDispersionIndex_ = startIndex; !visual_->viz1()->shutdownRequested(); ++lowDispersionIndex_)
+  {
+    sequence.sample(lowDispersionIndex_, candidateState);
+
+    // Skip states in collision or too close to obstacles, as the valid state sampler would
+    if (useClearance)
+    {
+      double dist;
+      if (!si_->getStateValidityChecker()->isValid(candidateState, dist) || dist < clearance)
+        continue;
+    }
+    else if (!si_->isValid(candidateState))
+      continue;
+
+    bool usedState = false;
+    const bool sparseGraphNotCompleted = addSample(candidateState, threadID, usedState, indent);
+
+    if (usedState)
+    {
+      // State was used, so allocate new state
+      candidateState = si_->allocState();
+    }
+
+    if (!sparseGraphNotCompleted)
+    {
+      ++lowDispersionIndex_;  // this state was already tried
+      break;                  // no more states needed
+    }
+  }
+  lowDispersionRunning_ = false;
+
+  si_->freeState(candidateState);
+
+  // Save the graph together with the index, so that the next generation continues right after these samples
+  if (sg_->getSavingEnabled() && sg_->saveIfChanged(indent))
+    saveLowDispersionIndex(lowDispersionIndex_, indent);
+  BOLT_INFO(indent, true, "Low-dispersion sampling stopped, continue from index " << lowDispersionIndex_);
+
+  // Random sampling fills in the rest with its own count of failures
+  numConsecutiveFailures_ = 0;
+
+  return true;
+}
+
+bool SparseGenerator::loadLowDispersionIndex(std::size_t &index, std::size_t indent)
+{
+  const std::string indexPath = getLowDispersionPath();
+  BOLT_FUNC(indent, verbose_, "loadLowDispersionIndex() " << indexPath);
+
+  if (!boost::filesystem::exists(indexPath))
+    return false;
+
+  std::ifstream in(indexPath.c_str());
+  std::size_t savedIndex, vertexCount, edgeCount;
+  if (!(in >> savedIndex >> vertexCount >> edgeCount))
+  {
+    OMPL_WARN("Ignoring low-dispersion index %s, it is invalid", indexPath.c_str());
+    return false;
+  }
+
+  // The index only applies to the graph it was saved with, e.g. not after the database was replaced
+  if (vertexCount != sg_->getNumVertices() || edgeCount != sg_->getNumEdges())
+  {
+    OMPL_WARN("Ignoring low-dispersion index %s, it was saved with a graph of %u vertices and %u edges",
+              indexPath.c_str(), static_cast<unsigned int>(vertexCount), static_cast<unsigned int>(edgeCount));
+    return false;
+  }
+  index = savedIndex;
+
+  BOLT_INFO(indent, true, "Continuing low-dispersion sequence from saved index " << index);
+  return true;
+}
+
+bool SparseGenerator::saveLowDispersionIndex(std::size_t index, std::size_t indent)
+{
+  const std::string indexPath = getLowDispersionPath();
+  BOLT_FUNC(indent, verbose_, "saveLowDispersionIndex() " << index << " to " << indexPath);
+
+  // Write next to the old index and then replace it, so a crash never leaves an empty file
+  const std::string tempPath = indexPath + ".tmp";
+  {
+    std::ofstream out(tempPath.c_str());
+    out << index << " " << sg_->getNumVertices() << " " << sg_->getNumEdges() << std::endl;
+    if (!out.good())
+    {
+      OMPL_ERROR("Failed to write low-dispersion index %s", tempPath.c_str());
+      return false;
+    }
+  }
+
+  boost::system::error_code ec;
+  boost::filesystem::rename(tempPath, indexPath, ec);
+  if (ec)
+  {
+    OMPL_ERROR("Failed to replace low-dispersion index %s: %s", indexPath.c_str(), ec.message().c_str());
+    return false;
+  }
+  return true;
+}
+
 bool SparseGenerator::addSample(ob::State *state, std::size_t threadID, bool &usedState, std::size_t indent)
 {
   // Find nearby nodes
@@ -412,8 +652,9 @@ bool SparseGenerator::addSample(CandidateData &candidateD, std::size_t threadID,
     // State was added
     numConsecutiveFailures_ = 0;
 
-    // Save on interval of new state addition
-    if ((numRandSamplesAdded_ + 1) % saveInterval_ == 0)
+    // Save on interval of new state addition. Saving removes deleted vertices, which would renumber the vertices
+    // held by concurrent insertion threads, so they only save once finished
+    if (!insertionRunning_ && (numRandSamplesAdded_ + 1) % saveInterval_ == 0)
     {
       stopCandidateQueueAndSave(indent);
 
@@ -441,6 +682,12 @@ bool SparseGenerator::addSample(CandidateData &candidateD, std::size_t threadID,
     if (visual_->viz1()->shutdownRequested())
     {
       BOLT_INFO(indent, true, "Shutdown requested");
+
+      // The other concurrent insertion threads may still be using the graph, they are joined and the graph is saved
+      // once all of them have stopped
+      if (insertionRunning_)
+        return false;  // stop inserting states
+
       stopCandidateQueueAndSave(indent);
       exit(0);
     }
@@ -566,30 +813,44 @@ void SparseGenerator::findGraphNeighbors(CandidateData &candidateD, double dista
   BOLT_FUNC(indent, vFindGraphNeighbors_, "findGraphNeighbors() within sparse delta "
                                               << sparseCriteria_->getSparseDelta());
 
-  // Search in thread-safe manner
-  // Note that the main thread could be modifying the NN, so we have to lock it
-  sg_->getQueryStateNonConst(threadID) = candidateD.state_;
-  sg_->getNN()->nearestR(sg_->getQueryVertices(threadID), distance, candidateD.graphNeighborhood_);
-  sg_->getQueryStateNonConst(threadID) = nullptr;
-
   // Now that we got the neighbors from the NN, we must remove any we can't see
-  for (std::size_t i = 0; i < candidateD.graphNeighborhood_.size(); ++i)
+  std::vector<MotionSegment> segments;
+  std::vector<SparseVertex> segmentVertices;
+
+  // Search in thread-safe manner
+  // Note that other threads could be modifying the graph, so we have to lock it
   {
-    const SparseVertex &v2 = candidateD.graphNeighborhood_[i];
+    boost::shared_lock<boost::shared_mutex> lock(sparseCriteria_->getGraphMutex());
+    sg_->getQueryStateNonConst(threadID) = candidateD.state_;
+    sg_->getNN()->nearestR(sg_->getQueryVertices(threadID), distance, candidateD.graphNeighborhood_);
+    sg_->getQueryStateNonConst(threadID) = nullptr;
 
-    // Don't collision check if they are the same state
-    if (candidateD.state_ != sg_->getState(v2))
+    for (const SparseVertex &v2 : candidateD.graphNeighborhood_)
     {
-      if (!si_->checkMotion(candidateD.state_, sg_->getState(v2)))
+      // Don't collision check if they are the same state
+      if (candidateD.state_ == sg_->getState(v2))
       {
+        if (vFindGraphNeighbors_)
+          std::cout << " ---- Skipping collision checking because same vertex " << std::endl;
+
+        candidateD.visibleNeighborhood_.push_back(v2);
         continue;
       }
+
+      segments.push_back(MotionSegment(candidateD.state_, sg_->getState(v2)));
+      segmentVertices.push_back(v2);
     }
-    else if (vFindGraphNeighbors_)
-      std::cout << " ---- Skipping collision checking because same vertex " << std::endl;
+  }
 
+  // Check all edges in parallel, the results come back from the closest neighbor to the farthest
+  MotionBatchPtr batch = sparseCriteria_->getBatchMotionValidator()->checkMotions(segments);
+  std::size_t i;
+  bool valid;
+  while (batch->next(i, valid))
+  {
     // The two are visible to each other!
-    candidateD.visibleNeighborhood_.push_back(candidateD.graphNeighborhood_[i]);
+    if (valid)
+      candidateD.visibleNeighborhood_.push_back(segmentVertices[i]);
   }
 
   BOLT_DEBUG(indent, vFindGraphNeighbors_,
@@ -857,6 +1118,20 @@ void SparseGenerator::stopCandidateQueueAndSave(std::size_t indent)
 
   BOLT_FUNC(indent, verbose_, "stopCandidateQueueAndSave()");
 
+  // Saving removes deleted vertices, which would renumber the vertices held by concurrent insertion threads. The graph
+  // is saved once all of them have stopped
+  if (insertionRunning_)
+    return;
+
+  // Neither does low-dispersion sampling, which can be continued from the index reached
+  if (lowDispersionRunning_)
+  {
+    // The state at the current index was just added, so it is part of the saved graph
+    if (sg_->saveIfChanged(indent) && saveLowDispersionIndex(lowDispersionIndex_ + 1, indent))
+      BOLT_INFO(indent, true, "Saved low-dispersion samples up to index " << lowDispersionIndex_);
+    return;
+  }
+
   // Stop and reset the candidate queue because it uses the nearest neighbors and will have bad vertices stored
   candidateQueue_->stopGenerating(indent);
 
@@ -82,6 +82,7 @@ SparseGraph::SparseGraph(base::SpaceInformationPtr si, VisualizerPtr visual)
   , visual_(visual)
   , disjointSets_(boost::get(&SparseVertexStruct::vertex_rank_, g_),
                   boost::get(&SparseVertexStruct::vertex_predecessor_, g_))
+  , modificationCount_(0)
 {
   // Save number of threads available
   numThreads_ = boost::thread::hardware_concurrency();
@@ -91,14 +92,19 @@ SparseGraph::SparseGraph(base::SpaceInformationPtr si, VisualizerPtr visual)
 
   // Saving and loading from file
   sparseStorage_.reset(new SparseStorage(si_, this));
+  edgeValidityCache_.reset(new EdgeValidityCache(si_, this));
+  edgeOccupancyIndex_.reset(new EdgeOccupancyIndex(this));
+
+  // Keep vertex states next to each other in memory
+  stateArena_.reset(new StateArena(si_->getStateSpace()));
+  if (!stateArena_->isSupported())
+    BOLT_WARN(0, true, "State space does not store its values contiguously, state arena disabled");
 
   // Smoothing paths in ideal way for SPARS criteria */
   sparseSmoother_.reset(new SparseSmoother(si_, visual_));
 
-  // Initialize nearest neighbor datastructure
-  // nn_.reset(new NearestNeighborsGNATNoThreadSafety<SparseVertex>());
-  nn_.reset(new NearestNeighborsGNAT<SparseVertex>());
-  nn_->setDistanceFunction(boost::bind(&otb::SparseGraph::distanceFunction, this, _1, _2));
+  // Initialize nearest neighbor datastructure, setup() replaces it if another type is chosen
+  setupNearestNeighbors();
 
   if (superDebug_)
   {
@@ -127,6 +133,55 @@ void SparseGraph::clear()
   initializeQueryState();
 }
 
+void SparseGraph::setupNearestNeighbors(std::size_t indent)
+{
+  BOLT_FUNC(indent, verbose_, "SparseGraph::setupNearestNeighbors() type: " << nearestNeighborsType_);
+
+  FlatMetric metric = FLAT_METRIC_UNKNOWN;
+  if (nearestNeighborsType_ != "gnat")
+  {
+    if (nearestNeighborsType_ != "linear" && nearestNeighborsType_ != "kd_tree")
+    {
+      BOLT_WARN(indent, true, "Unknown nearest neighbors type " << nearestNeighborsType_ << ", using gnat");
+    }
+    else if ((metric = detectFlatMetric(si_->getStateSpace())) == FLAT_METRIC_UNKNOWN)
+    {
+      BOLT_WARN(indent, true, "State space distance is not a norm of the joint values, nearest neighbors type "
+                                  << nearestNeighborsType_ << " is not exact, using gnat");
+    }
+  }
+
+  NearestNeighborsFlat::StateFunction getState = [this](SparseVertex v)
+  {
+    return getVertexOrQueryState(v);
+  };
+  const std::string type = nearestNeighborsType_;
+  base::StateSpacePtr space = si_->getStateSpace();
+  std::function<NearestNeighborsConcurrent::NearestNeighborsPtr()> allocator = [metric, type, space, getState]()
+  {
+    if (metric == FLAT_METRIC_UNKNOWN)
+      return NearestNeighborsConcurrent::NearestNeighborsPtr(new NearestNeighborsGNAT<SparseVertex>());
+    if (type == "linear")
+      return NearestNeighborsConcurrent::NearestNeighborsPtr(new NearestNeighborsFlatLinear(space, metric, getState));
+    return NearestNeighborsConcurrent::NearestNeighborsPtr(new NearestNeighborsFlatKD(space, metric, getState));
+  };
+
+  // Candidate threads search while the main thread inserts, so keep two copies that are updated in turn
+  nn_.reset(new NearestNeighborsConcurrent(allocator));
+  nn_->setDistanceFunction(boost::bind(&otb::SparseGraph::distanceFunction, this, _1, _2));
+
+  // Reinsert existing vertices
+  std::vector<SparseVertex> vertices;
+  foreach (SparseVertex v, boost::vertices(g_))
+  {
+    if (v < getNumQueryVertices() || stateDeleted(v))  // Ignore query and deleted vertices
+      continue;
+    vertices.push_back(v);
+  }
+  if (!vertices.empty())
+    nn_->add(vertices);
+}
+
 void SparseGraph::freeMemory()
 {
   foreach (SparseVertex v, boost::vertices(g_))
@@ -140,12 +195,19 @@ void SparseGraph::freeMemory()
 #endif
 
     // Free states memory
-    if (g_[v].state_ != nullptr)
-      si_->freeState(g_[v].state_);
+    freeVertexState(v);
   }
 
+  // Unmap file that states may have been loaded from
+  sparseStorage_->releaseMappedStates();
+  stateArena_->clear();
+
+  // Recorded changes no longer apply to the emptied graph
+  sparseStorage_->discardJournal();
+
   // Clear vertices and edges
   g_.clear();
+  markModified();
 
   // Clear nearest neighbor
   nn_->clear();
@@ -157,6 +219,8 @@ bool SparseGraph::setup()
 {
   sparseSmoother_->setup();
 
+  setupNearestNeighbors();
+
   base::DiscreteMotionValidator *dmv = dynamic_cast<base::DiscreteMotionValidator *>(si_->getMotionValidator().get());
   dmv->setRequiredStateClearance(0.0);
 
@@ -215,6 +279,13 @@ bool SparseGraph::load(std::size_t indent)
   // Show more data
   printGraphStats();
 
+  // Loaded graphs are mostly searched from now on
+  freezeGraph(indent);
+
+  // Results of collision checking edges in previous sessions
+  if (useEdgeValidityCache_)
+    edgeValidityCache_->load(filePath_, indent);
+
   // Nothing to save because was just loaded from file
   hasUnsavedChanges_ = false;
 
@@ -228,6 +299,10 @@ bool SparseGraph::saveIfChanged(std::size_t indent)
 {
   BOLT_FUNC(indent, true, "SparseGraph::saveIfChanged()");
 
+  // The cache changes while planning even if the graph does not
+  if (useEdgeValidityCache_ && savingEnabled_ && !filePath_.empty())
+    edgeValidityCache_->saveIfChanged(filePath_, indent);
+
   if (hasUnsavedChanges_)
   {
     return save(indent);
@@ -261,6 +336,19 @@ bool SparseGraph::save(std::size_t indent)
     return false;
   }
 
+  // Append only what changed since the last save, until the journal is large enough to fold into a new snapshot
+  if (sparseStorage_->useJournal_ && !sparseStorage_->journalNeedsCompaction(filePath_))
+  {
+    time::point start = time::now();
+    if (!sparseStorage_->appendJournal(filePath_, indent))
+      return false;
+    hasUnsavedChanges_ = false;
+
+    BOLT_INFO(indent, true, "Appended changes to journal in " << time::seconds(time::now() - start)
+                                                              << " seconds. Time: " << time::as_string(time::now()));
+    return true;
+  }
+
   // Always must clear out deleted veritices from graph before saving otherwise NULL state will throw exception
   removeDeletedVertices(indent);
 
@@ -298,12 +386,10 @@ bool SparseGraph::astarSearch(const SparseVertex start, const SparseVertex goal,
     return true;
   }
 
-  // Hold a list of the shortest path parent to each vertex
-  SparseVertex *vertexPredecessors = new SparseVertex[getNumVertices()];
-  // boost::vector_property_map<SparseVertex> vertexPredecessors(getNumVertices());
+  // Holds the shortest path parent and distance of each vertex, reused between searches on this thread
+  SearchWorkspace &workspace = SearchWorkspace::getThreadWorkspace();
 
   bool foundGoal = false;
-  double *vertexDistances = new double[getNumVertices()];
 
 #ifndef NDEBUG
   // Reset statistics
@@ -316,44 +402,25 @@ bool SparseGraph::astarSearch(const SparseVertex start, const SparseVertex goal,
     visual_->viz4()->deleteAllMarkers();
   }
 
-  try
-  {
-    boost::astar_search(g_, start,  // graph, start state
-                        [this, goal](SparseVertex v)
-                        {
-                          return astarHeuristic(v, goal);  // the heuristic
-                        },
-                        // ability to disable edges (set cost to inifinity):
-                        // boost::weight_map(SparseEdgeWeightMap(g_, edgeCollisionStatePropertySparse_))
-                        // popularityBias, popularityBiasEnabled))
-                        boost::weight_map(boost::get(&SparseEdgeStruct::weight_, g_))
-                            .predecessor_map(vertexPredecessors)
-                            .distance_map(&vertexDistances[0])
-                            .visitor(SparseAstarVisitor(goal, this)));
-  }
-  catch (FoundGoalException &)
-  {
-    foundGoal = true;
-  }
+  // Search the frozen copy if it is up to date, its neighbors and weights are contiguous in memory
+  if (frozen_)
+    foundGoal = astarSearchGraph(csr_, boost::get(&SparseCSREdgeStruct::weight_, csr_), start, goal, workspace);
+  else
+    foundGoal = astarSearchGraph(g_, boost::get(&SparseEdgeStruct::weight_, g_), start, goal, workspace);
 
   // Search failed
   if (!foundGoal)
   {
     BOLT_WARN(indent, vSearch_, "Did not find goal");
 
-    // Unload
-    delete[] vertexPredecessors;
-    delete[] vertexDistances;
-
     // No solution found from start to goal
     return false;
   }
 
-  distance = vertexDistances[goal];
+  distance = workspace.getDistance(goal);
 
 #ifndef NDEBUG
-  // the custom exception from SparseAstarVisitor
-  BOLT_DEBUG(indent, vSearch_, "AStar found solution. Distance to goal: " << vertexDistances[goal]);
+  BOLT_DEBUG(indent, vSearch_, "AStar found solution. Distance to goal: " << distance);
 
   BOLT_DEBUG(indent, vSearch_, "Number nodes opened: " << numNodesOpened_
                                                        << ", Number nodes closed: " << numNodesClosed_);
@@ -365,7 +432,7 @@ bool SparseGraph::astarSearch(const SparseVertex start, const SparseVertex goal,
 
   // Trace back the shortest path in reverse and only save the states
   SparseVertex v;
-  for (v = goal; v != vertexPredecessors[v]; v = vertexPredecessors[v])
+  for (v = goal; v != workspace.getPredecessor(v); v = workspace.getPredecessor(v))
     vertexPath.push_back(v);
 
   // Add the start state to the path, unless this path is just one vertex long and the start==goal
@@ -390,7 +457,9 @@ bool SparseGraph::astarSearch(const SparseVertex start, const SparseVertex goal,
     for (std::size_t i = getNumQueryVertices(); i < getNumVertices(); ++i)  // skip query vertices
     {
       const SparseVertex v1 = i;
-      const SparseVertex v2 = vertexPredecessors[v1];
+      if (!workspace.isDiscovered(v1))
+        continue;
+      const SparseVertex v2 = workspace.getPredecessor(v1);
       if (v1 != v2)
       {
         visual_->viz4()->edge(getState(v1), getState(v2), 10);
@@ -400,11 +469,6 @@ bool SparseGraph::astarSearch(const SparseVertex start, const SparseVertex goal,
   }
 #endif
 
-  // Unload
-  delete[] vertexPredecessors;
-  delete[] vertexDistances;
-
-  // No solution found from start to goal
   return foundGoal;
 }
 
@@ -414,10 +478,8 @@ bool SparseGraph::astarSearchLength(SparseVertex start, SparseVertex goal, doubl
 
   bool foundGoal = false;
 
-  // Hold a list of the shortest path parent to each vertex
-  // TODO: reuse this initialized memory!
-  SparseVertex *vertexPredecessors = new SparseVertex[getNumVertices()];
-  double *vertexDistances = new double[getNumVertices()];
+  // Holds the shortest path parent and distance of each vertex, reused between searches on this thread
+  SearchWorkspace &workspace = SearchWorkspace::getThreadWorkspace();
 
   distance = std::numeric_limits<double>::infinity();
 
@@ -432,39 +494,111 @@ bool SparseGraph::astarSearchLength(SparseVertex start, SparseVertex goal, doubl
   }
 #endif
 
-  try
-  {
-    boost::astar_search(g_, start,  // graph, start state
-                        [this, goal](SparseVertex v)
-                        {
-                          return astarHeuristic(v, goal);  // the heuristic
-                        },
-                        // ability to disable edges (set cost to inifinity):
-                        // boost::weight_map(SparseEdgeWeightMap(g_, edgeCollisionStatePropertySparse_))
-                        // popularityBias, popularityBiasEnabled))
-                        boost::weight_map(boost::get(&SparseEdgeStruct::weight_, g_))
-                            .predecessor_map(vertexPredecessors)
-                            .distance_map(&vertexDistances[0])
-                            .visitor(SparseAstarVisitor(goal, this)));
-  }
-  catch (FoundGoalException &)
+  bool reachedGoal;
+  if (frozen_)
+    reachedGoal = astarSearchGraph(csr_, boost::get(&SparseCSREdgeStruct::weight_, csr_), start, goal, workspace);
+  else
+    reachedGoal = astarSearchGraph(g_, boost::get(&SparseEdgeStruct::weight_, g_), start, goal, workspace);
+
+  if (reachedGoal)
   {
-    distance = vertexDistances[goal];
+    distance = workspace.getDistance(goal);
 
-    if (!std::isinf(vertexDistances[goal]))
+    if (!std::isinf(distance))
     {
       foundGoal = true;
     }
   }
 
-  // Unload
-  delete[] vertexPredecessors;
-  delete[] vertexDistances;
-
   // No solution found from start to goal
   return foundGoal;
 }
 
+template <typename Graph, typename WeightMap>
+bool SparseGraph::astarSearchGraph(const Graph &graph, WeightMap weights, SparseVertex start, SparseVertex goal,
+                                   SearchWorkspace &workspace)
+{
+  workspace.reset(getNumVertices());
+  workspace.discover(start, 0, astarHeuristic(start, goal), start);
+
+  SparseVertex v;
+  while (workspace.popOpen(v))
+  {
+#ifndef NDEBUG
+    // Statistics
+    recordNodeClosed();
+    if (visualizeAstar_)
+    {
+      visual_->viz4()->state(getState(v), tools::LARGE, tools::BLACK, 1);
+      visual_->viz4()->trigger();
+      usleep(visualizeAstarSpeed_ * 1000000);
+    }
+#endif
+
+    // The goal has the lowest cost on the open list, so its path is the shortest
+    if (v == goal)
+      return true;
+
+    const double distanceV = workspace.getDistance(v);
+    typename boost::graph_traits<Graph>::out_edge_iterator ei, ei_end;
+    for (boost::tie(ei, ei_end) = boost::out_edges(v, graph); ei != ei_end; ++ei)
+    {
+      const SparseVertex u = boost::target(*ei, graph);
+      if (workspace.isClosed(u))
+        continue;
+
+      const double distanceU = distanceV + get(weights, *ei);
+      if (workspace.isDiscovered(u) && workspace.getDistance(u) <= distanceU)
+        continue;
+
+#ifndef NDEBUG
+      // Statistics
+      if (!workspace.isDiscovered(u))
+      {
+        recordNodeOpened();
+        if (visualizeAstar_)
+          visual_->viz4()->state(getState(u), tools::SMALL, tools::GREEN, 1);
+      }
+#endif
+
+      workspace.discover(u, distanceU, distanceU + astarHeuristic(u, goal), v);
+    }
+  }
+
+  return false;
+}
+
+void SparseGraph::freezeGraph(std::size_t indent)
+{
+  BOLT_FUNC(indent, verbose_, "SparseGraph::freezeGraph()");
+  time::point startTime = time::now();  // Benchmark
+
+  // Store every undirected edge in both directions
+  std::vector<std::pair<SparseVertex, SparseVertex> > endpoints;
+  std::vector<SparseCSREdgeStruct> properties;
+  endpoints.reserve(2 * getNumEdges());
+  properties.reserve(2 * getNumEdges());
+  foreach (const SparseEdge e, boost::edges(g_))
+  {
+    const SparseVertex v1 = boost::source(e, g_);
+    const SparseVertex v2 = boost::target(e, g_);
+    SparseCSREdgeStruct property;
+    property.weight_ = g_[e].weight_;
+
+    endpoints.push_back(std::make_pair(v1, v2));
+    properties.push_back(property);
+    endpoints.push_back(std::make_pair(v2, v1));
+    properties.push_back(property);
+  }
+
+  csr_ = SparseCSRGraph(boost::edges_are_unsorted_multi_pass, endpoints.begin(), endpoints.end(), properties.begin(),
+                        getNumVertices());
+  frozen_ = true;
+
+  BOLT_DEBUG(indent, verbose_, "Froze graph with " << getNumVertices() << " vertices and " << getNumEdges()
+                                                   << " edges in " << time::seconds(time::now() - startTime) << " s");
+}
+
 bool SparseGraph::checkPathLength(SparseVertex v1, SparseVertex v2, std::size_t indent)
 {
   return checkPathLength(v1, v2, si_->distance(getState(v1), getState(v2)), indent);
@@ -474,22 +608,97 @@ bool SparseGraph::checkPathLength(SparseVertex v1, SparseVertex v2, double dista
 {
   static const double SMALL_EPSILON = 0.0001;
 
-  double pathLength;
-  if (!astarSearchLength(v1, v2, pathLength, indent))
-    return true;
-
-  if (pathLength < distance + SMALL_EPSILON)
+  // Only whether a shorter path exists matters, not its length
+  if (hasPathShorterThan(v1, v2, distance + SMALL_EPSILON, indent))
   {
-    BOLT_ERROR(indent, "New interface edge does not help enough, edge length: " << distance << ", astar: " << pathLength
-                                                                                << ", difference between distances: "
-                                                                                << fabs(distance - pathLength));
+    BOLT_ERROR(indent, "New interface edge does not help enough, edge length: " << distance);
     return false;
   }
 
-  BOLT_WARN(indent, false, "Interface edge qualifies - diff: " << (distance + SMALL_EPSILON - pathLength));
+  BOLT_WARN(indent, false, "Interface edge qualifies");
   return true;
 }
 
+bool SparseGraph::hasPathShorterThan(SparseVertex v1, SparseVertex v2, double bound, std::size_t indent)
+{
+  BOLT_FUNC(indent, vSearch_, "SparseGraph::hasPathShorterThan()");
+
+  if (frozen_)
+    return boundedBidirectionalSearch(csr_, boost::get(&SparseCSREdgeStruct::weight_, csr_), v1, v2, bound);
+  return boundedBidirectionalSearch(g_, boost::get(&SparseEdgeStruct::weight_, g_), v1, v2, bound);
+}
+
+template <typename Graph, typename WeightMap>
+bool SparseGraph::boundedBidirectionalSearch(const Graph &graph, WeightMap weights, SparseVertex v1, SparseVertex v2,
+                                             double bound)
+{
+  if (v1 == v2)
+    return bound > 0;
+
+  // Even a straight line is too long
+  const double estimate = astarHeuristic(v1, v2);
+  if (estimate >= bound)
+    return false;
+
+  SearchWorkspace &forward = SearchWorkspace::getThreadWorkspace(0);
+  SearchWorkspace &reverse = SearchWorkspace::getThreadWorkspace(1);
+  forward.reset(getNumVertices());
+  reverse.reset(getNumVertices());
+  forward.discover(v1, 0, estimate, v1);
+  reverse.discover(v2, 0, estimate, v2);
+
+  SparseVertex v;
+  while (true)
+  {
+    // Grow the smaller frontier. Each direction alone would find any short enough path, so once either runs out of
+    // vertices under the bound there is none
+    if (forward.getNumOpen() <= reverse.getNumOpen())
+    {
+      if (!forward.popOpen(v))
+        return false;
+      if (expandBoundedFrontier(graph, weights, v, v2, bound, forward, reverse))
+        return true;
+    }
+    else
+    {
+      if (!reverse.popOpen(v))
+        return false;
+      if (expandBoundedFrontier(graph, weights, v, v1, bound, reverse, forward))
+        return true;
+    }
+  }
+}
+
+template <typename Graph, typename WeightMap>
+bool SparseGraph::expandBoundedFrontier(const Graph &graph, WeightMap weights, SparseVertex v, SparseVertex target,
+                                        double bound, SearchWorkspace &workspace, const SearchWorkspace &other)
+{
+  const double distanceV = workspace.getDistance(v);
+  typename boost::graph_traits<Graph>::out_edge_iterator ei, ei_end;
+  for (boost::tie(ei, ei_end) = boost::out_edges(v, graph); ei != ei_end; ++ei)
+  {
+    const SparseVertex u = boost::target(*ei, graph);
+    if (workspace.isClosed(u))
+      continue;
+
+    const double distanceU = distanceV + get(weights, *ei);
+    if (workspace.isDiscovered(u) && workspace.getDistance(u) <= distanceU)
+      continue;
+
+    // The frontiers meet
+    if (distanceU + other.getDistance(u) < bound)
+      return true;
+
+    // Every path through u is at least this long
+    const double estimateU = distanceU + astarHeuristic(u, target);
+    if (estimateU >= bound)
+      continue;
+
+    workspace.discover(u, distanceU, estimateU, v);
+  }
+  return false;
+}
+
 double SparseGraph::astarHeuristic(SparseVertex a, SparseVertex b) const
 {
   // Assume vertex 'a' is the one we care about its populariy
@@ -762,6 +971,16 @@ bool SparseGraph::sameComponent(SparseVertex v1, SparseVertex v2)
   return boost::same_component(v1, v2, disjointSets_);
 }
 
+bool SparseGraph::sameComponentReadOnly(SparseVertex v1, SparseVertex v2) const
+{
+  // Follow the parents up to the representative of each set
+  while (g_[v1].vertex_predecessor_ != v1)
+    v1 = g_[v1].vertex_predecessor_;
+  while (g_[v2].vertex_predecessor_ != v2)
+    v2 = g_[v2].vertex_predecessor_;
+  return v1 == v2;
+}
+
 void SparseGraph::resetDisjointSets()
 {
   disjointSets_ = SparseDisjointSetType(boost::get(&SparseVertexStruct::vertex_rank_, g_),
@@ -774,7 +993,11 @@ SparseVertex SparseGraph::addVertex(base::State *state, const VertexType &type,
   SparseVertex v = boost::add_vertex(g_);
 
   // Add properties
-  g_[v].state_ = state;
+  g_[v].state_ = adoptState(v, state);
+  markModified();
+
+  // Record for the next incremental save
+  sparseStorage_->journalAddVertex(v);
 
   // Quit early if just mirroring graph
   if (fastMirrorMode_)
@@ -786,17 +1009,14 @@ SparseVertex SparseGraph::addVertex(base::State *state, const VertexType &type,
 // Clear all nearby interface data whenever a new vertex is added
 #ifdef ENABLE_QUALITY
   if (sparseCriteria_ && sparseCriteria_->getUseFourthCriteria())
-    clearInterfaceData(state);
+    clearInterfaceData(g_[v].state_);  // the passed state may have been freed by adoptState()
 #endif
 
   if (sparseCriteria_ && sparseCriteria_->useConnectivityCriteria_)
     disjointSets_.make_set(v);
 
-  // Add vertex to nearest neighbor structure
-  {
-    std::lock_guard<std::mutex> guard(nearestNeighborMutex_);
-    nn_->add(v);
-  }
+  // Add vertex to nearest neighbor structure, does not block threads searching it
+  nn_->add(v);
 
   // Book keeping for what was added
   switch (type)
@@ -850,13 +1070,55 @@ SparseVertex SparseGraph::addVertex(base::State *state, const VertexType &type,
   return v;
 }
 
+void SparseGraph::addVertices(const std::vector<base::State *> &states, const VertexType &type, std::size_t indent)
+{
+  BOLT_FUNC(indent, vAdd_, "SparseGraph::addVertices(): " << states.size() << " vertices, type " << type);
+
+  if (states.empty())
+    return;
+
+  std::vector<SparseVertex> vertices;
+  vertices.reserve(states.size());
+  for (base::State *state : states)
+  {
+    // Create vertex
+    SparseVertex v = boost::add_vertex(g_);
+
+    // Add properties
+    g_[v].state_ = adoptState(v, state);
+
+    // Record for the next incremental save
+    sparseStorage_->journalAddVertex(v);
+
+    if (sparseCriteria_ && sparseCriteria_->useConnectivityCriteria_)
+      disjointSets_.make_set(v);
+
+    // Visualize
+    if (visualizeSparseGraph_)
+      visualizeVertex(v, type);
+
+    vertices.push_back(v);
+  }
+  markModified();
+
+  // Add all vertices to nearest neighbor structure in one change
+  nn_->add(vertices);
+
+  if (visualizeSparseGraph_ && visualizeSparseGraphSpeed_ > std::numeric_limits<double>::epsilon())
+    visual_->viz1()->trigger(visualizeTriggerEvery_);
+
+  // Enable saving
+  hasUnsavedChanges_ = true;
+}
+
 SparseVertex SparseGraph::addVertexFromFile(base::State *state, std::size_t indent)
 {
   // Create vertex
   SparseVertex v = boost::add_vertex(g_);
 
   // Add properties
-  g_[v].state_ = state;
+  g_[v].state_ = adoptState(v, state);
+  markModified();
 
   // Connected component tracking
   if (sparseCriteria_ && sparseCriteria_->useConnectivityCriteria_)
@@ -869,14 +1131,15 @@ void SparseGraph::removeVertex(SparseVertex v, std::size_t indent)
 {
   BOLT_FUNC(indent, verbose_, "SparseGraph::removeVertex = " << v);
 
+  // Record for the next incremental save
+  sparseStorage_->journalRemoveVertex(v);
+  markModified();
+
   // Remove from nearest neighbor
-  {
-    std::lock_guard<std::mutex> guard(nearestNeighborMutex_);
-    nn_->remove(v);
-  }
+  nn_->remove(v);
 
   // Delete state
-  si_->freeState(g_[v].state_);
+  freeVertexState(v);
   g_[v].state_ = nullptr;
 
 #ifdef ENABLE_QUALITY
@@ -901,6 +1164,19 @@ void SparseGraph::removeDeletedVertices(std::size_t indent)
 {
   bool verbose = true;
   BOLT_FUNC(indent, verbose, "SparseGraph::removeDeletedVertices()");
+  markModified();
+
+  // Vertices are about to be renumbered, so move the arena rows to where their vertices will end up
+  SparseVertex newIndex = numThreads_;
+  foreach (SparseVertex v, boost::vertices(g_))
+  {
+    if (v < numThreads_ || stateDeleted(v))
+      continue;
+
+    if (stateArena_->ownsState(v, g_[v].state_))
+      g_[v].state_ = stateArena_->move(v, newIndex);
+    newIndex++;
+  }
 
   // Remove all vertices that are set to 0
   std::size_t numRemoved = 0;
@@ -937,7 +1213,6 @@ void SparseGraph::removeDeletedVertices(std::size_t indent)
   }
 
   // Reset the nearest neighbor tree
-  std::lock_guard<std::mutex> guard(nearestNeighborMutex_);
   nn_->clear();
 
   // Reset disjoint sets
@@ -945,15 +1220,17 @@ void SparseGraph::removeDeletedVertices(std::size_t indent)
     resetDisjointSets();
 
   // Reinsert vertices into nearest neighbor
+  std::vector<SparseVertex> vertices;
   foreach (SparseVertex v, boost::vertices(g_))
   {
     if (v <= queryVertices_.back())  // Ignore query vertices
       continue;
 
-    nn_->add(v);
+    vertices.push_back(v);
     if (sparseCriteria_ && sparseCriteria_->useConnectivityCriteria_)
       disjointSets_.make_set(v);
   }
+  nn_->add(vertices);
 
   // Reinsert edges into disjoint sets
   if (sparseCriteria_ && sparseCriteria_->useConnectivityCriteria_)
@@ -993,6 +1270,10 @@ SparseEdge SparseGraph::addEdge(SparseVertex v1, SparseVertex v2, double weight,
 
   // Weight properties
   g_[e].weight_ = weight;
+  markModified();
+
+  // Record for the next incremental save
+  sparseStorage_->journalAddEdge(v1, v2, weight);
 
   // Quit early if just mirroring graph
   if (fastMirrorMode_)
@@ -1041,11 +1322,14 @@ SparseEdge SparseGraph::addEdgeDummy(std::size_t numVertices)
   SparseVertex dummy2 = numVertices - 1;
 
   std::cout << "edge from  " << dummy1 << " to " << dummy2 << std::endl;
+  markModified();
   return (boost::add_edge(dummy1, dummy2, g_)).first;
 }
 
 void SparseGraph::removeEdge(SparseEdge e, std::size_t indent)
 {
+  markModified();
+  sparseStorage_->journalRemoveEdge(boost::source(e, g_), boost::target(e, g_));
   boost::remove_edge(e, g_);
 }
 
@@ -1102,12 +1386,37 @@ const base::State *SparseGraph::getState(SparseVertex v) const
   return g_[v].state_;
 }
 
+const base::State *SparseGraph::getVertexOrQueryState(SparseVertex v) const
+{
+  if (v < numThreads_)
+    return queryStates_[v];
+  return g_[v].state_;
+}
+
 /** \brief Determine if a vertex has been deleted (but not fully removed yet) */
 bool SparseGraph::stateDeleted(SparseVertex v) const
 {
   return g_[v].state_ == nullptr;
 }
 
+base::State *SparseGraph::adoptState(SparseVertex v, base::State *state)
+{
+  // States viewing into a memory mapped file are already contiguous
+  if (!stateArena_->isSupported() || sparseStorage_->isMappedState(state))
+    return state;
+
+  base::State *arenaState = stateArena_->store(v, state);
+  si_->freeState(state);
+  return arenaState;
+}
+
+void SparseGraph::freeVertexState(SparseVertex v)
+{
+  base::State *state = g_[v].state_;
+  if (state != nullptr && !stateArena_->ownsState(v, state) && !sparseStorage_->isMappedState(state))
+    si_->freeState(state);
+}
+
 SparseVertex SparseGraph::getSparseRepresentative(base::State *state)
 {
   std::vector<SparseVertex> graphNeighbors;
@@ -1149,7 +1458,9 @@ void SparseGraph::clearEdgesNearVertex(SparseVertex vertex, std::size_t indent)
   foreach (SparseVertex v, graphNeighbors)
   {
     // Remove all edges to and from vertex
+    sparseStorage_->journalClearVertex(v);
     boost::clear_vertex(v, g_);
+    markModified();
   }
 
 #ifndef NDEBUG
@@ -1524,39 +1835,3 @@ double SparseGraph::getSparseDelta()
 // BOOST_CONCEPT_ASSERT(
 //                      (boost::ReadablePropertyMapConcept<ompl::tools::bolt::SparseEdgeWeightMap,
 //                      ompl::tools::bolt::SparseEdge>));
-
-// SparseAstarVisitor methods ////////////////////////////////////////////////////////////////////////////
-
-BOOST_CONCEPT_ASSERT((boost::AStarVisitorConcept<otb::SparseAstarVisitor, otb::SparseAdjList>));
-
-otb::SparseAstarVisitor::SparseAstarVisitor(SparseVertex goal, SparseGraph *parent) : goal_(goal), parent_(parent)
-{
-}
-
-#ifndef NDEBUG
-void otb::SparseAstarVisitor::discover_vertex(SparseVertex v, const SparseAdjList &) const
-{
-  // Statistics
-  parent_->recordNodeOpened();
-
-  if (parent_->visualizeAstar_)
-    parent_->getVisual()->viz4()->state(parent_->getState(v), tools::SMALL, tools::GREEN, 1);
-}
-#endif
-
-void otb::SparseAstarVisitor::examine_vertex(SparseVertex v, const SparseAdjList &) const
-{
-#ifndef NDEBUG
-  // Statistics
-  parent_->recordNodeClosed();
-  if (parent_->visualizeAstar_)
-  {
-    parent_->getVisual()->viz4()->state(parent_->getState(v), tools::LARGE, tools::BLACK, 1);
-    parent_->getVisual()->viz4()->trigger();
-    usleep(parent_->visualizeAstarSpeed_ * 1000000);
-  }
-#endif
-
-  if (v == goal_)
-    throw FoundGoalException();
-}
@@ -39,11 +39,14 @@
 // OMPL
 #include <bolt_core/SparseMirror.h>
 #include <bolt_core/SparseCriteria.h>
+#include <bolt_core/SparseStorage.h>
 
 // Boost
 #include <boost/foreach.hpp>
 
 // C++
+#include <cstdio>
+#include <fstream>
 #include <thread>
 
 #define foreach BOOST_FOREACH
@@ -89,16 +92,14 @@ void SparseMirror::mirrorGraphDualArm(base::SpaceInformationPtr dualSpaceInfo,
   BOLT_ASSERT(dualSpaceInfo->getStateSpace()->getDimension() >= monoSI_->getStateSpace()->getDimension() * 2,
               "Number of dimensions in dual space info should be double or more the mono space number of dimension");
 
-  // -----------------------------------------------------------------------------
-  // Create SparseGraph for dual arm
-  SparseGraphPtr dualSG = SparseGraphPtr(new SparseGraph(dualSpaceInfo, visual_));
-  dualSG->setFilePath(outputFile + ".ompl");
-  // Copy settings
-  dualSG->savingEnabled_ = monoSG_->savingEnabled_;
+  if (!monoSG_->savingEnabled_)
+  {
+    BOLT_WARN(indent, true, "Saving is disabled, not mirroring graph");
+    return;
+  }
 
   // -----------------------------------------------------------------------------
   // Load sparse criteria formulas
-  // SparseFormula dualFormulas;
   SparseCriteriaPtr monoSC = monoSG_->getSparseCriteria();
   sparseDelta_ = monoSC->getSparseDelta();
 
@@ -106,319 +107,399 @@ void SparseMirror::mirrorGraphDualArm(base::SpaceInformationPtr dualSpaceInfo,
   assert(sparseDelta_ > 0);
   assert(sparseDelta_ > 0.000000001);  // Sanity check
 
-  // -----------------------------------------------------------------------------
-  // Improve sparsegraph speed
-  dualSG->setFastMirrorMode(true);
-  dualSG->setHasUnsavedChanges(true);  // because this is not automatically enabled when in fast mirror mode
-  BOLT_ASSERT(dualSG->getSparseCriteria() == false, "SparseCriteria should not be initialized so that "
-                                                    "disjoint sets is not used");
-
-  // Visualize
-  if (visualizeMiroring_)
+  const std::string filePath = outputFile + ".ompl";
+  const std::size_t numMonoVertices = monoSG_->getNumVertices();
+  const std::size_t numShards = (numMonoVertices + shardRows_ - 1) / shardRows_;
+  recordLength_ = 1 + dualSpaceInfo->getStateSpace()->getSerializationLength();
+
+  // The left arm state of every pair is one of these, so only mirror them once
+  mirroredStates_.assign(numMonoVertices, NULL);
+  for (SparseVertex v = monoSG_->getNumQueryVertices(); v < numMonoVertices; ++v)
   {
-    visual_->viz1()->deleteAllMarkers();
-    visual_->viz1()->trigger();
+    mirroredStates_[v] = leftArmSpaceInfo->allocState();
+    mirrorState(monoSG_->getState(v), mirroredStates_[v], indent + 2);
   }
 
-  // -----------------------------------------------------------------------------
-  // Insert mono SparseGraph into dual SparseGraph
+  validPairs_.assign(numMonoVertices, std::vector<boost::uint64_t>((numMonoVertices + 63) / 64, 0));
+  rowCounts_.assign(numMonoVertices, 0);
+  skippedStates_ = 0;
+  skippedCollisionEdges_ = 0;
+  skippedTooLongEdges_ = 0;
 
-  // Map from every sparseV1 vertex to every vertex in the new graph that has the same roots
-  std::vector<std::vector<SparseVertex>> vertexMapMatrix(monoSG_->getNumVertices());
+  // -----------------------------------------------------------------------------
+  // Combine every pair of vertices, each shard writes the valid ones to its own file
+  BOLT_INFO(indent, true, "Combining " << monoSG_->getNumRealVertices() << " sparse graph vertices with their mirror "
+                                                                           "in "
+                                       << numShards << " shards");
+  numRowsDone_ = 0;
+  const bool verticesDone = runShards(numShards, [&](std::size_t shard)
+                                      {
+                                        mirrorVerticesShard(shard, dualSpaceInfo, filePath, indent + 2);
+                                      });
 
-  // Allocate memory for copying the mirrored version of state2
-  base::State *state2Mirrored = leftArmSpaceInfo->getStateSpace()->allocState();
+  // Free memory
+  for (base::State *state : mirroredStates_)
+    if (state)
+      leftArmSpaceInfo->freeState(state);
+  mirroredStates_.clear();
 
-  // Loop through every vertex in sparse graph
-  BOLT_DEBUG(indent, true, "Adding " << monoSG_->getNumVertices() << " sparse graph vertices into dual arm "
-                                                                     "graph");
-  std::size_t showEvery = std::max((unsigned int)(1), monoSG_->getNumVertices() / 100);
-  foreach (SparseVertex sparseV1, boost::vertices(monoSG_->getGraph()))
+  // Do not save a dual graph that is missing vertices
+  if (!verticesDone)
   {
-    // The first thread number of verticies are used for queries and should be skipped
-    if (sparseV1 < monoSG_->getNumQueryVertices())
-      continue;
+    BOLT_WARN(indent, true, "Shutdown requested, not saving the partially mirrored graph");
+    removeShards(filePath, numShards, "vertices");
+    return;
+  }
 
-    BOLT_INFO(indent + 2, (sparseV1 % showEvery == 0) || true,
-              "Mirroring graph progress: " << (double(sparseV1) / monoSG_->getNumVertices() * 100.0)
-                                           << "%. Dual graph verticies: " << dualSG->getNumVertices()
-                                           << ", Dual graph edges: " << dualSG->getNumEdges());
+  // Rows are stored in order, so the index of a dual vertex follows from the sizes of the rows before it
+  rowOffsets_.assign(numMonoVertices + 1, 0);
+  for (std::size_t i = 0; i < numMonoVertices; ++i)
+    rowOffsets_[i + 1] = rowOffsets_[i] + rowCounts_[i];
+  const std::size_t numDualVertices = rowOffsets_.back();
 
-    const base::State *state1 = monoSG_->getState(sparseV1);
-    if (visualizeMiroring_)
-      visual_->viz1()->state(state1, tools::ROBOT, tools::DEFAULT, 0);
+  BOLT_DEBUG(indent, vMirrorStatus_, "Total states skipped: " << skippedStates_ << " out of "
+                                                              << numDualVertices + skippedStates_);
 
-    // Record a mapping from the old vertex index to the new index
-    std::vector<SparseVertex> sparseV2ToDualVertex(monoSG_->getNumVertices(), /*initial value*/ 0);
+  // -----------------------------------------------------------------------------
+  // Save an empty dual graph, the generated vertices and edges are replayed on top of it from its journal
+  SparseGraphPtr dualSG = SparseGraphPtr(new SparseGraph(dualSpaceInfo, visual_));
+  dualSG->setFilePath(filePath);
+  dualSG->savingEnabled_ = true;
+  dualSG->setHasUnsavedChanges(true);
+  dualSG->save(indent);
+  dualSG->getSparseStorage()->waitForCompaction();
 
-    // Loop through every vertex again
-    std::size_t skippedStates = 0;
-    foreach (SparseVertex sparseV2, boost::vertices(monoSG_->getGraph()))
+  // A dual graph that is missing part of its journal must not be loaded later
+  const std::string journalPath = dualSG->getSparseStorage()->getJournalPath(filePath);
+  auto removeDualGraph = [&]()
+  {
+    std::remove(journalPath.c_str());
+    std::remove(filePath.c_str());
+  };
+
+  {
+    SparseStorage::JournalHeader h;
+    h.marker = BOLT_JOURNAL_MARKER;
+    h.version = BOLT_JOURNAL_VERSION;
+    h.baseVertexCount = 0;
+    h.baseEdgeCount = 0;
+    h.stateLength = recordLength_ - 1;
+
+    std::ofstream journal(journalPath.c_str(), std::ios::binary);
+    journal.write(reinterpret_cast<const char *>(&h), sizeof(SparseStorage::JournalHeader));
+    std::size_t numBytes;
+    if (!appendShards(journal, filePath, numShards, "vertices", numBytes, indent))
     {
-      // The first thread number of verticies are used for queries and should be skipped
-      if (sparseV2 < monoSG_->getNumQueryVertices())
-        continue;
+      BOLT_ERROR(indent, "Unable to write the vertices of the dual graph journal " << journalPath);
+      journal.close();
+      removeDualGraph();
+      return;
+    }
+  }
 
-      const base::State *state2 = monoSG_->getState(sparseV2);
-      mirrorState(state2, state2Mirrored, indent + 2);
+  // -----------------------------------------------------------------------------
+  // Connect the rows, reading the combined states back from the journal instead of keeping them
+  BOLT_INFO(indent, true, "Connecting " << numDualVertices << " dual graph vertices");
+  numRowsDone_ = 0;
+  const bool edgesDone = runShards(numShards, [&](std::size_t shard)
+                                   {
+                                     mirrorEdgesShard(shard, dualSpaceInfo, filePath, indent + 2);
+                                   });
+  if (!edgesDone)
+  {
+    BOLT_WARN(indent, true, "Shutdown requested, not saving the partially mirrored graph");
+    removeShards(filePath, numShards, "edges");
+    removeDualGraph();
+    return;
+  }
 
-      if (visualizeMiroring_)
-        visual_->viz2()->state(state2Mirrored, tools::ROBOT, tools::DEFAULT, /*extraData*/ 0, leftArmSpaceInfo);
+  std::size_t numDualEdges = 0;
+  {
+    std::ofstream journal(journalPath.c_str(), std::ios::binary | std::ios::app);
+    std::size_t numBytes;
+    if (!appendShards(journal, filePath, numShards, "edges", numBytes, indent))
+    {
+      BOLT_ERROR(indent, "Unable to write the edges of the dual graph journal " << journalPath);
+      journal.close();
+      removeDualGraph();
+      return;
+    }
+    numDualEdges = numBytes / (1 + 2 * sizeof(boost::uint64_t) + sizeof(float));
+  }
+
+  validPairs_.clear();
+  rowCounts_.clear();
+  rowOffsets_.clear();
 
+  BOLT_DEBUG(indent, vMirrorStatus_, "Skipped " << skippedCollisionEdges_ << " edges due to collision, "
+                                                << skippedTooLongEdges_ << " due to length");
+  BOLT_INFO(indent, true, "Saved dual graph with " << numDualVertices << " vertices and " << numDualEdges
+                                                   << " edges to " << filePath);
+}
+
+void SparseMirror::mirrorVerticesShard(std::size_t shard, base::SpaceInformationPtr dualSpaceInfo,
+                                       const std::string &filePath, std::size_t indent)
+{
+  std::ofstream out(getShardPath(filePath, shard, "vertices").c_str(), std::ios::binary);
+  std::vector<unsigned char> record(recordLength_);
+  record[0] = SparseStorage::JOURNAL_ADD_VERTEX;
+
+  const std::size_t numMonoVertices = monoSG_->getNumVertices();
+  const std::size_t showEvery = std::max(std::size_t(1), numMonoVertices / 100);
+  const SparseVertex endV1 = std::min((shard + 1) * shardRows_, numMonoVertices);
+  for (SparseVertex sparseV1 = shard * shardRows_; sparseV1 < endV1; ++sparseV1)
+  {
+    // The first thread number of verticies are used for queries and should be skipped
+    if (sparseV1 < monoSG_->getNumQueryVertices())
+      continue;
+
+    const base::State *state1 = monoSG_->getState(sparseV1);
+    for (SparseVertex sparseV2 = monoSG_->getNumQueryVertices(); sparseV2 < numMonoVertices; ++sparseV2)
+    {
       // Create dual state via callback
-      base::State *stateCombined = combineStatesCallback_(state1, state2Mirrored);
+      base::State *stateCombined = combineStatesCallback_(state1, mirroredStates_[sparseV2]);
 
       // Check that new state is still valid
       if (collisionCheckMirror_ && !dualSpaceInfo->isValid(stateCombined))
       {
-        BOLT_DEBUG(indent + 2, vMirror_, "found invalid combined state");
-
-        if (visualizeMiroring_)
-        {
-          visual_->viz3()->state(stateCombined, tools::ROBOT, tools::RED, /*extraData*/ 0, dualSpaceInfo);
-
-          visual_->waitForUserFeedback("found invalid combined state");
-        }
-
-        skippedStates++;
+        BOLT_DEBUG(indent, vMirror_, "found invalid combined state");
+        dualSpaceInfo->freeState(stateCombined);
+        skippedStates_++;
         continue;
       }
-      else  // show valid robot
-      {
-        // visual_->viz3()->state(stateCombined, tools::ROBOT, tools::DEFAULT, /*extraData*/ 0, dualSpaceInfo);
-        // usleep(0.001*1000000);
-      }
 
-      // Insert into new graph
-      SparseVertex vertexCombined = dualSG->addVertex(stateCombined, DISCRETIZED, indent + 2);
+      dualSpaceInfo->getStateSpace()->serialize(&record[1], stateCombined);
+      out.write(reinterpret_cast<const char *>(&record[0]), record.size());
+      dualSpaceInfo->freeState(stateCombined);
 
-      // Short term mapping
-      sparseV2ToDualVertex[sparseV2] = vertexCombined;
+      validPairs_[sparseV1][sparseV2 / 64] |= boost::uint64_t(1) << (sparseV2 % 64);
+      rowCounts_[sparseV1]++;
     }
-    BOLT_DEBUG(indent + 2, vMirrorStatus_,
-               "Total states skipped: " << (double(skippedStates) / monoSG_->getNumVertices() * 100) << "%. Skipped "
-                                        << skippedStates << " states out of total " << monoSG_->getNumVertices());
-    // visual_->waitForUserFeedback("before adding edges");
 
-    // Copy the short term mapping into the long term mapping
-    vertexMapMatrix[sparseV1] = sparseV2ToDualVertex;
-
-    // Loop through every edge in sparse graph and connect this subgraph
-    addEdgesForDim(sparseV2ToDualVertex, dualSG, dualSpaceInfo, indent + 2);
-
-    // visual_->waitForUserFeedback("Done copying edges for inner loop");
+    const std::size_t rowsDone = ++numRowsDone_;
+    BOLT_INFO(indent, rowsDone % showEvery == 0,
+              "Mirroring vertices progress: " << (double(rowsDone) / numMonoVertices * 100.0) << "%");
+  }
+}
 
-    if (visual_->viz1()->shutdownRequested())
-      break;
-  }  // end foreach vertex
+void SparseMirror::mirrorEdgesShard(std::size_t shard, base::SpaceInformationPtr dualSpaceInfo,
+                                    const std::string &filePath, std::size_t indent)
+{
+  const SparseAdjList &g = monoSG_->getGraph();
+  const std::size_t numMonoVertices = monoSG_->getNumVertices();
 
-  // Free memory
-  leftArmSpaceInfo->getStateSpace()->freeState(state2Mirrored);
+  std::ifstream journal(monoSG_->getSparseStorage()->getJournalPath(filePath).c_str(), std::ios::binary);
+  std::ofstream out(getShardPath(filePath, shard, "edges").c_str(), std::ios::binary);
 
-  if (visual_->viz1()->shutdownRequested())
-    return;
+  // States of the row being connected, and of a neighboring row
+  std::vector<base::State *> states1(numMonoVertices), states2(numMonoVertices);
+  std::vector<std::size_t> indices1(numMonoVertices), indices2(numMonoVertices);
+  for (std::size_t i = 0; i < numMonoVertices; ++i)
+  {
+    states1[i] = dualSpaceInfo->allocState();
+    states2[i] = dualSpaceInfo->allocState();
+  }
 
-  BOLT_INFO(indent, true, "Done generating intial copy of graphs (but not interconnected edges).");
+  auto writeEdge = [&](std::size_t v1, std::size_t v2, double distance)
+  {
+    const boost::uint8_t type = SparseStorage::JOURNAL_ADD_EDGE;
+    const boost::uint64_t index1 = v1, index2 = v2;
+    const float weight = distance;
+    out.write(reinterpret_cast<const char *>(&type), sizeof(type));
+    out.write(reinterpret_cast<const char *>(&index1), sizeof(index1));
+    out.write(reinterpret_cast<const char *>(&index2), sizeof(index2));
+    out.write(reinterpret_cast<const char *>(&weight), sizeof(weight));
+  };
+
+  const std::size_t showEvery = std::max(std::size_t(1), numMonoVertices / 100);
+  const SparseVertex endV1 = std::min((shard + 1) * shardRows_, numMonoVertices);
+  for (SparseVertex sparseV1 = shard * shardRows_; sparseV1 < endV1; ++sparseV1)
+  {
+    if (sparseV1 < monoSG_->getNumQueryVertices() || !rowCounts_[sparseV1])
+      continue;
 
-  // Save graph
-  // dualSG->save(indent);
+    readRow(journal, sparseV1, dualSpaceInfo, states1, indices1);
 
-  // Add all cross edges
-  addEdgesForAll(vertexMapMatrix, dualSG, dualSpaceInfo, indent);
+    // The left arm moves along every edge of the sparse graph while the right arm stays
+    foreach (const SparseEdge sparseE, boost::edges(g))
+    {
+      const SparseVertex sparseE_v0 = boost::source(sparseE, g);
+      const SparseVertex sparseE_v1 = boost::target(sparseE, g);
+      if (sparseE_v0 < monoSG_->getNumQueryVertices() || sparseE_v1 < monoSG_->getNumQueryVertices() ||
+          !isPairValid(sparseV1, sparseE_v0) || !isPairValid(sparseV1, sparseE_v1))
+        continue;
 
-  // Save graph
-  dualSG->save(indent);
-}
+      // Check if edge is too long
+      double newEdgeDist = monoSI_->distance(states1[sparseE_v0], states1[sparseE_v1]);
+      if (newEdgeDist > 2 * sparseDelta_)
+      {
+        BOLT_WARN(indent, vMirror_, "Edge is longer than 2*sparseDelta=" << 2 * sparseDelta_
+                                                                          << ", value=" << newEdgeDist);
+        skippedTooLongEdges_++;
+        continue;
+      }
 
-void SparseMirror::addEdgesForDim(std::vector<SparseVertex> &sparseV2ToDualVertex, SparseGraphPtr &dualSG,
-                                  base::SpaceInformationPtr dualSpaceInfo, std::size_t indent)
-{
-  BOLT_FUNC(indent, verbose_, "addEdgesForDim");
+      // Check if edge is in collision
+      if (collisionCheckMirror_ && !dualSpaceInfo->checkMotion(states1[sparseE_v0], states1[sparseE_v1]))
+      {
+        BOLT_DEBUG(indent, vMirror_, "found collision combined state");
+        skippedCollisionEdges_++;
+        continue;
+      }
 
-  // Loop through every edge in sparse graph and connect this subgraph
-  std::size_t skippedUnconnectedEdges = 0;
-  std::size_t skippedCollisionEdges = 0;
-  std::size_t skippedTooLongEdges = 0;
-  foreach (const SparseEdge sparseE, boost::edges(monoSG_->getGraph()))
-  {
-    const SparseVertex sparseE_v0 = sparseV2ToDualVertex[boost::source(sparseE, monoSG_->getGraph())];
-    const SparseVertex sparseE_v1 = sparseV2ToDualVertex[boost::target(sparseE, monoSG_->getGraph())];
-    if (sparseE_v0 == 0 || sparseE_v1 == 0)
-    {
-      skippedUnconnectedEdges++;
-      continue;
+      writeEdge(indices1[sparseE_v0], indices1[sparseE_v1], newEdgeDist);
     }
 
-    // Check if edge is too long
-    double newEdgeDist = monoSI_->distance(dualSG->getState(sparseE_v0), dualSG->getState(sparseE_v1));
-    if (newEdgeDist > 2 * sparseDelta_)
+    // The right arm moves along each of its edges, to a higher index vertex so that every edge is only used once,
+    // while the left arm moves to any nearby vertex
+    foreach (const SparseVertex sparseV1Next, boost::adjacent_vertices(sparseV1, g))
     {
-      BOLT_WARN(indent, true, "Edge is longer than 2*sparseDelta=" << 2 * sparseDelta_ << ", value=" << newEdgeDist);
-      visual_->waitForUserFeedback("edge is too long");
-      skippedTooLongEdges++;
-      continue;
-    }
+      if (sparseV1Next <= sparseV1 || !rowCounts_[sparseV1Next])
+        continue;
 
-    // Check if edge is in collision
-    if (collisionCheckMirror_ &&
-        !dualSpaceInfo->checkMotion(dualSG->getState(sparseE_v0), dualSG->getState(sparseE_v1)))
-    {
-      BOLT_DEBUG(indent, vMirror_, "found collision combined state");
+      readRow(journal, sparseV1Next, dualSpaceInfo, states2, indices2);
 
-      if (vMirror_)
+      for (SparseVertex sparseV2 = monoSG_->getNumQueryVertices(); sparseV2 < numMonoVertices; ++sparseV2)
       {
-        visual_->viz3()->state(dualSG->getState(sparseE_v0), tools::ROBOT, tools::RED, /*extraData*/ 0, dualSpaceInfo);
-        usleep(0.001 * 1000000);
-        visual_->waitForUserFeedback("found collision combined state");
-      }
+        if (!isPairValid(sparseV1, sparseV2))
+          continue;
 
-      skippedCollisionEdges++;
-      continue;
+        for (SparseVertex sparseV2Next = monoSG_->getNumQueryVertices(); sparseV2Next < numMonoVertices;
+             ++sparseV2Next)
+        {
+          if (!isPairValid(sparseV1Next, sparseV2Next))
+            continue;
+
+          // Check if edge is too long
+          double newEdgeDist = monoSI_->distance(states1[sparseV2], states2[sparseV2Next]);
+          if (newEdgeDist > sparseDelta_)
+          {
+            skippedTooLongEdges_++;
+            continue;
+          }
+
+          writeEdge(indices1[sparseV2], indices2[sparseV2Next], newEdgeDist);
+        }
+      }
     }
 
-    // Create edge
-    // dualSG->visualizeSparseGraph_ = true;
-    // dualSG->visualizeSparseGraphSpeed_ = 0.001;
-    // dualSG->visualizeDatabaseVertices_ = false;
-    // dualSG->visualizeDatabaseEdges_ = true;
-    dualSG->addEdge(sparseE_v0, sparseE_v1, newEdgeDist, eUNKNOWN, indent);
+    const std::size_t rowsDone = ++numRowsDone_;
+    BOLT_INFO(indent, rowsDone % showEvery == 0,
+              "Mirroring edges progress: " << (double(rowsDone) / numMonoVertices * 100.0) << "%");
   }
 
-  BOLT_DEBUG(indent, vMirrorStatus_,
-             "Total edges skipped: " << (double(skippedUnconnectedEdges + skippedCollisionEdges) /
-                                         monoSG_->getNumEdges() * 100)
-                                     << "%. Skipped edges: " << skippedUnconnectedEdges << " no endpoints, "
-                                     << skippedCollisionEdges << " collision, " << skippedTooLongEdges << " length, "
-                                     << "out of total: " << monoSG_->getNumEdges());
+  // Free memory
+  for (std::size_t i = 0; i < numMonoVertices; ++i)
+  {
+    dualSpaceInfo->freeState(states1[i]);
+    dualSpaceInfo->freeState(states2[i]);
+  }
 }
 
-void SparseMirror::addEdgesForAll(std::vector<std::vector<SparseVertex>> &vertexMapMatrix, SparseGraphPtr dualSG,
-                                  base::SpaceInformationPtr dualSpaceInfo, std::size_t indent)
+void SparseMirror::readRow(std::istream &journal, SparseVertex rightV, base::SpaceInformationPtr dualSpaceInfo,
+                           std::vector<base::State *> &states, std::vector<std::size_t> &indices)
 {
-  BOLT_FUNC(indent, true, "addEdgesForAll()");
-
-  // Add all edges across each dimension
-  // Loop through every edge in sparse graph and connect this subgraph
-  std::size_t skippedDuplicateEdges = 0;
-  std::size_t skippedTooLongEdges = 0;
-  std::size_t skippedAstarPath = 0;
-  std::size_t skippedCollisionEdges = 0;
-  std::size_t skippedUnconnectedEdges = 0;
-  std::size_t addedPath = 0;
-  std::size_t count = 1;
-  const std::size_t showEvery = std::max((unsigned int)(1), monoSG_->getNumEdges() / 100);
-
-  // Cache graph size before we begin growing it
-  std::size_t numDualVertices = dualSG->getNumVertices();
-
-  foreach (const SparseEdge sparseE, boost::edges(monoSG_->getGraph()))
-  {
-    const SparseVertex sparseE_v0 = boost::source(sparseE, monoSG_->getGraph());
-    const SparseVertex sparseE_v1 = boost::target(sparseE, monoSG_->getGraph());
+  std::vector<unsigned char> buffer(rowCounts_[rightV] * recordLength_);
+  journal.seekg(sizeof(SparseStorage::JournalHeader) + rowOffsets_[rightV] * recordLength_);
+  journal.read(reinterpret_cast<char *>(&buffer[0]), buffer.size());
 
-    // Duplicate this edge for all verticies derived from this pair of vertices
-    for (const SparseVertex dualVertex0 : vertexMapMatrix[sparseE_v0])
-    {
-      BOLT_ASSERT(dualVertex0 < numDualVertices, "dualVertex0 out of range");
-
-      // if (dualVertex0 == 0)
-      // {
-      //   skippedUnconnectedEdges++;
-      //   continue;
-      // }
+  std::size_t record = 0;
+  for (SparseVertex leftV = monoSG_->getNumQueryVertices(); leftV < monoSG_->getNumVertices(); ++leftV)
+  {
+    if (!isPairValid(rightV, leftV))
+      continue;
 
-      // The first thread number of verticies are used for queries and should be skipped
-      if (dualVertex0 < dualSG->getNumQueryVertices())
-        continue;
+    dualSpaceInfo->getStateSpace()->deserialize(states[leftV], &buffer[record * recordLength_ + 1]);
+    indices[leftV] = rowOffsets_[rightV] + record;
+    record++;
+  }
+}
 
-      for (const SparseVertex dualVertex1 : vertexMapMatrix[sparseE_v1])
-      {
-        BOLT_ASSERT(dualVertex1 < numDualVertices, "dualVertex1 out of range");
+bool SparseMirror::runShards(std::size_t numShards, const std::function<void(std::size_t)> &processShard)
+{
+  const std::size_t numThreads =
+      numThreads_ ? numThreads_ : std::max(std::size_t(1), std::size_t(std::thread::hardware_concurrency()));
 
-        // if (dualVertex1 == 0)
-        // {
-        //   skippedUnconnectedEdges++;
-        //   continue;
-        // }
+  std::atomic<std::size_t> nextShard(0);
+  std::atomic<bool> interrupted(false);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < std::min(numThreads, numShards); ++i)
+  {
+    threads.push_back(std::thread([&]()
+                                  {
+                                    for (std::size_t shard = nextShard++; shard < numShards; shard = nextShard++)
+                                    {
+                                      if (visual_->viz1()->shutdownRequested())
+                                      {
+                                        interrupted = true;
+                                        break;
+                                      }
+                                      processShard(shard);
+                                    }
+                                  }));
+  }
+  for (std::thread &thread : threads)
+    thread.join();
 
-        // The first thread number of verticies are used for queries and should be skipped
-        if (dualVertex1 < dualSG->getNumQueryVertices())
-          continue;
+  return !interrupted;
+}
 
-        // Check duplicate
-        // time::point startTime0 = time::now(); // Benchmark
-        if (dualSG->hasEdge(dualVertex0, dualVertex1))
-        {
-          skippedDuplicateEdges++;
-          continue;
-        }
-        // OMPL_INFORM("duplicate took %f seconds", time::seconds(time::now() - startTime0)); // Benchmark
-
-        // Check if edge is too long
-        // time::point startTime1 = time::now(); // Benchmark
-        double newEdgeDist = monoSI_->distance(dualSG->getState(dualVertex0), dualSG->getState(dualVertex1));
-        bool useHalfOfSparseDelta = true;
-        if ((useHalfOfSparseDelta && newEdgeDist > sparseDelta_) ||
-            (!useHalfOfSparseDelta && newEdgeDist > 2 * sparseDelta_))
-        {
-          BOLT_WARN(indent, false, "Edge is longer than 2*sparseDelta=" << 2 * sparseDelta_
-                                                                        << ", value=" << newEdgeDist);
-          skippedTooLongEdges++;
-          continue;
-        }
-        // OMPL_INFORM("length    took %f seconds", time::seconds(time::now() - startTime1)); // Benchmark
-
-        // Check if there already is a path of equal distance in graph
-        // time::point startTime2 = time::now(); // Benchmark
-        // if (!dualSG->checkPathLength(dualVertex0, dualVertex1, newEdgeDist, indent))
-        // {
-        //   //BOLT_WARN(indent, true, "There is already a path through graph the same length or shorter");
-        //   skippedAstarPath++;
-        //   continue;
-        // }
-        // //OMPL_INFORM("astar     took %f seconds", time::seconds(time::now() - startTime2)); // Benchmark
-
-        // Check if edge is in collision
-        // time::point startTime3 = time::now(); // Benchmark
-        if (false && collisionCheckMirror_ &&
-            !dualSpaceInfo->checkMotion(dualSG->getState(dualVertex0), dualSG->getState(dualVertex1)))
-        {
-          skippedCollisionEdges++;
-          continue;
-        }
-        // OMPL_INFORM("collision took %f seconds", time::seconds(time::now() - startTime3)); // Benchmark
+bool SparseMirror::appendShards(std::ofstream &journal, const std::string &filePath, std::size_t numShards,
+                                const std::string &type, std::size_t &numBytes, std::size_t indent)
+{
+  numBytes = 0;
+  std::vector<char> buffer(1 << 20);
+  bool success = journal.good();
+  for (std::size_t shard = 0; shard < numShards; ++shard)
+  {
+    const std::string shardPath = getShardPath(filePath, shard, type);
 
-        // Create edge
-        dualSG->addEdge(dualVertex0, dualVertex1, newEdgeDist, eUNKNOWN, indent);
-        addedPath++;
-      }
+    // Every shard writes its file, even if it has no records
+    std::ifstream in(shardPath.c_str(), std::ios::binary | std::ios::ate);
+    const std::streamoff size = in ? static_cast<std::streamoff>(in.tellg()) : -1;
+    if (size < 0)
+    {
+      BOLT_ERROR(indent, "Unable to read shard " << shardPath);
+      success = false;
+    }
 
-      if (visual_->viz1()->shutdownRequested())
+    // Copy in chunks and check both streams, an empty or failed read would otherwise fail the journal silently
+    in.seekg(0);
+    std::streamoff remaining = success ? size : 0;
+    while (remaining > 0)
+    {
+      in.read(&buffer[0], std::min<std::streamoff>(remaining, buffer.size()));
+      journal.write(&buffer[0], in.gcount());
+      remaining -= in.gcount();
+      if (!in || !journal.good())
         break;
     }
+    if (success && (remaining != 0 || !journal.good()))
+    {
+      BOLT_ERROR(indent, "Unable to append shard " << shardPath << " to the journal, " << remaining
+                                                   << " bytes were not copied");
+      success = false;
+    }
+    if (success)
+      numBytes += size;
 
-    // clang-format off
-    BOLT_DEBUG(indent, (count % showEvery == 0),
-               "Mirror edge " << count << " of " << monoSG_->getNumEdges() << " ("
-               << int(ceil(double(count) / monoSG_->getNumEdges() * 100)) << "%). Skipped -"
-               << " dup: " << skippedDuplicateEdges
-               << ", unconnected: " << skippedUnconnectedEdges
-               << ", length: " << skippedTooLongEdges
-               << ", astar: " << skippedAstarPath
-               << ", collision: " << skippedCollisionEdges
-               << ", ADDED: " << addedPath
-               << ", Total edge: " << dualSG->getNumEdges());
-    // clang-format on
-
-    count++;  // Status
-
-    if (visual_->viz1()->shutdownRequested())
-      break;
+    in.close();
+    std::remove(shardPath.c_str());
   }
 
-  BOLT_DEBUG(indent, vMirrorStatus_, "Skipped " << skippedDuplicateEdges << " edges because duplicate, "
-                                                << skippedCollisionEdges
-                                                << " due to collision, out of total: " << monoSG_->getNumEdges());
+  journal.flush();
+  return success && journal.good();
+}
+
+void SparseMirror::removeShards(const std::string &filePath, std::size_t numShards, const std::string &type) const
+{
+  for (std::size_t shard = 0; shard < numShards; ++shard)
+    std::remove(getShardPath(filePath, shard, type).c_str());
+}
+
+std::string SparseMirror::getShardPath(const std::string &filePath, std::size_t shard, const std::string &type) const
+{
+  return filePath + ".shard" + std::to_string(shard) + "." + type;
 }
 
 // TODO: convert this function into a callback that is application specific
@@ -45,6 +45,13 @@
 #include <boost/foreach.hpp>
 #include <boost/thread.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
 // Profiling
 #include <valgrind/callgrind.h>
@@ -61,8 +68,115 @@ SparseStorage::SparseStorage(const base::SpaceInformationPtr &si, SparseGraph *s
   : si_(si), sparseGraph_(sparseGraph)
 {
   numQueryVertices_ = boost::thread::hardware_concurrency();
+  numLoadThreads_ = std::max(1u, boost::thread::hardware_concurrency());
+}
+
+SparseStorage::~SparseStorage()
+{
+  waitForCompaction();
+  releaseMappedStates();
+}
+
+namespace
+{
+/** \brief Round a byte offset up so that the following block is aligned for doubles */
+boost::uint64_t alignFlatOffset(boost::uint64_t offset)
+{
+  return (offset + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+}
+
+/** \brief Write zeros until the stream reaches the requested byte offset */
+void padFlatStream(std::ostream &out, boost::uint64_t &position, boost::uint64_t offset)
+{
+  static const char zeros[sizeof(double)] = {};
+  out.write(zeros, offset - position);
+  position = offset;
+}
+
+/** \brief Read the first four bytes of a file, which identify the format it was saved in */
+boost::uint32_t readFileMarker(const std::string &filePath)
+{
+  std::ifstream in(filePath.c_str(), std::ios::binary);
+  boost::uint32_t marker = 0;
+  in.read(reinterpret_cast<char *>(&marker), sizeof(marker));
+  return in.good() ? marker : 0;
+}
+
+/** \brief Append an unsigned integer using 7 bits per byte, the high bit marks that more bytes follow */
+void writeVarint(std::vector<unsigned char> &buffer, boost::uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    buffer.push_back(static_cast<unsigned char>(value | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back(static_cast<unsigned char>(value));
+}
+
+/** \brief Decode an integer written with writeVarint() and advance \e data, returns false if \e end is reached */
+bool readVarint(const unsigned char *&data, const unsigned char *end, boost::uint64_t &value)
+{
+  value = 0;
+  for (std::size_t shift = 0; data < end && shift < 64; shift += 7)
+  {
+    const unsigned char byte = *data++;
+    value |= static_cast<boost::uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
 }
 
+/** \brief Store a quantized joint value using \e numBytes bytes */
+void writeFixedPoint(unsigned char *data, boost::uint32_t value, std::size_t numBytes)
+{
+  if (numBytes == 1)
+    *data = static_cast<boost::uint8_t>(value);
+  else if (numBytes == 2)
+  {
+    boost::uint16_t shortValue = static_cast<boost::uint16_t>(value);
+    std::memcpy(data, &shortValue, sizeof(shortValue));
+  }
+  else
+    std::memcpy(data, &value, sizeof(value));
+}
+
+/** \brief Read a quantized joint value written with writeFixedPoint() */
+boost::uint32_t readFixedPoint(const unsigned char *data, std::size_t numBytes)
+{
+  if (numBytes == 1)
+    return *data;
+  if (numBytes == 2)
+  {
+    boost::uint16_t shortValue;
+    std::memcpy(&shortValue, data, sizeof(shortValue));
+    return shortValue;
+  }
+  boost::uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+/** \brief Append the raw bytes of \e value to a journal record */
+template <typename T>
+void appendJournalValue(std::vector<unsigned char> &buffer, const T &value)
+{
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+/** \brief Read a value written with appendJournalValue() and advance \e data, returns false if \e end is reached */
+template <typename T>
+bool readJournalValue(const unsigned char *&data, const unsigned char *end, T &value)
+{
+  if (end - data < static_cast<std::ptrdiff_t>(sizeof(T)))
+    return false;
+  std::memcpy(&value, data, sizeof(T));
+  data += sizeof(T);
+  return true;
+}
+}  // namespace
+
 void SparseStorage::save(const std::string &filePath, std::size_t indent)
 {
   indent += 2;
@@ -76,14 +190,41 @@ void SparseStorage::save(const std::string &filePath, std::size_t indent)
   BOLT_INFO(indent, true, "  Vertices: " << sparseGraph_->getNumVertices() << " (Change: " << diffVertices << ")");
   BOLT_INFO(indent, true, "------------------------------------------------");
 
-  std::ofstream out(filePath.c_str(), std::ios::binary);
+  // Only one snapshot may be written at a time
+  waitForCompaction();
 
   // Save previous graph size
   prevNumEdges_ = sparseGraph_->getNumEdges();
   prevNumVertices_ = sparseGraph_->getNumVertices();
 
-  save(out);
-  out.close();
+  // The snapshot contains every change recorded so far
+  {
+    std::lock_guard<std::mutex> guard(journalMutex_);
+    journalPending_.clear();
+    journalPendingRecords_ = 0;
+    journalRecords_ = 0;
+    journalBaseVertexCount_ = sparseGraph_->getNumVertices() - numQueryVertices_;
+    journalBaseEdgeCount_ = sparseGraph_->getNumEdges();
+  }
+
+  if (useJournal_)
+  {
+    // Serialize while the graph cannot change, then let the disk write happen in the background
+    std::shared_ptr<std::stringstream> snapshot(
+        new std::stringstream(std::ios::in | std::ios::out | std::ios::binary));
+    saveSnapshot(*snapshot, indent);
+    journalValid_ = true;
+    compactionThread_ = boost::thread(boost::bind(&SparseStorage::writeSnapshotThread, this, filePath, snapshot));
+  }
+  else
+  {
+    // Write to a temporary file first, because the previous file may still be memory mapped by loadFlat()
+    const std::string tempFilePath = filePath + ".tmp";
+    std::ofstream out(tempFilePath.c_str(), std::ios::binary);
+    saveSnapshot(out, indent);
+    out.close();
+    replaceSnapshot(tempFilePath, filePath);
+  }
 
   // Log the graph size
   std::ofstream loggingFile;                              // open to append
@@ -92,6 +233,55 @@ void SparseStorage::save(const std::string &filePath, std::size_t indent)
   loggingFile.close();
 }
 
+void SparseStorage::saveSnapshot(std::ostream &out, std::size_t indent)
+{
+  if (useCompressedFormat_)
+    saveCompressed(out, indent);
+  else if (useFlatFormat_)
+    saveFlat(out, indent);
+  else
+    save(out);
+}
+
+void SparseStorage::writeSnapshotThread(std::string filePath, std::shared_ptr<std::stringstream> snapshot)
+{
+  const std::string tempFilePath = filePath + ".tmp";
+  std::ofstream out(tempFilePath.c_str(), std::ios::binary);
+
+  // Stream the buffer out directly, str() would hold a second copy of the whole database
+  out << snapshot->rdbuf();
+  snapshot.reset();
+  out.close();
+
+  if (!out.good())
+  {
+    OMPL_ERROR("Failed to write database file %s", tempFilePath.c_str());
+    journalValid_ = false;
+    return;
+  }
+
+  replaceSnapshot(tempFilePath, filePath);
+}
+
+void SparseStorage::replaceSnapshot(const std::string &tempFilePath, const std::string &filePath)
+{
+  // Replace the old file, any existing mapping keeps referencing the old contents
+  boost::system::error_code ec;
+  boost::filesystem::rename(tempFilePath, filePath, ec);
+  if (ec)
+  {
+    OMPL_ERROR("Failed to replace database file %s: %s", filePath.c_str(), ec.message().c_str());
+    journalValid_ = false;
+    return;
+  }
+
+  // The old journal only applied to the old file
+  if (useJournal_)
+    resetJournal(filePath);
+  else
+    boost::filesystem::remove(getJournalPath(filePath), ec);
+}
+
 void SparseStorage::save(std::ostream &out)
 {
   if (!out.good())
@@ -194,6 +384,209 @@ void SparseStorage::saveEdges(boost::archive::binary_oarchive &oa)
   std::cout << std::endl;
 }
 
+void SparseStorage::saveFlat(std::ostream &out, std::size_t indent)
+{
+  BOLT_FUNC(indent, verbose_, "saveFlat()");
+
+  if (!out.good())
+  {
+    OMPL_ERROR("Failed to save BoltData: output stream is invalid");
+    return;
+  }
+
+  const SparseAdjList &g = sparseGraph_->getGraph();
+  const base::StateSpacePtr &space = si_->getStateSpace();
+
+  std::vector<int> signature;
+  space->computeSignature(signature);
+
+  // Layout all blocks of the file
+  FlatHeader h;
+  h.marker = BOLT_FLAT_ARCHIVE_MARKER;
+  h.version = BOLT_FLAT_ARCHIVE_VERSION;
+  h.vertexCount = sparseGraph_->getNumVertices() - numQueryVertices_;
+  h.edgeCount = sparseGraph_->getNumEdges();
+  h.stateDimension = getFlatStateDimension(space);
+  h.signatureLength = signature.size();
+  h.signatureOffset = sizeof(FlatHeader);
+  h.statesOffset = alignFlatOffset(h.signatureOffset + h.signatureLength * sizeof(boost::int32_t));
+  h.edgeOffsetsOffset = h.statesOffset + h.vertexCount * h.stateDimension * sizeof(double);
+  h.edgeTargetsOffset = h.edgeOffsetsOffset + (h.vertexCount + 1) * sizeof(boost::uint64_t);
+  h.weightsOffset = alignFlatOffset(h.edgeTargetsOffset + h.edgeCount * sizeof(boost::uint32_t));
+  h.fileSize = h.weightsOffset + h.edgeCount * sizeof(float);
+
+  boost::uint64_t position = 0;
+  out.write(reinterpret_cast<const char *>(&h), sizeof(FlatHeader));
+  position += sizeof(FlatHeader);
+
+  // Signature
+  for (std::size_t i = 0; i < signature.size(); ++i)
+  {
+    boost::int32_t value = signature[i];
+    out.write(reinterpret_cast<const char *>(&value), sizeof(boost::int32_t));
+  }
+  position += h.signatureLength * sizeof(boost::int32_t);
+  padFlatStream(out, position, h.statesOffset);
+
+  // States - one contiguous row per vertex
+  std::vector<double> row(h.stateDimension);
+  for (SparseVertex v = numQueryVertices_; v < sparseGraph_->getNumVertices(); ++v)
+  {
+    BOLT_ASSERT(sparseGraph_->getState(v) != NULL, "State is null");
+    copyToFlatValues(space, sparseGraph_->getState(v), &row[0], h.stateDimension);
+    out.write(reinterpret_cast<const char *>(&row[0]), h.stateDimension * sizeof(double));
+  }
+  position = h.edgeOffsetsOffset;
+
+  // Edges in compressed sparse row order, each undirected edge stored once on its lower index vertex
+  std::vector<boost::uint64_t> edgeOffsets(h.vertexCount + 1, 0);
+  std::vector<boost::uint32_t> edgeTargets;
+  std::vector<float> weights;
+  edgeTargets.reserve(h.edgeCount);
+  weights.reserve(h.edgeCount);
+  for (SparseVertex v = numQueryVertices_; v < sparseGraph_->getNumVertices(); ++v)
+  {
+    foreach (const SparseEdge e, boost::out_edges(v, g))
+    {
+      const SparseVertex v2 = boost::target(e, g);
+      if (v2 < v)
+        continue;
+
+      edgeTargets.push_back(v2 - numQueryVertices_);
+      weights.push_back(g[e].weight_);
+    }
+    edgeOffsets[v - numQueryVertices_ + 1] = edgeTargets.size();
+  }
+  BOLT_ASSERT(edgeTargets.size() == h.edgeCount, "Edges found in adjacency lists do not match the edge count");
+
+  out.write(reinterpret_cast<const char *>(&edgeOffsets[0]), edgeOffsets.size() * sizeof(boost::uint64_t));
+  if (h.edgeCount)
+    out.write(reinterpret_cast<const char *>(&edgeTargets[0]), h.edgeCount * sizeof(boost::uint32_t));
+  position = h.edgeTargetsOffset + h.edgeCount * sizeof(boost::uint32_t);
+  padFlatStream(out, position, h.weightsOffset);
+  if (h.edgeCount)
+    out.write(reinterpret_cast<const char *>(&weights[0]), h.edgeCount * sizeof(float));
+
+  if (!out.good())
+    OMPL_ERROR("Failed to save BoltData: error writing flat file");
+}
+
+void SparseStorage::saveCompressed(std::ostream &out, std::size_t indent)
+{
+  BOLT_FUNC(indent, verbose_, "saveCompressed()");
+
+  if (!out.good())
+  {
+    OMPL_ERROR("Failed to save BoltData: output stream is invalid");
+    return;
+  }
+
+  const SparseAdjList &g = sparseGraph_->getGraph();
+  const base::StateSpacePtr &space = si_->getStateSpace();
+
+  std::vector<int> signature;
+  space->computeSignature(signature);
+
+  CompressedHeader h;
+  h.marker = BOLT_COMPRESSED_ARCHIVE_MARKER;
+  h.version = BOLT_COMPRESSED_ARCHIVE_VERSION;
+  h.vertexCount = sparseGraph_->getNumVertices() - numQueryVertices_;
+  h.edgeCount = sparseGraph_->getNumEdges();
+  h.stateDimension = getFlatStateDimension(space);
+  h.signatureLength = signature.size();
+  h.resolution = compressionResolution_;
+  h.hasWeights = compressionKeepWeights_;
+  const std::size_t dim = h.stateDimension;
+
+  // Convert all states to rows of doubles and find the range that each joint actually uses
+  std::vector<double> values(h.vertexCount * dim);
+  std::vector<double> minimums(dim, std::numeric_limits<double>::infinity());
+  std::vector<double> maximums(dim, -std::numeric_limits<double>::infinity());
+  for (std::size_t i = 0; i < h.vertexCount; ++i)
+  {
+    BOLT_ASSERT(sparseGraph_->getState(i + numQueryVertices_) != NULL, "State is null");
+    copyToFlatValues(space, sparseGraph_->getState(i + numQueryVertices_), &values[i * dim], dim);
+    for (std::size_t j = 0; j < dim; ++j)
+    {
+      minimums[j] = std::min(minimums[j], values[i * dim + j]);
+      maximums[j] = std::max(maximums[j], values[i * dim + j]);
+    }
+  }
+  if (!h.vertexCount)
+    std::fill(minimums.begin(), minimums.end(), 0.0);
+
+  // Choose the smallest integer width that holds the number of steps of the widest joint
+  double maxSteps = 0;
+  for (std::size_t j = 0; j < dim && h.vertexCount; ++j)
+    maxSteps = std::max(maxSteps, std::ceil((maximums[j] - minimums[j]) / h.resolution));
+  if (h.resolution <= 0 || maxSteps > std::numeric_limits<boost::uint32_t>::max())
+  {
+    OMPL_ERROR("Failed to save BoltData: compression resolution %f is too fine for the range of the joints",
+               h.resolution);
+    return;
+  }
+  h.valueBytes = maxSteps <= std::numeric_limits<boost::uint8_t>::max() ?
+                     1 :
+                     maxSteps <= std::numeric_limits<boost::uint16_t>::max() ? 2 : 4;
+
+  // States - fixed point steps above each joint's minimum
+  std::vector<unsigned char> states(values.size() * h.valueBytes);
+  for (std::size_t k = 0; k < values.size(); ++k)
+  {
+    boost::uint32_t step = static_cast<boost::uint32_t>(std::floor((values[k] - minimums[k % dim]) / h.resolution + 0.5));
+    writeFixedPoint(&states[k * h.valueBytes], step, h.valueBytes);
+  }
+
+  // Edges in compressed sparse row order, each undirected edge stored once on its lower index vertex
+  std::vector<unsigned char> edges;
+  std::vector<float> weights;
+  std::vector<std::pair<SparseVertex, float> > neighbors;
+  for (SparseVertex v = numQueryVertices_; v < sparseGraph_->getNumVertices(); ++v)
+  {
+    neighbors.clear();
+    foreach (const SparseEdge e, boost::out_edges(v, g))
+    {
+      const SparseVertex v2 = boost::target(e, g);
+      if (v2 > v)
+        neighbors.push_back(std::make_pair(v2, g[e].weight_));
+    }
+    std::sort(neighbors.begin(), neighbors.end());
+
+    writeVarint(edges, neighbors.size());
+    SparseVertex previous = v;
+    for (std::size_t i = 0; i < neighbors.size(); ++i)
+    {
+      writeVarint(edges, neighbors[i].first - previous);
+      previous = neighbors[i].first;
+      if (h.hasWeights)
+        weights.push_back(neighbors[i].second);
+    }
+  }
+  h.edgeBytes = edges.size();
+
+  BOLT_INFO(indent, verbose_, "Joint values use " << h.valueBytes << " bytes each, edges use " << h.edgeBytes
+                                                  << " bytes" << (h.hasWeights ? " plus weights" : ""));
+
+  // Write all blocks
+  out.write(reinterpret_cast<const char *>(&h), sizeof(CompressedHeader));
+  for (std::size_t i = 0; i < signature.size(); ++i)
+  {
+    boost::int32_t value = signature[i];
+    out.write(reinterpret_cast<const char *>(&value), sizeof(boost::int32_t));
+  }
+  if (dim)
+    out.write(reinterpret_cast<const char *>(&minimums[0]), dim * sizeof(double));
+  if (!states.empty())
+    out.write(reinterpret_cast<const char *>(&states[0]), states.size());
+  if (!edges.empty())
+    out.write(reinterpret_cast<const char *>(&edges[0]), edges.size());
+  if (!weights.empty())
+    out.write(reinterpret_cast<const char *>(&weights[0]), weights.size() * sizeof(float));
+
+  if (!out.good())
+    OMPL_ERROR("Failed to save BoltData: error writing compressed file");
+}
+
 bool SparseStorage::load(const std::string &filePath, std::size_t indent)
 {
   BOLT_INFO(indent, true, "------------------------------------------------");
@@ -223,10 +616,47 @@ bool SparseStorage::load(const std::string &filePath, std::size_t indent)
   bool visualizeSparseGraph = sparseGraph_->visualizeSparseGraph_;
   sparseGraph_->visualizeSparseGraph_ = false;
 
-  // Open file stream
-  std::ifstream in(filePath.c_str(), std::ios::binary);
-  bool result = load(in, indent);
-  in.close();
+  // Loading should not be recorded as changes
+  waitForCompaction();
+  journalPaused_ = true;
+
+  bool result;
+  if (isFlatFile(filePath))
+  {
+    result = loadFlat(filePath, indent);
+  }
+  else if (isCompressedFile(filePath))
+  {
+    std::ifstream in(filePath.c_str(), std::ios::binary);
+    result = loadCompressed(in, indent);
+    in.close();
+  }
+  else  // older boost archive format
+  {
+    // Open file stream
+    std::ifstream in(filePath.c_str(), std::ios::binary);
+    result = load(in, indent);
+    in.close();
+  }
+
+  // Do not leave a partially loaded graph behind
+  if (!result)
+  {
+    BOLT_WARN(indent, true, "Clearing partially loaded database");
+    sparseGraph_->clear();
+  }
+
+  // Apply the changes that were saved after the snapshot
+  journalValid_ = false;
+  if (result && boost::filesystem::exists(getJournalPath(filePath)))
+    loadJournal(filePath, indent);
+  else if (result && useJournal_)
+  {
+    journalBaseVertexCount_ = sparseGraph_->getNumVertices() - numQueryVertices_;
+    journalBaseEdgeCount_ = sparseGraph_->getNumEdges();
+    resetJournal(filePath);
+  }
+  journalPaused_ = false;
 
   // Re-enable visualizations
   sparseGraph_->visualizeSparseGraph_ = visualizeSparseGraph;
@@ -283,86 +713,650 @@ bool SparseStorage::load(std::istream &in, std::size_t indent)
   catch (boost::archive::archive_exception &ae)
   {
     OMPL_ERROR("Failed to load BoltData: %s", ae.what());
+    return false;
   }
 
   return true;
 }
 
-void SparseStorage::loadVertices(std::size_t numVertices, boost::archive::binary_iarchive &ia, std::size_t indent)
+bool SparseStorage::isFlatFile(const std::string &filePath)
 {
-  BOLT_FUNC(indent, true, "Loading vertices from file: " << numVertices);
+  return readFileMarker(filePath) == BOLT_FLAT_ARCHIVE_MARKER;
+}
+
+bool SparseStorage::isCompressedFile(const std::string &filePath)
+{
+  return readFileMarker(filePath) == BOLT_COMPRESSED_ARCHIVE_MARKER;
+}
+
+bool SparseStorage::loadFlat(const std::string &filePath, std::size_t indent)
+{
+  BOLT_FUNC(indent, verbose_, "loadFlat()");
+  namespace bi = boost::interprocess;
 
-  // Reserve memory
-  sparseGraph_->getGraphNonConst().m_vertices.reserve(numVertices);
+  // Map the whole file, pages are only read from disk once they are touched
+  std::shared_ptr<bi::mapped_region> region;
+  try
+  {
+    bi::file_mapping file(filePath.c_str(), bi::read_only);
+    region.reset(new bi::mapped_region(file, bi::copy_on_write));
+  }
+  catch (bi::interprocess_exception &ex)
+  {
+    OMPL_ERROR("Failed to load BoltData: unable to memory map file: %s", ex.what());
+    return false;
+  }
+
+  char *data = static_cast<char *>(region->get_address());
+  if (region->get_size() < sizeof(FlatHeader))
+  {
+    OMPL_ERROR("Failed to load BoltData: file is smaller than header");
+    return false;
+  }
+  const FlatHeader &h = *reinterpret_cast<const FlatHeader *>(data);
+
+  // Error checking
+  if (h.marker != BOLT_FLAT_ARCHIVE_MARKER)
+  {
+    OMPL_ERROR("Failed to load BoltData: BoltData flat marker not found");
+    return false;
+  }
+  if (h.version != BOLT_FLAT_ARCHIVE_VERSION)
+  {
+    OMPL_ERROR("Failed to load BoltData: unsupported flat file version %u", h.version);
+    return false;
+  }
+  if (h.fileSize > region->get_size())
+  {
+    OMPL_ERROR("Failed to load BoltData: flat file is truncated");
+    return false;
+  }
 
-  // Create thread to populate nearest neighbor structure, because that is the slowest component
-  loadVerticesFinished_ = false;
-  SparseVertex startingVertex = sparseGraph_->getNumVertices(); // should be number of threads
-  boost::thread nnThread(boost::bind(&SparseStorage::populateNNThread, this, startingVertex, numVertices));
+  // Every block must end inside the file, checked without overflowing for corrupt counts
+  auto blockFits = [&h](boost::uint64_t offset, boost::uint64_t count, boost::uint64_t elementSize)
+  {
+    return offset <= h.fileSize && (elementSize == 0 || count <= (h.fileSize - offset) / elementSize);
+  };
+  if (!blockFits(h.signatureOffset, h.signatureLength, sizeof(boost::int32_t)))
+  {
+    OMPL_ERROR("Failed to load BoltData: signature block is outside of the flat file");
+    return false;
+  }
 
+  // Verify that the state space is the same
   const base::StateSpacePtr &space = si_->getStateSpace();
-  std::size_t feedbackFrequency = numVertices / 10;
-  BoltVertexData vertexData;
+  std::vector<int> sig;
+  space->computeSignature(sig);
+  const boost::int32_t *fileSig = reinterpret_cast<const boost::int32_t *>(data + h.signatureOffset);
+  if (h.signatureLength != sig.size() || !std::equal(sig.begin(), sig.end(), fileSig))
+  {
+    OMPL_ERROR("Failed to load BoltData: StateSpace signature mismatch");
+    return false;
+  }
+  const std::size_t dim = h.stateDimension;
+  if (dim != getFlatStateDimension(space))
+  {
+    OMPL_ERROR("Failed to load BoltData: state dimension mismatch");
+    return false;
+  }
+  if (!blockFits(h.statesOffset, h.vertexCount, dim * sizeof(double)) || h.vertexCount >= h.fileSize ||
+      !blockFits(h.edgeOffsetsOffset, h.vertexCount + 1, sizeof(boost::uint64_t)) ||
+      !blockFits(h.edgeTargetsOffset, h.edgeCount, sizeof(boost::uint32_t)) ||
+      !blockFits(h.weightsOffset, h.edgeCount, sizeof(float)))
+  {
+    OMPL_ERROR("Failed to load BoltData: flat file blocks do not fit in the file");
+    return false;
+  }
 
-  std::cout << "         Vertices loaded: ";
-  for (std::size_t i = 0; i < numVertices; ++i)
+  double *values = reinterpret_cast<double *>(data + h.statesOffset);
+  const boost::uint64_t *edgeOffsets = reinterpret_cast<const boost::uint64_t *>(data + h.edgeOffsetsOffset);
+  const boost::uint32_t *edgeTargets = reinterpret_cast<const boost::uint32_t *>(data + h.edgeTargetsOffset);
+  const float *weights = reinterpret_cast<const float *>(data + h.weightsOffset);
+
+  // The edges of vertex i are edgeOffsets[i] to edgeOffsets[i + 1], so the offsets must cover every edge in order
+  if (edgeOffsets[0] != 0 || edgeOffsets[h.vertexCount] != h.edgeCount)
   {
-    // Copy in data from file
-    ia >> vertexData;
+    OMPL_ERROR("Failed to load BoltData: edge offsets do not cover the %lu edges", h.edgeCount);
+    return false;
+  }
+  for (std::size_t i = 0; i < h.vertexCount; ++i)
+  {
+    if (edgeOffsets[i] > edgeOffsets[i + 1])
+    {
+      OMPL_ERROR("Failed to load BoltData: edge offsets are corrupt");
+      return false;
+    }
+  }
+  for (std::size_t j = 0; j < h.edgeCount; ++j)
+  {
+    if (edgeTargets[j] >= h.vertexCount)
+    {
+      OMPL_ERROR("Failed to load BoltData: edge block is corrupt");
+      return false;
+    }
+  }
 
-    // Allocating a new state and deserializing it from the buffer
-    base::State *state = space->allocState();
-    space->deserialize(state, &vertexData.stateSerialized_[0]);
-    // Add to Sparse graph
-    sparseGraph_->addVertexFromFile(state, indent);
-    // Feedback
-    if ((i + 1) % feedbackFrequency == 0)
-      std::cout << static_cast<int>(ceil(i / double(numVertices) * 100.0)) << "% " << std::flush;
+  // If the states are a single array of doubles we can view them in place, otherwise fall back to copying
+  const bool zeroCopy = hasFlatStateLayout(space);
+  BOLT_INFO(indent, verbose_, "Loading " << h.vertexCount << " vertices and " << h.edgeCount << " edges"
+                                         << (zeroCopy ? " directly from mapped memory" : " by copying states"));
+
+  releaseMappedStates();
+  if (zeroCopy)
+  {
+    mappedStates_.reset(new FlatState[h.vertexCount]);
+    numMappedStates_ = h.vertexCount;
+    mappedRegion_ = region;
   }
-  std::cout << std::endl;
 
-  // Join thread
-  loadVerticesFinished_ = true;
+  // Vertices - every row has the same size so each thread can decode its own range of the states block
+  std::vector<base::State *> states(h.vertexCount);
+  decodeInChunks(h.vertexCount, [&](std::size_t start, std::size_t end)
+                 {
+                   for (std::size_t i = start; i < end; ++i)
+                   {
+                     if (zeroCopy)
+                     {
+                       mappedStates_[i].values = values + i * dim;
+                       states[i] = &mappedStates_[i];
+                     }
+                     else
+                     {
+                       states[i] = space->allocState();
+                       copyFromFlatValues(space, states[i], values + i * dim, dim);
+                     }
+                   }
+                 },
+                 indent);
+  addLoadedVertices(states, indent);
+
+  // Edges
+  for (std::size_t i = 0; i < h.vertexCount; ++i)
+  {
+    const SparseVertex v1 = i + numQueryVertices_;
+    for (boost::uint64_t j = edgeOffsets[i]; j < edgeOffsets[i + 1]; ++j)
+    {
+      const SparseVertex v2 = edgeTargets[j] + numQueryVertices_;
+      sparseGraph_->addEdge(v1, v2, weights[j], eUNKNOWN, indent);
+    }
+  }
 
-  time::point startTime;
-  if (vThreadTiming_)
-    startTime = time::now();  // Benchmark
+  return true;
+}
+
+bool SparseStorage::loadCompressed(std::istream &in, std::size_t indent)
+{
+  BOLT_FUNC(indent, verbose_, "loadCompressed()");
 
-  nnThread.join();
+  CompressedHeader h;
+  in.read(reinterpret_cast<char *>(&h), sizeof(CompressedHeader));
 
-  if (vThreadTiming_)
-    OMPL_INFORM("NN thread took %f seconds to catch up", time::seconds(time::now() - startTime));  // Benchmark
+  // Error checking
+  if (!in.good() || h.marker != BOLT_COMPRESSED_ARCHIVE_MARKER)
+  {
+    OMPL_ERROR("Failed to load BoltData: BoltData compressed marker not found");
+    return false;
+  }
+  if (h.version != BOLT_COMPRESSED_ARCHIVE_VERSION)
+  {
+    OMPL_ERROR("Failed to load BoltData: unsupported compressed file version %u", h.version);
+    return false;
+  }
+  if (h.valueBytes != 1 && h.valueBytes != 2 && h.valueBytes != 4)
+  {
+    OMPL_ERROR("Failed to load BoltData: invalid joint value width %u", h.valueBytes);
+    return false;
+  }
+
+  // Verify that the state space is the same
+  const base::StateSpacePtr &space = si_->getStateSpace();
+  std::vector<int> sig;
+  space->computeSignature(sig);
+  std::vector<boost::int32_t> fileSig(h.signatureLength);
+  if (h.signatureLength == sig.size() && !sig.empty())
+    in.read(reinterpret_cast<char *>(&fileSig[0]), fileSig.size() * sizeof(boost::int32_t));
+  if (h.signatureLength != sig.size() || !std::equal(sig.begin(), sig.end(), fileSig.begin()))
+  {
+    OMPL_ERROR("Failed to load BoltData: StateSpace signature mismatch");
+    return false;
+  }
+  const std::size_t dim = h.stateDimension;
+  if (dim != getFlatStateDimension(space))
+  {
+    OMPL_ERROR("Failed to load BoltData: state dimension mismatch");
+    return false;
+  }
+
+  // Read all blocks
+  std::vector<double> minimums(dim);
+  std::vector<unsigned char> statesData(h.vertexCount * dim * h.valueBytes);
+  std::vector<unsigned char> edgesData(h.edgeBytes);
+  std::vector<float> weights(h.hasWeights ? h.edgeCount : 0);
+  if (dim)
+    in.read(reinterpret_cast<char *>(&minimums[0]), dim * sizeof(double));
+  if (!statesData.empty())
+    in.read(reinterpret_cast<char *>(&statesData[0]), statesData.size());
+  if (!edgesData.empty())
+    in.read(reinterpret_cast<char *>(&edgesData[0]), edgesData.size());
+  if (!weights.empty())
+    in.read(reinterpret_cast<char *>(&weights[0]), weights.size() * sizeof(float));
+  if (!in.good())
+  {
+    OMPL_ERROR("Failed to load BoltData: compressed file is truncated");
+    return false;
+  }
+
+  BOLT_INFO(indent, verbose_, "Loading " << h.vertexCount << " vertices and " << h.edgeCount << " edges");
+
+  // Vertices - every row has the same size so each thread can decode its own range of the states block
+  std::vector<base::State *> states(h.vertexCount);
+  decodeInChunks(h.vertexCount, [&](std::size_t start, std::size_t end)
+                 {
+                   std::vector<double> row(dim);
+                   for (std::size_t i = start; i < end; ++i)
+                   {
+                     for (std::size_t j = 0; j < dim; ++j)
+                       row[j] = minimums[j] +
+                                readFixedPoint(&statesData[(i * dim + j) * h.valueBytes], h.valueBytes) * h.resolution;
+
+                     states[i] = space->allocState();
+                     copyFromFlatValues(space, states[i], &row[0], dim);
+
+                     // Rounding can place the value up to half a step past the joint limit
+                     space->enforceBounds(states[i]);
+                   }
+                 },
+                 indent);
+  addLoadedVertices(states, indent);
+
+  // Edges
+  std::vector<std::pair<SparseVertex, SparseVertex> > endpoints;
+  endpoints.reserve(h.edgeCount);
+  const unsigned char *data = edgesData.empty() ? NULL : &edgesData[0];
+  const unsigned char *dataEnd = data + edgesData.size();
+  for (std::size_t i = 0; i < h.vertexCount; ++i)
+  {
+    boost::uint64_t numNeighbors;
+    if (!readVarint(data, dataEnd, numNeighbors))
+    {
+      OMPL_ERROR("Failed to load BoltData: edge block is corrupt");
+      return false;
+    }
+
+    boost::uint64_t target = i;
+    for (std::size_t j = 0; j < numNeighbors; ++j)
+    {
+      boost::uint64_t delta;
+      if (!readVarint(data, dataEnd, delta) || (target += delta) >= h.vertexCount)
+      {
+        OMPL_ERROR("Failed to load BoltData: edge block is corrupt");
+        return false;
+      }
+      endpoints.push_back(std::make_pair(i + numQueryVertices_, target + numQueryVertices_));
+    }
+  }
+  if (endpoints.size() != h.edgeCount)
+  {
+    OMPL_ERROR("Failed to load BoltData: expected %lu edges but found %lu", h.edgeCount, endpoints.size());
+    return false;
+  }
+
+  // Weights that were not stored are recomputed from the states, which is independent for each edge
+  if (!h.hasWeights)
+  {
+    weights.resize(h.edgeCount);
+    decodeInChunks(h.edgeCount, [&](std::size_t start, std::size_t end)
+                   {
+                     for (std::size_t i = start; i < end; ++i)
+                       weights[i] = sparseGraph_->distanceFunction(endpoints[i].first, endpoints[i].second);
+                   },
+                   indent);
+  }
+
+  for (std::size_t i = 0; i < endpoints.size(); ++i)
+    sparseGraph_->addEdge(endpoints[i].first, endpoints[i].second, weights[i], eUNKNOWN, indent);
+
+  return true;
+}
+
+void SparseStorage::releaseMappedStates()
+{
+  mappedStates_.reset();
+  numMappedStates_ = 0;
+  mappedRegion_.reset();
+}
+
+void SparseStorage::journalAddVertex(std::size_t v)
+{
+  if (!useJournal_ || journalPaused_)
+    return;
+
+  const base::StateSpacePtr &space = si_->getStateSpace();
+  std::vector<unsigned char> state(space->getSerializationLength());
+  space->serialize(&state[0], sparseGraph_->getState(v));
+
+  std::lock_guard<std::mutex> guard(journalMutex_);
+  journalPending_.push_back(JOURNAL_ADD_VERTEX);
+  journalPending_.insert(journalPending_.end(), state.begin(), state.end());
+  journalPendingRecords_++;
+}
+
+void SparseStorage::journalRemoveVertex(std::size_t v)
+{
+  if (!useJournal_ || journalPaused_)
+    return;
+
+  std::lock_guard<std::mutex> guard(journalMutex_);
+  journalPending_.push_back(JOURNAL_REMOVE_VERTEX);
+  appendJournalValue(journalPending_, static_cast<boost::uint64_t>(v - numQueryVertices_));
+  journalPendingRecords_++;
+}
+
+void SparseStorage::journalClearVertex(std::size_t v)
+{
+  if (!useJournal_ || journalPaused_)
+    return;
+
+  std::lock_guard<std::mutex> guard(journalMutex_);
+  journalPending_.push_back(JOURNAL_CLEAR_VERTEX);
+  appendJournalValue(journalPending_, static_cast<boost::uint64_t>(v - numQueryVertices_));
+  journalPendingRecords_++;
+}
+
+void SparseStorage::journalAddEdge(std::size_t v1, std::size_t v2, float weight)
+{
+  if (!useJournal_ || journalPaused_)
+    return;
+
+  std::lock_guard<std::mutex> guard(journalMutex_);
+  journalPending_.push_back(JOURNAL_ADD_EDGE);
+  appendJournalValue(journalPending_, static_cast<boost::uint64_t>(v1 - numQueryVertices_));
+  appendJournalValue(journalPending_, static_cast<boost::uint64_t>(v2 - numQueryVertices_));
+  appendJournalValue(journalPending_, weight);
+  journalPendingRecords_++;
 }
 
-void SparseStorage::populateNNThread(std::size_t startingVertex, std::size_t numVertices)
+void SparseStorage::journalRemoveEdge(std::size_t v1, std::size_t v2)
 {
-  SparseVertex vertexID = startingVertex;  // skip the query vertices
-  SparseVertex endID = startingVertex + numVertices - 1;
+  if (!useJournal_ || journalPaused_)
+    return;
+
+  std::lock_guard<std::mutex> guard(journalMutex_);
+  journalPending_.push_back(JOURNAL_REMOVE_EDGE);
+  appendJournalValue(journalPending_, static_cast<boost::uint64_t>(v1 - numQueryVertices_));
+  appendJournalValue(journalPending_, static_cast<boost::uint64_t>(v2 - numQueryVertices_));
+  journalPendingRecords_++;
+}
+
+bool SparseStorage::journalNeedsCompaction(const std::string &filePath)
+{
+  // Whether the last snapshot made it to disk is only known once it is finished
+  waitForCompaction();
+
+  if (!journalValid_ || !boost::filesystem::exists(filePath))
+    return true;
+
+  const std::size_t graphSize = sparseGraph_->getNumVertices() + sparseGraph_->getNumEdges();
+  return journalRecords_ + journalPendingRecords_ > journalCompactionRatio_ * graphSize;
+}
+
+bool SparseStorage::appendJournal(const std::string &filePath, std::size_t indent)
+{
+  // The journal is only created once the snapshot it belongs to is on disk
+  waitForCompaction();
+
+  std::lock_guard<std::mutex> guard(journalMutex_);
+  const std::string journalPath = getJournalPath(filePath);
+  BOLT_INFO(indent, true, "Appending " << journalPendingRecords_ << " changes to journal " << journalPath);
+
+  std::ofstream out(journalPath.c_str(), std::ios::binary | std::ios::app);
+  if (!journalPending_.empty())
+    out.write(reinterpret_cast<const char *>(&journalPending_[0]), journalPending_.size());
+  out.close();
+
+  if (!out.good())
+  {
+    OMPL_ERROR("Failed to append to journal %s", journalPath.c_str());
+    journalValid_ = false;
+    return false;
+  }
+
+  journalRecords_ += journalPendingRecords_;
+  journalPending_.clear();
+  journalPendingRecords_ = 0;
+
+  // Save previous graph size
+  prevNumEdges_ = sparseGraph_->getNumEdges();
+  prevNumVertices_ = sparseGraph_->getNumVertices();
+
+  return true;
+}
+
+bool SparseStorage::loadJournal(const std::string &filePath, std::size_t indent)
+{
+  const std::string journalPath = getJournalPath(filePath);
+  BOLT_FUNC(indent, verbose_, "loadJournal() " << journalPath);
+
+  // Read the whole journal at once
+  std::ifstream in(journalPath.c_str(), std::ios::binary);
+  std::vector<unsigned char> buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  in.close();
+
+  const base::StateSpacePtr &space = si_->getStateSpace();
+  const unsigned char *data = buffer.empty() ? NULL : &buffer[0];
+  const unsigned char *end = data + buffer.size();
+
+  // Error checking
+  JournalHeader h;
+  if (!readJournalValue(data, end, h) || h.marker != BOLT_JOURNAL_MARKER || h.version != BOLT_JOURNAL_VERSION ||
+      h.stateLength != space->getSerializationLength())
+  {
+    OMPL_WARN("Ignoring journal %s, it is invalid", journalPath.c_str());
+    return false;
+  }
+  if (h.baseVertexCount != sparseGraph_->getNumVertices() - numQueryVertices_ ||
+      h.baseEdgeCount != sparseGraph_->getNumEdges())
+  {
+    OMPL_WARN("Ignoring journal %s, it does not belong to the loaded database", journalPath.c_str());
+    return false;
+  }
 
-  while (vertexID < endID)
+  // Replay each record in order, stopping at a record that was not completely written
+  const SparseAdjList &g = sparseGraph_->getGraph();
+  std::size_t numRecords = 0;
+  const unsigned char *recordStart = data;
+  boost::uint8_t type;
+  while (readJournalValue(data, end, type))
   {
-    // Check if there are any vertices ready to be inserted into the NN
-    // We subtract 1 because we do not want to process the newest vertex for threading reasons
-    while (vertexID < sparseGraph_->getNumVertices() - 1)
+    boost::uint64_t v1, v2;
+    float weight;
+    bool complete = false;
+    switch (type)
+    {
+      case JOURNAL_ADD_VERTEX:
+        if ((complete = end - data >= static_cast<std::ptrdiff_t>(h.stateLength)))
+        {
+          base::State *state = space->allocState();
+          space->deserialize(state, data);
+          data += h.stateLength;
+
+          SparseVertex v = sparseGraph_->addVertexFromFile(state, indent);
+          sparseGraph_->getNN()->add(v);
+        }
+        break;
+      case JOURNAL_REMOVE_VERTEX:
+        if ((complete = readJournalValue(data, end, v1)))
+          sparseGraph_->removeVertex(v1 + numQueryVertices_, indent);
+        break;
+      case JOURNAL_CLEAR_VERTEX:
+        if ((complete = readJournalValue(data, end, v1)))
+          while (boost::out_degree(v1 + numQueryVertices_, g))
+            sparseGraph_->removeEdge(*boost::out_edges(v1 + numQueryVertices_, g).first, indent);
+        break;
+      case JOURNAL_ADD_EDGE:
+        if ((complete = readJournalValue(data, end, v1) && readJournalValue(data, end, v2) &&
+                        readJournalValue(data, end, weight)))
+          sparseGraph_->addEdge(v1 + numQueryVertices_, v2 + numQueryVertices_, weight, eUNKNOWN, indent);
+        break;
+      case JOURNAL_REMOVE_EDGE:
+        if ((complete = readJournalValue(data, end, v1) && readJournalValue(data, end, v2)))
+        {
+          std::pair<SparseEdge, bool> e = boost::edge(v1 + numQueryVertices_, v2 + numQueryVertices_, g);
+          if (e.second)
+            sparseGraph_->removeEdge(e.first, indent);
+        }
+        break;
+      default:
+        break;
+    }
+
+    if (!complete)
     {
-      // There are vertices ready to be inserted
-      sparseGraph_->getNN()->add(vertexID);
-      vertexID++;
+      OMPL_WARN("Journal %s ends with an incomplete or unknown record, discarding it", journalPath.c_str());
+      break;
     }
+    recordStart = data;
+    numRecords++;
+  }
 
-    if (!loadVerticesFinished_)  // only wait if the parent thread isn't already done
+  // Cut off any partial record so that new records are appended after the last complete one
+  if (recordStart != end)
+  {
+    boost::system::error_code ec;
+    boost::filesystem::resize_file(journalPath, recordStart - &buffer[0], ec);
+    if (ec)
     {
-      usleep(0.00001 * 1000000);
+      OMPL_ERROR("Failed to truncate journal %s: %s", journalPath.c_str(), ec.message().c_str());
+      return false;
     }
   }
 
-  // There should be one vertex left
-  BOLT_ASSERT(vertexID == sparseGraph_->getNumVertices() - 1,
-              "There should only be one vertex left. sparseGraph_->getNumVertices(): " << sparseGraph_->getNumVertices()
-              << " vertexID: " << vertexID);
+  BOLT_INFO(indent, true, "Replayed " << numRecords << " changes from journal");
+
+  journalBaseVertexCount_ = h.baseVertexCount;
+  journalBaseEdgeCount_ = h.baseEdgeCount;
+  journalRecords_ = numRecords;
+  journalValid_ = true;
+  return true;
+}
+
+void SparseStorage::resetJournal(const std::string &filePath)
+{
+  JournalHeader h;
+  h.marker = BOLT_JOURNAL_MARKER;
+  h.version = BOLT_JOURNAL_VERSION;
+  h.baseVertexCount = journalBaseVertexCount_;
+  h.baseEdgeCount = journalBaseEdgeCount_;
+  h.stateLength = si_->getStateSpace()->getSerializationLength();
+
+  // Replace atomically so that a crash never leaves a journal without its header
+  const std::string journalPath = getJournalPath(filePath);
+  const std::string tempJournalPath = journalPath + ".tmp";
+  std::ofstream out(tempJournalPath.c_str(), std::ios::binary);
+  out.write(reinterpret_cast<const char *>(&h), sizeof(JournalHeader));
+  out.close();
+
+  boost::system::error_code ec;
+  boost::filesystem::rename(tempJournalPath, journalPath, ec);
+  if (!out.good() || ec)
+  {
+    OMPL_ERROR("Failed to create journal %s", journalPath.c_str());
+    journalValid_ = false;
+    return;
+  }
+  journalValid_ = true;
+}
+
+void SparseStorage::discardJournal()
+{
+  waitForCompaction();
+
+  std::lock_guard<std::mutex> guard(journalMutex_);
+  journalPending_.clear();
+  journalPendingRecords_ = 0;
+  journalRecords_ = 0;
+  journalValid_ = false;
+}
+
+void SparseStorage::waitForCompaction()
+{
+  if (compactionThread_.joinable())
+    compactionThread_.join();
+}
+
+void SparseStorage::loadVertices(std::size_t numVertices, boost::archive::binary_iarchive &ia, std::size_t indent)
+{
+  BOLT_FUNC(indent, true, "Loading vertices from file: " << numVertices);
+
+  // Reading the archive is sequential, so only copy out the serialized buffers here
+  std::vector<BoltVertexData> vertexData(numVertices);
+  for (std::size_t i = 0; i < numVertices; ++i)
+    ia >> vertexData[i];
+
+  // Allocating and deserializing the states is independent for each buffer
+  const base::StateSpacePtr &space = si_->getStateSpace();
+  std::vector<base::State *> states(numVertices);
+  decodeInChunks(numVertices, [&](std::size_t start, std::size_t end)
+                 {
+                   for (std::size_t i = start; i < end; ++i)
+                   {
+                     states[i] = space->allocState();
+                     space->deserialize(states[i], &vertexData[i].stateSerialized_[0]);
+                   }
+                 },
+                 indent);
+
+  addLoadedVertices(states, indent);
+}
+
+void SparseStorage::decodeInChunks(std::size_t numStates,
+                                   const std::function<void(std::size_t, std::size_t)> &decodeChunk,
+                                   std::size_t indent)
+{
+  std::size_t numThreads = std::min(numLoadThreads_, std::max<std::size_t>(1, numStates));
+  std::size_t chunkSize = numStates / numThreads;
+  BOLT_DEBUG(indent, verbose_, "Decoding " << numStates << " states on " << numThreads << " threads");
+
+  time::point startTime;
+  if (vThreadTiming_)
+    startTime = time::now();  // Benchmark
+
+  // Setup threading, the last thread takes the remainder
+  std::vector<boost::thread *> threads(numThreads);
+  for (std::size_t i = 0; i < threads.size(); ++i)
+  {
+    std::size_t start = i * chunkSize;
+    std::size_t end = (i == threads.size() - 1) ? numStates : start + chunkSize;
+    threads[i] = new boost::thread(boost::bind(decodeChunk, start, end));
+  }
+
+  // Join threads
+  for (std::size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i]->join();
+    delete threads[i];
+  }
+
+  if (vThreadTiming_)
+    OMPL_INFORM("Decoding states took %f seconds", time::seconds(time::now() - startTime));  // Benchmark
+}
+
+void SparseStorage::addLoadedVertices(const std::vector<base::State *> &states, std::size_t indent)
+{
+  std::vector<SparseVertex> vertices;
+  vertices.reserve(states.size());
+  for (std::size_t i = 0; i < states.size(); ++i)
+    vertices.push_back(sparseGraph_->addVertexFromFile(states[i], indent));
+
+  time::point startTime;
+  if (vThreadTiming_)
+    startTime = time::now();  // Benchmark
+
+  // Nearest neighbor can be built all at once now that every vertex is known
+  sparseGraph_->getNN()->add(vertices);
 
-  // Add the last vertex
-  sparseGraph_->getNN()->add(vertexID);
+  if (vThreadTiming_)
+    OMPL_INFORM("Building NN took %f seconds", time::seconds(time::now() - startTime));  // Benchmark
 }
 
 void SparseStorage::loadEdges(std::size_t numEdges, boost::archive::binary_iarchive &ia, std::size_t indent)
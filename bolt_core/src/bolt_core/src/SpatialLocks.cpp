@@ -0,0 +1,113 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Locks on regions of the state space so distant parts of the graph can be changed in parallel
+*/
+
+// Bolt
+#include <bolt_core/SpatialLocks.h>
+
+// Boost
+#include <boost/functional/hash.hpp>
+
+// C++
+#include <algorithm>
+#include <cmath>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+SpatialLocks::SpatialLocks(base::SpaceInformationPtr si, double cellWidth, std::size_t numDims,
+                           std::size_t numStripes)
+  : si_(si), cellWidth_(cellWidth), numDims_(numDims), stripes_(numStripes), numContended_(0)
+{
+  assert(cellWidth_ > 0);
+  assert(!stripes_.empty());
+}
+
+void SpatialLocks::lock(const base::State *state, std::vector<std::size_t> &stripes)
+{
+  std::vector<double> values;
+  si_->getStateSpace()->copyToReals(values, state);
+  const std::size_t numDims = std::min(numDims_, values.size());
+
+  std::vector<long> cell(numDims);
+  for (std::size_t i = 0; i < numDims; ++i)
+    cell[i] = static_cast<long>(std::floor(values[i] / cellWidth_));
+
+  // Visit the 3^numDims cells that differ by at most one in each coordinate
+  std::size_t numCells = 1;
+  for (std::size_t i = 0; i < numDims; ++i)
+    numCells *= 3;
+
+  stripes.clear();
+  for (std::size_t n = 0; n < numCells; ++n)
+  {
+    std::size_t hash = 0;
+    std::size_t offsets = n;
+    for (std::size_t i = 0; i < numDims; ++i)
+    {
+      boost::hash_combine(hash, cell[i] + long(offsets % 3) - 1);
+      offsets /= 3;
+    }
+    stripes.push_back(hash % stripes_.size());
+  }
+
+  // Lock in a global order so that two threads never wait on each other
+  std::sort(stripes.begin(), stripes.end());
+  stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+
+  for (std::size_t stripe : stripes)
+  {
+    if (!stripes_[stripe].try_lock())
+    {
+      numContended_++;
+      stripes_[stripe].lock();
+    }
+  }
+}
+
+void SpatialLocks::unlock(const std::vector<std::size_t> &stripes)
+{
+  for (std::size_t stripe : stripes)
+    stripes_[stripe].unlock();
+}
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
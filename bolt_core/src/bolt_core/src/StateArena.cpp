@@ -0,0 +1,102 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Univ of CO, Boulder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman <dave@dav.ee>
+   Desc:   Contiguous storage of the joint values of all vertices in a graph
+*/
+
+// Bolt
+#include <bolt_core/StateArena.h>
+
+// C++
+#include <algorithm>
+
+namespace ompl
+{
+namespace tools
+{
+namespace bolt
+{
+StateArena::StateArena(const base::StateSpacePtr &space)
+  : dim_(getFlatStateDimension(space)), supported_(hasFlatStateLayout(space))
+{
+}
+
+base::State *StateArena::store(std::size_t index, const base::State *state)
+{
+  FlatState *row = getRow(index);
+  const double *values = state->as<FlatState>()->values;
+  std::copy(values, values + dim_, row->values);
+  return row;
+}
+
+base::State *StateArena::move(std::size_t from, std::size_t to)
+{
+  FlatState *row = getRow(to);
+  if (from != to)
+  {
+    const double *values = getRow(from)->values;
+    std::copy(values, values + dim_, row->values);
+  }
+  return row;
+}
+
+void StateArena::clear()
+{
+  blocks_.clear();
+}
+
+FlatState *StateArena::getRow(std::size_t index)
+{
+  const std::size_t blockID = index / BLOCK_SIZE;
+  if (blockID >= blocks_.size())
+    blocks_.resize(blockID + 1);
+
+  // Allocate a new block and point each of its states at their row
+  if (!blocks_[blockID])
+  {
+    std::unique_ptr<Block> block(new Block());
+    block->values_.reset(new double[BLOCK_SIZE * dim_]);
+    block->states_.reset(new FlatState[BLOCK_SIZE]);
+    for (std::size_t i = 0; i < BLOCK_SIZE; ++i)
+      block->states_[i].values = &block->values_[i * dim_];
+    blocks_[blockID] = std::move(block);
+  }
+
+  return &blocks_[blockID]->states_[index % BLOCK_SIZE];
+}
+
+}  // namespace bolt
+}  // namespace tools
+}  // namespace ompl
@@ -53,7 +53,10 @@
 #include <boost/thread.hpp>
 
 // C++
+#include <algorithm>
+#include <cmath>
 #include <limits>
+#include <map>
 #include <queue>
 
 // Profiling
@@ -113,6 +116,8 @@ void TaskGraph::clear()
 {
   freeMemory();
   initializeQueryState();
+  sparseToTaskVertex0_.clear();
+  sparseToTaskVertex2_.clear();
 
   graphUnsaved_ = false;
   taskPlanningEnabled_ = false;
@@ -121,37 +126,38 @@ void TaskGraph::clear()
 void TaskGraph::freeMemory()
 {
   foreach (TaskVertex v, boost::vertices(g_))
-  {
-    if (g_[v].state_ == nullptr)
-      continue;
-
-    base::CompoundState *compoundState = g_[v].state_->as<base::CompoundState>();
-    base::DiscreteStateSpace::StateType *discreteState =
-        compoundState->as<base::DiscreteStateSpace::StateType>(DISCRETE);
-    base::State *modelBasedState = compoundState->as<base::DiscreteStateSpace::StateType>(MODEL_BASED);
+    freeVertexState(v);
 
-    // std::cout << "compoundState: " << compoundState << std::endl;
-    // std::cout << "discreteState: " << discreteState << std::endl;
-    // std::cout << "modelBasedState: " << modelBasedState << std::endl;
+  g_.clear();
+  nn_->clear();
+  frozen_ = false;
+  numLayerVertices_ = 0;
+  numLayerEdges_ = 0;
+}
 
-    // Do not free the joint state data (ModelBasedStateSpace) if its part of the SPARS graph also
-    if (discreteState->value == 1)  // the memory was allocated by cartesian planner and should be freed
-    {
-      // std::cout << "discreteState->value == 1 " << std::endl;
-      compoundSpace_->getSubspace(MODEL_BASED)->freeState(modelBasedState);
-    }
+void TaskGraph::freeVertexState(TaskVertex v)
+{
+  if (g_[v].state_ == nullptr)
+    return;
 
-    // Either way the Discrete state should be unloaded
-    // std::cout << "free discrete " << std::endl;
-    compoundSpace_->getSubspace(DISCRETE)->freeState(discreteState);
+  base::CompoundState *compoundState = g_[v].state_->as<base::CompoundState>();
+  base::DiscreteStateSpace::StateType *discreteState =
+      compoundState->as<base::DiscreteStateSpace::StateType>(DISCRETE);
+  base::State *modelBasedState = compoundState->as<base::DiscreteStateSpace::StateType>(MODEL_BASED);
 
-    // Delete the outer compound state
-    delete[] compoundState->components;
-    delete compoundState;
+  // Do not free the joint state data (ModelBasedStateSpace) if its part of the SPARS graph also
+  if (discreteState->value == 1)  // the memory was allocated by cartesian planner and should be freed
+  {
+    compoundSpace_->getSubspace(MODEL_BASED)->freeState(modelBasedState);
   }
 
-  g_.clear();
-  nn_->clear();
+  // Either way the Discrete state should be unloaded
+  compoundSpace_->getSubspace(DISCRETE)->freeState(discreteState);
+
+  // Delete the outer compound state
+  delete[] compoundState->components;
+  delete compoundState;
+  g_[v].state_ = nullptr;
 }
 
 void TaskGraph::initializeQueryState()
@@ -198,15 +204,20 @@ bool TaskGraph::astarSearch(const TaskVertex start, const TaskVertex goal, std::
     visual_->viz4()->deleteAllMarkers();
   }
 
+  // The task graph does not change between the repeated searches of lazy collision checking, only the collision
+  // state of its edges, so search a contiguous copy of it
+  if (!frozen_)
+    freezeGraph(indent);
+
   try
   {
-    boost::astar_search(g_, start,  // graph, start state
+    boost::astar_search(csr_, start,  // graph, start state
                         [this, goal](TaskVertex v)
                         {
                           return astarTaskHeuristic(v, goal);  // the heuristic
                         },
                         // ability to disable edges (set cost to inifinity):
-                        boost::weight_map(TaskEdgeWeightMap(g_))
+                        boost::weight_map(TaskCSREdgeWeightMap(csr_))
                             // boost::weight_map(boost::get(&TaskEdgeStruct::weight_, g_))
                             .predecessor_map(vertexPredecessors)
                             .distance_map(&vertexDistances[0])
@@ -272,6 +283,135 @@ bool TaskGraph::astarSearch(const TaskVertex start, const TaskVertex goal, std::
   return foundGoal;
 }
 
+bool TaskGraph::astarSearch(const std::vector<TaskVertex> &starts, const std::vector<double> &startCosts,
+                            const std::vector<TaskVertex> &goals, const std::vector<double> &goalCosts,
+                            std::vector<TaskVertex> &vertexPath, double &distance, std::size_t indent)
+{
+  BOLT_FUNC(indent, vSearch_, "TaskGraph.astarSearch() from " << starts.size() << " starts to " << goals.size()
+                                                               << " goals");
+  BOLT_ASSERT(starts.size() == startCosts.size(), "Every start needs a connection cost");
+  BOLT_ASSERT(goals.size() == goalCosts.size(), "Every goal needs a connection cost");
+
+  if (starts.empty() || goals.empty())
+    return false;
+
+#ifndef NDEBUG
+  // Reset statistics
+  numNodesOpened_ = 0;
+  numNodesClosed_ = 0;
+#endif
+
+  if (visualizeAstar_)
+  {
+    // Assume this was cleared by the parent program
+    visual_->viz4()->deleteAllMarkers();
+  }
+
+  if (!frozen_)
+    freezeGraph(indent);
+
+  // Connection cost of each goal, the lowest if a vertex was given more than once
+  std::map<TaskVertex, double> goalCostOf;
+  for (std::size_t i = 0; i < goals.size(); ++i)
+  {
+    auto inserted = goalCostOf.insert(std::make_pair(goals[i], goalCosts[i]));
+    if (!inserted.second)
+      inserted.first->second = std::min(inserted.first->second, goalCosts[i]);
+  }
+
+  // Holds the shortest path parent and distance of each vertex, reused between searches on this thread
+  SearchWorkspace &workspace = SearchWorkspace::getThreadWorkspace();
+  workspace.reset(getNumVertices());
+
+  // Admissible for the goals together with their connection costs. A vertex is evaluated every time it is discovered
+  // or expanded, so the minimum over the goals is only computed the first time in each search
+  auto heuristic = [this, &goalCostOf, &workspace](TaskVertex v)
+  {
+    if (!workspace.hasHeuristic(v))
+    {
+      double minimum = std::numeric_limits<double>::infinity();
+      for (const std::pair<const TaskVertex, double> &goal : goalCostOf)
+        minimum = std::min(minimum, astarTaskHeuristic(v, goal.first) + goal.second);
+      workspace.setHeuristic(v, minimum);
+    }
+    return workspace.getHeuristic(v);
+  };
+
+  // Seed with every start as if each were reached from a virtual source at its connection cost
+  for (std::size_t i = 0; i < starts.size(); ++i)
+  {
+    if (workspace.isDiscovered(starts[i]) && workspace.getDistance(starts[i]) <= startCosts[i])
+      continue;
+    workspace.discover(starts[i], startCosts[i], startCosts[i] + heuristic(starts[i]), starts[i]);
+  }
+
+  // The goals lead on to a virtual target at their connection cost, so the first goal expanded is not necessarily
+  // the best one. The search is finished once nothing left on the open list can beat the best goal expanded so far
+  TaskAstarStatisticsVisitor visitor(this);
+  TaskCSREdgeWeightMap weights(csr_);
+  double bestDistance = std::numeric_limits<double>::infinity();
+  TaskVertex bestGoal = goals.front();
+  TaskVertex v;
+  while (workspace.popOpen(v))
+  {
+    const double distanceV = workspace.getDistance(v);
+    if (distanceV + heuristic(v) >= bestDistance)
+      break;
+
+    visitor.examine_vertex(v, csr_);
+
+    std::map<TaskVertex, double>::const_iterator goal = goalCostOf.find(v);
+    if (goal != goalCostOf.end() && distanceV + goal->second < bestDistance)
+    {
+      bestDistance = distanceV + goal->second;
+      bestGoal = v;
+    }
+
+    foreach (const boost::graph_traits<TaskCSRGraph>::edge_descriptor e, boost::out_edges(v, csr_))
+    {
+      const TaskVertex u = boost::target(e, csr_);
+      if (workspace.isClosed(u))
+        continue;
+
+      // Edges found in collision have infinite weight
+      const double distanceU = distanceV + get(weights, e);
+      if (std::isinf(distanceU) || (workspace.isDiscovered(u) && workspace.getDistance(u) <= distanceU))
+        continue;
+
+#ifndef NDEBUG
+      if (!workspace.isDiscovered(u))
+        visitor.discover_vertex(u, csr_);
+#endif
+
+      workspace.discover(u, distanceU, distanceU + heuristic(u), v);
+    }
+  }
+
+  if (std::isinf(bestDistance))
+  {
+    BOLT_WARN(indent, vSearch_, "Did not find any goal");
+    return false;
+  }
+  distance = bestDistance;
+
+#ifndef NDEBUG
+  BOLT_DEBUG(indent, vSearch_, "AStar found solution. Distance to goal: " << distance);
+  BOLT_DEBUG(indent, vSearch_, "Number nodes opened: " << numNodesOpened_
+                                                       << ", Number nodes closed: " << numNodesClosed_);
+#endif
+
+  // Only clear the vertexPath after we know we have a new solution
+  vertexPath.clear();
+
+  // Trace back the shortest path in reverse, the start it came from is its own predecessor. When that start is
+  // also a goal the path is just this one vertex
+  for (v = bestGoal; v != workspace.getPredecessor(v); v = workspace.getPredecessor(v))
+    vertexPath.push_back(v);
+  vertexPath.push_back(v);
+
+  return true;
+}
+
 double TaskGraph::distanceVertex(const TaskVertex a, const TaskVertex b) const
 {
   // Special case: query vertices store their states elsewhere. Both cannot be query vertices
@@ -301,6 +441,34 @@ double TaskGraph::distanceState(const base::State *a, const base::State *b) cons
   return compoundSpace_->getSubspace(MODEL_BASED)->distance(getModelBasedState(a), getModelBasedState(b));
 }
 
+void TaskGraph::freezeGraph(std::size_t indent)
+{
+  BOLT_FUNC(indent, vSearch_, "TaskGraph.freezeGraph()");
+
+  // Store every undirected edge in both directions, pointing back to the original edge for its collision state
+  std::vector<std::pair<TaskVertex, TaskVertex> > endpoints;
+  std::vector<TaskCSREdgeStruct> properties;
+  endpoints.reserve(2 * getNumEdges());
+  properties.reserve(2 * getNumEdges());
+  foreach (const TaskEdge e, boost::edges(g_))
+  {
+    const TaskVertex v1 = boost::source(e, g_);
+    const TaskVertex v2 = boost::target(e, g_);
+    TaskCSREdgeStruct property;
+    property.weight_ = g_[e].weight_;
+    property.edge_ = &g_[e];
+
+    endpoints.push_back(std::make_pair(v1, v2));
+    properties.push_back(property);
+    endpoints.push_back(std::make_pair(v2, v1));
+    properties.push_back(property);
+  }
+
+  csr_ = TaskCSRGraph(boost::edges_are_unsorted_multi_pass, endpoints.begin(), endpoints.end(), properties.begin(),
+                      getNumVertices());
+  frozen_ = true;
+}
+
 double TaskGraph::astarTaskHeuristic(const TaskVertex a, const TaskVertex b) const
 {
   // Do not use task distance if that mode is not enabled
@@ -473,6 +641,15 @@ void TaskGraph::generateTaskSpace(std::size_t indent)
   BOLT_FUNC(indent, verbose_, "TaskGraph.generateTaskSpace()");
   time::point startTime = time::now();  // Benchmark
 
+  // Levels 0 and 2 only depend on the sparse graph, so a new task only has to replace the cartesian path
+  if (layersMatchSparseGraph() && removeTaskVertices(indent))
+  {
+    BOLT_DEBUG(indent, vGenerateTask_, "Reusing levels 0 and 2 of the task graph");
+    printGraphStats(time::seconds(time::now() - startTime), indent);
+    taskPlanningEnabled_ = true;
+    return;
+  }
+
   // Clear pre-existing graphs
   if (!isEmpty())
   {
@@ -481,10 +658,13 @@ void TaskGraph::generateTaskSpace(std::size_t indent)
   }
 
   // Record a mapping from SparseVertex to the two TaskVertices
-  std::vector<TaskVertex> sparseToTaskVertex0(sg_->getNumVertices());
-  std::vector<TaskVertex> sparseToTaskVertex2(sg_->getNumVertices());
+  const TaskVertex nullVertex = boost::graph_traits<TaskAdjList>::null_vertex();
+  sparseToTaskVertex0_.assign(sg_->getNumVertices(), nullVertex);
+  sparseToTaskVertex2_.assign(sg_->getNumVertices(), nullVertex);
 
-  // Loop through every vertex in sparse graph and copy twice to task graph
+  // Loop through every vertex in sparse graph and add it twice to task graph. The vertices point to the joint state
+  // in the sparse graph, and level 0 is not added to the nearest neighbor structure because nearestK() searches the
+  // one of the sparse graph
   BOLT_DEBUG(indent + 2, true || vGenerateTask_, "Adding " << 2 * sg_->getNumVertices() << " task space vertices");
   foreach (SparseVertex sparseV, boost::vertices(sg_->getGraph()))
   {
@@ -496,18 +676,21 @@ void TaskGraph::generateTaskSpace(std::size_t indent)
 
     // Create level 0 vertex
     const VertexLevel level0 = 0;
-    TaskVertex taskV0 = addVertexWithLevel(jointState, level0, indent);
-    sparseToTaskVertex0[sparseV] = taskV0;  // record mapping
+    const TaskVertex taskV0 = boost::add_vertex(g_);
+    g_[taskV0].state_ = createCompoundState(jointState, level0, indent);
+    sparseToTaskVertex0_[sparseV] = taskV0;  // record mapping
 
     // Create level 2 vertex
     const VertexLevel level2 = 2;
-    const TaskVertex taskV2 = addVertexWithLevel(jointState, level2, indent);
-    sparseToTaskVertex2[sparseV] = taskV2;  // record mapping
+    const TaskVertex taskV2 = boost::add_vertex(g_);
+    g_[taskV2].state_ = createCompoundState(jointState, level2, indent);
+    sparseToTaskVertex2_[sparseV] = taskV2;  // record mapping
 
     // Link the two vertices to each other for future bookkeeping
     g_[taskV0].task_mirror_ = taskV2;
     g_[taskV2].task_mirror_ = taskV0;
   }
+  frozen_ = false;
 
   // Loop through every edge in sparse graph and copy twice to task graph
   BOLT_DEBUG(indent + 2, true || vGenerateTask_, "Adding " << 2 * sg_->getNumEdges() << " task space edges");
@@ -517,12 +700,17 @@ void TaskGraph::generateTaskSpace(std::size_t indent)
     const SparseVertex &sparseE_v2 = boost::target(sparseE, sg_->getGraph());
 
     // Create level 0 edge
-    addEdge(sparseToTaskVertex0[sparseE_v0], sparseToTaskVertex0[sparseE_v2], indent);
+    addEdge(sparseToTaskVertex0_[sparseE_v0], sparseToTaskVertex0_[sparseE_v2], indent);
 
     // Create level 2 edge
-    addEdge(sparseToTaskVertex2[sparseE_v0], sparseToTaskVertex2[sparseE_v2], indent);
+    addEdge(sparseToTaskVertex2_[sparseE_v0], sparseToTaskVertex2_[sparseE_v2], indent);
   }
 
+  // Remember where the layers end so the next task can keep them
+  numLayerVertices_ = getNumVertices();
+  numLayerEdges_ = getNumEdges();
+  layerSparseModificationCount_ = sg_->getModificationCount();
+
   // Visualize
   // displayDatabase();
 
@@ -532,6 +720,74 @@ void TaskGraph::generateTaskSpace(std::size_t indent)
   taskPlanningEnabled_ = true;
 }
 
+bool TaskGraph::layersMatchSparseGraph() const
+{
+  // Counts alone miss a vertex or edge that was replaced by another, and states that moved in memory
+  return numLayerVertices_ > 0 && getNumVertices() >= numLayerVertices_ &&
+         layerSparseModificationCount_ == sg_->getModificationCount();
+}
+
+bool TaskGraph::removeTaskVertices(std::size_t indent)
+{
+  BOLT_FUNC(indent, vGenerateTask_, "TaskGraph.removeTaskVertices() " << getNumVertices() - numLayerVertices_
+                                                                      << " vertices");
+
+  // Vertices are stored in a vector, removing them from the back does not renumber the layers
+  while (getNumVertices() > numLayerVertices_)
+  {
+    const TaskVertex v = getNumVertices() - 1;
+    if (getTaskLevel(v) == 0)
+      nn_->remove(v);
+    freeVertexState(v);
+    boost::clear_vertex(v, g_);
+    boost::remove_vertex(v, g_);
+  }
+  frozen_ = false;
+
+  // Connectors from the previous cartesian path
+  startConnectorMinCost_ = std::numeric_limits<double>::infinity();
+  goalConnectorMinCost_ = std::numeric_limits<double>::infinity();
+
+  // Edges added between two layer vertices cannot be told apart from the layers
+  return getNumEdges() == numLayerEdges_;
+}
+
+void TaskGraph::nearestK(const base::State *state, std::size_t k, std::vector<TaskVertex> &neighbors,
+                         std::size_t threadID)
+{
+  neighbors.clear();
+
+  // Level 0 of the layers, found through the sparse graph
+  std::vector<SparseVertex> sparseNeighbors;
+  sg_->getQueryStateNonConst(threadID) = const_cast<base::State *>(getModelBasedState(state));
+  sg_->getNN()->nearestK(sg_->getQueryVertices(threadID), k, sparseNeighbors);
+  sg_->getQueryStateNonConst(threadID) = nullptr;
+
+  const TaskVertex nullVertex = boost::graph_traits<TaskAdjList>::null_vertex();
+  for (const SparseVertex sparseV : sparseNeighbors)
+  {
+    if (sparseV < sparseToTaskVertex0_.size() && sparseToTaskVertex0_[sparseV] != nullVertex)
+      neighbors.push_back(sparseToTaskVertex0_[sparseV]);
+  }
+
+  // Level 0 vertices that were added to the task graph directly
+  if (nn_->size() == 0)
+    return;
+
+  std::vector<TaskVertex> taskNeighbors;
+  queryStates_[threadID] = const_cast<base::State *>(state);
+  nn_->nearestK(queryVertices_[threadID], k, taskNeighbors);
+  queryStates_[threadID] = nullptr;
+
+  neighbors.insert(neighbors.end(), taskNeighbors.begin(), taskNeighbors.end());
+  std::sort(neighbors.begin(), neighbors.end(), [this, state](TaskVertex a, TaskVertex b)
+            {
+              return distanceState(state, getCompoundState(a)) < distanceState(state, getCompoundState(b));
+            });
+  if (neighbors.size() > k)
+    neighbors.resize(k);
+}
+
 bool TaskGraph::addCartPath(std::vector<base::State *> path, std::size_t indent)
 {
   BOLT_ERROR(indent, "TODO implement");
@@ -607,13 +863,13 @@ bool TaskGraph::addCartPath(std::vector<base::State *> path, std::size_t indent)
 }
 
 bool TaskGraph::connectVertexToNeighborsAtLevel(TaskVertex fromVertex, const VertexLevel level, bool isStart,
-                                                std::size_t indent)
+                                                std::size_t threadID, std::size_t indent)
 {
   BOLT_FUNC(indent, vGenerateTask_, "TaskGraph.connectVertexToNeighborsAtLevel()");
 
   // Get nearby states to goal
   std::vector<TaskVertex> neighbors;
-  getNeighborsAtLevel(fromVertex, level, numNeighborsConnectToCart_, neighbors, indent);
+  getNeighborsAtLevel(fromVertex, level, numNeighborsConnectToCart_, neighbors, threadID, indent);
 
   // Error check
   if (neighbors.empty())
@@ -654,19 +910,16 @@ bool TaskGraph::connectVertexToNeighborsAtLevel(TaskVertex fromVertex, const Ver
 }
 
 void TaskGraph::getNeighborsAtLevel(const TaskVertex origVertex, const VertexLevel level, const std::size_t kNeighbors,
-                                    std::vector<TaskVertex> &neighbors, std::size_t indent)
+                                    std::vector<TaskVertex> &neighbors, std::size_t threadID, std::size_t indent)
 {
   BOLT_FUNC(indent, vGenerateTask_, "TaskGraph.getNeighborsAtLevel()");
 
   BOLT_ASSERT(level != 1, "Unhandled level, does not support level 1");
 
-  const std::size_t threadID = 0;
   base::State *origState = getCompoundStateNonConst(origVertex);
 
   // Get nearby state
-  queryStates_[threadID] = origState;
-  nn_->nearestK(queryVertices_[threadID], kNeighbors, neighbors);
-  queryStates_[threadID] = nullptr;
+  nearestK(origState, kNeighbors, neighbors, threadID);
 
   /*
   // Run various checks
@@ -785,6 +1038,37 @@ void TaskGraph::clearEdgeCollisionStates()
     g_[e].collision_state_ = NOT_CHECKED;  // each edge has an unknown state
 }
 
+std::size_t TaskGraph::markEdgesInCollision(const std::vector<std::pair<SparseVertex, SparseVertex> > &sparseEdges,
+                                            std::size_t indent)
+{
+  BOLT_FUNC(indent, verbose_, "TaskGraph.markEdgesInCollision() " << sparseEdges.size() << " sparse edges");
+
+  std::size_t numMarked = 0;
+  const std::vector<TaskVertex> *levels[] = { &sparseToTaskVertex0_, &sparseToTaskVertex2_ };
+  for (const std::pair<SparseVertex, SparseVertex> &sparseEdge : sparseEdges)
+  {
+    for (const std::vector<TaskVertex> *sparseToTask : levels)
+    {
+      if (sparseEdge.first >= sparseToTask->size() || sparseEdge.second >= sparseToTask->size())
+        continue;
+      const TaskVertex v1 = (*sparseToTask)[sparseEdge.first];
+      const TaskVertex v2 = (*sparseToTask)[sparseEdge.second];
+      if (v1 == boost::graph_traits<TaskAdjList>::null_vertex() ||
+          v2 == boost::graph_traits<TaskAdjList>::null_vertex())
+        continue;
+
+      std::pair<TaskEdge, bool> edge = boost::edge(v1, v2, g_);
+      if (!edge.second)
+        continue;
+
+      g_[edge.first].collision_state_ = IN_COLLISION;
+      numMarked++;
+    }
+  }
+
+  return numMarked;
+}
+
 void TaskGraph::errorCheckDuplicateStates(std::size_t indent)
 {
   BOLT_ERROR(indent, "TaskGraph.errorCheckDuplicateStates() - NOT IMPLEMENTEDpart of super debug");
@@ -909,6 +1193,7 @@ TaskVertex TaskGraph::addVertex(base::State *state, std::size_t indent)
 {
   // Create vertex
   TaskVertex v = boost::add_vertex(g_);
+  frozen_ = false;
   BOLT_FUNC(indent, vAdd_, "TaskGraph.addVertex(): v: " << v);
 
   // Add properties
@@ -941,11 +1226,11 @@ void TaskGraph::removeVertex(TaskVertex v)
   nn_->remove(v);
 
   // Delete state
-  compoundSI_->freeState(g_[v].state_);
-  g_[v].state_ = NULL;
+  freeVertexState(v);
 
   // Remove all edges to and from vertex
   boost::clear_vertex(v, g_);
+  frozen_ = false;
 
   // We do not actually remove the vertex from the graph
   // because that would invalidate the nearest neighbor tree
@@ -954,6 +1239,7 @@ void TaskGraph::removeVertex(TaskVertex v)
 void TaskGraph::removeDeletedVertices(std::size_t indent)
 {
   BOLT_FUNC(indent, verbose_, "TaskGraph.removeDeletedVertices()");
+  frozen_ = false;
   bool verbose = true;
 
   // Remove all vertices that are set to 0
@@ -1023,6 +1309,7 @@ TaskEdge TaskGraph::addEdge(TaskVertex v1, TaskVertex v2, std::size_t indent)
 
   // Create the new edge
   TaskEdge e = (boost::add_edge(v1, v2, g_)).first;
+  frozen_ = false;
 
   // Weight properties
   g_[e].weight_ = distanceVertex(v1, v2);
@@ -1298,14 +1585,16 @@ BOOST_CONCEPT_ASSERT(
 
 // TaskAstarVisitor methods ////////////////////////////////////////////////////////////////////////////
 
+BOOST_CONCEPT_ASSERT((boost::AStarVisitorConcept<otb::TaskAstarStatisticsVisitor, otb::TaskCSRGraph>));
 BOOST_CONCEPT_ASSERT((boost::AStarVisitorConcept<otb::TaskAstarVisitor, otb::TaskAdjList>));
+BOOST_CONCEPT_ASSERT((boost::AStarVisitorConcept<otb::TaskAstarVisitor, otb::TaskCSRGraph>));
 
-otb::TaskAstarVisitor::TaskAstarVisitor(TaskVertex goal, TaskGraph *parent) : goal_(goal), parent_(parent)
+otb::TaskAstarStatisticsVisitor::TaskAstarStatisticsVisitor(TaskGraph *parent) : parent_(parent)
 {
 }
 
 #ifndef NDEBUG
-void otb::TaskAstarVisitor::discover_vertex(TaskVertex v, const TaskAdjList &) const
+void otb::TaskAstarStatisticsVisitor::discover_vertex(TaskVertex v, const TaskAdjList &) const
 {
   // Statistics
   parent_->recordNodeOpened();
@@ -1313,9 +1602,14 @@ void otb::TaskAstarVisitor::discover_vertex(TaskVertex v, const TaskAdjList &) c
   if (parent_->visualizeAstar_)
     parent_->getVisual()->viz4()->state(parent_->getModelBasedState(v), tools::SMALL, tools::GREEN, 1);
 }
+
+void otb::TaskAstarStatisticsVisitor::discover_vertex(TaskVertex v, const TaskCSRGraph &) const
+{
+  discover_vertex(v, parent_->getGraph());
+}
 #endif
 
-void otb::TaskAstarVisitor::examine_vertex(TaskVertex v, const TaskAdjList &) const
+void otb::TaskAstarStatisticsVisitor::examine_vertex(TaskVertex v, const TaskAdjList &) const
 {
 #ifndef NDEBUG
   parent_->recordNodeClosed();  // Statistics
@@ -1336,7 +1630,27 @@ void otb::TaskAstarVisitor::examine_vertex(TaskVertex v, const TaskAdjList &) co
     parent_->getVisual()->waitForUserFeedback("astar");
   }
 #endif
+}
+
+void otb::TaskAstarStatisticsVisitor::examine_vertex(TaskVertex v, const TaskCSRGraph &) const
+{
+  examine_vertex(v, parent_->getGraph());
+}
+
+otb::TaskAstarVisitor::TaskAstarVisitor(TaskVertex goal, TaskGraph *parent)
+  : TaskAstarStatisticsVisitor(parent), goal_(goal)
+{
+}
+
+void otb::TaskAstarVisitor::examine_vertex(TaskVertex v, const TaskAdjList &g) const
+{
+  TaskAstarStatisticsVisitor::examine_vertex(v, g);
 
   if (v == goal_)
     throw FoundGoalException();
 }
+
+void otb::TaskAstarVisitor::examine_vertex(TaskVertex v, const TaskCSRGraph &) const
+{
+  examine_vertex(v, parent_->getGraph());
+}
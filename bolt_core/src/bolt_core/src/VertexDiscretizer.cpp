@@ -160,63 +160,58 @@ void VertexDiscretizer::generateVertices(std::size_t indent)
 
   std::size_t dim = si_->getStateSpace()->getDimension();
 
-  // Setup bounds for joint 0
   ob::RealVectorBounds bounds = si_->getStateSpace()->getBounds();
   assert(bounds.high.size() == bounds.low.size());
   assert(bounds.high.size() == dim);
 
-  // Divide joint 0 between threads
-  const std::size_t jointID = 0;
-  const double range = bounds.high[jointID] - bounds.low[jointID] - startingValueOffset_;
-  const std::size_t jointIncrements = ceil(range / discretization_);
+  // Values of each joint
+  jointValues_.assign(dim, std::vector<double>());
+  numLatticePoints_ = 1;
+  for (std::size_t jointID = 0; jointID < dim; ++jointID)
+  {
+    // Special rule for 12dof: skip joint id 5 (joint 6), leaving it in its middle rotation
+    if (dim == 12 && jointID == 5)
+    {
+      jointValues_[jointID].push_back(0.0);
+      continue;
+    }
 
-  assert(jointIncrements >= 1);
+    BOLT_ASSERT(bounds.high[jointID] - bounds.low[jointID] > discretization_, "Bounds too small");
+
+    for (double value = bounds.low[jointID] + startingValueOffset_; value <= bounds.high[jointID];
+         value += discretization_)
+      jointValues_[jointID].push_back(value);
+
+    if (numLatticePoints_ > std::numeric_limits<std::size_t>::max() / jointValues_[jointID].size())
+      throw Exception(name_, "Too many lattice points at current discretization");
+    numLatticePoints_ *= jointValues_[jointID].size();
+  }
 
-  // Check that we have enough jointIncrements for all the threads
-  if (jointIncrements < numThreads_)
+  // Give each thread an equal share of the index space to start with
+  workRanges_.clear();
+  for (std::size_t i = 0; i < numThreads_; ++i)
   {
-    BOLT_DEBUG(indent, verbose_, "There are fewer joint_0 increments ("
-                                     << jointIncrements << ") at current discretization (" << discretization_
-                                     << ") than available threads (" << numThreads_ << "), underutilizing threading");
-    BOLT_DEBUG(indent, verbose_, "Optimal discretization for thread count: " << range / double(numThreads_));
-    numThreads_ = jointIncrements;
+    workRanges_.push_back(std::make_shared<WorkRange>());
+    workRanges_.back()->begin_ = numLatticePoints_ * i / numThreads_;
+    workRanges_.back()->end_ = numLatticePoints_ * (i + 1) / numThreads_;
   }
-  std::size_t jointIncrementsPerThread = jointIncrements / numThreads_;
 
   BOLT_DEBUG(indent, verbose_, "-------------------------------------------------------");
   BOLT_DEBUG(indent, verbose_, "Single-Pass Discretization: ");
   BOLT_DEBUG(indent, verbose_, "  Dimensions:             " << dim);
   BOLT_DEBUG(indent, verbose_, "  Discretization:         " << discretization_);
-  BOLT_DEBUG(indent, verbose_, "  J0 Low:                 " << bounds.low[jointID]);
-  BOLT_DEBUG(indent, verbose_, "  J0 High:                " << bounds.high[jointID]);
-  BOLT_DEBUG(indent, verbose_, "  J0 Range:               " << range);
-  BOLT_DEBUG(indent, verbose_, "  J0 Increments:          " << jointIncrements);
-  BOLT_DEBUG(indent, verbose_, "  J0 IncrementsPerThread: " << jointIncrementsPerThread);
-  BOLT_DEBUG(indent, verbose_, "  Total states:           " << pow(jointIncrements, dim));
+  BOLT_DEBUG(indent, verbose_, "  J0 Increments:          " << jointValues_[0].size());
+  BOLT_DEBUG(indent, verbose_, "  Total states:           " << numLatticePoints_);
+  BOLT_DEBUG(indent, verbose_, "  Chunk size:             " << chunkSize_);
   BOLT_DEBUG(indent, verbose_, "  Num Threads:            " << numThreads_);
   BOLT_DEBUG(indent, verbose_, "-------------------------------------------------------");
 
   // Setup threading
   std::vector<boost::thread *> threads(numThreads_);
 
-  double startJointValue = bounds.low[jointID] + startingValueOffset_;
-  double endJointValue;
-
   // For each thread
   for (std::size_t i = 0; i < threads.size(); ++i)
   {
-    endJointValue = startJointValue + (jointIncrementsPerThread - 1) * discretization_;
-
-    // Check if this is the last thread
-    if (i == threads.size() - 1)
-    {
-      // have it do remaining bounds
-      endJointValue = bounds.high[jointID];
-    }
-
-    BOLT_DEBUG(indent, vThread_, "Thread " << i << " will process Joint 0 values from " << startJointValue << " to "
-                                           << endJointValue);
-
     base::SpaceInformationPtr si(new base::SpaceInformation(si_->getStateSpace()));
     si->setStateValidityChecker(si_->getStateValidityChecker());
     si->setMotionValidator(si_->getMotionValidator());
@@ -227,10 +222,7 @@ void VertexDiscretizer::generateVertices(std::size_t indent)
       si->getStateValidityChecker()->setVisual(visual_);
     }
 
-    threads[i] = new boost::thread(
-        boost::bind(&VertexDiscretizer::generateVerticesThread, this, i, startJointValue, endJointValue, si, indent));
-
-    startJointValue = endJointValue + discretization_;
+    threads[i] = new boost::thread(boost::bind(&VertexDiscretizer::generateVerticesThread, this, i, si, indent));
   }
 
   // Join threads
@@ -239,132 +231,130 @@ void VertexDiscretizer::generateVertices(std::size_t indent)
     threads[i]->join();
     delete threads[i];
   }
+  workRanges_.clear();
+
   // Clear the visualization cache
   visual_->viz1()->trigger();
 }
 
-void VertexDiscretizer::generateVerticesThread(std::size_t threadID, double startJointValue, double endJointValue,
-                                               base::SpaceInformationPtr si, std::size_t indent)
+void VertexDiscretizer::generateVerticesThread(std::size_t threadID, base::SpaceInformationPtr si,
+                                               std::size_t indent)
 {
   BOLT_FUNC(indent, vThread_, "generateVerticesThread()");
 
-  std::size_t jointID = 0;
-  ob::RealVectorBounds bounds = si->getStateSpace()->getBounds();
   base::State *candidateState = si->getStateSpace()->allocState();
-
-  // Prepare for recursion
   std::vector<double> values(si->getStateSpace()->getDimension(), /*default value*/ 0);
 
-  // Customize for different state spaces TODO more generic
-  const std::size_t dim = si->getStateSpace()->getDimension();
-  std::size_t maxDiscretizationLevel = dim - 1;
-
-  // if (dim == 6 && false)
-  // {
-  //   maxDiscretizationLevel = dim - 2;  // don't discretize the wrist rotation
-  //   values[5] = 0.0;                   // middle rotation of wrist
-  // }
-  // else if (dim == 12 && false)
-  // {
-  //   maxDiscretizationLevel = dim - 2;  // don't discretize the wrist rotation
-  //   values[5] = 0.0;                   // middle rotation of wrist
-  //   values[11] = 0.0;                  // middle rotation of wrist
-  // }
-
-  // Loop through current joint
-  for (double value = startJointValue; value <= endJointValue; value += discretization_)
+  // Valid states of the current chunk, added to the graph together
+  std::vector<base::State *> batch;
+
+  std::size_t begin;
+  std::size_t end;
+  while (takeChunk(threadID, begin, end))
   {
-    // User feedback on thread 0
-    if (threadID == numThreads_ - 1)
+    for (std::size_t index = begin; index < end; ++index)
     {
-      const double percent = (value - startJointValue) / (endJointValue - startJointValue) * 100.0;
-      BOLT_DEBUG(indent, vThread_, "Vertex generation progress: " << std::setprecision(1) << percent
-                                                                  << " % Total vertices: "
-                                                                  << (verticesAdded_ > 0 ? verticesAdded_ - 1 : 0));
+      getLatticePoint(index, values);
+
+      if (checkState(values, si, candidateState, indent))
+        batch.push_back(si->cloneState(candidateState));
     }
 
-    // Set first joint value
-    values[jointID] = value;
+    // Add to graph
+    {
+      boost::unique_lock<boost::mutex> scoped_lock(sparseGraphMutex_);
+      sg_->addVertices(batch, DISCRETIZED, indent);
+      verticesAdded_ += batch.size();
+    }
+    batch.clear();
 
-    // Keep recursing
-    recursiveDiscretization(threadID, values, jointID + 1, si, candidateState, maxDiscretizationLevel, indent);
+    // User feedback on thread 0
+    if (threadID == 0)
+    {
+      BOLT_DEBUG(indent, vThread_, "Vertex generation at lattice point " << end << " of " << numLatticePoints_
+                                                                         << " Total vertices: " << verticesAdded_);
+    }
+
+    // Check for shutdown
+    if (visual_->viz1()->shutdownRequested())
+      exit(0);
   }
 
   // Cleanup
   si->freeState(candidateState);
 }
 
-void VertexDiscretizer::recursiveDiscretization(std::size_t threadID, std::vector<double> &values, std::size_t jointID,
-                                                base::SpaceInformationPtr si, base::State *candidateState,
-                                                std::size_t maxDiscretizationLevel, std::size_t indent)
+bool VertexDiscretizer::takeChunk(std::size_t threadID, std::size_t &begin, std::size_t &end)
 {
-  BOLT_FUNC(indent, vThread_, "recursiveDiscretization()");
-
-  ob::RealVectorBounds bounds = si->getStateSpace()->getBounds();
-
-  // Error check
-  BOLT_ASSERT(jointID < values.size(), "Joint ID too high");
-  BOLT_ASSERT(bounds.high[jointID] - bounds.low[jointID] > discretization_, "Bounds too small");
-
-  // Loop through current joint
-  for (double value = bounds.low[jointID] + startingValueOffset_; value <= bounds.high[jointID];
-       value += discretization_)
+  WorkRange &own = *workRanges_[threadID];
+  while (true)
   {
-    // User feedback on thread 0 for high dimension spaces
-    if (jointID == 1 && threadID == 0 && si->getStateSpace()->getDimension() > 3)
-    {
-      const double percent = (value - bounds.low[jointID]) / (bounds.high[jointID] - bounds.low[jointID]) * 100.0;
-
-      BOLT_DEBUG(indent, vThread_, "Level 1 vertex generation progress: "
-                                       << std::setprecision(1) << percent
-                                       << " % Total vertices: " << (verticesAdded_ > 0 ? verticesAdded_ - 1 : 0));
-    }
-
-    // Set value
-    values[jointID] = value;
-
-    // Check if we are at the end of the recursion
-    BOLT_DEBUG(indent, vThread_, "threadID " << threadID << " jointID " << jointID << " of " << maxDiscretizationLevel
-                                             << " --- ");
-    BOLT_DEBUG(indent, vThread_, "value: " << value << " high: " << bounds.high[jointID]
-                                           << " low: " << bounds.low[jointID] << " disc: " << discretization_
-                                           << " values.size() " << values.size());
-    if (vThread_)
     {
-      std::copy(values.begin(), values.end(), std::ostream_iterator<double>(std::cout, ", "));
-      std::cout << std::endl;
+      boost::unique_lock<boost::mutex> lock(own.mutex_);
+      if (own.begin_ < own.end_)
+      {
+        begin = own.begin_;
+        end = std::min(own.end_, begin + chunkSize_);
+        own.begin_ = end;
+        return true;
+      }
     }
 
-    if (jointID < maxDiscretizationLevel)
+    // Find the thread with the most work left
+    std::size_t victim = threadID;
+    std::size_t mostRemaining = 0;
+    for (std::size_t i = 0; i < workRanges_.size(); ++i)
     {
-      // Keep recursing
-
-      // Special rule for 12dof
-      if (si->getStateSpace()->getDimension() == 12 && jointID == 4)
+      boost::unique_lock<boost::mutex> lock(workRanges_[i]->mutex_);
+      const std::size_t remaining = workRanges_[i]->end_ - workRanges_[i]->begin_;
+      if (remaining > mostRemaining)
       {
-        // skip joint id 5 (joint 6)
-        recursiveDiscretization(threadID, values, jointID + 2, si, candidateState, maxDiscretizationLevel, indent);
-      }
-      else  // regular treatment
-      {
-        recursiveDiscretization(threadID, values, jointID + 1, si, candidateState, maxDiscretizationLevel, indent);
+        mostRemaining = remaining;
+        victim = i;
       }
     }
-    else  // this is the end of recursion, create a new state
-    {
-      createState(threadID, values, si, candidateState, indent);
+    if (mostRemaining == 0)
+      return false;
 
-      // Check for shutdown
-      if (visual_->viz1()->shutdownRequested())
-        exit(0);
+    // Steal the back half of its range, or all of it if only one chunk is left
+    std::size_t stolenBegin;
+    std::size_t stolenEnd;
+    {
+      boost::unique_lock<boost::mutex> lock(workRanges_[victim]->mutex_);
+      WorkRange &range = *workRanges_[victim];
+      if (range.begin_ >= range.end_)
+        continue;  // finished in the meantime, look again
+
+      const std::size_t remaining = range.end_ - range.begin_;
+      stolenEnd = range.end_;
+      stolenBegin = remaining <= chunkSize_ ? range.begin_ : range.end_ - remaining / 2;
+      range.end_ = stolenBegin;
     }
+
+    BOLT_DEBUG(0, vThread_, "Thread " << threadID << " stole lattice points " << stolenBegin << " to " << stolenEnd
+                                      << " from thread " << victim);
+
+    boost::unique_lock<boost::mutex> lock(own.mutex_);
+    own.begin_ = stolenBegin;
+    own.end_ = stolenEnd;
   }
 }
 
-void VertexDiscretizer::createState(std::size_t threadID, std::vector<double> &values, base::SpaceInformationPtr si,
-                                    base::State *candidateState, std::size_t indent)
+void VertexDiscretizer::getLatticePoint(std::size_t index, std::vector<double> &values) const
 {
-  BOLT_FUNC(indent, vThread_, "createState()");
+  // The last joint changes fastest
+  for (std::size_t jointID = jointValues_.size(); jointID-- > 0;)
+  {
+    const std::vector<double> &jointValues = jointValues_[jointID];
+    values[jointID] = jointValues[index % jointValues.size()];
+    index /= jointValues.size();
+  }
+}
+
+bool VertexDiscretizer::checkState(std::vector<double> &values, base::SpaceInformationPtr si,
+                                   base::State *candidateState, std::size_t indent)
+{
+  BOLT_FUNC(indent, vThread_, "checkState()");
 
   // Fill the state with current values
   si->getStateSpace()->copyFromReals(candidateState, values);
@@ -401,7 +391,7 @@ void VertexDiscretizer::createState(std::size_t threadID, std::vector<double> &v
       // usleep(0.001 * 1000000);
     }
 
-    return;
+    return false;
   }
 
   if (visualizeDistanceToCollision_)
@@ -431,19 +421,12 @@ void VertexDiscretizer::createState(std::size_t threadID, std::vector<double> &v
         //   usleep(0.001 * 1000000);
       }
 
-      return;
+      return false;
     }
     else
       BOLT_GREEN(indent, vThread_, "Accepted, actual distance to obstacle: " << dist);
   }
 
-  // Add to graph
-  {
-    boost::unique_lock<boost::mutex> scoped_lock(sparseGraphMutex_);
-    sg_->addVertex(si->cloneState(candidateState), DISCRETIZED, indent);
-    verticesAdded_++;
-  }
-
   // Visualize
   if (visualizeGridGeneration_)
   {
@@ -457,6 +440,8 @@ void VertexDiscretizer::createState(std::size_t threadID, std::vector<double> &v
     // else
     //   usleep(0.01 * 1000000);
   }
+
+  return true;
 }
 
 }  // namespace
@@ -576,6 +576,9 @@ bool CartPathPlanner::connectTrajectoryEndPoints(const TrajectoryGraph& graph_ve
   const std::vector<ompl::tools::bolt::TaskVertex>& start_vertices = graph_vertices.front();
   const std::vector<ompl::tools::bolt::TaskVertex>& goal_vertices = graph_vertices.back();
 
+  // The task graph is built on this thread, so it searches with the first query slot
+  const std::size_t threadID = 0;
+
   // Loop through all start points
   ROS_INFO_STREAM_NAMED(name_, "Connecting Cartesian start points to TaskGraph");
   for (const ompl::tools::bolt::TaskVertex& start_vertex : start_vertices)
@@ -583,7 +586,7 @@ bool CartPathPlanner::connectTrajectoryEndPoints(const TrajectoryGraph& graph_ve
     // Connect to TaskGraph
     const ompl::tools::bolt::VertexLevel level0 = 0;
     bool isStart = true;
-    if (!task_graph_->connectVertexToNeighborsAtLevel(start_vertex, level0, isStart, indent))
+    if (!task_graph_->connectVertexToNeighborsAtLevel(start_vertex, level0, isStart, threadID, indent))
     {
       OMPL_WARN("Failed to connect start vertex");
       return false;  // TODO(davetcoleman): return here?
@@ -613,7 +616,7 @@ bool CartPathPlanner::connectTrajectoryEndPoints(const TrajectoryGraph& graph_ve
     // Connect to TaskGraph
     const ompl::tools::bolt::VertexLevel level2 = 2;
     bool isStart = false;
-    if (!task_graph_->connectVertexToNeighborsAtLevel(goal_vertex, level2, isStart, indent))
+    if (!task_graph_->connectVertexToNeighborsAtLevel(goal_vertex, level2, isStart, threadID, indent))
     {
       OMPL_WARN("Failed to connect Descartes goal vertex");
       return false;  // TODO(davetcoleman): return here?
@@ -42,10 +42,14 @@
 // ROS
 #include <ros/ros.h>
 
+// C++
+#include <mutex>
+
 // MoveIt
 #include <moveit/planning_interface/planning_interface.h>
 #include <moveit/robot_state/conversions.h>
 #include <moveit/kinematic_constraints/utils.h>
+#include <moveit/collision_detection/collision_world.h>
 #include <bolt_moveit/moveit_base.h>
 
 // moveit_ompl
@@ -58,6 +62,7 @@
 // OMPL
 #include <ompl/tools/thunder/Thunder.h>
 #include <bolt_core/Bolt.h>
+#include <bolt_core/ProductGraph.h>
 #include <bolt_moveit/moveit_viz_window.h>
 
 // this package
@@ -124,10 +129,43 @@ public:
 
   void mirrorGraph(std::size_t indent);
 
+  /** \brief Plan for both arms on the product of the single arm graph with its mirror, without generating it */
+  void planDualArm(ob::SpaceInformationPtr both_arms_space_info, ob::SpaceInformationPtr left_arm_space_info,
+                   std::size_t indent);
+
+  /**
+   * \brief Find the product graph vertex nearest to the pose of both arms in a robot state
+   * \param both_arms_state - set to a new state of both arms at their pose in \e robot_state, owned by the caller
+   * \return false if the single arm graph is empty
+   */
+  bool findDualArmVertex(ompl::tools::bolt::ProductGraph& product_graph, const moveit::core::RobotState& robot_state,
+                         ompl::tools::bolt::ProductVertex& vertex, ob::State*& both_arms_state, std::size_t indent);
+
   ob::State* combineStates(const ob::State* state1, const ob::State* state2);
 
   void benchmarkMemoryAllocation(std::size_t indent);
 
+  /** \brief Hash of the geometry and pose of every world object, and of the attached objects, allowed collisions,
+   *         padding and clearance, for reusing collision checked edges */
+  ompl::tools::bolt::SceneFingerprint getSceneFingerprint();
+
+  /** \brief Check if the robot comes within the edge clearance of any of the named world objects while moving
+   *         between two states */
+  bool edgeTouchesObjects(const ob::State* s1, const ob::State* s2, const std::vector<std::string>& object_ids);
+
+  /** \brief Clearance from obstacles the motion validator requires along edges */
+  double getEdgeClearance();
+
+  /** \brief Id of the voxel of size edge_occupancy_resolution_ containing a workspace point */
+  boost::uint64_t getVoxel(const Eigen::Vector3d& point);
+
+  /** \brief Voxels holding the origin of a collision shape of the arm anywhere along the motion between two states */
+  void getSweptVoxels(const ob::State* s1, const ob::State* s2, std::vector<boost::uint64_t>& voxels);
+
+  /** \brief Voxels lying completely inside a world object inflated by the link padding, skipping objects the allowed
+   *         collision matrix lets the arm touch */
+  std::vector<boost::uint64_t> getObstacleVoxels();
+
   // --------------------------------------------------------
 
   // A shared node handle
@@ -156,6 +194,7 @@ public:
   moveit_ompl::ModelBasedStateSpacePtr both_arms_state_space_;
   moveit_ompl::ModelBasedStateSpacePtr left_arm_state_space_;
   moveit::core::RobotStatePtr mirror_state_;
+  std::mutex mirror_state_mutex_;
 
   // The visual tools for interfacing with Rviz
   std::vector<bolt_moveit::MoveItVizWindowPtr> vizs_;
@@ -210,6 +249,7 @@ public:
   bool mirror_graph_;
   std::string opposite_arm_name_;
   std::string both_arms_group_name_;
+  bool implicit_mirror_graph_ = false;
 
   // Fill in dimension
   // bool fill_in_dim_;
@@ -224,6 +264,7 @@ public:
   bool track_memory_consumption_ = false;
   bool use_logging_ = false;
   bool collision_checking_enabled_ = true;
+  double edge_occupancy_resolution_ = 0.1;
 
   double velocity_scaling_factor_ = 0.2;
   bool connect_to_hardware_ = false;
@@ -256,6 +297,16 @@ public:
 
   // Validity checker
   moveit_ompl::StateValidityChecker* validity_checker_;
+
+  // Collision world of only the objects that changed since the edge validity cache was built
+  collision_detection::CollisionWorldPtr changed_objects_world_;
+  std::vector<std::string> changed_object_ids_;
+  moveit::core::RobotStatePtr edge_check_state_;
+  ob::State* edge_check_ompl_state_ = nullptr;
+
+  // Scratch states for sweeping edges through the workspace
+  moveit::core::RobotStatePtr sweep_state_;
+  ob::State* sweep_ompl_state_ = nullptr;
 };  // end class
 
 // Create boost pointers for this class
@@ -43,6 +43,7 @@
 
 // OMPL
 #include <bolt_core/SparseMirror.h>
+#include <ompl/base/DiscreteMotionValidator.h>
 
 // this package
 #include <bolt_moveit/bolt_moveit.h>
@@ -53,9 +54,20 @@
 
 #include <moveit_ompl/model_size_state_space.h>
 
+// MoveIt
+#include <moveit/collision_detection_fcl/collision_world_fcl.h>
+#include <geometric_shapes/shape_operations.h>
+#include <geometric_shapes/bodies.h>
+#include <geometric_shapes/body_operations.h>
+#include <boost/scoped_ptr.hpp>
+
 // Profiling
 #include <valgrind/callgrind.h>
 
+// C++
+#include <algorithm>
+#include <limits>
+
 namespace ob = ompl::base;
 namespace ot = ompl::tools;
 namespace otb = ompl::tools::bolt;
@@ -96,6 +108,7 @@ BoltMoveIt::BoltMoveIt(const std::string &hostname, const std::string &package_p
   error += !rosparam_shortcuts::get(name_, rpnh, "mirror_graph", mirror_graph_);
   error += !rosparam_shortcuts::get(name_, rpnh, "opposite_arm_name", opposite_arm_name_);
   error += !rosparam_shortcuts::get(name_, rpnh, "both_arms_group_name", both_arms_group_name_);
+  error += !rosparam_shortcuts::get(name_, rpnh, "implicit_mirror_graph", implicit_mirror_graph_);
 
   // fill in last dimension
   // error += !rosparam_shortcuts::get(name_, rpnh, "fill_in_dim", fill_in_dim_);
@@ -116,6 +129,7 @@ BoltMoveIt::BoltMoveIt(const std::string &hostname, const std::string &package_p
   error += !rosparam_shortcuts::get(name_, rpnh, "post_processing_interval", post_processing_interval_);
   error += !rosparam_shortcuts::get(name_, rpnh, "use_logging", use_logging_);
   error += !rosparam_shortcuts::get(name_, rpnh, "collision_checking_enabled", collision_checking_enabled_);
+  error += !rosparam_shortcuts::get(name_, rpnh, "edge_occupancy_resolution", edge_occupancy_resolution_);
   // execution
   error += !rosparam_shortcuts::get(name_, rpnh, "connect_to_hardware", connect_to_hardware_);
   error += !rosparam_shortcuts::get(name_, rpnh, "velocity_scaling_factor", velocity_scaling_factor_);
@@ -285,6 +299,10 @@ BoltMoveIt::~BoltMoveIt()
   // Free start and goal states
   space_->freeState(ompl_start_);
   space_->freeState(ompl_goal_);
+  if (edge_check_ompl_state_)
+    space_->freeState(edge_check_ompl_state_);
+  if (sweep_ompl_state_)
+    space_->freeState(sweep_ompl_state_);
 }
 
 bool BoltMoveIt::loadOMPL()
@@ -324,6 +342,11 @@ bool BoltMoveIt::loadOMPL()
   // this is here because its how we do it in moveit_ompl
   bolt_->setFilePath(getFilePath(planning_group_name_));
 
+  // Only re-check cached edges near objects that changed since they were checked
+  otb::EdgeValidityCachePtr edge_cache = bolt_->getSparseGraph()->getEdgeValidityCache();
+  if (edge_cache)
+    edge_cache->setEdgeAffectedFn(boost::bind(&BoltMoveIt::edgeTouchesObjects, this, _1, _2, _3));
+
   // Create start and goal states
   ompl_start_ = space_->allocState();
   ompl_goal_ = space_->allocState();
@@ -368,6 +391,16 @@ bool BoltMoveIt::loadData(std::size_t indent)
       ROS_INFO_STREAM_NAMED(name_, "Unable to load sparse graph from file");
       return false;
     }
+
+    // Index which edges pass through which workspace voxels, once per graph
+    otb::SparseGraphPtr sg = bolt_->getSparseGraph();
+    otb::EdgeOccupancyIndexPtr occupancy = sg->getEdgeOccupancyIndex();
+    if (occupancy && !occupancy->load(sg->getFilePath(), edge_occupancy_resolution_, indent))
+    {
+      occupancy->build(boost::bind(&BoltMoveIt::getSweptVoxels, this, _1, _2, _3), edge_occupancy_resolution_,
+                       indent);
+      occupancy->save(sg->getFilePath(), indent);
+    }
   }
 
   if (track_memory_consumption_)  // Track memory usage
@@ -598,6 +631,16 @@ bool BoltMoveIt::plan(std::size_t indent)
   // Set the start and goal states
   bolt_->setStartAndGoalStates(ompl_start_, ompl_goal_);
 
+  // Edges found free in earlier sessions can be skipped if the obstacles are the same
+  otb::EdgeValidityCachePtr edge_cache = bolt_->getSparseGraph()->getEdgeValidityCache();
+  if (is_bolt_ && edge_cache)
+    edge_cache->setScene(getSceneFingerprint(), indent);
+
+  // Edges through space that is filled by obstacles are known to be invalid without checking them
+  otb::EdgeOccupancyIndexPtr occupancy = bolt_->getSparseGraph()->getEdgeOccupancyIndex();
+  if (is_bolt_ && occupancy && occupancy->isValid())
+    bolt_->getBoltPlanner()->setObstacleVoxels(getObstacleVoxels());
+
   // Solve -----------------------------------------------------------
 
   // Create the termination condition
@@ -672,6 +715,321 @@ bool BoltMoveIt::plan(std::size_t indent)
   return true;
 }
 
+namespace
+{
+/** \brief Mix \e values into a FNV-1a hash */
+boost::uint64_t hashValues(boost::uint64_t hash, const double *values, std::size_t count)
+{
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(values);
+  for (std::size_t i = 0; i < count * sizeof(double); ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/** \brief Mix the characters of \e text into a FNV-1a hash */
+boost::uint64_t hashString(boost::uint64_t hash, const std::string &text)
+{
+  for (const char c : text)
+  {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+  const double terminator = 0;  // so that "ab", "c" differs from "a", "bc"
+  return hashValues(hash, &terminator, 1);
+}
+
+/** \brief Mix the geometry and poses of some collision shapes into a FNV-1a hash */
+boost::uint64_t hashShapes(boost::uint64_t hash, const std::vector<shapes::ShapeConstPtr> &shapes,
+                           const EigenSTL::vector_Affine3d &poses)
+{
+  for (std::size_t i = 0; i < shapes.size(); ++i)
+  {
+    const shapes::Shape *shape = shapes[i].get();
+    const double type = static_cast<double>(shape->type);
+    hash = hashValues(hash, &type, 1);
+
+    const Eigen::Vector3d extents = shapes::computeShapeExtents(shape);
+    hash = hashValues(hash, extents.data(), 3);
+    if (shape->type == shapes::MESH)
+    {
+      const shapes::Mesh *mesh = static_cast<const shapes::Mesh *>(shape);
+      hash = hashValues(hash, mesh->vertices, 3 * mesh->vertex_count);
+    }
+
+    hash = hashValues(hash, poses[i].matrix().data(), 16);
+  }
+  return hash;
+}
+
+/** \brief Whether the origin of a collision shape is certainly inside of it, which is not so for meshes */
+bool isPrimitiveShape(const shapes::Shape *shape)
+{
+  return shape->type == shapes::BOX || shape->type == shapes::SPHERE || shape->type == shapes::CYLINDER ||
+         shape->type == shapes::CONE;
+}
+
+/** \brief Whether the allowed collision matrix may let two bodies touch, either by their own entry or by a default
+ *         entry of either one. Conditional entries count as allowed */
+bool isCollisionAllowed(const collision_detection::AllowedCollisionMatrix &acm, const std::string &name1,
+                        const std::string &name2)
+{
+  collision_detection::AllowedCollision::Type type;
+  if (acm.getEntry(name1, name2, type))
+    return type != collision_detection::AllowedCollision::NEVER;
+  if (acm.getDefaultEntry(name1, type) && type != collision_detection::AllowedCollision::NEVER)
+    return true;
+  return acm.getDefaultEntry(name2, type) && type != collision_detection::AllowedCollision::NEVER;
+}
+}  // namespace
+
+otb::SceneFingerprint BoltMoveIt::getSceneFingerprint()
+{
+  otb::SceneFingerprint fingerprint;
+  const boost::uint64_t empty_hash = 14695981039346656037ULL;
+
+  const collision_detection::WorldConstPtr &world = planning_scene_->getWorld();
+  for (const std::string &id : world->getObjectIds())
+  {
+    collision_detection::World::ObjectConstPtr object = world->getObject(id);
+    fingerprint[id] = hashShapes(empty_hash, object->shapes_, object->shape_poses_);
+  }
+
+  // The entries below are not world objects, so edgeTouchesObjects() reports that a change to any of them affects
+  // every edge
+
+  // Objects attached to the robot move with it
+  std::vector<const moveit::core::AttachedBody *> attached_bodies;
+  planning_scene_->getCurrentState().getAttachedBodies(attached_bodies);
+  for (const moveit::core::AttachedBody *body : attached_bodies)
+  {
+    boost::uint64_t hash = hashString(empty_hash, body->getAttachedLinkName());
+    for (const std::string &link : body->getTouchLinks())
+      hash = hashString(hash, link);
+    fingerprint["<attached> " + body->getName()] = hashShapes(hash, body->getShapes(), body->getFixedTransforms());
+  }
+
+  // Pairs that are allowed to collide, a pair that no longer is may put free edges in collision
+  const collision_detection::AllowedCollisionMatrix &acm = planning_scene_->getAllowedCollisionMatrix();
+  std::vector<std::string> entry_names;
+  acm.getAllEntryNames(entry_names);
+  boost::uint64_t acm_hash = empty_hash;
+  for (const std::string &name1 : entry_names)
+  {
+    collision_detection::AllowedCollision::Type type;
+    double value = acm.getDefaultEntry(name1, type) ? static_cast<double>(type) : -1.0;
+    acm_hash = hashValues(hashString(acm_hash, name1), &value, 1);
+    for (const std::string &name2 : entry_names)
+    {
+      value = acm.getEntry(name1, name2, type) ? static_cast<double>(type) : -1.0;
+      acm_hash = hashValues(hashString(acm_hash, name2), &value, 1);
+    }
+  }
+  fingerprint["<allowed collisions>"] = acm_hash;
+
+  // Padding and scaling of the robot links that are collision checked
+  boost::uint64_t padding_hash = empty_hash;
+  for (const std::pair<const std::string, double> &padding : planning_scene_->getCollisionRobot()->getLinkPadding())
+    padding_hash = hashValues(hashString(padding_hash, padding.first), &padding.second, 1);
+  for (const std::pair<const std::string, double> &scale : planning_scene_->getCollisionRobot()->getLinkScale())
+    padding_hash = hashValues(hashString(padding_hash, scale.first), &scale.second, 1);
+  fingerprint["<padding>"] = padding_hash;
+
+  // Clearance required along edges and at vertices
+  const double clearances[2] = { getEdgeClearance(), bolt_->getSparseGraph()->getObstacleClearance() };
+  fingerprint["<clearance>"] = hashValues(empty_hash, clearances, 2);
+
+  // Edges checked with collision checking off must not be trusted once it is turned on
+  if (collision_checking_enabled_)
+    fingerprint["<collision checking>"] = 1;
+
+  return fingerprint;
+}
+
+double BoltMoveIt::getEdgeClearance()
+{
+  ob::DiscreteMotionValidator *dmv = dynamic_cast<ob::DiscreteMotionValidator *>(si_->getMotionValidator().get());
+  return dmv ? dmv->getRequiredStateClearance() : 0.0;
+}
+
+bool BoltMoveIt::edgeTouchesObjects(const ob::State *s1, const ob::State *s2, const std::vector<std::string> &object_ids)
+{
+  // Collision world of only these objects, the same ones are asked about for every edge
+  if (object_ids != changed_object_ids_)
+  {
+    changed_object_ids_ = object_ids;
+    changed_objects_world_.reset();
+
+    collision_detection::WorldPtr world(new collision_detection::World());
+    for (const std::string &id : object_ids)
+    {
+      collision_detection::World::ObjectConstPtr object = planning_scene_->getWorld()->getObject(id);
+      if (!object)  // not a world object, nothing to check against
+        return true;
+      world->addToObject(id, object->shapes_, object->shape_poses_);
+    }
+    changed_objects_world_.reset(new collision_detection::CollisionWorldFCL(world));
+
+    if (!edge_check_state_)
+      edge_check_state_.reset(new moveit::core::RobotState(*current_state_));
+    if (!edge_check_ompl_state_)
+      edge_check_ompl_state_ = space_->allocState();
+  }
+  if (!changed_objects_world_)
+    return true;
+
+  // An edge that must keep a clearance is affected by objects within that distance, not only by contact
+  const double clearance = getEdgeClearance();
+  collision_detection::CollisionRequest request;
+  request.distance = clearance > 0;
+
+  // Sweep the padded robot along the edge at the resolution of the motion validator
+  const unsigned int segments = space_->validSegmentCount(s1, s2);
+  for (unsigned int i = 0; i <= segments; ++i)
+  {
+    space_->interpolate(s1, s2, static_cast<double>(i) / segments, edge_check_ompl_state_);
+    space_->copyToRobotState(*edge_check_state_, edge_check_ompl_state_);
+
+    collision_detection::CollisionResult result;
+    changed_objects_world_->checkRobotCollision(request, result, *planning_scene_->getCollisionRobot(),
+                                                *edge_check_state_);
+    if (result.collision || (request.distance && result.distance < clearance))
+      return true;
+  }
+
+  return false;
+}
+
+boost::uint64_t BoltMoveIt::getVoxel(const Eigen::Vector3d &point)
+{
+  // 21 bits per axis, centered on the origin
+  boost::uint64_t voxel = 0;
+  for (std::size_t i = 0; i < 3; ++i)
+  {
+    const boost::int64_t cell = static_cast<boost::int64_t>(std::floor(point[i] / edge_occupancy_resolution_));
+    voxel = (voxel << 21) | (static_cast<boost::uint64_t>(cell + (1 << 20)) & 0x1FFFFF);
+  }
+  return voxel;
+}
+
+void BoltMoveIt::getSweptVoxels(const ob::State *s1, const ob::State *s2, std::vector<boost::uint64_t> &voxels)
+{
+  if (!sweep_state_)
+    sweep_state_.reset(new moveit::core::RobotState(*current_state_));
+  if (!sweep_ompl_state_)
+    sweep_ompl_state_ = space_->allocState();
+
+  // Links that are never collision checked do not make an edge invalid wherever they pass
+  const collision_detection::AllowedCollisionMatrix &acm = planning_scene_->getAllowedCollisionMatrix();
+  std::vector<const moveit::core::LinkModel *> links;
+  for (const moveit::core::LinkModel *link : planning_jmg_->getLinkModels())
+  {
+    collision_detection::AllowedCollision::Type type;
+    if (!acm.getDefaultEntry(link->getName(), type) || type != collision_detection::AllowedCollision::ALWAYS)
+      links.push_back(link);
+  }
+
+  // The origin of a primitive collision shape is inside of it, so the robot certainly occupies the voxel holding it.
+  // Meshes are skipped because their origin may be outside of the mesh
+  const unsigned int segments = space_->validSegmentCount(s1, s2);
+  for (unsigned int i = 0; i <= segments; ++i)
+  {
+    space_->interpolate(s1, s2, static_cast<double>(i) / segments, sweep_ompl_state_);
+    space_->copyToRobotState(*sweep_state_, sweep_ompl_state_);
+
+    for (const moveit::core::LinkModel *link : links)
+    {
+      const std::vector<shapes::ShapeConstPtr> &shapes = link->getShapes();
+      for (std::size_t j = 0; j < shapes.size(); ++j)
+      {
+        if (!isPrimitiveShape(shapes[j].get()))
+          continue;
+        const Eigen::Affine3d pose =
+            sweep_state_->getGlobalLinkTransform(link) * link->getCollisionOriginTransforms()[j];
+        voxels.push_back(getVoxel(pose.translation()));
+      }
+    }
+  }
+}
+
+std::vector<boost::uint64_t> BoltMoveIt::getObstacleVoxels()
+{
+  std::vector<boost::uint64_t> voxels;
+  const double res = edge_occupancy_resolution_;
+
+  // Links that may have been swept, and the smallest padding the validity checker adds to them. A link origin within
+  // that distance of an obstacle means its padded shape touches the obstacle
+  std::vector<std::string> links;
+  double padding = std::numeric_limits<double>::infinity();
+  for (const moveit::core::LinkModel *link : planning_jmg_->getLinkModels())
+  {
+    const std::vector<shapes::ShapeConstPtr> &shapes = link->getShapes();
+    if (std::none_of(shapes.begin(), shapes.end(), [](const shapes::ShapeConstPtr &shape)
+                     {
+                       return isPrimitiveShape(shape.get());
+                     }))
+      continue;
+    links.push_back(link->getName());
+    padding = std::min(padding, planning_scene_->getCollisionRobot()->getLinkPadding(link->getName()));
+  }
+  padding = links.empty() ? 0.0 : std::max(0.0, padding);
+
+  const collision_detection::AllowedCollisionMatrix &acm = planning_scene_->getAllowedCollisionMatrix();
+  const collision_detection::WorldConstPtr &world = planning_scene_->getWorld();
+  for (const std::string &id : world->getObjectIds())
+  {
+    // The voxels do not record which link passed through them, so an object that any link may touch is skipped
+    if (std::any_of(links.begin(), links.end(), [&acm, &id](const std::string &link)
+                    {
+                      return isCollisionAllowed(acm, link, id);
+                    }))
+      continue;
+
+    collision_detection::World::ObjectConstPtr object = world->getObject(id);
+    for (std::size_t i = 0; i < object->shapes_.size(); ++i)
+    {
+      // Only convex shapes, for which a voxel is inside if all of its corners are
+      const shapes::Shape *shape = object->shapes_[i].get();
+      if (shape->type != shapes::BOX && shape->type != shapes::SPHERE && shape->type != shapes::CYLINDER)
+        continue;
+
+      boost::scoped_ptr<bodies::Body> body(bodies::createBodyFromShape(shape));
+      if (!body)
+        continue;
+      body->setPadding(padding);
+      body->setPose(object->shape_poses_[i]);
+      bodies::BoundingSphere sphere;
+      body->computeBoundingSphere(sphere);
+
+      Eigen::Vector3d min, max;
+      for (std::size_t k = 0; k < 3; ++k)
+      {
+        min[k] = std::floor((sphere.center[k] - sphere.radius) / res);
+        max[k] = std::floor((sphere.center[k] + sphere.radius) / res);
+      }
+
+      for (double x = min.x(); x <= max.x(); ++x)
+        for (double y = min.y(); y <= max.y(); ++y)
+          for (double z = min.z(); z <= max.z(); ++z)
+          {
+            bool inside = true;
+            for (std::size_t corner = 0; corner < 8 && inside; ++corner)
+            {
+              const Eigen::Vector3d point((x + (corner & 1)) * res, (y + ((corner >> 1) & 1)) * res,
+                                          (z + ((corner >> 2) & 1)) * res);
+              inside = body->containsPoint(point);
+            }
+            if (inside)
+              voxels.push_back(getVoxel(Eigen::Vector3d((x + 0.5) * res, (y + 0.5) * res, (z + 0.5) * res)));
+          }
+    }
+  }
+
+  return voxels;
+}
+
 void BoltMoveIt::loadCollisionChecker()
 {
   // Create state validity checking for this space
@@ -1103,11 +1461,122 @@ void BoltMoveIt::mirrorGraph(std::size_t indent)
   // Set callback for how to combine two arms into one state
   bolt_->getSparseMirror()->setCombineStatesCallback(boost::bind(&BoltMoveIt::combineStates, this, _1, _2));
 
+  // Plan on the product of the single arm graph with itself instead of saving it
+  if (implicit_mirror_graph_)
+  {
+    planDualArm(both_arms_space_info, left_arm_space_info, indent);
+    return;
+  }
+
   // Mirror graph
   bolt_->getSparseMirror()->mirrorGraphDualArm(both_arms_space_info, left_arm_space_info, file_path, indent);
   BOLT_INFO(indent, true, "Done mirroring graph!");
 }
 
+void BoltMoveIt::planDualArm(ob::SpaceInformationPtr both_arms_space_info, ob::SpaceInformationPtr left_arm_space_info,
+                             std::size_t indent)
+{
+  BOLT_FUNC(indent, true, "planDualArm()");
+
+  otb::ProductGraph product_graph(bolt_->getSparseMirror(), bolt_->getSparseGraph(), both_arms_space_info,
+                                  left_arm_space_info);
+  BOLT_INFO(indent, true, "Product graph has " << product_graph.getNumVertices() << " vertices");
+
+  // Start from the current pose of both arms, or the start marker, and go to the goal marker. Without markers the
+  // goal is a random pose of the planning group
+  moveit::core::RobotStatePtr start_state = (use_start_imarkers_ && imarker_start_) ? imarker_start_->getRobotState() :
+                                                                                    getCurrentState();
+  moveit::core::RobotStatePtr goal_state;
+  if (imarker_goal_)
+    goal_state = imarker_goal_->getRobotState();
+  else
+  {
+    goal_state.reset(new moveit::core::RobotState(*current_state_));
+    getRandomState(goal_state);
+  }
+
+  // Each arm starts and ends at the nearest pair of single arm vertices
+  otb::ProductVertex start, goal;
+  ob::State* actual_start;
+  ob::State* actual_goal;
+  const bool found_start = findDualArmVertex(product_graph, *start_state, start, actual_start, indent);
+  const bool found_goal = findDualArmVertex(product_graph, *goal_state, goal, actual_goal, indent);
+  if (!found_start || !found_goal)
+  {
+    both_arms_space_info->freeState(actual_start);
+    both_arms_space_info->freeState(actual_goal);
+    return;
+  }
+
+  ros::Time start_time = ros::Time::now();  // Benchmark runtime
+  const ob::PlannerTerminationCondition ptc = ob::timedPlannerTerminationCondition(5 * 60.0);
+  og::PathGeometric graph_path(both_arms_space_info);
+  og::PathGeometric path(both_arms_space_info, actual_start);
+  bool solved = false;
+  if (!both_arms_space_info->isValid(actual_start) || !both_arms_space_info->isValid(actual_goal))
+  {
+    BOLT_WARN(indent, true, "Start or goal of both arms is in collision");
+  }
+  else
+  {
+    solved = product_graph.lazyAstarSearch(start, goal, graph_path, ptc, indent);
+  }
+
+  // Connect the actual start and goal to the ends of the path through the graph
+  if (solved && (!both_arms_space_info->checkMotion(actual_start, graph_path.getState(0)) ||
+                 !both_arms_space_info->checkMotion(graph_path.getStates().back(), actual_goal)))
+  {
+    BOLT_WARN(indent, true, "Unable to connect the start or goal of both arms to the product graph");
+    solved = false;
+  }
+  if (solved)
+  {
+    path.append(graph_path);
+    path.append(actual_goal);
+  }
+  both_arms_space_info->freeState(actual_start);
+  both_arms_space_info->freeState(actual_goal);
+
+  if (!solved)
+  {
+    BOLT_WARN(indent, true, "Unable to find dual arm path");
+    return;
+  }
+  BOLT_INFO(indent, true, "Found dual arm path with " << path.getStateCount() << " states in "
+                                                     << (ros::Time::now() - start_time).toSec() << " seconds, "
+                                                     << product_graph.getNumCachedStates()
+                                                     << " combined states created");
+
+  if (!headless_)
+  {
+    for (std::size_t i = 0; i < path.getStateCount(); ++i)
+    {
+      viz3_->state(path.getState(i), ot::ROBOT, ot::DEFAULT, /*extraData*/ 0, both_arms_space_info);
+      viz3_->trigger();
+      ros::Duration(0.1).sleep();
+    }
+  }
+}
+
+bool BoltMoveIt::findDualArmVertex(otb::ProductGraph& product_graph, const moveit::core::RobotState& robot_state,
+                                   otb::ProductVertex& vertex, ob::State*& both_arms_state, std::size_t indent)
+{
+  ob::State* right_state = si_->allocState();
+  ob::State* left_state = left_arm_state_space_->allocState();
+  ob::State* left_state_mirrored = si_->allocState();
+  space_->copyToOMPLState(right_state, robot_state);
+  left_arm_state_space_->copyToOMPLState(left_state, robot_state);
+  bolt_->getSparseMirror()->mirrorState(left_state, left_state_mirrored, indent);
+
+  const bool found = product_graph.findNearestVertex(right_state, left_state_mirrored, vertex, indent);
+  both_arms_state = combineStates(right_state, left_state);
+
+  si_->freeState(right_state);
+  left_arm_state_space_->freeState(left_state);
+  si_->freeState(left_state_mirrored);
+  return found;
+}
+
 ob::State *BoltMoveIt::combineStates(const ob::State *state1, const ob::State *state2)
 {
   /* Notes:
@@ -1131,11 +1600,15 @@ ob::State *BoltMoveIt::combineStates(const ob::State *state1, const ob::State *s
 
   // Set the vectors for each joint model group
   // TODO: its possible the vectors do not align correctly for some robots, but I'm not sure
-  mirror_state_->setJointGroupPositions(planning_jmg_, values1);
-  mirror_state_->setJointGroupPositions(left_arm_jmg_, values2);
+  {
+    // Called from every thread that is mirroring the graph
+    std::lock_guard<std::mutex> lock(mirror_state_mutex_);
+    mirror_state_->setJointGroupPositions(planning_jmg_, values1);
+    mirror_state_->setJointGroupPositions(left_arm_jmg_, values2);
 
-  // Fill the state with current values
-  both_arms_state_space_->copyToOMPLState(both_arms_state, *mirror_state_);
+    // Fill the state with current values
+    both_arms_state_space_->copyToOMPLState(both_arms_state, *mirror_state_);
+  }
 
   if (false)
   {
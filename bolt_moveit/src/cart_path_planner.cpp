@@ -912,6 +912,9 @@ bool CartPathPlanner::connectTrajectoryEndPoints(const TaskVertexMatrix& point_v
   const TaskVertexPoint& start_vertices = point_vertices.front();
   const TaskVertexPoint& goal_vertices = point_vertices.back();
 
+  // The task graph is built on this thread, so it searches with the first query slot
+  const std::size_t threadID = 0;
+
   // Loop through all start points
   BOLT_INFO(indent, true, "Connecting Cartesian start points to TaskGraph");
   for (const ompl::tools::bolt::TaskVertex& start_vertex : start_vertices)
@@ -919,7 +922,7 @@ bool CartPathPlanner::connectTrajectoryEndPoints(const TaskVertexMatrix& point_v
     // Connect to TaskGraph
     const ompl::tools::bolt::VertexLevel level0 = 0;
     bool isStart = true;
-    if (!task_graph_->connectVertexToNeighborsAtLevel(start_vertex, level0, isStart, indent))
+    if (!task_graph_->connectVertexToNeighborsAtLevel(start_vertex, level0, isStart, threadID, indent))
     {
       BOLT_WARN(indent, true, "Failed to connect start vertex");
       return false;  // TODO(davetcoleman): return here?
@@ -949,7 +952,7 @@ bool CartPathPlanner::connectTrajectoryEndPoints(const TaskVertexMatrix& point_v
     // Connect to TaskGraph
     const ompl::tools::bolt::VertexLevel level2 = 2;
     bool isStart = false;
-    if (!task_graph_->connectVertexToNeighborsAtLevel(goal_vertex, level2, isStart, indent))
+    if (!task_graph_->connectVertexToNeighborsAtLevel(goal_vertex, level2, isStart, threadID, indent))
     {
       BOLT_WARN(indent, true, "Failed to connect goal vertex");
       return false;  // TODO(davetcoleman): return here?
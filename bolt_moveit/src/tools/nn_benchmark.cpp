@@ -0,0 +1,177 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of PickNik LLC nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman
+   Desc:   Compare the nearest neighbor datastructures available to the sparse graph on random joint states
+*/
+
+// OMPL
+#include <ompl/base/spaces/RealVectorStateSpace.h>
+#include <ompl/datastructures/NearestNeighborsGNAT.h>
+#include <ompl/util/Time.h>
+
+// Bolt
+#include <bolt_core/NearestNeighborsFlat.h>
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace otb = ompl::tools::bolt;
+namespace ob = ompl::base;
+
+namespace bolt_moveit
+{
+typedef std::shared_ptr<ompl::NearestNeighbors<otb::SparseVertex> > NearestNeighborsPtr;
+
+/** \brief Time nearestR and nearestK of one datastructure and count results that differ from the reference */
+void benchmarkNearestNeighbors(const std::string &name, NearestNeighborsPtr nn, NearestNeighborsPtr reference,
+                               const std::vector<otb::SparseVertex> &vertices, std::size_t numVertices,
+                               double radius, std::size_t k)
+{
+  ompl::time::point start = ompl::time::now();
+  nn->add(std::vector<otb::SparseVertex>(vertices.begin(), vertices.begin() + numVertices));
+  const double buildTime = ompl::time::seconds(ompl::time::now() - start);
+
+  // The remaining vertices are the queries
+  std::vector<otb::SparseVertex> result;
+  std::vector<otb::SparseVertex> expected;
+  std::size_t numFound = 0;
+  std::size_t numMismatches = 0;
+
+  start = ompl::time::now();
+  for (std::size_t i = numVertices; i < vertices.size(); ++i)
+  {
+    nn->nearestR(vertices[i], radius, result);
+    numFound += result.size();
+  }
+  const double radiusTime = ompl::time::seconds(ompl::time::now() - start);
+
+  start = ompl::time::now();
+  for (std::size_t i = numVertices; i < vertices.size(); ++i)
+    nn->nearestK(vertices[i], k, result);
+  const double kTime = ompl::time::seconds(ompl::time::now() - start);
+
+  // Verify against the reference, order of equally distant results does not matter
+  for (std::size_t i = numVertices; i < vertices.size(); ++i)
+  {
+    nn->nearestK(vertices[i], k, result);
+    reference->nearestK(vertices[i], k, expected);
+    std::sort(result.begin(), result.end());
+    std::sort(expected.begin(), expected.end());
+    numMismatches += (result != expected);
+  }
+
+  const std::size_t numQueries = vertices.size() - numVertices;
+  std::cout << std::setw(10) << name << std::fixed << std::setprecision(4) << "  build: " << buildTime
+            << " s  nearestR: " << radiusTime / numQueries * 1e6 << " us  nearestK: " << kTime / numQueries * 1e6
+            << " us  avg in radius: " << std::setprecision(1) << static_cast<double>(numFound) / numQueries
+            << "  mismatches: " << numMismatches << std::endl;
+}
+
+/** \brief Run all datastructures on random states of a \e dim dimensional joint space */
+void benchmarkDimension(std::size_t dim, std::size_t numVertices, std::size_t numQueries, double sparseDeltaFraction,
+                        std::size_t k)
+{
+  // Joint limits similar to a revolute arm
+  ob::StateSpacePtr space(new ob::RealVectorStateSpace(dim));
+  space->as<ob::RealVectorStateSpace>()->setBounds(-M_PI, M_PI);
+  space->setup();
+
+  // Random states, the first numVertices are inserted and the rest used as queries
+  std::vector<ob::State *> states(numVertices + numQueries);
+  std::vector<otb::SparseVertex> vertices(states.size());
+  ob::StateSamplerPtr sampler = space->allocStateSampler();
+  for (std::size_t i = 0; i < states.size(); ++i)
+  {
+    states[i] = space->allocState();
+    sampler->sampleUniform(states[i]);
+    vertices[i] = i;
+  }
+
+  otb::NearestNeighborsFlat::StateFunction getState = [&states](otb::SparseVertex v)
+  {
+    return states[v];
+  };
+  ompl::NearestNeighbors<otb::SparseVertex>::DistanceFunction distance = [&space, &states](
+      const otb::SparseVertex &a, const otb::SparseVertex &b)
+  {
+    return space->distance(states[a], states[b]);
+  };
+
+  const otb::FlatMetric metric = otb::detectFlatMetric(space);
+  const double radius = sparseDeltaFraction * space->getMaximumExtent();
+  std::cout << "-------------------------------------------------------" << std::endl;
+  std::cout << dim << " DOF, " << numVertices << " vertices, " << numQueries << " queries, radius " << radius
+            << ", k " << k << std::endl;
+
+  NearestNeighborsPtr reference(new otb::NearestNeighborsFlatLinear(space, metric, getState));
+  reference->add(std::vector<otb::SparseVertex>(vertices.begin(), vertices.begin() + numVertices));
+
+  NearestNeighborsPtr gnat(new ompl::NearestNeighborsGNAT<otb::SparseVertex>());
+  gnat->setDistanceFunction(distance);
+  benchmarkNearestNeighbors("gnat", gnat, reference, vertices, numVertices, radius, k);
+
+  NearestNeighborsPtr linear(new otb::NearestNeighborsFlatLinear(space, metric, getState));
+  benchmarkNearestNeighbors("linear", linear, reference, vertices, numVertices, radius, k);
+
+  NearestNeighborsPtr kdTree(new otb::NearestNeighborsFlatKD(space, metric, getState));
+  benchmarkNearestNeighbors("kd_tree", kdTree, reference, vertices, numVertices, radius, k);
+
+  for (std::size_t i = 0; i < states.size(); ++i)
+    space->freeState(states[i]);
+}
+
+}  // namespace bolt_moveit
+
+int main(int argc, char **argv)
+{
+  // Usage: nn_benchmark [num_vertices] [num_queries] [sparse_delta_fraction] [k]
+  const std::size_t numVertices = argc > 1 ? std::atoi(argv[1]) : 10000;
+  const std::size_t numQueries = argc > 2 ? std::atoi(argv[2]) : 1000;
+  const double sparseDeltaFraction = argc > 3 ? std::atof(argv[3]) : 0.1;
+  const std::size_t k = argc > 4 ? std::atoi(argv[4]) : 10;
+
+  // Degrees of freedom of the hilgendorf arm, one baxter arm, and both baxter arms
+  const std::size_t dims[] = { 6, 7, 14 };
+  for (std::size_t dim : dims)
+    bolt_moveit::benchmarkDimension(dim, numVertices, numQueries, sparseDeltaFraction, k);
+
+  return 0;
+}
@@ -0,0 +1,155 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, University of Colorado, Boulder
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of PickNik LLC nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Dave Coleman
+   Desc:   Throughput of state validity checking as the number of threads checking at once grows
+*/
+
+// ROS
+#include <ros/ros.h>
+
+// MoveIt
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit_ompl/model_size_state_space.h>
+
+// Bolt
+#include <bolt_moveit/state_validity_checker.h>
+
+// OMPL
+#include <ompl/base/SpaceInformation.h>
+#include <ompl/util/Time.h>
+
+// C++
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace ob = ompl::base;
+
+namespace bolt_moveit
+{
+/** \brief Check every state \e repeats times, split evenly over \e numThreads threads. Returns checks per second */
+double benchmarkThreads(const ob::SpaceInformationPtr &si, const std::vector<ob::State *> &states,
+                        std::size_t numThreads, std::size_t repeats, std::size_t &numValid)
+{
+  std::atomic<std::size_t> valid(0);
+  std::vector<std::thread> threads;
+
+  ompl::time::point start = ompl::time::now();
+  for (std::size_t t = 0; t < numThreads; ++t)
+  {
+    threads.push_back(std::thread([&, t]()
+                                  {
+                                    std::size_t threadValid = 0;
+                                    for (std::size_t r = 0; r < repeats; ++r)
+                                      for (std::size_t i = t; i < states.size(); i += numThreads)
+                                        threadValid += si->isValid(states[i]);
+                                    valid += threadValid;
+                                  }));
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+  const double duration = ompl::time::seconds(ompl::time::now() - start);
+
+  numValid = valid / repeats;
+  return states.size() * repeats / duration;
+}
+
+}  // namespace bolt_moveit
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "validity_benchmark");
+
+  // Usage: validity_benchmark [planning_group] [num_states] [repeats] [max_threads]
+  const std::string group_name = argc > 1 ? argv[1] : "right_arm";
+  const std::size_t numStates = argc > 2 ? std::atoi(argv[2]) : 1000;
+  const std::size_t repeats = argc > 3 ? std::atoi(argv[3]) : 10;
+  const std::size_t maxThreads =
+      argc > 4 ? std::atoi(argv[4]) : std::max(1u, std::thread::hardware_concurrency());
+
+  // Robot
+  robot_model_loader::RobotModelLoader loader("robot_description");
+  moveit::core::RobotModelPtr robot_model = loader.getModel();
+  if (!robot_model || !robot_model->hasJointModelGroup(group_name))
+  {
+    ROS_ERROR_STREAM("Unable to load robot model with planning group " << group_name);
+    return 1;
+  }
+  planning_scene::PlanningScenePtr planning_scene(new planning_scene::PlanningScene(robot_model));
+  moveit::core::RobotState start_state(robot_model);
+  start_state.setToDefaultValues();
+
+  // Space
+  moveit_ompl::ModelBasedStateSpaceSpecification mbss_spec(robot_model,
+                                                           robot_model->getJointModelGroup(group_name));
+  moveit_ompl::ModelBasedStateSpacePtr space = moveit_ompl::chooseModelSizeStateSpace(mbss_spec);
+  space->setup();
+  ob::SpaceInformationPtr si = std::make_shared<ob::SpaceInformation>(space);
+  si->setStateValidityChecker(ob::StateValidityCheckerPtr(new moveit_ompl::StateValidityChecker(
+      group_name, si, start_state, planning_scene::PlanningSceneConstPtr(planning_scene), space)));
+  si->setup();
+
+  // Random states, the same ones for every thread count
+  std::vector<ob::State *> states(numStates);
+  ob::StateSamplerPtr sampler = space->allocStateSampler();
+  for (std::size_t i = 0; i < states.size(); ++i)
+  {
+    states[i] = space->allocState();
+    sampler->sampleUniform(states[i]);
+  }
+
+  std::cout << "-------------------------------------------------------" << std::endl;
+  std::cout << group_name << ", " << numStates << " states checked " << repeats << " times" << std::endl;
+  double singleThread = 0;
+  for (std::size_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+  {
+    std::size_t numValid;
+    const double checksPerSecond = bolt_moveit::benchmarkThreads(si, states, numThreads, repeats, numValid);
+    if (numThreads == 1)
+      singleThread = checksPerSecond;
+    std::cout << std::setw(4) << numThreads << " threads  " << std::fixed << std::setprecision(0) << std::setw(10)
+              << checksPerSecond << " checks/s  speedup: " << std::setprecision(2) << checksPerSecond / singleThread
+              << "  valid: " << numValid << std::endl;
+  }
+
+  for (std::size_t i = 0; i < states.size(); ++i)
+    space->freeState(states[i]);
+
+  return 0;
+}
@@ -39,9 +39,15 @@
 
 #include <moveit/robot_state/robot_state.h>
 #include <boost/thread.hpp>
+#include <atomic>
 
 namespace moveit_ompl
 {
+/** @class TSStateStorage
+    @brief One scratch RobotState per thread. Each thread is given a small slot number the first time it asks for
+    storage, which indexes an array of states without taking a lock. Slots are handed back when threads exit and
+    reused by later threads together with the state that was created for them, so states are only freed with the
+    storage */
 class TSStateStorage
 {
 public:
@@ -51,8 +57,16 @@ public:
 
   robot_state::RobotState *getStateStorage() const;
 
+  /** \brief Number of threads that can be alive at once and still look up their state without locking */
+  static const std::size_t MAX_THREAD_SLOTS = 256;
+
 private:
   robot_state::RobotState start_state_;
+
+  /** \brief State of the thread owning each slot, only ever written by that thread */
+  mutable std::atomic<robot_state::RobotState *> slot_states_[MAX_THREAD_SLOTS];
+
+  /** \brief Threads that did not get a slot fall back to a locked lookup */
   mutable std::map<boost::thread::id, robot_state::RobotState *> thread_states_;
   mutable boost::mutex lock_;
 };
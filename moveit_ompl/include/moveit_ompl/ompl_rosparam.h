@@ -104,6 +104,15 @@ void loadOMPLParameters(ros::NodeHandle nh, const std::string &name, ompl::tools
     error += !get(name, rpnh, "obstacle_clearance", sparseGraph->obstacleClearance_);
     error += !get(name, rpnh, "save_enabled", sparseGraph->savingEnabled_);
     error += !get(name, rpnh, "super_debug", sparseGraph->superDebug_);
+    error += !get(name, rpnh, "nearest_neighbors", sparseGraph->nearestNeighborsType_);
+    error += !get(name, rpnh, "edge_validity_cache", sparseGraph->useEdgeValidityCache_);
+    error += !get(name, rpnh, "edge_occupancy_index", sparseGraph->useEdgeOccupancyIndex_);
+    error += !get(name, rpnh, "flat_file_format", sparseGraph->getSparseStorage()->useFlatFormat_);
+    error += !get(name, rpnh, "compression/enabled", sparseGraph->getSparseStorage()->useCompressedFormat_);
+    error += !get(name, rpnh, "compression/resolution", sparseGraph->getSparseStorage()->compressionResolution_);
+    error += !get(name, rpnh, "compression/keep_weights", sparseGraph->getSparseStorage()->compressionKeepWeights_);
+    error += !get(name, rpnh, "journal/enabled", sparseGraph->getSparseStorage()->useJournal_);
+    error += !get(name, rpnh, "journal/compaction_ratio", sparseGraph->getSparseStorage()->journalCompactionRatio_);
     error += !get(name, rpnh, "verbose/add", sparseGraph->vAdd_);
     error += !get(name, rpnh, "verbose/search", sparseGraph->vSearch_);
     error += !get(name, rpnh, "visualize/spars_graph", sparseGraph->visualizeSparseGraph_);
@@ -141,6 +150,8 @@ void loadOMPLParameters(ros::NodeHandle nh, const std::string &name, ompl::tools
     error += !get(name, rpnh, "use_quality_criteria", sparseCriteria->useQualityCriteria_);
     error += !get(name, rpnh, "use_direct_connectivity_criteria", sparseCriteria->useDirectConnectivyCriteria_);
     error += !get(name, rpnh, "use_smoothed_path_improvement_rule", sparseCriteria->useSmoothedPathImprovementRule_);
+    error += !get(name, rpnh, "motion_validation_threads", sparseCriteria->numMotionValidationThreads_);
+    error += !get(name, rpnh, "use_speculative_criteria", sparseCriteria->useSpeculativeCriteria_);
     error += !get(name, rpnh, "verbose/criteria", sparseCriteria->vCriteria_);
     error += !get(name, rpnh, "verbose/quality", sparseCriteria->vQuality_);
     error += !get(name, rpnh, "verbose/quality_max_spanner", sparseCriteria->vQualityMaxSpanner_);
@@ -164,6 +175,10 @@ void loadOMPLParameters(ros::NodeHandle nh, const std::string &name, ompl::tools
     error += !get(name, rpnh, "fourth_criteria_after_failures", sparseGenerator->fourthCriteriaAfterFailures_);
     error += !get(name, rpnh, "use_discretized_samples", sparseGenerator->useDiscretizedSamples_);
     error += !get(name, rpnh, "use_random_samples", sparseGenerator->useRandomSamples_);
+    error += !get(name, rpnh, "use_low_dispersion_samples", sparseGenerator->useLowDispersionSamples_);
+    error += !get(name, rpnh, "low_dispersion_start_index", sparseGenerator->lowDispersionStartIndex_);
+    error += !get(name, rpnh, "use_concurrent_insertion", sparseGenerator->useConcurrentInsertion_);
+    error += !get(name, rpnh, "insertion_threads", sparseGenerator->numInsertionThreads_);
     error += !get(name, rpnh, "verify_graph_properties", sparseGenerator->verifyGraphProperties_);
     error += !get(name, rpnh, "verbose", sparseGenerator->verbose_);
     error += !get(name, rpnh, "verbose/guarantees", sparseGenerator->vGuarantees_);
@@ -172,6 +187,8 @@ void loadOMPLParameters(ros::NodeHandle nh, const std::string &name, ompl::tools
   // SparseMirror
   {
     ros::NodeHandle rpnh(nh, "sparse_mirror");
+    error += !get(name, rpnh, "num_threads", sparseMirror->numThreads_);
+    error += !get(name, rpnh, "shard_rows", sparseMirror->shardRows_);
     error += !get(name, rpnh, "verbose/verbose", sparseMirror->verbose_);
   }
 
@@ -198,6 +215,7 @@ void loadOMPLParameters(ros::NodeHandle nh, const std::string &name, ompl::tools
   // BoltPlanner
   {
     ros::NodeHandle rpnh(nh, "bolt_planner");
+    error += !get(name, rpnh, "incremental_search", boltPlanner->useIncrementalSearch_);
     error += !get(name, rpnh, "verbose/verbose", boltPlanner->verbose_);
     error += !get(name, rpnh, "verbose/collision_check", boltPlanner->vCollisionCheck_);
     error += !get(name, rpnh, "visualize/smoothed_trajectory", boltPlanner->visualizeSmoothedTrajectory_);
@@ -210,6 +228,8 @@ void loadOMPLParameters(ros::NodeHandle nh, const std::string &name, ompl::tools
   // CandidateQueue
   {
     ros::NodeHandle rpnh(nh, "candidate_queue");
+    error += !get(name, rpnh, "num_threads", candidateQueue->numThreadsRequested_);
+    error += !get(name, rpnh, "queue_size_per_thread", candidateQueue->queueSizePerThread_);
     error += !get(name, rpnh, "verbose/verbose", candidateQueue->verbose_);
     error += !get(name, rpnh, "verbose/neighbor", candidateQueue->vNeighbor_);
     error += !get(name, rpnh, "verbose/clear", candidateQueue->vClear_);
@@ -35,18 +35,89 @@
 /* Author: Ioan Sucan */
 
 #include <moveit_ompl/detail/threadsafe_state_storage.h>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+/** \brief Slot number of a thread, shared by all TSStateStorage instances. Handed out on first use and returned to
+    the free list when the thread exits */
+class ThreadSlot
+{
+public:
+  ThreadSlot() : slot_(acquire())
+  {
+  }
+
+  ~ThreadSlot()
+  {
+    if (slot_ < moveit_ompl::TSStateStorage::MAX_THREAD_SLOTS)
+    {
+      std::lock_guard<std::mutex> slock(mutex());
+      freeSlots().push_back(slot_);
+    }
+  }
+
+  std::size_t get() const
+  {
+    return slot_;
+  }
+
+private:
+  static std::size_t acquire()
+  {
+    static std::size_t next_slot = 0;
+    std::lock_guard<std::mutex> slock(mutex());
+    if (!freeSlots().empty())
+    {
+      std::size_t slot = freeSlots().back();
+      freeSlots().pop_back();
+      return slot;
+    }
+    if (next_slot < moveit_ompl::TSStateStorage::MAX_THREAD_SLOTS)
+      return next_slot++;
+    return moveit_ompl::TSStateStorage::MAX_THREAD_SLOTS;  // no slot left
+  }
+
+  static std::mutex &mutex()
+  {
+    static std::mutex m;
+    return m;
+  }
+
+  static std::vector<std::size_t> &freeSlots()
+  {
+    static std::vector<std::size_t> free_slots;
+    return free_slots;
+  }
+
+  std::size_t slot_;
+};
+
+std::size_t getThreadSlot()
+{
+  static thread_local ThreadSlot slot;
+  return slot.get();
+}
+}
 
 moveit_ompl::TSStateStorage::TSStateStorage(const robot_model::RobotModelPtr &robot_model) : start_state_(robot_model)
 {
   start_state_.setToDefaultValues();
+  for (std::size_t i = 0; i < MAX_THREAD_SLOTS; ++i)
+    slot_states_[i].store(NULL, std::memory_order_relaxed);
 }
 
 moveit_ompl::TSStateStorage::TSStateStorage(const robot_state::RobotState &start_state) : start_state_(start_state)
 {
+  for (std::size_t i = 0; i < MAX_THREAD_SLOTS; ++i)
+    slot_states_[i].store(NULL, std::memory_order_relaxed);
 }
 
 moveit_ompl::TSStateStorage::~TSStateStorage()
 {
+  for (std::size_t i = 0; i < MAX_THREAD_SLOTS; ++i)
+    delete slot_states_[i].load(std::memory_order_acquire);
   for (std::map<boost::thread::id, robot_state::RobotState *>::iterator it = thread_states_.begin();
        it != thread_states_.end(); ++it)
     delete it->second;
@@ -54,8 +125,21 @@ moveit_ompl::TSStateStorage::~TSStateStorage()
 
 robot_state::RobotState *moveit_ompl::TSStateStorage::getStateStorage() const
 {
+  // Only the thread that owns a slot reads or writes it, so no lock is needed
+  const std::size_t slot = getThreadSlot();
+  if (slot < MAX_THREAD_SLOTS)
+  {
+    robot_state::RobotState *st = slot_states_[slot].load(std::memory_order_acquire);
+    if (!st)
+    {
+      st = new robot_state::RobotState(start_state_);
+      slot_states_[slot].store(st, std::memory_order_release);
+    }
+    return st;
+  }
+
   robot_state::RobotState *st = NULL;
-  boost::mutex::scoped_lock slock(lock_);  /// \todo use Thread Local Storage?
+  boost::mutex::scoped_lock slock(lock_);
   std::map<boost::thread::id, robot_state::RobotState *>::const_iterator it =
       thread_states_.find(boost::this_thread::get_id());
   if (it == thread_states_.end())